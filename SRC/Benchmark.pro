@@ -0,0 +1,39 @@
+#
+# Micro-benchmarks of the operators of the class MyImage, without Qt
+# Adapt the paths to the libraries in the file libraries.pri
+#
+include(libraries.pri)
+
+CONFIG -= qt app_bundle
+CONFIG += console
+unix: LIBS += -lpthread
+
+TARGET = VideoBenchmark
+TEMPLATE = app
+
+SOURCES += benchmark.cpp \
+           myimage.cpp \
+           framebuffer.cpp \
+           framesource.cpp \
+           rawframes.cpp \
+           stagetimer.cpp \
+           scratchpool.cpp \
+           processinggraph.cpp \
+           lutcompositor.cpp \
+           stripexecutor.cpp \
+           frameproducts.cpp \
+           operatorcache.cpp \
+           videoframe.cpp
+
+HEADERS  += myimage.h \
+            framebuffer.h \
+            framesource.h \
+            rawframes.h \
+            stagetimer.h \
+            scratchpool.h \
+            processinggraph.h \
+            lutcompositor.h \
+            stripexecutor.h \
+            frameproducts.h \
+            operatorcache.h \
+            videoframe.h
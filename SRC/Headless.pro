@@ -0,0 +1,49 @@
+#
+# Batch processing of videos and directories of images with the class MyImage, without Qt
+# Adapt the paths to the libraries in the file libraries.pri
+#
+include(libraries.pri)
+
+CONFIG -= qt app_bundle
+CONFIG += console
+unix: LIBS += -lpthread
+
+TARGET = VideoHeadless
+TEMPLATE = app
+
+SOURCES += headless.cpp \
+           myimage.cpp \
+           pipelinespec.cpp \
+           framebuffer.cpp \
+           framesource.cpp \
+           rawframes.cpp \
+           stagetimer.cpp \
+           scratchpool.cpp \
+           processinggraph.cpp \
+           lutcompositor.cpp \
+           stripexecutor.cpp \
+           frameproducts.cpp \
+           operatorcache.cpp \
+           videoframe.cpp \
+           videorecorder.cpp \
+           snapshotwriter.cpp \
+           processingcommands.cpp \
+           sessionlog.cpp
+
+HEADERS  += myimage.h \
+            pipelinespec.h \
+            framebuffer.h \
+            framesource.h \
+            rawframes.h \
+            stagetimer.h \
+            scratchpool.h \
+            processinggraph.h \
+            lutcompositor.h \
+            stripexecutor.h \
+            frameproducts.h \
+            operatorcache.h \
+            videoframe.h \
+            videorecorder.h \
+            snapshotwriter.h \
+            processingcommands.h \
+            sessionlog.h
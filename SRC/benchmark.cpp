@@ -0,0 +1,555 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *   Micro-benchmarks of the operators of the class MyImage (blur, edges, threshold, histogram
+ *   equalization, module photo, transformation, object and motion detection) on synthetic
+ *   frames at several resolutions and for several values of their parameters.
+ *   For every case the time per frame, the time per pixel, the frame rate and the number of
+ *   allocations per frame are measured. The results are written as JSON so that they can be
+ *   compared between two versions of the program.
+ *   No Qt thing here.
+*/
+
+#include "myimage.h"
+#include "framesource.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//+++++++++++++++++++++++++++++++++++++++++++++ COUNT THE ALLOCATIONS
+
+static std::atomic<unsigned long long> heap_allocations(0);
+
+void* operator new(std::size_t size) {
+    heap_allocations++;
+    void *p = std::malloc(size > 0 ? size : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](std::size_t size) {
+    heap_allocations++;
+    void *p = std::malloc(size > 0 ? size : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    std::free(p);
+}
+
+/**
+ * @brief The CountingAllocator class
+ *
+ * Default allocator of the cv::Mat during the benchmark: counts the image buffers
+ * and forwards the work to the standard allocator of OpenCV
+ */
+class CountingAllocator : public cv::MatAllocator
+{
+public:
+    CountingAllocator() : std_allocator(cv::Mat::getStdAllocator()), allocations(0), bytes(0) {}
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override {
+        cv::UMatData *u = this->std_allocator->allocate(dims, sizes, type, data, step, flags, usageFlags);
+        if (data == nullptr && u != nullptr) {
+            this->allocations++;
+            this->bytes += u->size;
+        }
+        return u;
+    }
+
+    bool allocate(cv::UMatData* data, cv::AccessFlag accessflags, cv::UMatUsageFlags usageFlags) const override {
+        return this->std_allocator->allocate(data, accessflags, usageFlags);
+    }
+
+    void deallocate(cv::UMatData* data) const override {
+        this->std_allocator->deallocate(data);
+    }
+
+    void reset() {
+        this->allocations = 0;
+        this->bytes = 0;
+    }
+
+    cv::MatAllocator *std_allocator;
+    mutable std::atomic<unsigned long long> allocations, bytes;
+};
+
+//+++++++++++++++++++++++++++++++++++++++++++++ ACCESS TO THE OPERATORS OF MYIMAGE
+
+/**
+ * @brief The MyImageBenchmark class
+ *
+ * Friend of MyImage: calls the private operators directly on the member image
+ */
+class MyImageBenchmark
+{
+public:
+    static void set_frame(MyImage &img, const cv::Mat &frame) {
+        frame.copyTo(img.input);
+        img.image = img.input;
+        img.products.invalidate();
+    }
+    static void smooth(MyImage &img)     { img.smoothImage(img.image, img.blur_range, img.blur_method); }
+    static void edges(MyImage &img)      { img.detectEdges(); }
+    static void threshold(MyImage &img)  { img.thresholdImage(); }
+    static void histo_eq(MyImage &img)   { img.equalizeHistogram(); }
+    static void photo(MyImage &img)      { img.modulephoto(); }
+    static void transform(MyImage &img)  { img.transformImage(); }
+    static void bw(MyImage &img)         { img.toBlackandWhite(); }
+    static void inverse(MyImage &img)    { img.inverseImage(); }
+    static void tone(MyImage &img)       { img.toneImage(); }
+    static void objects(MyImage &img)    { img.get_object_detected(); }
+    static void motion(MyImage &img)     { img.get_motion_detected(); }
+    static void histogram(MyImage &img)  { img.get_image_histogram(); }
+    static void chain(MyImage &img)      { cv::Mat frame = img.input; img.set_image_content(frame); }
+};
+
+/**
+ * @brief The BenchCase struct
+ *
+ * One operator with one set of parameters
+ */
+struct BenchCase {
+    std::string op;
+    std::string params;
+    std::function<void(MyImage&)> setup;
+    std::function<void(MyImage&)> run;
+};
+
+/**
+ * @brief The BenchResult struct
+ */
+struct BenchResult {
+    std::string op, params, resolution;
+    int width, height, iterations;
+    double median_ms, mean_ms, min_ms, ns_per_pixel, fps;
+    double mat_allocations, mat_bytes, heap_allocations;
+};
+
+/**
+ * @brief create_cases
+ * @return the list of all the operators and of their parameters
+ */
+static std::vector<BenchCase> create_cases() {
+    std::vector<BenchCase> cases;
+    const char* blur_names[] = { "", "blur", "gaussian", "median", "bilateral", "erode", "dilate", "open",
+                                 "close", "gradient", "tophat", "blackhat", "hitmiss" };
+    const int ranges[] = { 3, 5, 9, 15, 31 };
+
+    // smoothImage: 12 methods, sweep of blur_range (the bilateral filter is limited to the small ranges)
+    for (int method=1; method<=12; method++) {
+        for (int r=0; r<5; r++) {
+            int range = ranges[r];
+            if ((method == 4 && range > 9) || (method == 12 && r > 0))
+                continue;
+            BenchCase c;
+            c.op = std::string("smooth/") + blur_names[method];
+            c.params = method == 12 ? "kernel=3" : "range=" + std::to_string(range);
+            c.setup = [method, range](MyImage &img) { img.set_blur_method(method); img.set_size_blur(range); };
+            c.run = MyImageBenchmark::smooth;
+            cases.push_back(c);
+        }
+    }
+
+    // detectEdges: Sobel, Laplacian, Canny
+    const char* edge_names[] = { "", "sobel", "laplacian", "canny" };
+    for (int method=1; method<=3; method++) {
+        BenchCase c;
+        c.op = std::string("edges/") + edge_names[method];
+        c.params = method == 3 ? "threshold=50:ratio=2.5" : "";
+        c.setup = [method](MyImage &img) { img.set_edge_method(method); };
+        c.run = MyImageBenchmark::edges;
+        cases.push_back(c);
+    }
+
+    // thresholdImage: 5 global thresholds, Otsu, triangle, 2 adaptive thresholds with a sweep of the block size
+    const char* threshold_names[] = { "", "binary", "binary_inv", "trunc", "tozero", "tozero_inv",
+                                      "otsu", "triangle", "adaptive_mean", "adaptive_gaussian" };
+    const int blocksizes[] = { 3, 11, 31 };
+    for (int method=1; method<=9; method++) {
+        for (int b=0; b<3; b++) {
+            if (method < 8 && b > 0)
+                continue;
+            int blocksize = blocksizes[b];
+            BenchCase c;
+            c.op = std::string("threshold/") + threshold_names[method];
+            c.params = method >= 8 ? "blocksize=" + std::to_string(blocksize) : "value=127";
+            c.setup = [method, blocksize](MyImage &img) {
+                img.set_threshold_method(method);
+                img.set_threshold_value(127);
+                img.set_threshold_blocksize(blocksize);
+            };
+            c.run = MyImageBenchmark::threshold;
+            cases.push_back(c);
+        }
+    }
+
+    // equalizeHistogram: global and CLAHE
+    for (int method=1; method<=2; method++) {
+        BenchCase c;
+        c.op = method == 1 ? "histeq/global" : "histeq/clahe";
+        c.params = method == 2 ? "tiles=8:clip=2" : "";
+        c.setup = [method](MyImage &img) { img.set_histo_eq_method(method); };
+        c.run = MyImageBenchmark::histo_eq;
+        cases.push_back(c);
+    }
+
+    // modulephoto
+    const char* photo_names[] = { "", "decolor", "denoise", "edge_preserving", "detail_enhance",
+                                  "pencil_sketch", "stylization", "white_balance" };
+#ifdef withxphoto
+    const int photo_methods = 7;
+#else
+    const int photo_methods = 6;
+#endif
+    for (int method=1; method<=photo_methods; method++) {
+        BenchCase c;
+        c.op = std::string("photo/") + photo_names[method];
+        c.params = (method >= 3 && method <= 6) ? "sigmas=60:sigmar=0.45" : "";
+        c.setup = [method](MyImage &img) {
+            img.set_photo_method(method);
+            img.set_photo_sigmas(60);
+            img.set_photo_sigmar(0.45);
+        };
+        c.run = MyImageBenchmark::photo;
+        cases.push_back(c);
+    }
+
+    // transformImage
+    const int angles[] = { 0, 45 };
+    for (int a=0; a<2; a++) {
+        int angle = angles[a];
+        BenchCase c;
+        c.op = "transform/rotation";
+        c.params = "angle=" + std::to_string(angle);
+        c.setup = [angle](MyImage &img) { img.set_transf_method(1); img.set_transf_rotation_value(angle); };
+        c.run = MyImageBenchmark::transform;
+        cases.push_back(c);
+    }
+
+    // Colour operations
+    BenchCase bw;
+    bw.op = "colour/bw";
+    bw.setup = [](MyImage &) {};
+    bw.run = MyImageBenchmark::bw;
+    cases.push_back(bw);
+    BenchCase inverse;
+    inverse.op = "colour/inverse";
+    inverse.setup = [](MyImage &) {};
+    inverse.run = MyImageBenchmark::inverse;
+    cases.push_back(inverse);
+    BenchCase tone;
+    tone.op = "colour/tone";
+    tone.params = "brightness=20:contrast=1.2:gamma=1.5";
+    tone.setup = [](MyImage &img) { img.set_tone_brightness(20); img.set_tone_contrast(1.2); img.set_tone_gamma(1.5); };
+    tone.run = MyImageBenchmark::tone;
+    cases.push_back(tone);
+
+    // Chains of neighbourhood filters in set_image_content(), stage after stage or by bands
+    for (int strips=0; strips<=1; strips++) {
+        BenchCase c;
+        c.op = "chain/blur+sobel+threshold";
+        c.params = "range=9:strips=" + std::to_string(strips);
+        c.setup = [strips](MyImage &img) {
+            img.toggleBlur(true);
+            img.set_blur_method(2);
+            img.set_size_blur(9);
+            img.toggleEdge(true);
+            img.set_edge_method(1);
+            img.toggleThreshold(true);
+            img.set_threshold_method(1);
+            img.set_threshold_value(40);
+            img.set_strip_execution(strips == 1);
+        };
+        c.run = MyImageBenchmark::chain;
+        cases.push_back(c);
+
+        BenchCase a;
+        a.op = "chain/blur+laplacian+adaptive";
+        a.params = "range=5:blocksize=11:strips=" + std::to_string(strips);
+        a.setup = [strips](MyImage &img) {
+            img.toggleBlur(true);
+            img.set_blur_method(1);
+            img.set_size_blur(5);
+            img.toggleEdge(true);
+            img.set_edge_method(2);
+            img.toggleThreshold(true);
+            img.set_threshold_method(8);
+            img.set_threshold_blocksize(11);
+            img.set_strip_execution(strips == 1);
+        };
+        a.run = MyImageBenchmark::chain;
+        cases.push_back(a);
+    }
+
+    // Side outputs: object detection, motion detection, histogram. The detectors are measured at full
+    // resolution and on a copy reduced to 480 pixels wide.
+    const char* object_names[] = { "", "hough_lines", "hough_circles", "harris" };
+    const int analysis_widths[] = { 0, 480 };
+    for (int w=0; w<2; w++) {
+        int width = analysis_widths[w];
+        for (int method=1; method<=3; method++) {
+            BenchCase c;
+            c.op = std::string("objects/") + object_names[method];
+            c.params = "threshold=100:analysis=" + std::to_string(width);
+            c.setup = [method, width](MyImage &img) {
+                img.set_object_detection_method(method);
+                img.set_hough_line_threshold(100);
+                img.set_analysis_width(width);
+            };
+            c.run = MyImageBenchmark::objects;
+            cases.push_back(c);
+        }
+        BenchCase motion;
+        motion.op = "motion/mog2";
+        motion.params = "analysis=" + std::to_string(width);
+        motion.setup = [width](MyImage &img) { img.set_motion_detection_method(1); img.set_analysis_width(width); };
+        motion.run = MyImageBenchmark::motion;
+        cases.push_back(motion);
+    }
+    BenchCase histogram;
+    histogram.op = "histogram";
+    histogram.setup = [](MyImage &) {};
+    histogram.run = MyImageBenchmark::histogram;
+    cases.push_back(histogram);
+
+    return cases;
+}
+
+/**
+ * @brief run_case
+ * @param c: BenchCase the operator to measure
+ * @param frames: vector of cv::Mat the synthetic frames, used in turn
+ * @param min_iterations: integer the minimum number of measured frames
+ * @param min_time: double the minimum measuring time in seconds
+ * @param allocator: CountingAllocator that counts the image buffers
+ * @return the measures
+ */
+static BenchResult run_case(BenchCase &c, std::vector<cv::Mat> &frames, int min_iterations, double min_time,
+                            CountingAllocator &allocator) {
+    MyImage img;
+    c.setup(img);
+
+    // Warm up: first allocations, lazy initializations of OpenCV (and the background of MOG2)
+    for (int i=0; i<2; i++) {
+        MyImageBenchmark::set_frame(img, frames[i % frames.size()]);
+        c.run(img);
+    }
+
+    std::vector<double> durations;
+    unsigned long long mat_allocations = 0, mat_bytes = 0, heap = 0;
+    double total = 0.;
+    while ((int) durations.size() < min_iterations || total < min_time*1000.) {
+        // Copy the input outside of the measure
+        MyImageBenchmark::set_frame(img, frames[durations.size() % frames.size()]);
+
+        allocator.reset();
+        unsigned long long heap_before = heap_allocations;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        c.run(img);
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        heap += heap_allocations - heap_before;
+        mat_allocations += allocator.allocations;
+        mat_bytes += allocator.bytes;
+
+        durations.push_back(elapsed);
+        total += elapsed;
+    }
+
+    BenchResult r;
+    r.op = c.op;
+    r.params = c.params;
+    r.width  = frames[0].cols;
+    r.height = frames[0].rows;
+    r.iterations = (int) durations.size();
+    std::sort(durations.begin(), durations.end());
+    r.median_ms = durations[(durations.size()-1) / 2];
+    r.mean_ms   = total / durations.size();
+    r.min_ms    = durations.front();
+    r.ns_per_pixel = r.median_ms * 1.e6 / ((double) r.width * r.height);
+    r.fps = r.median_ms > 0. ? 1000. / r.median_ms : 0.;
+    r.mat_allocations  = (double) mat_allocations / durations.size();
+    r.mat_bytes        = (double) mat_bytes / durations.size();
+    r.heap_allocations = (double) heap / durations.size();
+    return r;
+}
+
+/**
+ * @brief json_string
+ * @return the string between quotes, with the special characters escaped
+ */
+static std::string json_string(const std::string &s) {
+    std::string out = "\"";
+    for (size_t i=0; i<s.size(); i++) {
+        if (s[i] == '"' || s[i] == '\\')
+            out += '\\';
+        out += s[i];
+    }
+    return out + "\"";
+}
+
+/**
+ * @brief write_json
+ * @param out: ostream where the JSON document is written
+ * @param results: vector of BenchResult all the measures
+ */
+static void write_json(std::ostream &out, std::vector<BenchResult> &results) {
+    char date[64];
+    time_t now = time(nullptr);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+    out << "{\n"
+        << "  \"date\": " << json_string(date) << ",\n"
+        << "  \"opencv\": " << json_string(cv::getVersionString()) << ",\n"
+        << "  \"threads\": " << cv::getNumThreads() << ",\n"
+        << "  \"results\": [\n";
+    char line[1024];
+    for (size_t i=0; i<results.size(); i++) {
+        BenchResult &r = results[i];
+        snprintf(line, sizeof(line),
+                 "    {\"op\": %s, \"params\": %s, \"resolution\": %s, \"width\": %d, \"height\": %d, "
+                 "\"iterations\": %d, \"median_ms\": %.4f, \"mean_ms\": %.4f, \"min_ms\": %.4f, "
+                 "\"ns_per_pixel\": %.4f, \"fps\": %.2f, \"mat_allocations_per_frame\": %.2f, "
+                 "\"mat_bytes_per_frame\": %.0f, \"heap_allocations_per_frame\": %.2f}%s\n",
+                 json_string(r.op).c_str(), json_string(r.params).c_str(), json_string(r.resolution).c_str(),
+                 r.width, r.height, r.iterations, r.median_ms, r.mean_ms, r.min_ms, r.ns_per_pixel, r.fps,
+                 r.mat_allocations, r.mat_bytes, r.heap_allocations, i+1 < results.size() ? "," : "");
+        out << line;
+    }
+    out << "  ]\n}\n";
+}
+
+/**
+ * @brief usage
+ * @param program: string the name of the executable
+ */
+static void usage(const char *program) {
+    std::cout << "Usage: " << program << " [options]\n\n"
+              << "Options:\n"
+              << "  --json <file>          write the results to this file (default: standard output)\n"
+              << "  --resolutions <list>   among 480p,720p,1080p,4K (default: all)\n"
+              << "  --filter <text>        only the operators whose name contains this text, e.g. smooth/ or photo\n"
+              << "  --iterations <N>       minimum number of measured frames per case (default: 5)\n"
+              << "  --min-time <seconds>   minimum measuring time per case (default: 0.3)\n"
+              << "  --threads <N>          number of threads used by OpenCV (default: OpenCV's choice)\n"
+              << "  --list                 print the cases without running them\n" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    std::string json_file, filter, resolutions = "480p,720p,1080p,4K";
+    int min_iterations = 5;
+    double min_time = 0.3;
+    bool list_only = false;
+
+    for (int i=1; i<argc; i++) {
+        std::string option = argv[i];
+        if (option == "--help" || option == "-h") {
+            usage(argv[0]);
+            return 0;
+        }
+        if (option == "--list") {
+            list_only = true;
+            continue;
+        }
+        if (i+1 >= argc) {
+            std::cerr << "Missing value for the option " << option << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+        if      (option == "--json")        json_file = value;
+        else if (option == "--resolutions") resolutions = value;
+        else if (option == "--filter")      filter = value;
+        else if (option == "--iterations")  min_iterations = std::max(1, std::atoi(value.c_str()));
+        else if (option == "--min-time")    min_time = std::atof(value.c_str());
+        else if (option == "--threads")     cv::setNumThreads(std::atoi(value.c_str()));
+        else {
+            std::cerr << "Unknown option " << option << std::endl;
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<BenchCase> all_cases = create_cases(), cases;
+    for (size_t i=0; i<all_cases.size(); i++)
+        if (filter.empty() || all_cases[i].op.find(filter) != std::string::npos)
+            cases.push_back(all_cases[i]);
+    if (list_only) {
+        for (size_t i=0; i<cases.size(); i++)
+            std::cout << cases[i].op << " " << cases[i].params << std::endl;
+        return 0;
+    }
+
+    // Resolutions
+    std::vector<std::pair<std::string, cv::Size> > sizes;
+    std::stringstream list(resolutions);
+    std::string name;
+    while (std::getline(list, name, ',')) {
+        if      (name == "480p")  sizes.push_back(std::make_pair(name, cv::Size(640, 480)));
+        else if (name == "720p")  sizes.push_back(std::make_pair(name, cv::Size(1280, 720)));
+        else if (name == "1080p") sizes.push_back(std::make_pair(name, cv::Size(1920, 1080)));
+        else if (name == "4K")    sizes.push_back(std::make_pair(name, cv::Size(3840, 2160)));
+        else {
+            std::cerr << "Unknown resolution " << name << std::endl;
+            return 1;
+        }
+    }
+
+    CountingAllocator allocator;
+    std::vector<BenchResult> results;
+    for (size_t s=0; s<sizes.size(); s++) {
+        // A few different frames so that the motion detection has something to detect
+        SyntheticSource synthetic(sizes[s].second.width, sizes[s].second.height, 30., 0);
+        if (!synthetic.open()) {
+            std::cerr << "Cannot generate the frames at " << sizes[s].first << std::endl;
+            return 1;
+        }
+        std::vector<cv::Mat> frames(8);
+        for (size_t i=0; i<frames.size(); i++)
+            synthetic.render(frames[i], (long long) i);
+
+        cv::Mat::setDefaultAllocator(&allocator);
+        for (size_t i=0; i<cases.size(); i++) {
+            BenchResult r = run_case(cases[i], frames, min_iterations, min_time, allocator);
+            r.resolution = sizes[s].first;
+            results.push_back(r);
+            fprintf(stderr, "%-6s %-28s %-24s %10.3f ms %8.2f ns/px %8.1f fps %7.1f mat allocs %7.1f heap allocs\n",
+                    r.resolution.c_str(), r.op.c_str(), r.params.c_str(), r.median_ms, r.ns_per_pixel, r.fps,
+                    r.mat_allocations, r.heap_allocations);
+        }
+        cv::Mat::setDefaultAllocator(nullptr);
+    }
+
+    if (json_file.empty()) {
+        write_json(std::cout, results);
+    }
+    else {
+        std::ofstream out(json_file.c_str());
+        if (!out) {
+            std::cerr << "Cannot create the file " << json_file << std::endl;
+            return 1;
+        }
+        write_json(out, results);
+    }
+    return 0;
+}
@@ -3,7 +3,8 @@
  *
  * PURPOSE
  *   Management of the Qthread that takes care of capturing the camera, applying image
- *   processes on it and sending the treated image to the GUI MainWindow through signals
+ *   processes on it and sending the treated image to the GUI MainWindow. The images are handed
+ *   over through triple buffers and the GUI is notified by signals.
  *
  *   Multithreaded implementation. The class captureVideo is solely dedicated to the treatment
  *   of the image and the saving of movies/images to local files.
@@ -11,24 +12,30 @@
 
 #include "capturevideo.h"
 
+#include <limits>
+
 /**
  * @brief captureVideo::captureVideo
  * @param parent: object of class QMainWindow to open QFileDialog windows
- * @param data_lock: object of class QMutex to lock-unlock access to common variables between threads
  *
  * Constructor of the class captureVideo. Initialization of intern variables.
  */
-captureVideo::captureVideo(QMainWindow *parent,QMutex *data_lock) : mainWindowParent(parent),
-                                                                    data_lock(data_lock)
+captureVideo::captureVideo(QMainWindow *parent) : frame_buffer(4, FrameRingBuffer::KEEP_LATEST),
+                                                  frame_grabber(&frame_buffer),
+                                                  requested_groups(1),
+                                                  commands(NB_COMMANDS),
+                                                  recorder_sink(recorder),
+                                                  stream_sink(streamer),
+                                                  snapshot_sink(snapshots),
+                                                  mainWindowParent(parent)
 {
     this->running          = false; // Is this thread running?
-    this->motion_active    = false; // Is motion detection activated?
-    this->objects_active   = false; // Is object detection activated?
     this->qrdecoder_active = false; // Is QR decoder activated?
-    this->histo_active     = false; // Is histogram activated?
+    this->profiling_active = false; // Are the durations of the stages displayed?
     this->panorama_active  = false; // Is panorama stitching activated?
 
-    this->camID = -1;
+    this->source  = nullptr; // Where the frames come from (camera, video file, ...)
+    this->myFrame = nullptr;
 
     // Initializations
     this->main_directory = QCoreApplication::applicationDirPath().toStdString();
@@ -46,6 +53,43 @@ captureVideo::captureVideo(QMainWindow *parent,QMutex *data_lock) : mainWindowPa
     this->video_out_name = this->main_directory + "my_video.avi";
     this->cameraFPS = 20.;
     this->cameraFPScalculated = false;
+    this->stream_pipeline = "appsrc ! videoconvert ! x264enc tune=zerolatency speed-preset=ultrafast ! "
+                            "rtph264pay ! udpsink host=127.0.0.1 port=5000";
+
+    // Where the frames go. The main window always shows the processed image, the windows of the side
+    // outputs are active while they are shown (see applyCommands()), the others while they run.
+    this->frame_sink.set_active(true);
+    this->frame_sink.set_notification([this]() { emit frameCaptured(); });
+    this->motion_sink.set_notification([this]() { emit motionCaptured(); });
+    this->objects_sink.set_notification([this]() { emit objectsCaptured(); });
+    this->histo_sink.set_notification([this]() { emit histogramCaptured(); });
+    this->sinks.subscribe(&this->motion_sink,   FrameSink::TAP_MOTION);
+    this->sinks.subscribe(&this->objects_sink,  FrameSink::TAP_OBJECTS);
+    this->sinks.subscribe(&this->histo_sink,    FrameSink::TAP_HISTOGRAM);
+    this->sinks.subscribe(&this->recorder_sink, FrameSink::TAP_OUTPUT);
+    this->sinks.subscribe(&this->stream_sink,   FrameSink::TAP_OUTPUT);
+    this->sinks.subscribe(&this->snapshot_sink, FrameSink::TAP_OUTPUT);
+#if QT_VERSION < QT_VERSION_CHECK(5, 14, 0)
+    // QImage has no BGR format: the channels of the displayed frames are swapped in their copy
+    std::function<VideoFrame(const VideoFrame&)> conversion = [this](const VideoFrame &frame) {
+        return toDisplayFrame(frame);
+    };
+    this->frame_sink.set_conversion(conversion);
+    this->motion_sink.set_conversion(conversion);
+    this->objects_sink.set_conversion(conversion);
+    this->histo_sink.set_conversion(conversion);
+#endif
+}
+
+/**
+ * @brief captureVideo::~captureVideo
+ *
+ * Destructor of the class captureVideo. Stop grabbing and delete the source of frames.
+ */
+captureVideo::~captureVideo() {
+    this->pipeline.stop();
+    this->frame_grabber.stop();
+    delete this->source;
 }
 
 /**
@@ -65,18 +109,47 @@ void captureVideo::setParent(QMainWindow *parent) {
  * Set the ID number of the camera to open
  */
 void captureVideo::setCamera(int camera){
-    this->camID = camera;
+    setSource(new CameraSource(camera));
+}
+
+/**
+ * @brief captureVideo::setSource
+ * @param new_source: FrameSource the new source of frames (camera, video file, directory of images, synthetic)
+ *
+ * Replace the source of frames. captureVideo takes the ownership of new_source. The source is opened by openCamera()
+ */
+void captureVideo::setSource(FrameSource *new_source){
+    // The processing thread must not use the old source anymore: stop it, then close the old source
+    // with its recordings before it is deleted
+    if (isRunning() && QThread::currentThread() != this) {
+        this->running = false;
+        wait();
+    }
+    closeCamera();
+    if (this->source != nullptr && this->source != new_source)
+        delete this->source;
+    this->source = new_source;
+}
+
+/**
+ * @brief captureVideo::getSourceName
+ * @return a description of the actual source of frames
+ */
+QString captureVideo::getSourceName(){
+    if (this->source == nullptr)
+        return QString();
+    return QString::fromStdString(this->source->get_name());
 }
 
 /**
  * @brief captureVideo::openCamera
  * @param integers width and height passed as parameters are set when the camera is opened
- * @return true if the camera is open. False if the camera ID is not set yet
+ * @return true if the camera is open. False if the source of frames is not set yet
  *
- * Open the camera anad initialize a new object of class MyImage
+ * Open the camera (or any other source of frames) and initialize a new object of class MyImage
  */
 bool captureVideo::openCamera(int &width, int &height){
-    if (this->camID<0) {
+    if (this->source == nullptr) {
         qDebug() << "captureVideo::openCamera - Cannot open camera";
         return false;
     }
@@ -85,6 +158,9 @@ bool captureVideo::openCamera(int &width, int &height){
     // Create a new OpenCV MyImage, don't initialize it in the constructor otherwise
     // myFrame is owned by mainWindow
     this->myFrame = new MyImage();
+    // The processed image is shared with the sinks: the boxes of the motion are only drawn on the display
+    this->myFrame->set_motion_boxes_drawn(false);
+    this->command_state.assign(NB_COMMANDS, std::numeric_limits<double>::quiet_NaN());
     
 #ifdef withobjdetect
     // Set the cascade file for face detection
@@ -108,13 +184,19 @@ bool captureVideo::openCamera(int &width, int &height){
         return false;
     }
     
-    // Open the camera in OpenCV
-    bool test = this->capture.open(this->camID);
+    // Open the camera (or the video file, ...) in OpenCV
+    bool test = this->source->open();
     
     // Get the dimensions of the camera frame
     if (test) {
-        width  = capture.get(cv::CAP_PROP_FRAME_WIDTH);
-        height = capture.get(cv::CAP_PROP_FRAME_HEIGHT);
+        this->frame_size = this->source->get_size();
+        width  = this->frame_size.width;
+        height = this->frame_size.height;
+
+        // Preallocate the ring buffer and launch the thread that grabs the frames
+        this->frame_buffer.allocate(this->frame_size, CV_8UC3);
+        this->frame_buffer.reset_counters();
+        test = this->frame_grabber.start(this->source);
     }
     
     return test;
@@ -125,20 +207,27 @@ bool captureVideo::openCamera(int &width, int &height){
  * @return true if everything went well. False otherwise.
  *
  * Close the camera and delete the object of class MyImage. Close also the current movie if active.
+ * The cleanup does not depend on the state of the source: a video file that has ended is not open anymore.
  */
 bool captureVideo::closeCamera() {
-    if (cameraIsOpen()){
-        this->capture.release();
-
-        // Delete object of class MyImage
-        if (this->myFrame != nullptr ) {
-            delete this->myFrame ;
-            this->myFrame = nullptr ;
-        }
-
-        // Stop saving the movie
-        if (this->recording) file_save_movie(false);
+    // Stop the pipelined processing and the grabbing before releasing the camera
+    this->pipeline.stop();
+    this->frame_grabber.stop();
+    if (cameraIsOpen())
+        this->source->release();
+
+    // Delete object of class MyImage
+    if (this->myFrame != nullptr ) {
+        delete this->myFrame ;
+        this->myFrame = nullptr ;
     }
+
+    // Stop saving the movie
+    if (this->recording) file_save_movie(false);
+    if (this->motion_recorder.isRunning()) file_save_motion(false);
+    if (this->raw_writer.isRunning()) file_save_raw(false);
+    if (this->session.isRunning() || this->session.isRequested()) file_save_session(false);
+    if (this->streamer.isRunning()) file_stream(false);
     return true;
 }
 
@@ -147,7 +236,7 @@ bool captureVideo::closeCamera() {
  * @return the status of the camera
  */
 bool captureVideo::cameraIsOpen(){
-    return this->capture.isOpened();
+    return this->source != nullptr && this->source->isOpened();
 }
 
 #ifdef withzbar
@@ -176,45 +265,108 @@ void captureVideo::run() {
     const int count_2_read = 100; // 100 frames to compute the FPS
     int current_count = 0;
     bool first_time = true;
+    unsigned long long frame_count = 0, sequence = 0;
+    std::chrono::steady_clock::time_point loop_start, processing_start;
 
     // While loop as long as running is true
     while (this->running) {
+        loop_start = std::chrono::steady_clock::now();
+        bool measured = false, recorded = false;
+        unsigned long long result_hash = 0;
+        int side_outputs = 0;
+        VideoFrame frame;
+
+        // Take the parameters changed from the GUI, the whole frame is processed with the same ones
+        applyCommands();
+        applyRequests();
+
         if(cameraIsOpen()) {
             if (first_time){
                 timer.start();
                 first_time = false;
             }
-            // capture the camera frame and save it in imageMat
-            this->capture >> imageMat;
-            // Stay in the while loop as long as the camera has not started
-            while (imageMat.empty()) {
-                this->capture >> imageMat;
-                qDebug() << "captureVideo::run() : Empty image";
+            // A session begins with the current parameters and without the history of the previous frames
+            if (this->session.isRequested()) {
+                if (this->session.begin(this->command_state)) {
+                    this->myFrame->reset_history();
+                    emit changeInfo("Recording the session under "+QString::fromStdString(this->session.get_filename()));
+                }
+                else
+                    emit changeInfo(QString::fromStdString(this->session.get_error()));
+            }
+            // Switch between the sequential and the pipelined processing at a frame boundary
+            updatePipeline();
+
+            // Get the freshest frame from the grabbing thread, the previous buffer of imageMat
+            // is given back to the ring buffer. In pipelined mode, the frame has already been
+            // through the first stages and only the last group is left to myFrame.
+            bool received = this->pipeline.isRunning() ? this->pipeline.pop(imageMat, 100)
+                                                       : this->frame_buffer.pop(imageMat, 100);
+            if (!received) {
+                qDebug() << "captureVideo::run() : No frame received from the camera";
+                continue;
             }
 
+            // The input of the processing is recorded before MyImage modifies it. A session that lost
+            // a frame is stopped, the log and the raw file would not match anymore.
+            bool session_running = this->session.isRunning();
+            recorded = this->session.record_frame(imageMat);
+            if (session_running && !recorded && !this->session.get_error().empty()) {
+                this->session.stop();
+                emit changeInfo(QString::fromStdString(this->session.get_error()));
+            }
+
+            // The input and the stages are only tapped in the sequential mode (see updatePipeline())
+            bool sequential = !this->pipeline.isRunning();
+            // MyImage writes into the input, this tap needs its own copy
+            if (sequential && this->sinks.isWanted(FrameSink::TAP_INPUT))
+                this->sinks.publish(FrameSink::TAP_INPUT, -1, this->frame_pool.create(imageMat, sequence));
+            unsigned int stage_taps = sequential ? this->sinks.get_stage_taps() : 0;
+            this->myFrame->set_stage_taps(stage_taps, &this->frame_pool);
+
             // Send the frame to the class MyImage for post-processing
+            processing_start = std::chrono::steady_clock::now();
+            measured = true;
             this->myFrame->set_image_content(imageMat);
+            for (int stage=0; stage_taps != 0 && stage<MyImage::NB_STAGES; stage++) {
+                if (!(stage_taps & MyImage::stage_bit(stage)))
+                    continue;
+                // Copied once by MyImage into a buffer of the pool, which the frame takes over
+                cv::Mat tap = this->myFrame->take_stage_tap(stage);
+                if (!tap.empty())
+                    this->sinks.publish(FrameSink::TAP_STAGE, stage, this->frame_pool.freeze(tap, sequence));
+            }
 
             // Get the image after post-processing
             imageMat = myFrame->get_image_content();
-            imageMat.copyTo(this->currentMat);
+            if (recorded)
+                result_hash = SessionRecorder::hash(imageMat);
+
+            // The processed image itself, without any copy, shared by the display, the recorders and the
+            // snapshots. MyImage and the ring buffers never write into a buffer still referenced.
+            frame = VideoFramePool::share(imageMat, sequence++);
+
+            // Snapshots, recorded video and stream of the processed image, unless they are moved to
+            // another tap (see setTap()). The frames are encoded and saved by their own threads.
+            this->sinks.publish(FrameSink::TAP_OUTPUT, -1, frame);
+            std::string report;
+            if (this->snapshots.take_report(report))
+                emit changeInfo(QString::fromStdString(report));
             
-            // Record the video
-            if (this->recording) {
-                this->video_out << imageMat; // save the image before the colour conversion
-                if (this->record_time_blink <= 20) // Display a blinking red circle
-                    cv::circle(imageMat,cv::Point(20,20),15, cv::Scalar(0,0,255), -1, 8);
-                this->record_time_blink ++;
-                if (this->record_time_blink >= 40)
-                    this->record_time_blink = 0;
-            }
+            // Record the events of motion, the motion area comes from the last detection
+            if (this->motion_recorder.isRunning() &&
+                this->motion_recorder.push(frame.get_image(), this->myFrame->get_motion_area()))
+                emit changeInfo("Motion detected: recording the event "+
+                                QString::number(this->motion_recorder.get_events()));
             current_count ++;
             if (current_count == count_2_read) {
                 // Compute the FPS
                 int elapsed_ms = timer.elapsed();
                 this->cameraFPS = count_2_read / (elapsed_ms / 1000.0) ;
                 this->cameraFPScalculated = true;
-                emit changeInfo("The FPS of the camera has been computed: "+QString::number(this->cameraFPS));
+                emit changeInfo("The FPS of the camera has been computed: "+QString::number(this->cameraFPS)+
+                                " ("+QString::number(getDroppedFrames())+" frames dropped, "+
+                                QString::number(getDisplayDroppedFrames())+" not displayed)");
 //                emit this->setFPSrate(this->cameraFPS);
             }
         }
@@ -223,48 +375,83 @@ void captureVideo::run() {
             imageMat = cv::Mat::zeros(480, 640, CV_8UC1);
             myFrame->set_image_content(imageMat);
             imageMat = myFrame->get_image_content();
+            frame = VideoFramePool::share(imageMat, sequence++);
         }
 
-        // Convert the opencv image to a QImage that will be displayed on the main window
-        // The first step is to convert the colour from BGR to RGB
-        cv::cvtColor(imageMat, imageMat, cv::COLOR_BGR2RGB);
-
-        // Lock mechanism to ensure that the data is not overwritten by another thread
-        this->data_lock->lock();
-        // Create the QImage on the basis of the data from the OpenCV image
-        this->myQimage = QImage(imageMat.data, imageMat.cols, imageMat.rows, imageMat.cols*3, QImage::Format_RGB888);
-        // Unlock the data
-        this->data_lock->unlock();
-        
-        // Launch the motion detection algorithm and send the result to the Qt manager
-        if (this->motion_active) {
-            cv::Mat motionMat = this->myFrame->get_motion_detected();
-            this->data_lock->lock();
-            this->motionQimage = QImage(motionMat.data, motionMat.cols, motionMat.rows, motionMat.cols*3, QImage::Format_RGB888);
-            this->data_lock->unlock();
-            emit motionCaptured(&this->motionQimage);
+        // The analyzers run less often when the frame rate cannot be held (see QualityGovernor)
+        bool analyze = frame_count++ % this->governor.get_cadence() == 0;
+
+        // Launch the motion detection algorithm and send the result to the sinks subscribed to it.
+        // The recording of the events of motion needs it even if nobody else does. The side outputs
+        // are shared like the processed image: MyImage rewrites them in new buffers while they are held.
+        bool motion_wanted = this->sinks.isWanted(FrameSink::TAP_MOTION);
+        if ((motion_wanted || this->motion_recorder.isRunning()) && analyze) {
+            cv::Mat &motion = this->myFrame->get_motion_detected();
+            if (motion_wanted)
+                this->sinks.publish(FrameSink::TAP_MOTION, -1, VideoFramePool::share(motion, frame.get_sequence()));
+            side_outputs |= SIDE_MOTION;
         }
 
-        // Launch the object detection algorithm and send the result to the Qt manager
-        if (this->objects_active) {
-            cv::Mat objectsMat = this->myFrame->get_object_detected();
-            this->data_lock->lock();
-            this->objectsQimage = QImage(objectsMat.data, objectsMat.cols, objectsMat.rows, objectsMat.cols*3, QImage::Format_RGB888);
-            this->data_lock->unlock();
-            emit objectsCaptured(&this->objectsQimage);
+        // Launch the object detection algorithm and send the result to the sinks subscribed to it
+        if (this->sinks.isWanted(FrameSink::TAP_OBJECTS) && analyze) {
+            this->sinks.publish(FrameSink::TAP_OBJECTS, -1,
+                                VideoFramePool::share(this->myFrame->get_object_detected(), frame.get_sequence()));
+            side_outputs |= SIDE_OBJECTS;
         }
         
-        // Launch the histogram equalization algorithm and send the result to the Qt manager
-        if (this->histo_active) {
-            cv::Mat histoMat = this->myFrame->get_image_histogram();
-            this->data_lock->lock();
-            this->histoQimage = QImage(histoMat.data, histoMat.cols, histoMat.rows, histoMat.cols*3, QImage::Format_RGB888);
-            this->data_lock->unlock();
-            emit histogramCaptured(&this->histoQimage);
+        // Compute the histogram and send it to the sinks subscribed to it
+        if (this->sinks.isWanted(FrameSink::TAP_HISTOGRAM) && analyze) {
+            this->sinks.publish(FrameSink::TAP_HISTOGRAM, -1,
+                                VideoFramePool::share(this->myFrame->get_image_histogram(), frame.get_sequence()));
+            side_outputs |= SIDE_HISTOGRAM;
         }
+
+        // The side outputs depend on the cadence of the analyzers, the replay must compute the same ones
+        if (recorded)
+            this->session.record_result(result_hash, side_outputs);
         
-        // Send the main image to the Qt manager
-        emit frameCaptured(&this->myQimage);
+        // Send the durations of the stages to the Qt manager a few times per second
+        if (this->profiling_active && this->myFrame->get_profiler().get_frame() % 15 == 0)
+            sendProfile();
+
+        // The recording mark is drawn after the detectors, they must not see it
+        bool marked = false;
+        if (measured && (this->recording || this->motion_recorder.isRecording() || this->session.isRunning() ||
+                         this->streamer.isRunning())) {
+            marked = this->record_time_blink <= 20; // Display a blinking red circle
+            this->record_time_blink ++;
+            if (this->record_time_blink >= 40)
+                this->record_time_blink = 0;
+        }
+
+        // Send the main image to the Qt manager. Only the display shows the boxes of the motion and the
+        // mark: it gets its own copy to draw them, the shared frame stays as recorded.
+        if (marked || (side_outputs & SIDE_MOTION)) {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+            cv::Scalar red(0, 0, 255);
+#else
+            cv::Scalar red(255, 0, 0);      // the copy for the display is RGB
+#endif
+            cv::Mat annotated = toDisplayBuffer(imageMat);
+            if (side_outputs & SIDE_MOTION) {
+                const std::vector<cv::Rect> &boxes = this->myFrame->get_motion_boxes();
+                for (size_t i=0; i<boxes.size(); i++)
+                    cv::rectangle(annotated, boxes[i], red, 1);
+            }
+            if (marked)
+                cv::circle(annotated,cv::Point(20,20),15, red, -1, 8);
+            this->frame_sink.show(this->frame_pool.freeze(annotated, frame.get_sequence()));
+        }
+        else
+            this->frame_sink.consume(frame);
+
+        // Adapt the quality to the processing time of the frame, then respect the maximum frame rate
+        std::chrono::steady_clock::time_point loop_end = std::chrono::steady_clock::now();
+        if (measured && this->governor.update(std::chrono::duration<double, std::milli>(loop_end - processing_start).count()))
+            applyQuality();
+        int pause = this->governor.get_sleep_ms(std::chrono::duration<double, std::milli>(loop_end - loop_start).count());
+        if (pause > 0)
+            msleep(pause);
         
     } // end of big while on running
     closeCamera();
@@ -291,7 +478,7 @@ void captureVideo::setThreadStatus(bool state){
  * Activate/desactivate the conversion to Black & White
  */
 void captureVideo::toggleBW(bool state){
-    this->myFrame->toggleBW(state) ;
+    this->commands.post(CMD_BW, state);
     if (state)
         emit changeInfo("Black and White activated");
     else
@@ -305,7 +492,7 @@ void captureVideo::toggleBW(bool state){
  * Activate/desactivate the inversion of the colours
  */
 void captureVideo::toggleInverse(bool state){
-    this->myFrame->toggleInverse(state) ;
+    this->commands.post(CMD_INVERSE, state);
     if (state)
         emit changeInfo("Inversed colours activated");
     else
@@ -319,7 +506,7 @@ void captureVideo::toggleInverse(bool state){
  * Activate/desactivate the blurring of the image
  */
 void captureVideo::toggleBlur(bool state) {
-    this->myFrame->toggleBlur(state);
+    this->commands.post(CMD_BLUR, state);
     if (state)
         emit changeInfo("Blur filter activated");
     else
@@ -333,7 +520,7 @@ void captureVideo::toggleBlur(bool state) {
  * Activate/desactivate the thresholding
  */
 void captureVideo::toggleThreshold(bool state) {
-    this->myFrame->toggleThreshold(state);
+    this->commands.post(CMD_THRESHOLD, state);
     if (state)
         emit changeInfo("Threshold activated");
     else
@@ -347,7 +534,7 @@ void captureVideo::toggleThreshold(bool state) {
  * Activate/desactivate the edge detection algorithm
  */
 void captureVideo::toggleEdge(bool state) {
-    this->myFrame->toggleEdge(state);
+    this->commands.post(CMD_EDGE, state);
     if (state)
         emit changeInfo("Edge detection activated");
     else
@@ -361,8 +548,7 @@ void captureVideo::toggleEdge(bool state) {
  * Activate/desactivate the motion detection algorithm
  */
 void captureVideo::toggleMotionDetection(bool state) {
-    this->myFrame->toggleMotionDetection(state);
-    this->motion_active = state;
+    this->commands.post(CMD_MOTION, state);
     if (state)
         emit changeInfo("Motion detection activated");
     else
@@ -377,7 +563,7 @@ void captureVideo::toggleMotionDetection(bool state) {
  * Activate/desactivate the face detection algorithm. A background image is fetch from a local directory
  */
 void captureVideo::toggleFaceDetection(bool state) {
-    this->myFrame->toggleFace_Recon(state);
+    this->commands.post(CMD_FACE, state);
     if (state)
         emit changeInfo("Face detection activated");
     else
@@ -392,8 +578,7 @@ void captureVideo::toggleFaceDetection(bool state) {
  * Activate/desactivate the object detection algorithm for lines, circles and points
  */
 void captureVideo::toggleObjectDetection(bool state) {
-    this->myFrame->toggleObjectDetection(state);
-    this->objects_active = state;
+    this->commands.post(CMD_OBJECTS, state);
     if (state)
         emit changeInfo("Point/line/circle detection activated");
     else
@@ -408,8 +593,7 @@ void captureVideo::toggleObjectDetection(bool state) {
  * Activate/desactivate the ZBar decoding of QR codes and barcodes
  */
 void captureVideo::toggleQRcode(bool state){
-    this->myFrame->toggleQRcode(state);
-    this->qrdecoder_active = state;
+    this->commands.post(CMD_QRCODE, state);
     if (state)
         emit changeInfo("QR code detection activated");
     else
@@ -424,7 +608,7 @@ void captureVideo::toggleQRcode(bool state){
  * Activate/desactivate the geometrical transformations (rotations, etc.)
  */
 void captureVideo::toggleTransformation(bool state){
-    this->myFrame->toggleTransformation(state);
+    this->commands.post(CMD_TRANSFORMATION, state);
     if (state)
         emit changeInfo("Transformations activated");
     else
@@ -438,7 +622,7 @@ void captureVideo::toggleTransformation(bool state){
  * Activate/desactivate the histogram equalization + show histogram
  */
 void captureVideo::toggleHistogramEqualization(bool state){
-    this->myFrame->toggleHistoEq(state);
+    this->commands.post(CMD_HISTO_EQ, state);
     if (state)
         emit changeInfo("Histogram equalization activated");
     else
@@ -453,8 +637,7 @@ void captureVideo::toggleHistogramEqualization(bool state){
  * Activate/desactivate the image stitching operation
  */
 void captureVideo::togglePanorama(bool state){
-    this->myFrame->togglePanorama(state);
-    this->panorama_active = state;
+    this->commands.post(CMD_PANORAMA, state);
     if (state)
         emit changeInfo("Panorama creation activated");
     else
@@ -469,92 +652,103 @@ void captureVideo::togglePanorama(bool state){
  * Activate/desactivate the photo module
  */
 void captureVideo::togglePhoto(bool state) {
-    this->myFrame->togglePhoto(state);
+    this->commands.post(CMD_PHOTO, state);
     if (state)
         emit changeInfo("Module Photo activated");
     else
         emit changeInfo("Module Photo desactivated");
 }
 
+/**
+ * @brief captureVideo::toggleTone
+ * @param state: boolean ON/OFF
+ *
+ * Activate/desactivate the brightness/contrast/gamma correction
+ */
+void captureVideo::toggleTone(bool state) {
+    this->commands.post(CMD_TONE, state);
+    if (state)
+        emit changeInfo("Brightness/contrast activated");
+    else
+        emit changeInfo("Brightness/contrast desactivated");
+}
+
 //+++++++++++++++++++++++++++++++++++++++++++++ FUNCTIONS THAT CHANGE VALUES
 // Their purposes are pretty explicit
 void captureVideo::change_blur_range(int value) {
-    this->myFrame->set_size_blur(value);
+    this->commands.post(CMD_BLUR_RANGE, value);
 }
 
 void captureVideo::change_blur_method(int method) {
-    this->myFrame->set_blur_method(method);
+    this->commands.post(CMD_BLUR_METHOD, method);
 }
 
 void captureVideo::change_blur_element(int element) {
-    this->myFrame->set_morpho_element(element);
+    this->commands.post(CMD_BLUR_ELEMENT, element);
 }
 
 void captureVideo::change_threshold_value(int value) {
-    this->myFrame->set_threshold_value(value);
+    this->commands.post(CMD_THRESHOLD_VALUE, value);
 }
 
 void captureVideo::change_threshold_method(int method){
-    this->myFrame->set_threshold_method(method);
+    this->commands.post(CMD_THRESHOLD_METHOD, method);
 }
 
 void captureVideo::change_threshold_blocksize(int value){
-    this->myFrame->set_threshold_blocksize(value);
+    this->commands.post(CMD_THRESHOLD_BLOCKSIZE, value);
 }
 
 void captureVideo::change_threshold_type(int type){
-    if (type == Qt::Checked)
-        this->myFrame->set_threshold_type(1);
-    else
-        this->myFrame->set_threshold_type(0);
+    this->commands.post(CMD_THRESHOLD_TYPE, type == Qt::Checked ? 1 : 0);
 }
 
 void captureVideo::change_edge_method(int method) {
-    this->myFrame->set_edge_method(method);
+    this->commands.post(CMD_EDGE_METHOD, method);
 }
 
 void captureVideo::change_edge_canny_lowthreshold(int value) {
-    this->myFrame->set_canny_threshold(value);
+    this->commands.post(CMD_CANNY_THRESHOLD, value);
 }
 
 void captureVideo::change_edge_canny_ratio(double value) {
-    this->myFrame->set_canny_ratio(value);
+    this->commands.post(CMD_CANNY_RATIO, value);
 }
 
 void captureVideo::change_motion_detection_method(int method){
-    this->myFrame->set_motion_detection_method(method);
+    this->commands.post(CMD_MOTION_METHOD, method);
 }
 
 void captureVideo::change_object_detection_method(int method){
-    this->myFrame->set_object_detection_method(method);
+    this->commands.post(CMD_OBJECTS_METHOD, method);
 }
 
 void captureVideo::change_object_hough_line_threshold(int value){
-    this->myFrame->set_hough_line_threshold(value);
+    this->commands.post(CMD_HOUGH_THRESHOLD, value);
 }
 
 void captureVideo::change_transformation_method(int method){
-    this->myFrame->set_transf_method(method);
+    this->commands.post(CMD_TRANSF_METHOD, method);
 }
 
 void captureVideo::change_transformation_value_rotation(int value) {
-    this->myFrame->set_transf_rotation_value(value);
+    this->commands.post(CMD_TRANSF_ROTATION, value);
 }
 
 void captureVideo::change_histogram_method(int method){
-    this->myFrame->set_histo_eq_method(method);
+    this->commands.post(CMD_HISTO_METHOD, method);
 }
 
 void captureVideo::change_histogram_tiles(int value){
-    this->myFrame->set_histo_eq_tiles(value);
+    this->commands.post(CMD_HISTO_TILES, value);
 }
 
 void captureVideo::change_histogram_clip_limit(int value){
-    this->myFrame->set_histo_eq_clip_limit(value);
+    this->commands.post(CMD_HISTO_CLIP, value);
 }
 
 void captureVideo::change_histogram_show(bool state){
-    this->histo_active = state;
+    this->commands.post(CMD_HISTO_SHOW, state);
 }
 
 #ifdef withstitching
@@ -564,9 +758,7 @@ void captureVideo::change_histogram_show(bool state){
  * Insert a new image in the panorama stitching and update the result
  */
 void captureVideo::panorama_pick_up_image(){
-    this->myFrame->panorama_insert_image();
-    emit panoramaInfo("Computing the new panorama...");
-    panorama_update();
+    postRequest(REQUEST_PANORAMA_INSERT);
 }
 
 /**
@@ -575,9 +767,7 @@ void captureVideo::panorama_pick_up_image(){
  * Delete the last inserted image from the panorama and update the result
  */
 void captureVideo::panorama_pop_out_image(){
-    this->myFrame->panorama_pop_up_image();
-    emit panoramaInfo("Removed the last image from the stack");
-    panorama_update();
+    postRequest(REQUEST_PANORAMA_POP);
 }
 
 /**
@@ -586,9 +776,7 @@ void captureVideo::panorama_pop_out_image(){
  * Empty the panorama from all images
  */
 void captureVideo::panorama_reset(){
-    this->myFrame->panorama_reset();
-    emit panoramaInfo("Reset the stack");
-    panorama_update();
+    postRequest(REQUEST_PANORAMA_RESET);
 }
 
 /**
@@ -597,27 +785,32 @@ void captureVideo::panorama_reset(){
  * Compute the result of the image stitching and send the result to the GUI
  */
 void captureVideo::panorama_update(){
+    postRequest(REQUEST_PANORAMA_UPDATE);
+}
+
+/**
+ * @brief captureVideo::computePanorama
+ *
+ * Stitching of the images of the panorama, the result is sent to the GUI. Called from run().
+ */
+void captureVideo::computePanorama(){
     std::string return_status = this->myFrame->panorama_compute_result();
     cv::Mat imageMat = this->myFrame->get_image_panorama();
     int num_imgs = this->myFrame->panorama_get_size();
     emit panoramaNumberImages(num_imgs);
     emit panoramaInfo(QString::fromStdString(return_status));
 
-    this->data_lock->lock();
-    this->panorama_Qimage = QImage(imageMat.data, imageMat.cols, imageMat.rows, imageMat.cols*3, QImage::Format_RGB888);
-    this->data_lock->unlock();
-
-    emit panoramaCaptured(&this->panorama_Qimage);
+    // The stitcher rewrites the panorama in place, the QImage gets its own copy
+    emit panoramaCaptured(toQImage(toDisplayFrame(VideoFramePool::share(imageMat, 0), true)));
 }
 
 /**
  * @brief captureVideo::panorama_save
  *
- * Save the resulting panorama to a local file
+ * Save the resulting panorama to a local file. The file name is asked here, the panorama is handed
+ * over to the threads of this->snapshots by run().
  */
 void captureVideo::panorama_save(){
-    cv::Mat imageMat = this->myFrame->get_image_panorama();
-
     QString QfileNameLocal = QFileDialog::getSaveFileName(this->mainWindowParent,
                                                          tr("File name to save the panorama"),
                                                          QString::fromStdString(this->main_directory),
@@ -625,59 +818,592 @@ void captureVideo::panorama_save(){
     if (QfileNameLocal.isEmpty()) // If one clicked the cancel button, the string is empty
         return;
 
-    this->file_name_save = QfileNameLocal.toStdString();
-
-    std::vector<int> compression_params;
-    compression_params.push_back(cv::IMWRITE_JPEG_QUALITY);
-    compression_params.push_back(100);
-    compression_params.push_back(cv::IMWRITE_PNG_COMPRESSION);
-    compression_params.push_back(4);
-
-    cv::Mat imageOutput;
-    cv::cvtColor(imageMat, imageOutput, cv::COLOR_BGR2RGB);
-    cv::imwrite(this->file_name_save , imageOutput , compression_params );
+    {
+        std::lock_guard<std::mutex> guard(this->request_lock);
+        this->panorama_file_name = QfileNameLocal.toStdString();
+    }
+    postRequest(REQUEST_PANORAMA_SAVE);
 }
 #endif
 
 void captureVideo::change_photo_method(int method){
-    this->myFrame->set_photo_method(method);
+    this->commands.post(CMD_PHOTO_METHOD, method);
 }
 
 void captureVideo::change_photo_sigmas(int value){
-    this->myFrame->set_photo_sigmas(value);
+    this->commands.post(CMD_PHOTO_SIGMAS, value);
 }
 
 void captureVideo::change_photo_sigmar(double value){
-    this->myFrame->set_photo_sigmar(value);
+    this->commands.post(CMD_PHOTO_SIGMAR, value);
+}
+
+void captureVideo::change_tone_brightness(int value){
+    this->commands.post(CMD_TONE_BRIGHTNESS, value);
+}
+
+void captureVideo::change_tone_contrast(double value){
+    this->commands.post(CMD_TONE_CONTRAST, value);
+}
+
+void captureVideo::change_tone_gamma(double value){
+    this->commands.post(CMD_TONE_GAMMA, value);
+}
+
+/**
+ * @brief captureVideo::change_frame_policy
+ * @param policy: integer the behaviour of the ring buffer when the processing is slower than the camera
+ *                [1] drop the oldest frame, [2] block the grabbing thread, [3] keep only the latest frame
+ */
+void captureVideo::change_frame_policy(int policy){
+    this->frame_buffer.set_policy(policy);
+}
+
+/**
+ * @brief captureVideo::toggleProfiling
+ * @param state: boolean ON/OFF
+ *
+ * Activate/desactivate the display of the time spent in every stage of the image processing
+ */
+void captureVideo::toggleProfiling(bool state){
+    this->profiling_active = state;
+    if (state)
+        emit changeInfo("Display of the stage timings activated");
+    else
+        emit changeInfo("Display of the stage timings desactivated");
+}
+
+/**
+ * @brief captureVideo::togglePipeline
+ * @param state: boolean ON/OFF
+ *
+ * Activate/desactivate the pipelined processing: the stages of the image processing are split into
+ * groups that run on different cores, one frame per group at a time. The switch happens in run().
+ */
+void captureVideo::togglePipeline(bool state){
+    if (state) {
+        // Keep one core for the grabbing thread
+        this->requested_groups = qMax(2, qMin(4, QThread::idealThreadCount()-1));
+        emit changeInfo("Pipelined processing activated ("+QString::number(this->requested_groups.load())+" threads)");
+    }
+    else {
+        this->requested_groups = 1;
+        emit changeInfo("Pipelined processing desactivated");
+    }
+}
+
+/**
+ * @brief captureVideo::toggleGovernor
+ * @param state: boolean ON/OFF
+ *
+ * Activate/desactivate the adaptive quality: the resolution of the processing, the cadence of the
+ * analyzers and the variants of the expensive operators are chosen to hold the target frame rate
+ */
+void captureVideo::toggleGovernor(bool state){
+    this->commands.post(CMD_GOVERNOR, state ? 1. : 0.);
+    if (state)
+        emit changeInfo("Adaptive quality activated");
+    else
+        emit changeInfo("Adaptive quality desactivated");
+}
+
+/**
+ * @brief captureVideo::change_target_fps
+ * @param fps: integer the frame rate held by the adaptive quality
+ */
+void captureVideo::change_target_fps(int fps){
+    this->commands.post(CMD_TARGET_FPS, fps);
+}
+
+/**
+ * @brief captureVideo::change_fps_cap
+ * @param fps: integer the maximum frame rate of the processing, 0 for no maximum
+ */
+void captureVideo::change_fps_cap(int fps){
+    this->commands.post(CMD_FPS_CAP, fps);
+}
+
+/**
+ * @brief captureVideo::change_analysis_width
+ * @param width: integer the width of the reduced copy analyzed by the detectors, 0 for the full resolution
+ */
+void captureVideo::change_analysis_width(int width){
+    this->commands.post(CMD_ANALYSIS_WIDTH, width);
+}
+
+/**
+ * @brief captureVideo::change_record_policy
+ * @param policy: integer the behaviour when the encoder of the video falls behind
+ *                [1] drop the oldest waiting frame, [2] make the processing wait for the encoder
+ */
+void captureVideo::change_record_policy(int policy){
+    this->recorder.set_policy(policy);
+}
+
+/**
+ * @brief captureVideo::change_motion_preroll
+ * @param seconds: integer the duration recorded before an event of motion
+ */
+void captureVideo::change_motion_preroll(int seconds){
+    this->commands.post(CMD_MOTION_PREROLL, seconds);
+}
+
+/**
+ * @brief captureVideo::change_motion_postroll
+ * @param seconds: integer the duration recorded after the end of the motion
+ */
+void captureVideo::change_motion_postroll(int seconds){
+    this->commands.post(CMD_MOTION_POSTROLL, seconds);
+}
+
+/**
+ * @brief captureVideo::change_motion_threshold
+ * @param area: double the part of the image in motion that starts an event, between 0 and 1
+ */
+void captureVideo::change_motion_threshold(double area){
+    this->commands.post(CMD_MOTION_THRESHOLD, area);
+}
+
+/**
+ * @brief captureVideo::applyQuality
+ *
+ * Gives the quality level chosen by the governor to myFrame. Called from run() between two frames.
+ */
+void captureVideo::applyQuality(){
+    this->myFrame->set_processing_scale(this->governor.get_scale());
+    this->myFrame->set_fast_variants(this->governor.get_fast_variants());
+    recordCommand(CMD_PROCESSING_SCALE, this->governor.get_scale());
+    recordCommand(CMD_FAST_VARIANTS, this->governor.get_fast_variants() ? 1. : 0.);
+    if (this->pipeline.isRunning())
+        this->pipeline.update_settings(*this->myFrame);
+    emit changeInfo("Quality of the processing: "+QString::fromStdString(this->governor.get_description()));
+}
+
+/**
+ * @brief captureVideo::applyCommands
+ * @return true if at least one parameter has changed
+ *
+ * Applies to myFrame the changes posted by the slots since the previous frame. Only the last value
+ * of a parameter is applied, a slider being dragged does not slow down the processing. Called from
+ * run() between two frames, so that myFrame is only modified by the thread that uses it.
+ */
+bool captureVideo::applyCommands(){
+    if (this->myFrame == nullptr || !this->commands.drain(this->pending_commands))
+        return false;
+
+    for (size_t i=0; i<this->pending_commands.size(); i++) {
+        int key = this->pending_commands[i].key;
+        double value = this->pending_commands[i].value;
+        bool state = value != 0.;
+        // The processing itself is changed as in the replay of the sessions (see apply_command())
+        bool handled = apply_command(*this->myFrame, key, value);
+        switch (key) {
+        case CMD_MOTION:           this->motion_sink.set_active(state); break;
+        case CMD_OBJECTS:          this->objects_sink.set_active(state); break;
+#ifdef withzbar
+        case CMD_QRCODE:           this->qrdecoder_active = state; break;
+#endif // endif withzbar
+#ifdef withstitching
+        case CMD_PANORAMA:         this->panorama_active = state; break;
+#endif // endif withstitching
+        case CMD_HISTO_SHOW:       this->histo_sink.set_active(state); break;
+        case CMD_GOVERNOR:
+            this->governor.set_enabled(state);
+            applyQuality();
+            break;
+        case CMD_TARGET_FPS:       this->governor.set_target_fps(value); break;
+        case CMD_FPS_CAP:          this->governor.set_fps_cap(value); break;
+        case CMD_MOTION_PREROLL:   this->motion_recorder.set_preroll(value); break;
+        case CMD_MOTION_POSTROLL:  this->motion_recorder.set_postroll(value); break;
+        case CMD_MOTION_THRESHOLD: this->motion_recorder.set_threshold(value); break;
+        default:
+            if (!handled) {
+                qDebug() << "captureVideo::applyCommands() : Unknown command" << key;
+                continue;
+            }
+            break;
+        }
+        recordCommand(key, value);
+    }
+
+    // The upstream threads of the pipelined mode take the new parameters at their next frame
+    if (this->pipeline.isRunning())
+        this->pipeline.update_settings(*this->myFrame);
+    return true;
+}
+
+/**
+ * @brief captureVideo::postRequest
+ * @param request: integer WorkerRequest carried out by run() before the next frame
+ */
+void captureVideo::postRequest(int request){
+    std::lock_guard<std::mutex> guard(this->request_lock);
+    this->requests.push_back(request);
+}
+
+/**
+ * @brief captureVideo::applyRequests
+ *
+ * Carries out, in order, the requests of the GUI that use myFrame (see postRequest()). Called from
+ * run() between two frames, like applyCommands().
+ */
+void captureVideo::applyRequests(){
+    {
+        std::lock_guard<std::mutex> guard(this->request_lock);
+        if (this->requests.empty())
+            return;
+        this->pending_requests.swap(this->requests);
+    }
+    for (size_t i=0; i<this->pending_requests.size() && this->myFrame != nullptr; i++) {
+        switch (this->pending_requests[i]) {
+#ifdef withstitching
+        case REQUEST_PANORAMA_INSERT:
+            this->myFrame->panorama_insert_image();
+            emit panoramaInfo("Computing the new panorama...");
+            computePanorama();
+            break;
+        case REQUEST_PANORAMA_POP:
+            this->myFrame->panorama_pop_up_image();
+            emit panoramaInfo("Removed the last image from the stack");
+            computePanorama();
+            break;
+        case REQUEST_PANORAMA_RESET:
+            this->myFrame->panorama_reset();
+            emit panoramaInfo("Reset the stack");
+            computePanorama();
+            break;
+        case REQUEST_PANORAMA_UPDATE:
+            computePanorama();
+            break;
+        case REQUEST_PANORAMA_SAVE: {
+            std::string filename;
+            {
+                std::lock_guard<std::mutex> guard(this->request_lock);
+                filename = this->panorama_file_name;
+            }
+            // Written by the threads of this->snapshots
+            int format = QFileInfo(QString::fromStdString(filename)).suffix().toLower() == "png" ? SnapshotWriter::FORMAT_PNG
+                                                                                                 : SnapshotWriter::FORMAT_JPEG;
+            this->snapshots.save(this->myFrame->get_image_panorama(), filename, format, 100);
+            emit panoramaInfo("Saving the panorama under "+QString::fromStdString(filename));
+            break;
+        }
+#endif // endif withstitching
+#ifdef withtesseract
+        case REQUEST_TEXT_IMAGE:
+        case REQUEST_TEXT_AREAS:
+            detectTextAreas(this->pending_requests[i] == REQUEST_TEXT_AREAS);
+            break;
+#endif // endif withtesseract
+        default:
+            break;
+        }
+    }
+    this->pending_requests.clear();
+}
+
+/**
+ * @brief captureVideo::recordCommand
+ * @param key: integer ProcessingCommand
+ * @param value: double the value applied between two frames
+ *
+ * Keeps the current state of the parameters for the beginning of a session, and records the change
+ * in the session in progress
+ */
+void captureVideo::recordCommand(int key, double value){
+    if (key >= 0 && key < (int) this->command_state.size())
+        this->command_state[key] = value;
+    this->session.record_command(key, value);
+}
+
+/**
+ * @brief captureVideo::updatePipeline
+ *
+ * Start or stop the pipelined processing as requested by togglePipeline(). Called from run() between
+ * two frames. The stages are grouped according to their median durations measured by myFrame.
+ */
+void captureVideo::updatePipeline(){
+    // The frames of a session are processed sequentially, as in the replay. The input and the stages
+    // of the frame only exist in myFrame in the sequential mode.
+    bool sequential = this->session.isRunning() || this->sinks.isWanted(FrameSink::TAP_INPUT) ||
+                      this->sinks.isWanted(FrameSink::TAP_STAGE);
+    int groups = sequential ? 1 : (int) this->requested_groups;
+    if (groups == this->pipeline.get_number_groups())
+        return;
+    if (groups <= 1) {
+        this->pipeline.stop();
+        return;
+    }
+
+    std::vector<double> costs;
+    double total = 0.;
+    for (int stage=MyImage::STAGE_FACE; stage<=MyImage::STAGE_QRCODE; stage++) {
+        StageStatistics stats = this->myFrame->get_profiler().get_statistics(stage);
+        costs.push_back(stats.active ? stats.p50 : 0.);
+        total += costs.back();
+    }
+    // Nothing measured yet: assume that all the stages cost the same
+    if (total <= 0.)
+        costs.assign(costs.size(), 1.);
+
+    if (!this->pipeline.start(&this->frame_buffer, this->myFrame, PipelinedProcessor::balance(costs, groups))) {
+        qDebug() << "captureVideo::updatePipeline() : Cannot start the pipelined processing";
+        this->requested_groups = 1;
+    }
+}
+
+/**
+ * @brief captureVideo::sendProfile
+ *
+ * Summarize the durations of the active stages (mean, median, 99th percentile, maximum in ms)
+ * and send them to the Qt manager for the overlay and the status bar
+ */
+void captureVideo::sendProfile(){
+    std::vector<StageStatistics> stats = this->myFrame->get_profiler().get_all_statistics();
+    QStringList lines;
+    QString summary;
+    int slowest = -1;
+    for (int i=0; i<(int)stats.size(); i++) {
+        if (!stats[i].active)
+            continue;
+        lines << QString("%1 %2 %3 %4 %5").arg(QString::fromStdString(stats[i].name), -10)
+                                          .arg(stats[i].mean, 7, 'f', 2)
+                                          .arg(stats[i].p50,  7, 'f', 2)
+                                          .arg(stats[i].p99,  7, 'f', 2)
+                                          .arg(stats[i].max,  7, 'f', 2);
+        if (i != MyImage::STAGE_PIPELINE && (slowest < 0 || stats[i].p50 > stats[slowest].p50))
+            slowest = i;
+    }
+    lines.prepend(QString("%1 %2 %3 %4 %5").arg("stage (ms)", -10).arg("mean", 7).arg("p50", 7).arg("p99", 7).arg("max", 7));
+
+    // Encoding of the recorded video, done by its own thread
+    if (this->recorder.isRunning())
+        lines << QString("recorder: queue %1 (max %2), encode %3 ms (max %4), %5 dropped")
+                     .arg(this->recorder.get_queue_depth()).arg(this->recorder.get_max_queue_depth())
+                     .arg(this->recorder.get_mean_encode_ms(), 0, 'f', 2).arg(this->recorder.get_max_encode_ms(), 0, 'f', 2)
+                     .arg(this->recorder.get_dropped_frames());
+    if (this->raw_writer.isRunning())
+        lines << QString("raw frames: %1 written, %2 dropped, write %3 ms, compression %4")
+                     .arg(this->raw_writer.get_written_frames()).arg(this->raw_writer.get_dropped_frames())
+                     .arg(this->raw_writer.get_mean_write_ms(), 0, 'f', 2).arg(this->raw_writer.get_compression_ratio(), 0, 'f', 2);
+    if (this->snapshots.get_written() + this->snapshots.get_failed() > 0)
+        lines << QString("snapshots: %1 waiting, write %2 ms (max %3), %4 written, %5 failed")
+                     .arg(this->snapshots.get_pending())
+                     .arg(this->snapshots.get_mean_write_ms(), 0, 'f', 2).arg(this->snapshots.get_max_write_ms(), 0, 'f', 2)
+                     .arg(this->snapshots.get_written()).arg(this->snapshots.get_failed());
+    if (this->streamer.isRunning())
+        lines << QString("stream: queue %1 (max %2), encode %3 ms (max %4), %5 dropped")
+                     .arg(this->streamer.get_queue_depth()).arg(this->streamer.get_max_queue_depth())
+                     .arg(this->streamer.get_mean_encode_ms(), 0, 'f', 2).arg(this->streamer.get_max_encode_ms(), 0, 'f', 2)
+                     .arg(this->streamer.get_dropped_frames());
+    lines << QString("shared frames: %1 buffers allocated, %2 free")
+                 .arg(this->frame_pool.get_allocations()).arg(this->frame_pool.get_number_buffers());
+
+    const StageStatistics &pipeline = stats[MyImage::STAGE_PIPELINE];
+    summary = "Processing: p50 "+QString::number(pipeline.p50, 'f', 2)+" ms, p99 "+QString::number(pipeline.p99, 'f', 2)+" ms";
+    if (slowest >= 0)
+        summary += " - slowest stage: "+QString::fromStdString(stats[slowest].name)+
+                   " ("+QString::number(stats[slowest].p50, 'f', 2)+" ms)";
+    emit profileUpdated(lines, summary);
+}
+
+/**
+ * @brief releaseFrame
+ * @param frame: VideoFrame* the reference to the frame kept by a QImage
+ *
+ * Called by Qt when the last copy of the QImage is destroyed
+ */
+static void releaseFrame(void *frame){
+    delete static_cast<VideoFrame*>(frame);
+}
+
+/**
+ * @brief captureVideo::toQImage
+ * @param frame: VideoFrame the frame to display, gray or in the format of toDisplayFrame()
+ * @return a read-only QImage sharing the pixels of frame, which is kept alive as long as the QImage exists
+ *
+ * With Qt >= 5.14 the BGR images are displayed as they are (QImage::Format_BGR888). With older versions,
+ * the channels have already been swapped by toDisplayFrame(), on the thread of the producer.
+ */
+QImage captureVideo::toQImage(const VideoFrame &frame){
+    const cv::Mat &image = frame.get_image();
+    if (image.empty())
+        return QImage();
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    QImage::Format format = image.channels() == 1 ? QImage::Format_Grayscale8 : QImage::Format_BGR888;
+#else
+    QImage::Format format = image.channels() == 1 ? QImage::Format_Grayscale8 : QImage::Format_RGB888;
+#endif
+    // The constant data makes the QImage read-only: painting on it would detach a copy
+    QImage shared(static_cast<const uchar*>(image.data), image.cols, image.rows, static_cast<int>(image.step),
+                  format, releaseFrame, new VideoFrame(frame));
+    return shared;
+}
+
+/**
+ * @brief captureVideo::toDisplayBuffer
+ * @param image: cv::Mat BGR or gray
+ * @return a buffer of the pool holding image in the format of toQImage(), to be given to freeze().
+ *         With Qt < 5.14 the channels are swapped during the copy, there is no other pass.
+ */
+cv::Mat captureVideo::toDisplayBuffer(const cv::Mat &image){
+    cv::Mat buffer = this->frame_pool.acquire(image.size(), image.type());
+#if QT_VERSION < QT_VERSION_CHECK(5, 14, 0)
+    if (image.channels() == 3) {
+        cv::cvtColor(image, buffer, cv::COLOR_BGR2RGB);
+        return buffer;
+    }
+#endif
+    image.copyTo(buffer);
+    return buffer;
+}
+
+/**
+ * @brief captureVideo::toDisplayFrame
+ * @param frame: VideoFrame BGR or gray
+ * @param own: boolean true if the result must not share the pixels of frame (their producer will
+ *             rewrite them)
+ * @return frame in the format of toQImage(): frame itself when it can be displayed as it is, else its
+ *         copy by toDisplayBuffer()
+ */
+VideoFrame captureVideo::toDisplayFrame(const VideoFrame &frame, bool own){
+    if (frame.empty())
+        return frame;
+#if QT_VERSION < QT_VERSION_CHECK(5, 14, 0)
+    own = own || frame.get_image().channels() == 3;
+#endif
+    if (!own)
+        return frame;
+    cv::Mat buffer = toDisplayBuffer(frame.get_image());
+    return this->frame_pool.freeze(buffer, frame.get_sequence());
+}
+
+/**
+ * @brief captureVideo::takeImage
+ * @param display: TripleBuffer the handoff from the OpenCV thread
+ * @param image: QImage that receives the newest image
+ * @return true if a new image has been received
+ *
+ * Called from the GUI thread. image shares the pixels of the frame and keeps it alive (see toQImage())
+ */
+bool captureVideo::takeImage(TripleBuffer &display, QImage &image){
+    if (!display.acquire())
+        return false;
+    image = toQImage(display.get_read_buffer());
+    return true;
+}
+
+/**
+ * @brief captureVideo::getFrame
+ * @param image: QImage that receives the newest processed frame
+ * @return true if a new frame is available
+ */
+bool captureVideo::getFrame(QImage &image){
+    return takeImage(this->frame_sink.get_buffer(), image);
+}
+
+/**
+ * @brief captureVideo::getMotionImage
+ * @param image: QImage that receives the newest result of the motion detection
+ * @return true if a new image is available
+ */
+bool captureVideo::getMotionImage(QImage &image){
+    return takeImage(this->motion_sink.get_buffer(), image);
+}
+
+/**
+ * @brief captureVideo::getObjectsImage
+ * @param image: QImage that receives the newest result of the object detection
+ * @return true if a new image is available
+ */
+bool captureVideo::getObjectsImage(QImage &image){
+    return takeImage(this->objects_sink.get_buffer(), image);
+}
+
+/**
+ * @brief captureVideo::getHistogramImage
+ * @param image: QImage that receives the newest histogram
+ * @return true if a new image is available
+ */
+bool captureVideo::getHistogramImage(QImage &image){
+    return takeImage(this->histo_sink.get_buffer(), image);
+}
+
+/**
+ * @brief captureVideo::getDisplayDroppedFrames
+ * @return the number of processed frames replaced by a newer one before the GUI could display them
+ */
+unsigned long long captureVideo::getDisplayDroppedFrames(){
+    return this->frame_sink.get_buffer().get_dropped_frames();
+}
+
+/**
+ * @brief captureVideo::getDroppedFrames
+ * @return the number of frames grabbed from the camera that have never been processed
+ */
+unsigned long long captureVideo::getDroppedFrames(){
+    return this->frame_buffer.get_dropped_frames();
 }
 
 /**
  * @brief captureVideo::file_save_image
  *
- * Save the current image on the camera to a local file
+ * Save the next frame of the tap point of the snapshots (the processed image by default) to a local
+ * file. It is captured when the action is triggered, not when the file name has been chosen.
  */
 void captureVideo::file_save_image() {
+    saveSnapshots(1);
+}
+
+/**
+ * @brief captureVideo::file_save_burst
+ * @param count: integer the number of consecutive frames to save
+ *
+ * Save the next frames to local files, numbered after the chosen file name
+ */
+void captureVideo::file_save_burst(int count) {
+    saveSnapshots(count);
+}
+
+/**
+ * @brief captureVideo::saveSnapshots
+ * @param count: integer the number of consecutive frames to save
+ *
+ * The frames are captured by run() as soon as this function is called, while the file name is asked.
+ * The format is chosen with the type of file in the dialog window. The frames are compressed and
+ * written by the threads of this->snapshots, run() announces the end of the writing.
+ */
+void captureVideo::saveSnapshots(int count) {
+    this->snapshots.capture(count);
+
+    // Type of file in the dialog window: format, JPEG quality and extension
+    const QStringList filters = QStringList() << tr("PNG image (*.png)")
+                                              << tr("PNG image, fast with low compression (*.png)")
+                                              << tr("JPEG image, best quality (*.jpg)")
+                                              << tr("JPEG image (*.jpg)")
+                                              << tr("BMP image, no compression (*.bmp)");
+    const int formats[]   = { SnapshotWriter::FORMAT_PNG, SnapshotWriter::FORMAT_PNG_FAST,
+                              SnapshotWriter::FORMAT_JPEG, SnapshotWriter::FORMAT_JPEG, SnapshotWriter::FORMAT_BMP };
+    const int qualities[] = { 0, 0, 100, 90, 0 };
+
+    QString selectedFilter = filters[0];
     QString QfileNameLocal = QFileDialog::getSaveFileName(this->mainWindowParent,
-                                                         tr("File name to save the image"),
+                                                         count == 1 ? tr("File name to save the image")
+                                                                    : tr("File name to save the images"),
                                                          QString::fromStdString(this->main_directory),
-                                                         tr("Images (*.png *.jpg)") );
-    if (QfileNameLocal.isEmpty()) // If one clicked the cancel button, the string is empty
+                                                         filters.join(";;"), &selectedFilter );
+    if (QfileNameLocal.isEmpty()) { // If one clicked the cancel button, the string is empty
+        this->snapshots.cancel();
         return;
+    }
+    int format = qMax(0, filters.indexOf(selectedFilter));
+    if (QFileInfo(QfileNameLocal).suffix().isEmpty())
+        QfileNameLocal += QString::fromStdString(SnapshotWriter::get_extension(formats[format]));
 
     this->file_name_save = QfileNameLocal.toStdString();
-
-    std::vector<int> compression_params;
-    compression_params.push_back(cv::IMWRITE_JPEG_QUALITY);
-    compression_params.push_back(100);
-    compression_params.push_back(cv::IMWRITE_PNG_COMPRESSION);
-    compression_params.push_back(4);
-
-//    Mat imageMat = myFrame->get_image_content();
-//    Mat imageOutput;
-//    cvtColor(imageMat, imageOutput, COLOR_BGR2RGB);
-    cv::imwrite(this->file_name_save , this->currentMat , compression_params );
-
-    emit changeInfo("Saved the image under "+QfileNameLocal);
+    this->snapshots.commit(this->file_name_save, formats[format], qualities[format]);
+    if (this->snapshots.isCapturing())
+        emit changeInfo("Capturing "+QString::number(count)+" frames for "+QfileNameLocal);
 }
 
 /**
@@ -685,72 +1411,321 @@ void captureVideo::file_save_image() {
  * @param state: if true, start recording a movie from the camera
  *                 false, stop the recording of the movie
  * @return true if everything went well
- *        false if the user clicked on 'Cancel' when setting the filename for the movie.
- *              This allows the GUI to desactivate the button 'Record'
+ *        false if the user clicked on 'Cancel' when setting the filename for the movie,
+ *              or if the video could not be created. This allows the GUI to desactivate the button 'Record'
  *
- * Managment of the recording to a movie.
+ * Managment of the recording to a movie. The codec and the container are chosen with the type of
+ * file in the dialog window. The frames are encoded by the thread of this->recorder.
  */
 bool captureVideo::file_save_movie(bool state) {
-    this->recording = state;
     if (state) {
-        if (! this->video_out.isOpened() ) {// FPS : this->capture.get(cv::CAP_PROP_FPS)
-
+        if (! this->recorder.isRunning() ) {
+            // Type of file in the dialog window: codec (fourcc) and extension of the container
+            const QStringList filters = QStringList() << tr("XVID video (*.avi)")
+                                                      << tr("Motion JPEG video (*.avi)")
+                                                      << tr("MPEG-4 video (*.mp4)");
+            const char* codecs[]     = { "XVID", "MJPG", "mp4v" };
+            const char* extensions[] = { ".avi", ".avi", ".mp4" };
+
+            QString selectedFilter = filters[0];
             QString QfileNameLocal = QFileDialog::getSaveFileName(this->mainWindowParent,
                                                                  tr("Filename for the video"),
                                                                  QString::fromStdString(this->main_directory),
-                                                                 tr("Images (*.avi)") );
+                                                                 filters.join(";;"), &selectedFilter );
             if (QfileNameLocal.isEmpty()) {// If one clicked the cancel button, the string is empty
                 this->recording = false;
                 return false; // return false so that the button "Record" is desactivated in the mainwindow
             }
+            int format = qMax(0, filters.indexOf(selectedFilter));
+            if (QFileInfo(QfileNameLocal).suffix().isEmpty())
+                QfileNameLocal += extensions[format];
 
             this->video_out_name = QfileNameLocal.toStdString();
 
             double local_fps;
             if (this->cameraFPScalculated)
                 local_fps = this->cameraFPS ;
+            else if (this->source->get_fps() > 0.)
+                local_fps = this->source->get_fps();
             else
                 local_fps = 20;
-            this->video_out.open(this->video_out_name,cv::VideoWriter::fourcc('X','V','I','D'),
-                                 local_fps,
-                                 cv::Size(this->capture.get(cv::CAP_PROP_FRAME_WIDTH),
-                                          this->capture.get(cv::CAP_PROP_FRAME_HEIGHT)),
-                                 true);
+            const char *codec = codecs[format];
+            if (!this->recorder.start(this->video_out_name,
+                                      cv::VideoWriter::fourcc(codec[0], codec[1], codec[2], codec[3]),
+                                      local_fps,
+                                      this->frame_size)) {
+                emit changeInfo("Cannot create the video "+QString::fromStdString(this->video_out_name));
+                this->recording = false;
+                return false;
+            }
         }
+        this->recording = true;
         emit changeInfo("Saving the video under "+QString::fromStdString(this->video_out_name));
     }
     else {
-        if (this->video_out.isOpened() )
-            this->video_out.release();
+        this->recording = false;
+        // The frames still waiting for the encoder are written before the file is closed
+        this->recorder.stop();
 
         this->record_time_blink = 0;
-        emit changeInfo("Saved the video under "+QString::fromStdString(this->video_out_name));
+        emit changeInfo("Saved the video under "+QString::fromStdString(this->video_out_name)+" ("+
+                        QString::number(this->recorder.get_encoded_frames())+" frames, "+
+                        QString::number(this->recorder.get_dropped_frames())+" dropped, encoding "+
+                        QString::number(this->recorder.get_mean_encode_ms(), 'f', 2)+" ms per frame, up to "+
+                        QString::number(this->recorder.get_max_queue_depth())+" frames waiting)");
+    }
+    return true;
+}
+
+/**
+ * @brief captureVideo::file_save_motion
+ * @param state: if true, start recording the events of motion
+ *                 false, stop recording them
+ * @return true if everything went well
+ *        false if the user clicked on 'Cancel' when choosing the directory of the videos
+ *
+ * Only the events of motion are recorded, one video per event in the chosen directory, with the
+ * seconds before the motion starts and after it stops
+ */
+bool captureVideo::file_save_motion(bool state) {
+    if (state) {
+        QString directory = QFileDialog::getExistingDirectory(this->mainWindowParent,
+                                                              tr("Directory of the videos of the events"),
+                                                              QString::fromStdString(this->main_directory));
+        if (directory.isEmpty())
+            return false;
+
+        double local_fps;
+        if (this->cameraFPScalculated)
+            local_fps = this->cameraFPS ;
+        else if (this->source != nullptr && this->source->get_fps() > 0.)
+            local_fps = this->source->get_fps();
+        else
+            local_fps = 20;
+        if (!this->motion_recorder.start(directory.toStdString(), local_fps))
+            return false;
+        emit changeInfo("Recording the events of motion in "+directory);
+    }
+    else {
+        // The current event is written before the thread stops
+        this->motion_recorder.stop();
+        emit changeInfo("Recorded "+QString::number(this->motion_recorder.get_events())+" events of motion ("+
+                        QString::number(this->motion_recorder.get_written_frames())+" frames, "+
+                        QString::number(this->motion_recorder.get_dropped_frames())+" dropped)");
+    }
+    return true;
+}
+
+/**
+ * @brief captureVideo::file_save_raw
+ * @param state: if true, start recording the raw frames of the camera
+ *                 false, stop recording them
+ * @return true if everything went well
+ *        false if the user clicked on 'Cancel' when setting the filename, or if the file could not be created
+ *
+ * The frames are recorded as delivered by the camera, before any processing, by the grabbing thread.
+ * The file can be replayed with RawFileSource (Open a video file, or raw:<file> in VideoHeadless).
+ */
+bool captureVideo::file_save_raw(bool state) {
+    if (state) {
+        QStringList filters = QStringList() << tr("Raw frames (*.raw)");
+        if (RawFrameWriter::isCompressionAvailable())
+            filters << tr("Raw frames, LZ4 compression (*.raw)");
+
+        QString selectedFilter = filters[0];
+        QString QfileNameLocal = QFileDialog::getSaveFileName(this->mainWindowParent,
+                                                             tr("Filename for the raw frames"),
+                                                             QString::fromStdString(this->main_directory),
+                                                             filters.join(";;"), &selectedFilter );
+        if (QfileNameLocal.isEmpty()) // If one clicked the cancel button, the string is empty
+            return false;
+        if (QFileInfo(QfileNameLocal).suffix().isEmpty())
+            QfileNameLocal += ".raw";
+
+        double local_fps = this->source != nullptr ? this->source->get_fps() : 0.;
+        if (local_fps <= 0. && this->cameraFPScalculated)
+            local_fps = this->cameraFPS;
+        if (!this->raw_writer.start(QfileNameLocal.toStdString(), local_fps, filters.indexOf(selectedFilter) == 1)) {
+            emit changeInfo("Cannot create the file "+QfileNameLocal);
+            return false;
+        }
+        this->frame_grabber.set_raw_writer(&this->raw_writer);
+        emit changeInfo("Recording the raw frames under "+QfileNameLocal);
+    }
+    else {
+        this->frame_grabber.set_raw_writer(nullptr);
+        // The frames still waiting are written before the file is closed
+        this->raw_writer.stop();
+        emit changeInfo("Saved the raw frames under "+QString::fromStdString(this->raw_writer.get_filename())+" ("+
+                        QString::number(this->raw_writer.get_written_frames())+" frames, "+
+                        QString::number(this->raw_writer.get_dropped_frames())+" dropped, "+
+                        QString::number(this->raw_writer.get_written_bytes()/(1024*1024))+" MiB)");
     }
     return true;
 }
 
+/**
+ * @brief captureVideo::file_save_session
+ * @param state: if true, start recording a session
+ *                 false, stop recording it
+ * @return true if everything went well
+ *        false if the user clicked on 'Cancel' when setting the filename
+ *
+ * A session is made of the input frames (raw file next to the session file) and of every parameter
+ * change with the frame where it applies. It begins at the next frame, with the current parameters,
+ * and is replayed bit for bit by VideoHeadless --session <file>.
+ */
+bool captureVideo::file_save_session(bool state) {
+    if (state) {
+        QString QfileNameLocal = QFileDialog::getSaveFileName(this->mainWindowParent,
+                                                             tr("Filename for the session"),
+                                                             QString::fromStdString(this->main_directory),
+                                                             tr("Sessions (*.session)") );
+        if (QfileNameLocal.isEmpty()) // If one clicked the cancel button, the string is empty
+            return false;
+        if (QFileInfo(QfileNameLocal).suffix().isEmpty())
+            QfileNameLocal += ".session";
+
+        double local_fps = this->source != nullptr ? this->source->get_fps() : 0.;
+        if (local_fps <= 0. && this->cameraFPScalculated)
+            local_fps = this->cameraFPS;
+        // The files are created by run() at the next frame (see SessionRecorder::begin())
+        this->session.request(QfileNameLocal.toStdString(), local_fps);
+    }
+    else {
+        bool running = this->session.isRunning();
+        // The frames still waiting are written before the files are closed
+        this->session.stop();
+        this->record_time_blink = 0;
+        if (running)
+            emit changeInfo("Saved the session under "+QString::fromStdString(this->session.get_filename())+" ("+
+                            QString::number(this->session.get_frames())+" frames, "+
+                            QString::number(this->session.get_commands())+" parameter changes)");
+    }
+    return true;
+}
+
+/**
+ * @brief captureVideo::file_stream
+ * @param state: if true, start streaming the frames
+ *                 false, stop the stream
+ * @return true if everything went well
+ *        false if the user clicked on 'Cancel' when setting the pipeline, or if it could not be opened
+ *
+ * The frames are encoded by a GStreamer pipeline that begins with appsrc (OpenCV must be built with
+ * GStreamer). By default the processed image is sent in RTP/H.264 to the port 5000 of this computer,
+ * any other tap can be streamed with setTap().
+ */
+bool captureVideo::file_stream(bool state) {
+    if (state) {
+        bool accepted = false;
+        QString pipeline = QInputDialog::getText(this->mainWindowParent, tr("Stream the frames"),
+                                                 tr("GStreamer pipeline:"), QLineEdit::Normal,
+                                                 QString::fromStdString(this->stream_pipeline), &accepted);
+        if (!accepted || pipeline.trimmed().isEmpty())
+            return false;
+        this->stream_pipeline = pipeline.trimmed().toStdString();
+
+        double local_fps = this->cameraFPScalculated ? this->cameraFPS : 0.;
+        if (local_fps <= 0. && this->source != nullptr)
+            local_fps = this->source->get_fps();
+        if (local_fps <= 0.)
+            local_fps = 20;
+        if (!this->streamer.start_stream(this->stream_pipeline, local_fps, this->frame_size)) {
+            emit changeInfo("Cannot open the stream "+QString::fromStdString(this->stream_pipeline));
+            return false;
+        }
+        emit changeInfo("Streaming the frames to "+QString::fromStdString(this->stream_pipeline));
+    }
+    else {
+        this->streamer.stop();
+        this->record_time_blink = 0;
+        emit changeInfo("Stopped the stream ("+QString::number(this->streamer.get_encoded_frames())+" frames, "+
+                        QString::number(this->streamer.get_dropped_frames())+" dropped)");
+    }
+    return true;
+}
+
+/**
+ * @brief captureVideo::setTap
+ * @param sink: integer captureVideo::TapSink the recorder, the stream or the snapshots
+ * @param point: integer FrameSink::TapPoint where the sink takes its frames
+ * @param stage: integer the stage of MyImage for FrameSink::TAP_STAGE, ignored otherwise
+ *
+ * Called from the GUI, applied from the next frame. The camera input and the stages are only
+ * computed while a sink subscribed to them is active, and suspend the pipelined mode meanwhile.
+ */
+void captureVideo::setTap(int sink, int point, int stage) {
+    FrameSink *tapped = getTapSink(sink);
+    if (tapped == nullptr) {
+        qDebug() << "captureVideo::setTap() : Unknown sink" << sink;
+        return;
+    }
+    this->sinks.subscribe(tapped, point, stage);
+}
+
+/**
+ * @brief captureVideo::getTapSink
+ * @param sink: integer captureVideo::TapSink
+ * @return the sink, nullptr if it does not exist
+ */
+FrameSink* captureVideo::getTapSink(int sink) {
+    switch (sink) {
+    case SINK_RECORDER:  return &this->recorder_sink;
+    case SINK_STREAM:    return &this->stream_sink;
+    case SINK_SNAPSHOTS: return &this->snapshot_sink;
+    default:             return nullptr;
+    }
+}
+
 #ifdef withtesseract
 /**
-     * @brief detectTextAreas
-     * @param areas
-     * @return 
-     */
-QImage captureVideo::detectTextAreas(std::vector<QRect> &areas, bool detectArea){
+ * @brief captureVideo::requestTextAreas
+ * @param detectArea: boolean true to detect the areas of text, false to only get the image
+ *
+ * The detection is made by run() on the last processed frame, textAreasCaptured() is emitted when
+ * its result can be fetched with getTextAreas()
+ */
+void captureVideo::requestTextAreas(bool detectArea){
+    postRequest(detectArea ? REQUEST_TEXT_AREAS : REQUEST_TEXT_IMAGE);
+}
+
+/**
+ * @brief captureVideo::getTextAreas
+ * @param image: QImage that receives the image of the last detection
+ * @param areas: vector of QRect that receives the areas of text found by the last detection
+ */
+void captureVideo::getTextAreas(QImage &image, std::vector<QRect> &areas){
+    std::lock_guard<std::mutex> guard(this->request_lock);
+    image = this->text_image;
+    areas = this->text_areas;
+}
+
+/**
+ * @brief captureVideo::detectTextAreas
+ * @param detectArea: boolean true to detect the areas of text, false to only get the image
+ *
+ * Detection of the text in the last processed frame, called from run()
+ */
+void captureVideo::detectTextAreas(bool detectArea){
     std::vector<cv::Rect> areas_cv ;
     cv::Mat frame_cv = this->myFrame->textAreasDetect(areas_cv, detectArea);
     
     // Convert cv::Rect to QRect
-    for (int i=0; i<areas_cv.size(); i++) {
+    std::vector<QRect> areas;
+    for (size_t i=0; i<areas_cv.size(); i++) {
         cv::Rect cur = areas_cv.at(i);
         areas.push_back( QRect(cur.y , cur.x , cur.height , cur.width) ) ;// int left, int top, int width, int height
     }
     
-    // I don't know why I don't have to convert the colours this time
-//    if (!frame_cv.empty())
-//        cv::cvtColor(frame_cv, frame_cv, cv::COLOR_BGR2RGB);
-    QImage frame = QImage(frame_cv.data, frame_cv.cols, frame_cv.rows, frame_cv.cols*3, QImage::Format_RGB888);
-    
-    return frame;
+    // frame_cv is a copy made for the detection, the QImage shares it
+    QImage image = toQImage(toDisplayFrame(VideoFramePool::share(frame_cv, 0)));
+    {
+        std::lock_guard<std::mutex> guard(this->request_lock);
+        this->text_image = image;
+        this->text_areas.swap(areas);
+    }
+    emit textAreasCaptured(detectArea);
 }
 #endif // endif withtesseract
 
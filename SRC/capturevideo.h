@@ -9,27 +9,77 @@
 #include <QObject>
 #include <QDebug>
 #include <QThread>
-#include <QMutex>
 #include <QImage>
 #include <QFileDialog>
+#include <QInputDialog>
+#include <QFileInfo>
 #include <QMainWindow>
 #include <QTime> // Calculate the FPS of the camera
+#include <QStringList>
 #include <QCoreApplication>
 
 // MyImage
 #include "myimage.h"
 
+// Grabbing thread
+#include "framebuffer.h"
+#include "framegrabber.h"
+#include "framesource.h"
+
+// Stages of MyImage spread over several cores
+#include "pipelinedprocessor.h"
+
+// Handoff of the images to the GUI, shared without copy by all their users
+#include "triplebuffer.h"
+#include "videoframe.h"
+
+// Parameter changes sent by the GUI, applied between two frames (see applyCommands())
+#include "commandqueue.h"
+#include "processingcommands.h"
+
+// Adaptive quality to hold the frame rate
+#include "qualitygovernor.h"
+
+// Encoding thread of the recorded videos
+#include "videorecorder.h"
+#include "motionrecorder.h"
+
+// Saving of the images by a pool of threads
+#include "snapshotwriter.h"
+
+// Sessions replayed by VideoHeadless
+#include "sessionlog.h"
+
+// Displays, recorders, snapshots and stream subscribed to the tap points of the processing
+#include "framesinks.h"
+
 // OpenCV
 #include "opencv2/core.hpp"
 #include "opencv2/videoio.hpp"
 #include "opencv2/highgui.hpp"
 
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
 class captureVideo : public QThread
 {
     Q_OBJECT
 public:
-    explicit captureVideo(QMainWindow *parent=nullptr,QMutex* data_lock=nullptr);
+    // Sinks that can be moved to another tap point with setTap(), the displays have fixed taps
+    enum TapSink {
+        SINK_RECORDER = 0,
+        SINK_STREAM,
+        SINK_SNAPSHOTS,
+        NB_TAP_SINKS
+    };
+
+    explicit captureVideo(QMainWindow *parent=nullptr);
+    ~captureVideo();
     void setCamera(int camID);
+    void setSource(FrameSource *new_source);
+    QString getSourceName();
     bool openCamera(int &width, int &height);
     bool closeCamera();
     bool cameraIsOpen();
@@ -39,20 +89,36 @@ public:
     bool getQRcodedata(std::string &, std::string &);
 #endif // endif withzbar
     bool file_save_movie(bool);
+    bool file_save_motion(bool);
+    bool file_save_raw(bool);
+    bool file_save_session(bool);
+    bool file_stream(bool);
+    void setTap(int sink, int point, int stage=-1);
+    unsigned long long getDroppedFrames();
+    unsigned long long getDisplayDroppedFrames();
+    bool getFrame(QImage &image);
+    bool getMotionImage(QImage &image);
+    bool getObjectsImage(QImage &image);
+    bool getHistogramImage(QImage &image);
     
 #ifdef withtesseract
-    QImage detectTextAreas(std::vector<QRect> &areas, bool detectArea);
+    void requestTextAreas(bool detectArea);
+    void getTextAreas(QImage &image, std::vector<QRect> &areas);
 #endif // endif withtesseract
     
 signals:
-    void frameCaptured(QImage *image);
-    void motionCaptured(QImage *image);
-    void objectsCaptured(QImage *image);
-    void histogramCaptured(QImage *image);
-    void panoramaCaptured(QImage *image);
+    // A new image is ready, it must be fetched with getFrame(), getMotionImage(), ...
+    void frameCaptured();
+    void motionCaptured();
+    void objectsCaptured();
+    void histogramCaptured();
+    void panoramaCaptured(QImage image);
     void changeInfo(QString label);
     void panoramaInfo(QString label);
     void panoramaNumberImages(int);
+    // The image of the text detection is ready, it must be fetched with getTextAreas()
+    void textAreasCaptured(bool detectArea);
+    void profileUpdated(QStringList lines, QString summary);
     
 public slots:
     void toggleBW(bool);
@@ -74,6 +140,7 @@ public slots:
     void togglePanorama(bool);
 #endif // endif withstitching
     void togglePhoto(bool);
+    void toggleTone(bool);
     
     void change_blur_range(int);
     void change_blur_method(int);
@@ -105,6 +172,22 @@ public slots:
     void change_photo_sigmas(int);
     void change_photo_sigmar(double);
     
+    void change_tone_brightness(int);
+    void change_tone_contrast(double);
+    void change_tone_gamma(double);
+    
+    void change_frame_policy(int);
+    void toggleProfiling(bool);
+    void togglePipeline(bool);
+    void toggleGovernor(bool);
+    void change_target_fps(int);
+    void change_fps_cap(int);
+    void change_analysis_width(int);
+    void change_record_policy(int);
+    void change_motion_preroll(int);
+    void change_motion_postroll(int);
+    void change_motion_threshold(double);
+    
 #ifdef withstitching
     void panorama_pick_up_image();
     void panorama_pop_out_image();
@@ -114,6 +197,7 @@ public slots:
 #endif // endif withstitching
     
     void file_save_image();
+    void file_save_burst(int count);
     
 protected:
     void run() override; 
@@ -121,16 +205,50 @@ protected:
 private:
     // Private variables
     MyImage* myFrame;
-    cv::Mat currentMat;
-    int camID,record_time_blink;
-    cv::VideoCapture capture;
-    cv::VideoWriter video_out;
+    int record_time_blink;
+    FrameSource *source;
+    cv::Size frame_size;
+    FrameRingBuffer frame_buffer;
+    FrameGrabber frame_grabber;
+    PipelinedProcessor pipeline;
+    std::atomic<int> requested_groups;
+    CommandQueue commands;
+    std::vector<CommandQueue::Command> pending_commands;
+    std::vector<double> command_state;  // last value of every ProcessingCommand, NaN if never set
+    QualityGovernor governor;
+    VideoRecorder recorder;
+    RawFrameWriter raw_writer;
+    MotionRecorder motion_recorder;
+    SnapshotWriter snapshots;
+    SessionRecorder session;
+    VideoRecorder streamer;
     cv::String file_name_save, main_directory, file_background, file_cascade,file_facemark,video_out_name;
-    bool recording,running,motion_active,objects_active,qrdecoder_active;
-    bool histo_active,panorama_active;
-    QImage myQimage,motionQimage,objectsQimage,histoQimage,panorama_Qimage;
+    std::string stream_pipeline;
+    bool recording,running,qrdecoder_active;
+    bool panorama_active;
+    std::atomic<bool> profiling_active;
+    // Requests of the GUI that use myFrame (panorama, text detection), carried out by run() between
+    // two frames. Unlike the commands, every request is kept and they are carried out in order.
+    enum WorkerRequest {
+        REQUEST_PANORAMA_INSERT = 0,
+        REQUEST_PANORAMA_POP,
+        REQUEST_PANORAMA_RESET,
+        REQUEST_PANORAMA_UPDATE,
+        REQUEST_PANORAMA_SAVE,
+        REQUEST_TEXT_IMAGE,
+        REQUEST_TEXT_AREAS
+    };
+    std::mutex request_lock;
+    std::vector<int> requests, pending_requests;
+    std::string panorama_file_name;     // file of REQUEST_PANORAMA_SAVE, guarded by request_lock
+    QImage text_image;                  // result of the text detection, guarded by request_lock
+    std::vector<QRect> text_areas;
+    VideoFramePool frame_pool;
+    SinkRegistry sinks;
+    DisplaySink frame_sink, motion_sink, objects_sink, histo_sink;
+    RecorderSink recorder_sink, stream_sink;
+    SnapshotSink snapshot_sink;
     QMainWindow *mainWindowParent;
-    QMutex *data_lock;
     double cameraFPS ;
     bool cameraFPScalculated;
     
@@ -142,6 +260,25 @@ private:
 #ifdef withface
     bool setFacemarkFile();
 #endif // endif withface
+    void sendProfile();
+    void postRequest(int request);
+    void applyRequests();
+#ifdef withstitching
+    void computePanorama();
+#endif // endif withstitching
+#ifdef withtesseract
+    void detectTextAreas(bool detectArea);
+#endif // endif withtesseract
+    void saveSnapshots(int count);
+    void updatePipeline();
+    bool applyCommands();
+    void recordCommand(int key, double value);
+    void applyQuality();
+    FrameSink* getTapSink(int sink);
+    bool takeImage(TripleBuffer &display, QImage &image);
+    static QImage toQImage(const VideoFrame &frame);
+    cv::Mat toDisplayBuffer(const cv::Mat &image);
+    VideoFrame toDisplayFrame(const VideoFrame &frame, bool own=false);
 };
 
 #endif // CAPTUREVIDEO_H
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *  Lock-free queue of the parameter changes of the image processing, several producers and one
+ *  consumer. The repeated changes of a parameter (a slider being dragged) are merged into the last
+ *  one, so that the consumer applies at most one change per parameter and per frame. No Qt thing here.
+*/
+
+#include "commandqueue.h"
+
+#include <algorithm>
+#include <cassert>
+
+/**
+ * @brief CommandQueue::CommandQueue
+ * @param number_keys: integer the number of different parameters, the keys are 0 to number_keys-1
+ */
+CommandQueue::CommandQueue(int number_keys) : nodes(new Node[number_keys > 0 ? number_keys : 1]),
+                                              number_keys(number_keys > 0 ? number_keys : 1),
+                                              head(nullptr),
+                                              posted(0),
+                                              drained(0)
+{
+    for (int i=0; i<this->number_keys; i++) {
+        this->nodes[i].key  = i;
+        this->nodes[i].next = nullptr;
+        this->nodes[i].pending = false;
+        this->nodes[i].value   = 0.;
+    }
+}
+
+/**
+ * @brief CommandQueue::post
+ * @param key: integer the parameter
+ * @param value: double its new value (integers and booleans are exact)
+ *
+ * Called by any thread. If the parameter is already pending, only its value is replaced.
+ */
+void CommandQueue::post(int key, double value) {
+    assert(key>=0 && key<this->number_keys);
+    if (key < 0 || key >= this->number_keys)
+        return;
+    Node *node = &this->nodes[key];
+    node->value = value;
+    this->posted++;
+    if (node->pending.exchange(true))
+        return; // the consumer will read the new value
+
+    Node *next = this->head.load();
+    do {
+        node->next = next;
+    } while (!this->head.compare_exchange_weak(next, node));
+}
+
+/**
+ * @brief CommandQueue::drain
+ * @param commands: vector receives the pending commands, in the order in which they became pending
+ * @return true if there is at least one command
+ *
+ * Called by the consumer thread only
+ */
+bool CommandQueue::drain(std::vector<Command> &commands) {
+    commands.clear();
+    Node *list = this->head.exchange(nullptr);
+    if (list == nullptr)
+        return false;
+
+    // The nodes cannot be pushed again while they are pending: walk the stack before releasing them
+    for (Node *node = list; node != nullptr; node = node->next) {
+        Command command;
+        command.key   = node->key;
+        command.value = 0.;
+        commands.push_back(command);
+    }
+    std::reverse(commands.begin(), commands.end());
+
+    // A value posted after the release of its node queues the node again for the next drain
+    for (size_t i=0; i<commands.size(); i++) {
+        Node &node = this->nodes[commands[i].key];
+        node.pending = false;
+        commands[i].value = node.value;
+    }
+    this->drained += commands.size();
+    return true;
+}
+
+/**
+ * @brief CommandQueue::get_number_keys
+ * @return the number of different parameters
+ */
+int CommandQueue::get_number_keys() {
+    return this->number_keys;
+}
+
+/**
+ * @brief CommandQueue::get_posted
+ * @return the number of calls to post() since the creation
+ */
+unsigned long long CommandQueue::get_posted() {
+    return this->posted;
+}
+
+/**
+ * @brief CommandQueue::get_drained
+ * @return the number of commands given to the consumer since the creation, the others have been merged
+ */
+unsigned long long CommandQueue::get_drained() {
+    return this->drained;
+}
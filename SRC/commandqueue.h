@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef COMMANDQUEUE_H
+#define COMMANDQUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief The CommandQueue class
+ *
+ * Mailbox of the parameter changes sent by any thread (the GUI) to one processing thread, which
+ * applies them between two frames. A command is a key (the parameter) and a value, and only the
+ * last value posted for a key is kept: a key is queued once, when it becomes pending, and its value
+ * is read when the queue is drained. Neither post() nor drain() takes a lock: every key has its own
+ * node, pushed on a stack with a compare-and-swap and taken all at once by the consumer.
+ */
+class CommandQueue
+{
+public:
+    struct Command {
+        int key;
+        double value;
+    };
+
+    explicit CommandQueue(int number_keys);
+
+    void post(int key, double value);
+    bool drain(std::vector<Command> &commands);
+
+    int get_number_keys();
+    unsigned long long get_posted();
+    unsigned long long get_drained();
+
+private:
+    struct Node {
+        int key;
+        Node *next;
+        std::atomic<bool> pending;     // the node is in the stack, or taken but not read yet
+        std::atomic<double> value;     // last value posted
+    };
+
+    std::unique_ptr<Node[]> nodes;
+    int number_keys;
+    std::atomic<Node*> head;
+    std::atomic<unsigned long long> posted;
+    unsigned long long drained;        // owned by the consumer
+};
+
+#endif // COMMANDQUEUE_H
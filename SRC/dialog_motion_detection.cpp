@@ -6,6 +6,8 @@
  *   Implemented methods are:
  *      1) Farneback dense optical flow (desactived because does not work)
  *      2) Foreground extraction
+ *   and with the recording of the events of motion (seconds recorded before and after the motion,
+ *   part of the image in motion that starts an event)
  *
 */
 
@@ -37,9 +39,62 @@ Dialog_Motion_Detection::Dialog_Motion_Detection(QWidget *parent): QDialog(paren
 //    radioButton1->setToolTip("Farneback dense optical flow computes the optical flow for all the points in the frame");
     radioButton2->setToolTip("Background extraction: create a foreground mask that contains the moving objects. It performs a subtraction between the current frame and a background model");
 
+    // QLabels to show the values of the recording of the events
+    this->Slider_preroll_qlabel = new QLabel("Before: 30 s", this);
+    this->Slider_preroll_qlabel->setFixedWidth(this->Slider_preroll_qlabel->sizeHint().width());
+    this->Slider_preroll_qlabel->setSizePolicy(QSizePolicy::Fixed,QSizePolicy::Fixed);
+    this->Slider_preroll_qlabel->setText("Before: 5 s");
+
+    this->Slider_postroll_qlabel = new QLabel("After: 60 s", this);
+    this->Slider_postroll_qlabel->setFixedWidth(this->Slider_postroll_qlabel->sizeHint().width());
+    this->Slider_postroll_qlabel->setSizePolicy(QSizePolicy::Fixed,QSizePolicy::Fixed);
+    this->Slider_postroll_qlabel->setText("After: 10 s");
+
+    this->Slider_threshold_qlabel = new QLabel("Trigger: 20.0 %", this);
+    this->Slider_threshold_qlabel->setFixedWidth(this->Slider_threshold_qlabel->sizeHint().width());
+    this->Slider_threshold_qlabel->setSizePolicy(QSizePolicy::Fixed,QSizePolicy::Fixed);
+    this->Slider_threshold_qlabel->setText("Trigger: 1 %");
+
+    // Slider for the seconds recorded before the motion [0,30]
+    QSlider* Slider_preroll_value = new QSlider( Qt::Horizontal , this);
+    Slider_preroll_value->setTickPosition(QSlider::TicksBothSides);
+    Slider_preroll_value->setTickInterval(5);
+    Slider_preroll_value->setSingleStep(1);
+    Slider_preroll_value->setRange(0,30);
+    Slider_preroll_value->setValue(5);
+    connect(Slider_preroll_value, SIGNAL(valueChanged(int)), this, SLOT(onClick_Slider_preroll_value(int)));
+
+    // Slider for the seconds recorded after the motion [1,60]
+    QSlider* Slider_postroll_value = new QSlider( Qt::Horizontal , this);
+    Slider_postroll_value->setTickPosition(QSlider::TicksBothSides);
+    Slider_postroll_value->setTickInterval(10);
+    Slider_postroll_value->setSingleStep(1);
+    Slider_postroll_value->setRange(1,60);
+    Slider_postroll_value->setValue(10);
+    connect(Slider_postroll_value, SIGNAL(valueChanged(int)), this, SLOT(onClick_Slider_postroll_value(int)));
+
+    // Slider for the part of the image in motion that starts an event [0.1%,20%] by steps of 0.1%
+    QSlider* Slider_threshold_value = new QSlider( Qt::Horizontal , this);
+    Slider_threshold_value->setTickPosition(QSlider::TicksBothSides);
+    Slider_threshold_value->setTickInterval(20);
+    Slider_threshold_value->setSingleStep(1);
+    Slider_threshold_value->setRange(1,200);
+    Slider_threshold_value->setValue(10);
+    connect(Slider_threshold_value, SIGNAL(valueChanged(int)), this, SLOT(onClick_Slider_threshold_value(int)));
+
+    Slider_preroll_value->setToolTip("Recording on motion: seconds kept in memory and recorded before the motion starts");
+    Slider_postroll_value->setToolTip("Recording on motion: seconds recorded after the motion has stopped");
+    Slider_threshold_value->setToolTip("Recording on motion: part of the image in motion that starts an event");
+
     QGridLayout *grid = new QGridLayout;
 //    grid->addWidget(radioButton1,                 0, 0);
     grid->addWidget(radioButton2,                 1, 0);
+    grid->addWidget(Slider_preroll_value,          2, 0);
+    grid->addWidget(this->Slider_preroll_qlabel,   2, 1);
+    grid->addWidget(Slider_postroll_value,         3, 0);
+    grid->addWidget(this->Slider_postroll_qlabel,  3, 1);
+    grid->addWidget(Slider_threshold_value,        4, 0);
+    grid->addWidget(this->Slider_threshold_qlabel, 4, 1);
 
     setLayout(grid);
     setWindowTitle(tr("Motion detection control window"));
@@ -55,3 +110,39 @@ Dialog_Motion_Detection::Dialog_Motion_Detection(QWidget *parent): QDialog(paren
 void Dialog_Motion_Detection::onClick_Radio_Motion_Method() {
     emit this->Signal_motion_detection_method_changed(this->RadioButtons->checkedId());
 }
+
+/**
+ * @brief Dialog_Motion_Detection::onClick_Slider_preroll_value
+ * @param value: integer value from the slider that manages the seconds recorded before the motion
+ * 
+ * Function called when the slider is modified.
+ * Emits a signal to the external world with the number of seconds.
+ */
+void Dialog_Motion_Detection::onClick_Slider_preroll_value(int value) {
+    this->Slider_preroll_qlabel->setText("Before: "+QString::number(value)+" s");
+    emit this->Signal_motion_record_preroll_changed(value);
+}
+
+/**
+ * @brief Dialog_Motion_Detection::onClick_Slider_postroll_value
+ * @param value: integer value from the slider that manages the seconds recorded after the motion
+ * 
+ * Function called when the slider is modified.
+ * Emits a signal to the external world with the number of seconds.
+ */
+void Dialog_Motion_Detection::onClick_Slider_postroll_value(int value) {
+    this->Slider_postroll_qlabel->setText("After: "+QString::number(value)+" s");
+    emit this->Signal_motion_record_postroll_changed(value);
+}
+
+/**
+ * @brief Dialog_Motion_Detection::onClick_Slider_threshold_value
+ * @param value: integer value from the slider, the part of the image in motion in tenths of percent
+ * 
+ * Function called when the slider is modified.
+ * Emits a signal to the external world with the part of the image, between 0 and 1.
+ */
+void Dialog_Motion_Detection::onClick_Slider_threshold_value(int value) {
+    this->Slider_threshold_qlabel->setText("Trigger: "+QString::number(value / 10.)+" %");
+    emit this->Signal_motion_record_threshold_changed(value / 1000.);
+}
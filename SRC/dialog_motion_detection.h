@@ -9,6 +9,9 @@
 #include <QGridLayout>
 #include <QButtonGroup>
 #include <QRadioButton>
+#include <QLabel>
+#include <QSizePolicy>
+#include <QSlider>
 
 class Dialog_Motion_Detection : public QDialog
 {
@@ -19,12 +22,21 @@ public:
 
 private:
     QButtonGroup* RadioButtons;
+    QLabel* Slider_preroll_qlabel;
+    QLabel* Slider_postroll_qlabel;
+    QLabel* Slider_threshold_qlabel;
 
 private slots:
     void onClick_Radio_Motion_Method();
+    void onClick_Slider_preroll_value(int value);
+    void onClick_Slider_postroll_value(int value);
+    void onClick_Slider_threshold_value(int value);
 
 signals:
     void Signal_motion_detection_method_changed(int);
+    void Signal_motion_record_preroll_changed(int);
+    void Signal_motion_record_postroll_changed(int);
+    void Signal_motion_record_threshold_changed(double);
 
 };
 
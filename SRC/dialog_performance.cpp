@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *   Management of the Qt window that deals with the frame rate of the processing:
+ *      * Target frame rate, held by lowering the quality of the processing
+ *      * Maximum frame rate
+ *      * Width of the reduced copy of the image analyzed by the detectors (faces, objects, motion, codes)
+*/
+
+#include "dialog_performance.h"
+
+/**
+ * @brief Dialog_Performance::Dialog_Performance
+ * @param parent
+ * 
+ * Constructor of the class Dialog_Performance. Set the appearance of the widget and create connections 
+ * between the sliders and the functionnalities
+ */
+Dialog_Performance::Dialog_Performance(QWidget *parent):    QDialog(parent)
+{
+    this->value_target_fps = 25;
+    this->value_fps_cap    = 0;
+    this->value_analysis_width = 0;
+
+    // QLabels to show the values
+    this->Slider_target_fps_qlabel = new QLabel("Target: 60 FPS", this);
+    this->Slider_target_fps_qlabel->setFixedWidth(this->Slider_target_fps_qlabel->sizeHint().width());
+    this->Slider_target_fps_qlabel->setSizePolicy(QSizePolicy::Fixed,QSizePolicy::Fixed);
+    this->Slider_target_fps_qlabel->setText("Target: 25 FPS");
+
+    this->Slider_fps_cap_qlabel = new QLabel("Maximum: 120 FPS", this);
+    this->Slider_fps_cap_qlabel->setFixedWidth(this->Slider_fps_cap_qlabel->sizeHint().width());
+    this->Slider_fps_cap_qlabel->setSizePolicy(QSizePolicy::Fixed,QSizePolicy::Fixed);
+    this->Slider_fps_cap_qlabel->setText("Maximum: none");
+
+    this->Slider_analysis_width_qlabel = new QLabel("Analysis: 1920 px", this);
+    this->Slider_analysis_width_qlabel->setFixedWidth(this->Slider_analysis_width_qlabel->sizeHint().width());
+    this->Slider_analysis_width_qlabel->setSizePolicy(QSizePolicy::Fixed,QSizePolicy::Fixed);
+    this->Slider_analysis_width_qlabel->setText("Analysis: full");
+
+    // Slider for the target frame rate [5,60]
+    QSlider* Slider_target_fps_value = new QSlider( Qt::Horizontal , this);
+    Slider_target_fps_value->setTickPosition(QSlider::TicksBothSides);
+    Slider_target_fps_value->setTickInterval(5);
+    Slider_target_fps_value->setSingleStep(1);
+    Slider_target_fps_value->setRange(5,60);
+    Slider_target_fps_value->setValue(this->value_target_fps);
+    connect(Slider_target_fps_value, SIGNAL(valueChanged(int)), this, SLOT(onClick_Slider_target_fps_value(int)));
+
+    // Slider for the maximum frame rate [0,120], 0 for no maximum
+    QSlider* Slider_fps_cap_value = new QSlider( Qt::Horizontal , this);
+    Slider_fps_cap_value->setTickPosition(QSlider::TicksBothSides);
+    Slider_fps_cap_value->setTickInterval(10);
+    Slider_fps_cap_value->setSingleStep(1);
+    Slider_fps_cap_value->setRange(0,120);
+    Slider_fps_cap_value->setValue(this->value_fps_cap);
+    connect(Slider_fps_cap_value, SIGNAL(valueChanged(int)), this, SLOT(onClick_Slider_fps_cap_value(int)));
+
+    // Slider for the width of the analyzed images [0,1920] by steps of 80, 0 for the full resolution
+    QSlider* Slider_analysis_width_value = new QSlider( Qt::Horizontal , this);
+    Slider_analysis_width_value->setTickPosition(QSlider::TicksBothSides);
+    Slider_analysis_width_value->setTickInterval(320);
+    Slider_analysis_width_value->setSingleStep(80);
+    Slider_analysis_width_value->setPageStep(160);
+    Slider_analysis_width_value->setRange(0,1920);
+    Slider_analysis_width_value->setValue(this->value_analysis_width);
+    connect(Slider_analysis_width_value, SIGNAL(valueChanged(int)), this, SLOT(onClick_Slider_analysis_width_value(int)));
+
+    // Tool tips when hovering the sliders
+    Slider_target_fps_value->setToolTip("Frame rate held by lowering the resolution of the processing, the cadence of the analyzers and the precision of the expensive filters");
+    Slider_fps_cap_value->setToolTip("Maximum frame rate of the processing, 0 for no maximum. Saves the processor when the scene does not need more.");
+    Slider_analysis_width_value->setToolTip("The detectors (faces, objects, motion, QR codes, text) work on a copy of the image reduced to this width, 0 for the full resolution");
+
+    // Grid layout
+    QGridLayout *grid = new QGridLayout(this);
+    grid->addWidget(Slider_target_fps_value,        0, 0);
+    grid->addWidget(this->Slider_target_fps_qlabel, 0, 1);
+    grid->addWidget(Slider_fps_cap_value,           1, 0);
+    grid->addWidget(this->Slider_fps_cap_qlabel,    1, 1);
+    grid->addWidget(Slider_analysis_width_value,        2, 0);
+    grid->addWidget(this->Slider_analysis_width_qlabel, 2, 1);
+
+    setLayout(grid);
+    setWindowTitle(tr("Frame rate control window"));
+    resize(400, 150);
+}
+
+/**
+ * @brief Dialog_Performance::onClick_Slider_target_fps_value
+ * @param value: integer value from the slider that manages the target frame rate
+ * 
+ * Function called when the slider for the target frame rate is modified.
+ * Emits a signal to the external world with the value of the target frame rate.
+ */
+void Dialog_Performance::onClick_Slider_target_fps_value(int value){
+    this->value_target_fps = value;
+    this->Slider_target_fps_qlabel->setText("Target: "+QString::number(this->value_target_fps)+" FPS");
+    emit this->Signal_performance_target_fps_changed(this->value_target_fps);
+}
+
+/**
+ * @brief Dialog_Performance::onClick_Slider_fps_cap_value
+ * @param value: integer value from the slider that manages the maximum frame rate
+ * 
+ * Function called when the slider for the maximum frame rate is modified.
+ * Emits a signal to the external world with the value of the maximum frame rate.
+ */
+void Dialog_Performance::onClick_Slider_fps_cap_value(int value){
+    this->value_fps_cap = value;
+    if (this->value_fps_cap == 0)
+        this->Slider_fps_cap_qlabel->setText("Maximum: none");
+    else
+        this->Slider_fps_cap_qlabel->setText("Maximum: "+QString::number(this->value_fps_cap)+" FPS");
+    emit this->Signal_performance_fps_cap_changed(this->value_fps_cap);
+}
+
+/**
+ * @brief Dialog_Performance::onClick_Slider_analysis_width_value
+ * @param value: integer value from the slider that manages the width of the analyzed images
+ * 
+ * Function called when the slider for the width of the analyzed images is modified.
+ * Emits a signal to the external world with the width, rounded to a multiple of 80 pixels.
+ */
+void Dialog_Performance::onClick_Slider_analysis_width_value(int value){
+    this->value_analysis_width = (value + 40) / 80 * 80;
+    if (this->value_analysis_width == 0)
+        this->Slider_analysis_width_qlabel->setText("Analysis: full");
+    else
+        this->Slider_analysis_width_qlabel->setText("Analysis: "+QString::number(this->value_analysis_width)+" px");
+    emit this->Signal_performance_analysis_width_changed(this->value_analysis_width);
+}
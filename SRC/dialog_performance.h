@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef DIALOG_PERFORMANCE_H
+#define DIALOG_PERFORMANCE_H
+
+#include <QDialog>
+#include <QLabel>
+#include <QGridLayout>
+#include <QSizePolicy>
+#include <QSlider>
+
+class Dialog_Performance: public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit Dialog_Performance(QWidget *parent = nullptr);
+
+private:
+    QLabel* Slider_target_fps_qlabel;
+    QLabel* Slider_fps_cap_qlabel;
+    QLabel* Slider_analysis_width_qlabel;
+    int value_target_fps,value_fps_cap,value_analysis_width;
+
+private slots:
+    void onClick_Slider_target_fps_value(int value);
+    void onClick_Slider_fps_cap_value(int value);
+    void onClick_Slider_analysis_width_value(int value);
+
+signals:
+    void Signal_performance_target_fps_changed(int value);
+    void Signal_performance_fps_cap_changed(int value);
+    void Signal_performance_analysis_width_changed(int value);
+
+};
+
+#endif // DIALOG_PERFORMANCE_H
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *   Management of the Qt window that deals with the tone of the image:
+ *      * Brightness
+ *      * Contrast
+ *      * Gamma correction
+ *  The three corrections are applied together with a lookup table
+*/
+
+#include "dialog_tone.h"
+
+/**
+ * @brief Dialog_Tone::Dialog_Tone
+ * @param parent
+ * 
+ * Constructor of the class Dialog_Tone. Set the appearance of the widget and create connections 
+ * between the sliders and the functionnalities
+ */
+Dialog_Tone::Dialog_Tone(QWidget *parent):    QDialog(parent)
+{
+    this->value_brightness = 0;
+    this->value_contrast   = 1.;
+    this->value_gamma      = 1.;
+
+    // QLabels to show the values
+    this->Slider_brightness_qlabel = new QLabel("Brightness: -100", this);
+    this->Slider_brightness_qlabel->setFixedWidth(this->Slider_brightness_qlabel->sizeHint().width());
+    this->Slider_brightness_qlabel->setSizePolicy(QSizePolicy::Fixed,QSizePolicy::Fixed);
+    this->Slider_brightness_qlabel->setText("Brightness: 0");
+
+    this->Slider_contrast_qlabel = new QLabel("Contrast: 3.00", this);
+    this->Slider_contrast_qlabel->setFixedWidth(this->Slider_contrast_qlabel->sizeHint().width());
+    this->Slider_contrast_qlabel->setSizePolicy(QSizePolicy::Fixed,QSizePolicy::Fixed);
+    this->Slider_contrast_qlabel->setText("Contrast: 1");
+
+    this->Slider_gamma_qlabel = new QLabel("Gamma: 5.00", this);
+    this->Slider_gamma_qlabel->setFixedWidth(this->Slider_gamma_qlabel->sizeHint().width());
+    this->Slider_gamma_qlabel->setSizePolicy(QSizePolicy::Fixed,QSizePolicy::Fixed);
+    this->Slider_gamma_qlabel->setText("Gamma: 1");
+
+    // Slider for the brightness [-100,100]
+    QSlider* Slider_brightness_value = new QSlider( Qt::Horizontal , this);
+    Slider_brightness_value->setTickPosition(QSlider::TicksBothSides);
+    Slider_brightness_value->setTickInterval(20);
+    Slider_brightness_value->setSingleStep(1);
+    Slider_brightness_value->setRange(-100,100);
+    Slider_brightness_value->setValue(0);
+    connect(Slider_brightness_value, SIGNAL(valueChanged(int)), this, SLOT(onClick_Slider_brightness_value(int)));
+
+    // Slider for the contrast [0,3] by steps of 0.01
+    QSlider* Slider_contrast_value = new QSlider( Qt::Horizontal , this);
+    Slider_contrast_value->setTickPosition(QSlider::TicksBothSides);
+    Slider_contrast_value->setTickInterval(25);
+    Slider_contrast_value->setSingleStep(1);
+    Slider_contrast_value->setRange(0,300);
+    Slider_contrast_value->setValue(100);
+    connect(Slider_contrast_value, SIGNAL(valueChanged(int)), this, SLOT(onClick_Slider_contrast_value(int)));
+
+    // Slider for the gamma [0.1,5] by steps of 0.01
+    QSlider* Slider_gamma_value = new QSlider( Qt::Horizontal , this);
+    Slider_gamma_value->setTickPosition(QSlider::TicksBothSides);
+    Slider_gamma_value->setTickInterval(50);
+    Slider_gamma_value->setSingleStep(1);
+    Slider_gamma_value->setRange(10,500);
+    Slider_gamma_value->setValue(100);
+    connect(Slider_gamma_value, SIGNAL(valueChanged(int)), this, SLOT(onClick_Slider_gamma_value(int)));
+
+    // Tool tips when hovering the sliders
+    Slider_brightness_value->setToolTip("Value added to every pixel");
+    Slider_contrast_value->setToolTip("Gain around the middle gray. 1 leaves the image unchanged.");
+    Slider_gamma_value->setToolTip("Gamma correction. Values above 1 brighten the dark tones.");
+
+    // Grid layout
+    QGridLayout *grid = new QGridLayout(this);
+    grid->addWidget(Slider_brightness_value,        0, 0);
+    grid->addWidget(this->Slider_brightness_qlabel, 0, 1);
+    grid->addWidget(Slider_contrast_value,          1, 0);
+    grid->addWidget(this->Slider_contrast_qlabel,   1, 1);
+    grid->addWidget(Slider_gamma_value,             2, 0);
+    grid->addWidget(this->Slider_gamma_qlabel,      2, 1);
+
+    setLayout(grid);
+    setWindowTitle(tr("Brightness, contrast and gamma control window"));
+    resize(400, 150);
+}
+
+/**
+ * @brief Dialog_Tone::onClick_Slider_brightness_value
+ * @param value: integer value from the slider that manages the brightness
+ * 
+ * Function called when the slider for the brightness is modified.
+ * Emits a signal to the external world with the value of the brightness.
+ */
+void Dialog_Tone::onClick_Slider_brightness_value(int value){
+    this->value_brightness = value;
+    this->Slider_brightness_qlabel->setText("Brightness: "+QString::number(this->value_brightness));
+    emit this->Signal_tone_brightness_changed(this->value_brightness);
+}
+
+/**
+ * @brief Dialog_Tone::onClick_Slider_contrast_value
+ * @param value: integer value from the slider that manages the contrast
+ * 
+ * Function called when the slider for the contrast is modified.
+ * Emits a signal to the external world with the value of the contrast.
+ */
+void Dialog_Tone::onClick_Slider_contrast_value(int value){
+    this->value_contrast = value / 100.;
+    this->Slider_contrast_qlabel->setText("Contrast: "+QString::number(this->value_contrast));
+    emit this->Signal_tone_contrast_changed(this->value_contrast);
+}
+
+/**
+ * @brief Dialog_Tone::onClick_Slider_gamma_value
+ * @param value: integer value from the slider that manages the gamma
+ * 
+ * Function called when the slider for the gamma is modified.
+ * Emits a signal to the external world with the value of the gamma.
+ */
+void Dialog_Tone::onClick_Slider_gamma_value(int value){
+    this->value_gamma = value / 100.;
+    this->Slider_gamma_qlabel->setText("Gamma: "+QString::number(this->value_gamma));
+    emit this->Signal_tone_gamma_changed(this->value_gamma);
+}
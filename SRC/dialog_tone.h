@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef DIALOG_TONE_H
+#define DIALOG_TONE_H
+
+#include <QDialog>
+#include <QLabel>
+#include <QGridLayout>
+#include <QSizePolicy>
+#include <QSlider>
+
+class Dialog_Tone: public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit Dialog_Tone(QWidget *parent = nullptr);
+
+private:
+    QLabel* Slider_brightness_qlabel;
+    QLabel* Slider_contrast_qlabel;
+    QLabel* Slider_gamma_qlabel;
+    int value_brightness;
+    double value_contrast,value_gamma;
+
+private slots:
+    void onClick_Slider_brightness_value(int value);
+    void onClick_Slider_contrast_value(int value);
+    void onClick_Slider_gamma_value(int value);
+
+signals:
+    void Signal_tone_brightness_changed(int value);
+    void Signal_tone_contrast_changed(double value);
+    void Signal_tone_gamma_changed(double value);
+
+};
+
+#endif // DIALOG_TONE_H
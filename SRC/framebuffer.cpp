@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *  Lock-free ring buffer of preallocated OpenCV frames, used to hand over the frames from
+ *  the thread that grabs the camera to the thread that processes them.
+ *  Every slot carries a sequence number that tells whether it is free or filled, so the
+ *  producer can also discard the oldest frame (acting as a second consumer) when the
+ *  buffer is full. No Qt thing here.
+*/
+
+#include "framebuffer.h"
+
+#include <cassert>
+#include <chrono>
+#include <thread>
+
+/**
+ * @brief FrameRingBuffer::FrameRingBuffer
+ * @param capacity: integer the number of slots of the ring
+ * @param policy: integer the behaviour when the ring is full (see FrameRingBuffer::Policy)
+ *
+ * Constructor of the class FrameRingBuffer. The slots are empty until allocate() is called.
+ */
+FrameRingBuffer::FrameRingBuffer(int capacity, int policy) : slots(new Slot[capacity > 0 ? capacity : 1]),
+                                                               enqueue_pos(0),
+                                                               dequeue_pos(0),
+                                                               policy(policy),
+                                                               closed(false),
+                                                               pushed(0),
+                                                               popped(0),
+                                                               dropped(0)
+{
+    assert(capacity>0);
+    this->capacity = (size_t) (capacity > 0 ? capacity : 1);
+    for (size_t i=0; i<this->capacity; i++)
+        this->slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+/**
+ * @brief FrameRingBuffer::allocate
+ * @param size: cv::Size the dimensions of the frames
+ * @param type: integer the OpenCV type of the frames (CV_8UC3, ...)
+ *
+ * Preallocate the image buffer of every slot. Must be called while no thread uses the ring.
+ */
+void FrameRingBuffer::allocate(cv::Size size, int type) {
+    clear();
+    for (size_t i=0; i<this->capacity; i++)
+        this->slots[i].frame.create(size, type);
+}
+
+/**
+ * @brief FrameRingBuffer::push
+ * @param frame: cv::Mat the new frame. On return it contains a recycled buffer (possibly empty)
+ * @return true if the frame has been queued. False if it has been dropped
+ *
+ * Called by the producer only. The behaviour when the ring is full depends on the policy.
+ */
+bool FrameRingBuffer::push(cv::Mat &frame) {
+    if (frame.empty())
+        return false;
+    this->pushed++;
+
+    cv::Mat victim;
+    while (!try_enqueue(frame)) {
+        if (this->closed) {
+            this->dropped++;
+            return false;
+        }
+        if (this->policy == BLOCK) {
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+        }
+        else if (try_dequeue(victim)) {
+            // Make room by discarding the oldest frame, its buffer will be recycled
+            this->dropped++;
+        }
+        else {
+            // The consumer is releasing the last occupied slot, it won't be long
+            std::this_thread::yield();
+        }
+    }
+    // Give back the buffer of the discarded frame rather than an empty one
+    if (frame.empty() && !victim.empty())
+        cv::swap(frame, victim);
+    return true;
+}
+
+/**
+ * @brief FrameRingBuffer::pop
+ * @param frame: cv::Mat that receives the frame. Its previous buffer is given back to the ring
+ * @param timeout_ms: integer the maximum waiting time if the ring is empty (0 = don't wait)
+ * @return true if a frame has been received
+ *
+ * Called by the consumer only. With the policy KEEP_LATEST, the older frames are discarded.
+ */
+bool FrameRingBuffer::pop(cv::Mat &frame, int timeout_ms) {
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() +
+                                                     std::chrono::milliseconds(timeout_ms);
+    while (!try_dequeue(frame)) {
+        if (this->closed || std::chrono::steady_clock::now() >= deadline)
+            return false;
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+
+    if (this->policy == KEEP_LATEST) {
+        // Only the freshest frame is of interest
+        while (try_dequeue(frame))
+            this->dropped++;
+    }
+    this->popped++;
+    return true;
+}
+
+/**
+ * @brief FrameRingBuffer::clear
+ *
+ * Discard all the queued frames. The buffers stay in the slots for later reuse.
+ */
+void FrameRingBuffer::clear() {
+    cv::Mat tmp;
+    while (try_dequeue(tmp))
+        ; // each dequeue hands the previous buffer back to the freed slot
+}
+
+/**
+ * @brief FrameRingBuffer::close
+ *
+ * Wake up and release a blocked producer or consumer. Used when a thread is stopped.
+ */
+void FrameRingBuffer::close() {
+    this->closed = true;
+}
+
+/**
+ * @brief FrameRingBuffer::reopen
+ *
+ * Accept again frames after a call to close()
+ */
+void FrameRingBuffer::reopen() {
+    this->closed = false;
+}
+
+/**
+ * @brief FrameRingBuffer::set_policy
+ * @param policy: integer the new behaviour when the ring is full (see FrameRingBuffer::Policy)
+ */
+void FrameRingBuffer::set_policy(int policy) {
+    assert(policy>=DROP_OLDEST && policy<=KEEP_LATEST);
+    this->policy = policy;
+}
+
+/**
+ * @brief FrameRingBuffer::get_policy
+ * @return the actual behaviour when the ring is full
+ */
+int FrameRingBuffer::get_policy() {
+    return this->policy;
+}
+
+/**
+ * @brief FrameRingBuffer::get_capacity
+ * @return the number of slots in the ring
+ */
+int FrameRingBuffer::get_capacity() {
+    return (int) this->capacity;
+}
+
+/**
+ * @brief FrameRingBuffer::get_size
+ * @return the approximate number of frames waiting in the ring
+ */
+int FrameRingBuffer::get_size() {
+    size_t in  = this->enqueue_pos.load(std::memory_order_relaxed);
+    size_t out = this->dequeue_pos.load(std::memory_order_relaxed);
+    return in > out ? (int) (in - out) : 0;
+}
+
+/**
+ * @brief FrameRingBuffer::get_pushed_frames
+ * @return the number of frames received from the producer
+ */
+unsigned long long FrameRingBuffer::get_pushed_frames() {
+    return this->pushed;
+}
+
+/**
+ * @brief FrameRingBuffer::get_popped_frames
+ * @return the number of frames delivered to the consumer
+ */
+unsigned long long FrameRingBuffer::get_popped_frames() {
+    return this->popped;
+}
+
+/**
+ * @brief FrameRingBuffer::get_dropped_frames
+ * @return the number of frames that have been discarded without being delivered
+ */
+unsigned long long FrameRingBuffer::get_dropped_frames() {
+    return this->dropped;
+}
+
+/**
+ * @brief FrameRingBuffer::reset_counters
+ */
+void FrameRingBuffer::reset_counters() {
+    this->pushed  = 0;
+    this->popped  = 0;
+    this->dropped = 0;
+}
+
+/**
+ * @brief FrameRingBuffer::try_enqueue
+ * @param frame: cv::Mat swapped with the content of the free slot
+ * @return false if the ring is full
+ */
+bool FrameRingBuffer::try_enqueue(cv::Mat &frame) {
+    size_t pos = this->enqueue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot &slot = this->slots[pos % this->capacity];
+        size_t seq = slot.sequence.load(std::memory_order_acquire);
+        long long dif = (long long) seq - (long long) pos;
+        if (dif == 0) {
+            if (this->enqueue_pos.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed)) {
+                cv::swap(slot.frame, frame);
+                slot.sequence.store(pos+1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (dif < 0)
+            return false; // full
+        else
+            pos = this->enqueue_pos.load(std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief FrameRingBuffer::try_dequeue
+ * @param frame: cv::Mat swapped with the content of the oldest filled slot
+ * @return false if the ring is empty
+ *
+ * May be called concurrently by the consumer and by the producer (to drop the oldest frame)
+ */
+bool FrameRingBuffer::try_dequeue(cv::Mat &frame) {
+    size_t pos = this->dequeue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+        Slot &slot = this->slots[pos % this->capacity];
+        size_t seq = slot.sequence.load(std::memory_order_acquire);
+        long long dif = (long long) seq - (long long) (pos+1);
+        if (dif == 0) {
+            if (this->dequeue_pos.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed)) {
+                cv::swap(slot.frame, frame);
+                slot.sequence.store(pos + this->capacity, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (dif < 0)
+            return false; // empty
+        else
+            pos = this->dequeue_pos.load(std::memory_order_relaxed);
+    }
+}
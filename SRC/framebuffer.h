@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include "opencv2/core.hpp"
+
+#include <atomic>
+#include <memory>
+
+/**
+ * @brief The FrameRingBuffer class
+ *
+ * Bounded single-producer / single-consumer queue of preallocated cv::Mat slots.
+ * Frames are exchanged with cv::swap so that the image buffers circulate between
+ * the producer, the slots and the consumer without any new allocation.
+ */
+class FrameRingBuffer
+{
+public:
+    // Behaviour of the buffer when the producer pushes while all the slots are occupied
+    enum Policy {
+        DROP_OLDEST = 1, // the oldest queued frame is discarded to make room for the new one
+        BLOCK       = 2, // the producer waits until the consumer frees a slot
+        KEEP_LATEST = 3  // as DROP_OLDEST, and pop() only returns the most recent frame
+    };
+
+    explicit FrameRingBuffer(int capacity=4, int policy=DROP_OLDEST);
+
+    void allocate(cv::Size size, int type);
+    bool push(cv::Mat &frame);
+    bool pop(cv::Mat &frame, int timeout_ms=0);
+    void clear();
+    void close();
+    void reopen();
+
+    void set_policy(int policy);
+    int  get_policy();
+    int  get_capacity();
+    int  get_size();
+
+    unsigned long long get_pushed_frames();
+    unsigned long long get_popped_frames();
+    unsigned long long get_dropped_frames();
+    void reset_counters();
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        cv::Mat frame;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    size_t capacity;
+    std::atomic<size_t> enqueue_pos, dequeue_pos;
+    std::atomic<int> policy;
+    std::atomic<bool> closed;
+    std::atomic<unsigned long long> pushed, popped, dropped;
+
+    bool try_enqueue(cv::Mat &frame);
+    bool try_dequeue(cv::Mat &frame);
+};
+
+#endif // FRAMEBUFFER_H
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *  The thread that grabs the frames from the camera. It is decoupled from the image processing
+ *  through a FrameRingBuffer so that a slow processing never lets the driver queue fill up with
+ *  stale frames. No Qt thing here.
+*/
+
+#include "framegrabber.h"
+
+#include <chrono>
+
+/**
+ * @brief FrameGrabber::FrameGrabber
+ * @param buffer: the FrameRingBuffer that receives the grabbed frames
+ *
+ * Constructor of the class FrameGrabber. The thread is launched by start()
+ */
+FrameGrabber::FrameGrabber(FrameRingBuffer *buffer) : buffer(buffer),
+                                                      source(nullptr),
+                                                      running(false),
+                                                      raw_writer(nullptr),
+                                                      grabbed(0),
+                                                      failed(0)
+{
+}
+
+/**
+ * @brief FrameGrabber::~FrameGrabber
+ *
+ * Stop the thread before destroying the object
+ */
+FrameGrabber::~FrameGrabber() {
+    stop();
+}
+
+/**
+ * @brief FrameGrabber::start
+ * @param source: the opened FrameSource to read from
+ * @return true if the thread has been launched
+ */
+bool FrameGrabber::start(FrameSource *source) {
+    stop();
+    if (source == nullptr || !source->isOpened())
+        return false;
+
+    this->source = source;
+    this->grabbed = 0;
+    this->failed  = 0;
+    this->buffer->reopen();
+    this->running = true;
+    this->thread = std::thread(&FrameGrabber::run, this);
+    return true;
+}
+
+/**
+ * @brief FrameGrabber::stop
+ *
+ * Terminate the loop of the thread and wait for it. The ring buffer is closed so that
+ * a producer blocked on a full ring is released.
+ */
+void FrameGrabber::stop() {
+    this->running = false;
+    this->buffer->close();
+    if (this->thread.joinable())
+        this->thread.join();
+}
+
+/**
+ * @brief FrameGrabber::isRunning
+ * @return the status of the thread
+ */
+bool FrameGrabber::isRunning() {
+    return this->running;
+}
+
+/**
+ * @brief FrameGrabber::set_raw_writer
+ * @param writer: RawFrameWriter that records the frames as they are grabbed, nullptr to stop
+ *
+ * The frames are recorded here rather than by the processing thread: the frames dropped by the
+ * ring buffer are recorded as well, with the time at which the driver delivered them
+ */
+void FrameGrabber::set_raw_writer(RawFrameWriter *writer) {
+    this->raw_writer = writer;
+}
+
+/**
+ * @brief FrameGrabber::get_grabbed_frames
+ * @return the number of frames read from the camera
+ */
+unsigned long long FrameGrabber::get_grabbed_frames() {
+    return this->grabbed;
+}
+
+/**
+ * @brief FrameGrabber::get_failed_grabs
+ * @return the number of empty frames returned by the camera
+ */
+unsigned long long FrameGrabber::get_failed_grabs() {
+    return this->failed;
+}
+
+/**
+ * @brief FrameGrabber::run
+ *
+ * The loop of the thread: read a frame in a recycled buffer and push it to the ring
+ */
+void FrameGrabber::run() {
+    cv::Mat frame;
+    while (this->running) {
+        // Never overwrite a buffer that is still referenced downstream (display, recording...)
+        if (frame.u != nullptr && frame.u->refcount > 1)
+            frame.release();
+
+        if (!this->source->read(frame) || frame.empty()) {
+            // The camera has not started yet, has been disconnected or the file is finished
+            this->failed++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            continue;
+        }
+        this->grabbed++;
+        RawFrameWriter *writer = this->raw_writer;
+        if (writer != nullptr)
+            writer->push(frame);
+        this->buffer->push(frame); // frame receives the recycled buffer of a free slot
+    }
+}
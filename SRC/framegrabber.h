@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef FRAMEGRABBER_H
+#define FRAMEGRABBER_H
+
+#include "opencv2/core.hpp"
+#include "framebuffer.h"
+#include "framesource.h"
+#include "rawframes.h"
+
+#include <atomic>
+#include <thread>
+
+/**
+ * @brief The FrameGrabber class
+ *
+ * Dedicated thread that reads the frames from the source as fast as the driver delivers them
+ * and pushes them into a FrameRingBuffer, independently of the speed of the image processing.
+ */
+class FrameGrabber
+{
+public:
+    explicit FrameGrabber(FrameRingBuffer *buffer);
+    ~FrameGrabber();
+
+    bool start(FrameSource *source);
+    void stop();
+    bool isRunning();
+    void set_raw_writer(RawFrameWriter *writer);
+
+    unsigned long long get_grabbed_frames();
+    unsigned long long get_failed_grabs();
+
+private:
+    FrameRingBuffer *buffer;
+    FrameSource *source;
+    std::thread thread;
+    std::atomic<bool> running;
+    std::atomic<RawFrameWriter*> raw_writer;
+    std::atomic<unsigned long long> grabbed, failed;
+
+    void run();
+};
+
+#endif // FRAMEGRABBER_H
@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *  Cache of the images derived from the current image of MyImage: gray levels, reduced copies for the
+ *  analyzers, histograms and the thresholds of Otsu and of the triangle computed from the histogram.
+ *  Every product is computed at most once per image. No Qt thing here.
+*/
+
+#include "frameproducts.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+
+/**
+ * @brief FrameProducts::FrameProducts
+ *
+ * Constructor of the class FrameProducts. There is no image yet.
+ */
+FrameProducts::FrameProducts() : valid(0),
+                                 hists(4),
+                                 computations(0)
+{
+}
+
+/**
+ * @brief FrameProducts::set_image
+ * @param image: cv::Mat the image the products are derived from
+ *
+ * The products are kept if image is the same image as before. If its content has been modified
+ * in place since, invalidate() must have been called.
+ */
+void FrameProducts::set_image(const cv::Mat &image) {
+    if (image.data == this->source.data && image.size() == this->source.size() &&
+        image.type() == this->source.type() && image.step == this->source.step)
+        return;
+    invalidate();
+    if (!image.empty())
+        this->source = cv::Mat(image.size(), image.type(), image.data, image.step);
+}
+
+/**
+ * @brief FrameProducts::invalidate
+ *
+ * Forgets the products, the image has been modified or replaced
+ */
+void FrameProducts::invalidate() {
+    this->source = cv::Mat();
+    this->valid = 0;
+}
+
+/**
+ * @brief FrameProducts::gray
+ * @return the gray levels of the image (CV_8UC1), the image itself if it is black and white
+ */
+const cv::Mat& FrameProducts::gray() {
+    assert(!this->source.empty());
+    if (this->source.channels() == 1)
+        return this->source;
+    if (!(this->valid & GRAY)) {
+        cv::cvtColor(this->source, this->gray_image, cv::COLOR_BGR2GRAY);
+        this->valid |= GRAY;
+        this->computations++;
+    }
+    return this->gray_image;
+}
+
+/**
+ * @brief FrameProducts::proxy
+ * @param width: integer the width of the reduced copy
+ * @return the image reduced to width columns with the same aspect ratio, the image itself if it is
+ *         not wider than width
+ */
+const cv::Mat& FrameProducts::proxy(int width) {
+    assert(width>0 && !this->source.empty());
+    if (width >= this->source.cols)
+        return this->source;
+    if (!(this->valid & PROXY) || this->proxy_image.cols != width) {
+        cv::Size size(width, std::max(1, cvRound(this->source.rows * (double) width / this->source.cols)));
+        cv::resize(this->source, this->proxy_image, size, 0, 0, cv::INTER_AREA);
+        this->valid |= PROXY;
+        this->computations++;
+    }
+    return this->proxy_image;
+}
+
+/**
+ * @brief FrameProducts::proxy_gray
+ * @param width: integer the width of the reduced copy
+ * @return the gray levels of proxy(width) (CV_8UC1)
+ */
+const cv::Mat& FrameProducts::proxy_gray(int width) {
+    assert(width>0 && !this->source.empty());
+    if (width >= this->source.cols)
+        return gray();
+    if (this->source.channels() == 1)
+        return proxy(width);
+    if (!(this->valid & PROXY_GRAY) || this->proxy_gray_image.cols != width) {
+        if (this->valid & GRAY) {
+            // Reducing the gray levels already there is cheaper than reducing the 3 channels
+            cv::Size size(width, std::max(1, cvRound(this->source.rows * (double) width / this->source.cols)));
+            cv::resize(this->gray_image, this->proxy_gray_image, size, 0, 0, cv::INTER_AREA);
+        }
+        else {
+            cv::cvtColor(proxy(width), this->proxy_gray_image, cv::COLOR_BGR2GRAY);
+        }
+        this->valid |= PROXY_GRAY;
+        this->computations++;
+    }
+    return this->proxy_gray_image;
+}
+
+/**
+ * @brief FrameProducts::histogram
+ * @param channel: integer the channel of the image (0 for blue, 1 for green, 2 for red)
+ * @return the histogram of the channel, 256 bins (CV_32FC1)
+ */
+const cv::Mat& FrameProducts::histogram(int channel) {
+    assert(!this->source.empty() && channel>=0 && channel<this->source.channels() && channel<4);
+    unsigned int bit = HISTOGRAMS << channel;
+    if (!(this->valid & bit)) {
+        // calcHist reads the channel directly, without splitting the image
+        compute_histogram(this->source, channel, this->hists[channel]);
+        this->valid |= bit;
+    }
+    return this->hists[channel];
+}
+
+/**
+ * @brief FrameProducts::gray_histogram
+ * @return the histogram of the gray levels, 256 bins (CV_32FC1)
+ */
+const cv::Mat& FrameProducts::gray_histogram() {
+    assert(!this->source.empty());
+    if (this->source.channels() == 1)
+        return histogram(0);
+    if (!(this->valid & GRAY_HISTOGRAM)) {
+        compute_histogram(gray(), 0, this->gray_hist);
+        this->valid |= GRAY_HISTOGRAM;
+    }
+    return this->gray_hist;
+}
+
+/**
+ * @brief FrameProducts::otsu_threshold
+ * @return the threshold of Otsu of the gray levels, the same value as cv::threshold with THRESH_OTSU
+ */
+double FrameProducts::otsu_threshold() {
+    int h[256];
+    get_counts(h);
+    double total = 0., mu = 0.;
+    for (int i=0; i<256; i++) {
+        total += h[i];
+        mu += i*(double)h[i];
+    }
+    if (total <= 0.)
+        return 0.;
+    double scale = 1./total;
+    mu *= scale;
+
+    // Maximizes the variance between the two classes
+    double mu1 = 0., q1 = 0., max_sigma = 0., max_val = 0.;
+    for (int i=0; i<256; i++) {
+        double p_i = h[i]*scale;
+        mu1 *= q1;
+        q1 += p_i;
+        double q2 = 1. - q1;
+        if (std::min(q1,q2) < FLT_EPSILON || std::max(q1,q2) > 1. - FLT_EPSILON)
+            continue;
+        mu1 = (mu1 + i*p_i)/q1;
+        double mu2 = (mu - q1*mu1)/q2;
+        double sigma = q1*q2*(mu1 - mu2)*(mu1 - mu2);
+        if (sigma > max_sigma) {
+            max_sigma = sigma;
+            max_val = i;
+        }
+    }
+    return max_val;
+}
+
+/**
+ * @brief FrameProducts::triangle_threshold
+ * @return the threshold of the triangle method, the same value as cv::threshold with THRESH_TRIANGLE
+ */
+double FrameProducts::triangle_threshold() {
+    const int N = 256;
+    int h[N];
+    get_counts(h);
+
+    int left_bound = 0, right_bound = 0, max_ind = 0, max = 0;
+    for (int i=0; i<N; i++)
+        if (h[i] > 0) {
+            left_bound = i;
+            break;
+        }
+    if (left_bound > 0)
+        left_bound--;
+    for (int i=N-1; i>0; i--)
+        if (h[i] > 0) {
+            right_bound = i;
+            break;
+        }
+    if (right_bound < N-1)
+        right_bound++;
+    for (int i=0; i<N; i++)
+        if (h[i] > max) {
+            max = h[i];
+            max_ind = i;
+        }
+
+    // The longest side of the histogram must be on the left
+    bool flipped = false;
+    if (max_ind-left_bound < right_bound-max_ind) {
+        flipped = true;
+        std::reverse(h, h+N);
+        left_bound = N-1-right_bound;
+        max_ind = N-1-max_ind;
+    }
+
+    // Farthest point from the line between the peak and the bound
+    double thresh = left_bound, dist = 0.;
+    double a = max, b = left_bound-max_ind;
+    for (int i=left_bound+1; i<=max_ind; i++) {
+        double tempdist = a*i + b*h[i];
+        if (tempdist > dist) {
+            dist = tempdist;
+            thresh = i;
+        }
+    }
+    thresh--;
+    if (flipped)
+        thresh = N-1-thresh;
+    return thresh;
+}
+
+/**
+ * @brief FrameProducts::get_computations
+ * @return the number of products computed since the creation
+ */
+unsigned long long FrameProducts::get_computations() {
+    return this->computations;
+}
+
+/**
+ * @brief FrameProducts::compute_histogram
+ * @param image: cv::Mat 8 bits image
+ * @param channel: integer the channel of image
+ * @param hist: cv::Mat receives the 256 bins
+ */
+void FrameProducts::compute_histogram(const cv::Mat &image, int channel, cv::Mat &hist) {
+    int size = 256;
+    float range[] = { 0, 256 };
+    const float* ranges = { range };
+    cv::calcHist(&image, 1, &channel, cv::Mat(), hist, 1, &size, &ranges, true, false);
+    this->computations++;
+}
+
+/**
+ * @brief FrameProducts::get_counts
+ * @param counts: the 256 bins of the histogram of the gray levels, as integers
+ */
+void FrameProducts::get_counts(int counts[256]) {
+    const cv::Mat &hist = gray_histogram();
+    for (int i=0; i<256; i++)
+        counts[i] = cvRound(hist.at<float>(i));
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef FRAMEPRODUCTS_H
+#define FRAMEPRODUCTS_H
+
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+
+#include <vector>
+
+/**
+ * @brief The FrameProducts class
+ *
+ * Images derived from the current image of MyImage (gray levels, reduced copies for the analyzers,
+ * histograms), computed on the first request and shared by all the operators that need them
+ * until the image is modified. The products are kept in buffers reused from one frame to the next.
+ * The returned images must not be modified, nor kept after the next call to set_image() or invalidate().
+ */
+class FrameProducts
+{
+public:
+    FrameProducts();
+
+    void set_image(const cv::Mat &image);
+    void invalidate();
+
+    const cv::Mat& gray();
+    const cv::Mat& proxy(int width);
+    const cv::Mat& proxy_gray(int width);
+    const cv::Mat& histogram(int channel);
+    const cv::Mat& gray_histogram();
+    double otsu_threshold();
+    double triangle_threshold();
+
+    unsigned long long get_computations();
+
+private:
+    enum Product { GRAY = 1, GRAY_HISTOGRAM = 2, HISTOGRAMS = 4,  // HISTOGRAMS << channel
+                   PROXY = 128, PROXY_GRAY = 256 };
+    // Header on the data of the image, without reference counting so that the buffer can be reused
+    cv::Mat source;
+    unsigned int valid;
+    cv::Mat gray_image, gray_hist, proxy_image, proxy_gray_image;
+    std::vector<cv::Mat> hists;
+    unsigned long long computations;
+
+    void compute_histogram(const cv::Mat &image, int channel, cv::Mat &hist);
+    void get_counts(int counts[256]);
+};
+
+#endif // FRAMEPRODUCTS_H
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *  Fan-out of the frames of the processing thread to the sinks (displays, recorders, snapshots,
+ *  stream) subscribed to a tap point: the camera input, the result of a stage, the processed image
+ *  or a side output. Only the taps with active subscribers are computed.
+ *  No Qt thing here.
+*/
+
+#include "framesinks.h"
+
+#include <algorithm>
+#include <iostream>
+
+/**
+ * @brief FrameSink::~FrameSink
+ */
+FrameSink::~FrameSink()
+{
+}
+
+/**
+ * @brief DisplaySink::DisplaySink
+ *
+ * Constructor of the class DisplaySink. The sink is inactive until set_active() is called.
+ */
+DisplaySink::DisplaySink() : active(false)
+{
+}
+
+/**
+ * @brief DisplaySink::set_notification
+ * @param notification: function called by consume() when the GUI must fetch the new frame
+ */
+void DisplaySink::set_notification(const std::function<void()> &notification) {
+    this->notification = notification;
+}
+
+/**
+ * @brief DisplaySink::set_conversion
+ * @param conversion: function that gives the frame in the format of the display, empty if the frames
+ *                    are displayed as they are
+ */
+void DisplaySink::set_conversion(const std::function<VideoFrame(const VideoFrame&)> &conversion) {
+    this->conversion = conversion;
+}
+
+/**
+ * @brief DisplaySink::set_active
+ * @param state: boolean true if the window of the display is shown
+ */
+void DisplaySink::set_active(bool state) {
+    this->active = state;
+}
+
+/**
+ * @brief DisplaySink::isActive
+ * @return true if the window of the display is shown
+ */
+bool DisplaySink::isActive() {
+    return this->active;
+}
+
+/**
+ * @brief DisplaySink::consume
+ * @param frame: VideoFrame the frame to display, converted to the format of the display if needed
+ */
+void DisplaySink::consume(const VideoFrame &frame) {
+    show(this->conversion ? this->conversion(frame) : frame);
+}
+
+/**
+ * @brief DisplaySink::show
+ * @param frame: VideoFrame already in the format of the display, put into the write slot of the buffer
+ *               (a reference, not a copy)
+ */
+void DisplaySink::show(const VideoFrame &frame) {
+    this->buffer.get_write_buffer() = frame;
+    if (this->buffer.publish() && this->notification)
+        this->notification();
+}
+
+/**
+ * @brief DisplaySink::get_buffer
+ * @return the handoff read by the GUI
+ */
+TripleBuffer& DisplaySink::get_buffer() {
+    return this->buffer;
+}
+
+/**
+ * @brief RecorderSink::RecorderSink
+ * @param recorder: VideoRecorder that encodes the frames
+ */
+RecorderSink::RecorderSink(VideoRecorder &recorder) : recorder(recorder)
+{
+}
+
+/**
+ * @brief RecorderSink::isActive
+ * @return true if a video is being recorded or streamed
+ */
+bool RecorderSink::isActive() {
+    return this->recorder.isRunning();
+}
+
+/**
+ * @brief RecorderSink::consume
+ * @param frame: VideoFrame the frame queued for the encoder, resized to the video if needed
+ */
+void RecorderSink::consume(const VideoFrame &frame) {
+    this->recorder.push(frame);
+}
+
+/**
+ * @brief SnapshotSink::SnapshotSink
+ * @param snapshots: SnapshotWriter that keeps then saves the frames
+ */
+SnapshotSink::SnapshotSink(SnapshotWriter &snapshots) : snapshots(snapshots)
+{
+}
+
+/**
+ * @brief SnapshotSink::isActive
+ * @return true if a snapshot or a burst waits for frames
+ */
+bool SnapshotSink::isActive() {
+    return this->snapshots.isCapturing();
+}
+
+/**
+ * @brief SnapshotSink::consume
+ * @param frame: VideoFrame the frame offered to the snapshot
+ */
+void SnapshotSink::consume(const VideoFrame &frame) {
+    this->snapshots.offer(frame);
+}
+
+/**
+ * @brief SinkRegistry::SinkRegistry
+ *
+ * Constructor of the class SinkRegistry. No sink is subscribed.
+ */
+SinkRegistry::SinkRegistry()
+{
+}
+
+/**
+ * @brief SinkRegistry::subscribe
+ * @param sink: FrameSink the consumer of the frames
+ * @param point: integer FrameSink::TapPoint where the frames are taken
+ * @param stage: integer the stage of MyImage for FrameSink::TAP_STAGE, ignored otherwise
+ *
+ * A sink is subscribed to a single tap point: a sink already subscribed is moved to the new one
+ */
+void SinkRegistry::subscribe(FrameSink *sink, int point, int stage) {
+    if (sink == nullptr || point < 0 || point >= FrameSink::NB_TAP_POINTS ||
+        (point == FrameSink::TAP_STAGE && (stage < 0 || stage >= 32))) {
+        std::cerr << "SinkRegistry::subscribe(): Invalid tap point " << point << " (stage " << stage << ")" << std::endl;
+        return;
+    }
+    Subscription subscription = { sink, point, point == FrameSink::TAP_STAGE ? stage : -1 };
+
+    std::lock_guard<std::mutex> guard(this->lock);
+    for (size_t i=0; i<this->subscriptions.size(); i++) {
+        if (this->subscriptions[i].sink == sink) {
+            this->subscriptions[i] = subscription;
+            return;
+        }
+    }
+    this->subscriptions.push_back(subscription);
+}
+
+/**
+ * @brief SinkRegistry::unsubscribe
+ * @param sink: FrameSink that will not receive any frame anymore
+ */
+void SinkRegistry::unsubscribe(FrameSink *sink) {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->subscriptions.erase(std::remove_if(this->subscriptions.begin(), this->subscriptions.end(),
+                                             [sink](const Subscription &subscription) { return subscription.sink == sink; }),
+                              this->subscriptions.end());
+}
+
+/**
+ * @brief SinkRegistry::get_subscription
+ * @param sink: FrameSink a consumer of the frames
+ * @param point: integer receives the FrameSink::TapPoint of the sink
+ * @param stage: integer receives the stage of FrameSink::TAP_STAGE, -1 otherwise
+ * @return false if the sink is not subscribed
+ */
+bool SinkRegistry::get_subscription(FrameSink *sink, int &point, int &stage) {
+    std::lock_guard<std::mutex> guard(this->lock);
+    for (size_t i=0; i<this->subscriptions.size(); i++) {
+        if (this->subscriptions[i].sink == sink) {
+            point = this->subscriptions[i].point;
+            stage = this->subscriptions[i].stage;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief SinkRegistry::isWanted
+ * @param point: integer FrameSink::TapPoint
+ * @param stage: integer the stage of FrameSink::TAP_STAGE, -1 for any stage
+ * @return true if an active sink is subscribed to the tap point: it has to be computed for this frame
+ */
+bool SinkRegistry::isWanted(int point, int stage) {
+    std::lock_guard<std::mutex> guard(this->lock);
+    for (size_t i=0; i<this->subscriptions.size(); i++) {
+        const Subscription &subscription = this->subscriptions[i];
+        if (subscription.point == point && (stage < 0 || subscription.stage == stage) &&
+            subscription.sink->isActive())
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief SinkRegistry::get_stage_taps
+ * @return the stages of MyImage wanted by an active sink (bits 1<<stage), for MyImage::set_stage_taps()
+ */
+unsigned int SinkRegistry::get_stage_taps() {
+    unsigned int stages = 0;
+    std::lock_guard<std::mutex> guard(this->lock);
+    for (size_t i=0; i<this->subscriptions.size(); i++) {
+        const Subscription &subscription = this->subscriptions[i];
+        if (subscription.point == FrameSink::TAP_STAGE && subscription.sink->isActive())
+            stages |= 1u << subscription.stage;
+    }
+    return stages;
+}
+
+/**
+ * @brief SinkRegistry::publish
+ * @param point: integer FrameSink::TapPoint where frame has been taken
+ * @param stage: integer the stage of FrameSink::TAP_STAGE, ignored otherwise
+ * @param frame: VideoFrame shared by all the sinks, never copied
+ * @return the number of sinks that received the frame
+ *
+ * Called by the processing thread only. The sinks are called without the lock, a recorder waiting for
+ * its encoder does not block the subscriptions made by the GUI.
+ */
+int SinkRegistry::publish(int point, int stage, const VideoFrame &frame) {
+    if (frame.empty())
+        return 0;
+    this->receivers.clear();
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        for (size_t i=0; i<this->subscriptions.size(); i++) {
+            const Subscription &subscription = this->subscriptions[i];
+            if (subscription.point == point && (point != FrameSink::TAP_STAGE || subscription.stage == stage) &&
+                subscription.sink->isActive())
+                this->receivers.push_back(subscription.sink);
+        }
+    }
+    for (size_t i=0; i<this->receivers.size(); i++)
+        this->receivers[i]->consume(frame);
+    return (int) this->receivers.size();
+}
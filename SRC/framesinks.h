@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef FRAMESINKS_H
+#define FRAMESINKS_H
+
+#include "videoframe.h"
+#include "triplebuffer.h"
+#include "videorecorder.h"
+#include "snapshotwriter.h"
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief The FrameSink class
+ *
+ * A consumer of the frames of the processing thread (display, recorder, snapshots, stream). It receives
+ * the frames of the tap point it is subscribed to in a SinkRegistry, and must not block the processing.
+ */
+class FrameSink
+{
+public:
+    // Where the frames are taken in the processing
+    enum TapPoint {
+        TAP_INPUT = 0,      // frame of the camera, before any processing
+        TAP_STAGE,          // image right after a stage of MyImage (see MyImage::set_stage_taps())
+        TAP_OUTPUT,         // processed image
+        TAP_MOTION,         // side outputs
+        TAP_OBJECTS,
+        TAP_HISTOGRAM,
+        NB_TAP_POINTS
+    };
+
+    virtual ~FrameSink();
+
+    virtual bool isActive() = 0;
+    virtual void consume(const VideoFrame &frame) = 0;
+};
+
+/**
+ * @brief The DisplaySink class
+ *
+ * Handoff of the frames to a window of the GUI through a TripleBuffer. The notification is only called
+ * when the GUI has fetched the previous frame (see TripleBuffer::publish()). A conversion to the
+ * format of the display, if any, is made by consume() on the thread of the producer.
+ */
+class DisplaySink : public FrameSink
+{
+public:
+    DisplaySink();
+
+    void set_notification(const std::function<void()> &notification);
+    void set_conversion(const std::function<VideoFrame(const VideoFrame&)> &conversion);
+    void set_active(bool state);
+    bool isActive() override;
+    void consume(const VideoFrame &frame) override;
+    void show(const VideoFrame &frame);
+    TripleBuffer& get_buffer();
+
+private:
+    TripleBuffer buffer;
+    std::atomic<bool> active;
+    std::function<void()> notification;
+    std::function<VideoFrame(const VideoFrame&)> conversion;
+};
+
+/**
+ * @brief The RecorderSink class
+ *
+ * Frames encoded by a VideoRecorder (video file or stream), active while the recorder runs
+ */
+class RecorderSink : public FrameSink
+{
+public:
+    explicit RecorderSink(VideoRecorder &recorder);
+
+    bool isActive() override;
+    void consume(const VideoFrame &frame) override;
+
+private:
+    VideoRecorder &recorder;
+};
+
+/**
+ * @brief The SnapshotSink class
+ *
+ * Frames of the snapshots and bursts of a SnapshotWriter, active while frames are being captured
+ */
+class SnapshotSink : public FrameSink
+{
+public:
+    explicit SnapshotSink(SnapshotWriter &snapshots);
+
+    bool isActive() override;
+    void consume(const VideoFrame &frame) override;
+
+private:
+    SnapshotWriter &snapshots;
+};
+
+/**
+ * @brief The SinkRegistry class
+ *
+ * Subscriptions of the sinks to the tap points, changed from any thread. The processing thread asks
+ * which taps are wanted before computing them: a tap without an active subscriber costs nothing.
+ * The sinks are not owned by the registry and must outlive it.
+ */
+class SinkRegistry
+{
+public:
+    SinkRegistry();
+
+    void subscribe(FrameSink *sink, int point, int stage=-1);
+    void unsubscribe(FrameSink *sink);
+    bool get_subscription(FrameSink *sink, int &point, int &stage);
+
+    bool isWanted(int point, int stage=-1);
+    unsigned int get_stage_taps();
+    int publish(int point, int stage, const VideoFrame &frame);
+
+private:
+    struct Subscription {
+        FrameSink *sink;
+        int point;
+        int stage;          // stage of TAP_STAGE, -1 otherwise
+    };
+
+    std::mutex lock;
+    std::vector<Subscription> subscriptions;
+    std::vector<FrameSink*> receivers;      // sinks of the frame being published, processing thread only
+};
+
+#endif // FRAMESINKS_H
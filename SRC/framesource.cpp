@@ -0,0 +1,415 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *  The sources of frames for the image processing. Besides the camera, frames can be read from
+ *  a video file, from a directory of images or generated synthetically, which allows to run and
+ *  profile the whole pipeline on machines without camera. No Qt thing here.
+*/
+
+#include "framesource.h"
+#include "rawframes.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sys/stat.h>
+
+/**
+ * @brief FrameSource::~FrameSource
+ */
+FrameSource::~FrameSource() {
+}
+
+/**
+ * @brief FrameSource::get_fps
+ * @return the nominal rate of the source in frames per second, 0 if unknown
+ */
+double FrameSource::get_fps() {
+    return 0.;
+}
+
+//+++++++++++++++++++++++++++++++++++++++++++++ CAMERA
+
+/**
+ * @brief CameraSource::CameraSource
+ * @param camID: integer the ID number of the camera to open
+ */
+CameraSource::CameraSource(int camID) : camID(camID)
+{
+}
+
+CameraSource::~CameraSource() {
+    release();
+}
+
+bool CameraSource::open() {
+    if (this->camID<0) {
+        std::cerr << "CameraSource::open(): Invalid camera ID "<<this->camID<<std::endl;
+        return false;
+    }
+    return this->capture.open(this->camID);
+}
+
+void CameraSource::release() {
+    if (this->capture.isOpened())
+        this->capture.release();
+}
+
+bool CameraSource::isOpened() {
+    return this->capture.isOpened();
+}
+
+bool CameraSource::read(cv::Mat &frame) {
+    return this->capture.read(frame);
+}
+
+cv::Size CameraSource::get_size() {
+    return cv::Size(this->capture.get(cv::CAP_PROP_FRAME_WIDTH),
+                    this->capture.get(cv::CAP_PROP_FRAME_HEIGHT));
+}
+
+double CameraSource::get_fps() {
+    return this->capture.get(cv::CAP_PROP_FPS);
+}
+
+std::string CameraSource::get_name() {
+    return "Camera "+std::to_string(this->camID);
+}
+
+//+++++++++++++++++++++++++++++++++++++++++++++ VIDEO FILE
+
+/**
+ * @brief VideoFileSource::VideoFileSource
+ * @param filename: string the video file to read
+ * @param decode_ahead: integer the number of frames decoded in advance by the background thread
+ * @param loop: boolean if true, restart from the beginning at the end of the file
+ */
+VideoFileSource::VideoFileSource(const std::string &filename, int decode_ahead, bool loop) : filename(filename),
+                                                                                             loop(loop),
+                                                                                             fps(0.),
+                                                                                             decoded(decode_ahead, FrameRingBuffer::BLOCK),
+                                                                                             decoding(false),
+                                                                                             finished(false)
+{
+}
+
+VideoFileSource::~VideoFileSource() {
+    release();
+}
+
+bool VideoFileSource::open() {
+    release();
+    if (!this->capture.open(this->filename)) {
+        std::cerr << "VideoFileSource::open(): Cannot open the video file "<<this->filename<<std::endl;
+        return false;
+    }
+    this->size = cv::Size(this->capture.get(cv::CAP_PROP_FRAME_WIDTH),
+                          this->capture.get(cv::CAP_PROP_FRAME_HEIGHT));
+    this->fps  = this->capture.get(cv::CAP_PROP_FPS);
+
+    // Launch the decode-ahead thread
+    this->decoded.allocate(this->size, CV_8UC3);
+    this->decoded.reopen();
+    this->finished = false;
+    this->decoding = true;
+    this->decoder  = std::thread(&VideoFileSource::decode, this);
+    return true;
+}
+
+void VideoFileSource::release() {
+    this->decoding = false;
+    this->decoded.close(); // release the decoder if it waits for a free slot
+    if (this->decoder.joinable())
+        this->decoder.join();
+    if (this->capture.isOpened())
+        this->capture.release();
+}
+
+bool VideoFileSource::isOpened() {
+    return this->capture.isOpened();
+}
+
+/**
+ * @brief VideoFileSource::read
+ * @param frame: cv::Mat that receives the next decoded frame
+ * @return false at the end of the file
+ */
+bool VideoFileSource::read(cv::Mat &frame) {
+    while (!this->decoded.pop(frame, 100)) {
+        if (this->finished && this->decoded.get_size() == 0)
+            return false;
+    }
+    return true;
+}
+
+cv::Size VideoFileSource::get_size() {
+    return this->size;
+}
+
+double VideoFileSource::get_fps() {
+    return this->fps;
+}
+
+std::string VideoFileSource::get_name() {
+    return this->filename;
+}
+
+/**
+ * @brief VideoFileSource::decode
+ *
+ * The loop of the decode-ahead thread
+ */
+void VideoFileSource::decode() {
+    cv::Mat frame;
+    while (this->decoding) {
+        if (frame.u != nullptr && frame.u->refcount > 1)
+            frame.release();
+
+        if (!this->capture.read(frame) || frame.empty()) {
+            if (this->loop && this->capture.set(cv::CAP_PROP_POS_FRAMES, 0))
+                continue;
+            break;
+        }
+        this->decoded.push(frame);
+    }
+    this->finished = true;
+}
+
+//+++++++++++++++++++++++++++++++++++++++++++++ DIRECTORY OF IMAGES
+
+/**
+ * @brief ImageSequenceSource::ImageSequenceSource
+ * @param directory: string the directory that contains the images
+ * @param fps: double the rate at which the images are delivered (0 = as fast as possible)
+ * @param loop: boolean if true, restart from the first image after the last one
+ */
+ImageSequenceSource::ImageSequenceSource(const std::string &directory, double fps, bool loop) : directory(directory),
+                                                                                                current(0),
+                                                                                                delivered(0),
+                                                                                                fps(fps),
+                                                                                                loop(loop),
+                                                                                                opened(false)
+{
+}
+
+bool ImageSequenceSource::open() {
+    std::vector<cv::String> all_files;
+    this->filenames.clear();
+    cv::glob(this->directory, all_files, false);
+
+    // Keep only the files that OpenCV can read
+    for (size_t i=0; i<all_files.size(); i++) {
+        if (cv::haveImageReader(all_files[i]))
+            this->filenames.push_back(all_files[i]);
+    }
+    std::sort(this->filenames.begin(), this->filenames.end());
+
+    if (this->filenames.empty()) {
+        std::cerr << "ImageSequenceSource::open(): No image found in "<<this->directory<<std::endl;
+        return false;
+    }
+
+    cv::Mat first = cv::imread(this->filenames[0], cv::IMREAD_COLOR);
+    this->size      = first.size();
+    this->current   = 0;
+    this->delivered = 0;
+    this->start     = std::chrono::steady_clock::now();
+    this->opened    = true;
+    return true;
+}
+
+void ImageSequenceSource::release() {
+    this->opened = false;
+}
+
+bool ImageSequenceSource::isOpened() {
+    return this->opened;
+}
+
+bool ImageSequenceSource::read(cv::Mat &frame) {
+    if (!this->opened)
+        return false;
+    if (this->current >= this->filenames.size()) {
+        if (!this->loop)
+            return false;
+        this->current = 0;
+    }
+
+    // Deliver the images at the requested rate
+    if (this->fps > 0.)
+        std::this_thread::sleep_until(this->start + std::chrono::microseconds((long long) (1e6 * this->delivered / this->fps)));
+    this->delivered++;
+
+    frame = cv::imread(this->filenames[this->current++], cv::IMREAD_COLOR);
+    if (!frame.empty() && frame.size() != this->size)
+        cv::resize(frame, frame, this->size);
+    return !frame.empty();
+}
+
+cv::Size ImageSequenceSource::get_size() {
+    return this->size;
+}
+
+double ImageSequenceSource::get_fps() {
+    return this->fps;
+}
+
+std::string ImageSequenceSource::get_name() {
+    return this->directory;
+}
+
+//+++++++++++++++++++++++++++++++++++++++++++++ SYNTHETIC FRAMES
+
+/**
+ * @brief SyntheticSource::SyntheticSource
+ * @param width: integer the width of the generated frames
+ * @param height: integer the height of the generated frames
+ * @param fps: double the rate at which the frames are delivered (0 = as fast as possible)
+ * @param seed: integer the seed of the noise
+ */
+SyntheticSource::SyntheticSource(int width, int height, double fps, unsigned int seed) : size(width, height),
+                                                                                         fps(fps),
+                                                                                         seed(seed),
+                                                                                         index(0),
+                                                                                         opened(false)
+{
+    assert(width>0 && height>0);
+}
+
+bool SyntheticSource::open() {
+    // Static background: a colour gradient
+    this->background.create(this->size, CV_8UC3);
+    for (int j=0; j<this->size.height; j++) {
+        cv::Vec3b *row = this->background.ptr<cv::Vec3b>(j);
+        for (int i=0; i<this->size.width; i++)
+            row[i] = cv::Vec3b(255*i/this->size.width, 255*j/this->size.height, 128);
+    }
+    this->noise.create(this->size, CV_16SC3);
+    this->index  = 0;
+    this->start  = std::chrono::steady_clock::now();
+    this->opened = true;
+    return true;
+}
+
+void SyntheticSource::release() {
+    this->opened = false;
+}
+
+bool SyntheticSource::isOpened() {
+    return this->opened;
+}
+
+bool SyntheticSource::read(cv::Mat &frame) {
+    if (!this->opened)
+        return false;
+
+    // Deliver the frames at the requested rate
+    if (this->fps > 0.)
+        std::this_thread::sleep_until(this->start + std::chrono::microseconds((long long) (1e6 * this->index / this->fps)));
+
+    render(frame, this->index);
+    this->index++;
+    return true;
+}
+
+/**
+ * @brief SyntheticSource::render
+ * @param frame: cv::Mat that receives the generated frame
+ * @param index: integer the number of the frame to generate
+ *
+ * Draws the frame number index. The result only depends on index and on the seed.
+ */
+void SyntheticSource::render(cv::Mat &frame, long long index) {
+    const int w = this->size.width, h = this->size.height;
+    const int r = std::max(4, std::min(w, h) / 10);
+    this->background.copyTo(frame);
+
+    // A disc bouncing horizontally
+    int period_x = 2 * (w - 2*r);
+    int x = (int) ((index * 7) % std::max(1, period_x));
+    if (x > w - 2*r) x = period_x - x;
+    cv::circle(frame, cv::Point(r + x, h/3), r, cv::Scalar(0, 0, 255), -1, cv::LINE_8);
+
+    // A rectangle going down
+    int y = (int) ((index * 5) % std::max(1, h - r));
+    cv::rectangle(frame, cv::Rect(w/2, y, 2*r, r), cv::Scalar(255, 255, 255), -1, cv::LINE_8);
+
+    // A rotating line
+    double angle = index * CV_PI / 90.;
+    cv::Point center(w/4, 2*h/3);
+    cv::line(frame, center, center + cv::Point((int) (r*2*cos(angle)), (int) (r*2*sin(angle))),
+             cv::Scalar(0, 255, 0), 3, cv::LINE_8);
+
+    // Gaussian noise, reproducible from one run to another
+    cv::RNG rng((unsigned long long) this->seed * 1000003ULL + (unsigned long long) index);
+    rng.fill(this->noise, cv::RNG::NORMAL, 0., 8.);
+    cv::add(frame, this->noise, frame, cv::noArray(), CV_8UC3);
+
+    cv::putText(frame, "Frame "+std::to_string(index), cv::Point(10, h - 20),
+                cv::FONT_HERSHEY_SIMPLEX, 1.0, cv::Scalar(0, 0, 0), 2, cv::LINE_8);
+}
+
+cv::Size SyntheticSource::get_size() {
+    return this->size;
+}
+
+double SyntheticSource::get_fps() {
+    return this->fps;
+}
+
+std::string SyntheticSource::get_name() {
+    return "Synthetic "+std::to_string(this->size.width)+"x"+std::to_string(this->size.height);
+}
+
+//+++++++++++++++++++++++++++++++++++++++++++++ FACTORY
+
+/**
+ * @brief create_frame_source
+ * @param description: string that describes the source
+ *          camera:<ID>                           a camera
+ *          video:<file>                          a video file
+ *          images:<directory>                    a directory of images
+ *          raw:<file>                            a raw file (see RawFrameWriter), replayed as fast as possible
+ *          synthetic[:<W>x<H>[@<fps>[:<seed>]]]  synthetic frames
+ *          <file or directory>                   a video file, a raw file (.raw) or a directory of images
+ * @return a new FrameSource (not opened yet), or nullptr if the description is invalid
+ */
+FrameSource* create_frame_source(const std::string &description) {
+    size_t colon = description.find(':');
+    std::string kind = description.substr(0, colon);
+    std::string arg  = colon == std::string::npos ? "" : description.substr(colon+1);
+
+    if (kind == "camera")
+        return new CameraSource(arg.empty() ? 0 : std::atoi(arg.c_str()));
+    if (kind == "video")
+        return new VideoFileSource(arg);
+    if (kind == "images")
+        return new ImageSequenceSource(arg);
+    if (kind == "raw")
+        return new RawFileSource(arg);
+    if (kind == "synthetic") {
+        int width = 640, height = 480;
+        double fps = 0.;
+        unsigned int seed = 0;
+        if (!arg.empty() && std::sscanf(arg.c_str(), "%dx%d@%lf:%u", &width, &height, &fps, &seed) < 2) {
+            std::cerr << "create_frame_source(): Invalid synthetic source "<<arg<<std::endl;
+            return nullptr;
+        }
+        return new SyntheticSource(width, height, fps, seed);
+    }
+
+    // No prefix: a directory of images or a video file
+    struct stat info;
+    if (stat(description.c_str(), &info) != 0) {
+        std::cerr << "create_frame_source(): Cannot find "<<description<<std::endl;
+        return nullptr;
+    }
+    if ((info.st_mode & S_IFMT) == S_IFDIR)
+        return new ImageSequenceSource(description);
+    if (description.size() > 4 && description.compare(description.size()-4, 4, ".raw") == 0)
+        return new RawFileSource(description);
+    return new VideoFileSource(description);
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef FRAMESOURCE_H
+#define FRAMESOURCE_H
+
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+#include "opencv2/imgcodecs.hpp"
+#include "opencv2/videoio.hpp"
+
+#include "framebuffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief The FrameSource class
+ *
+ * Interface of everything that can deliver frames to the image processing: cameras, video files,
+ * directories of images, synthetic generators...
+ */
+class FrameSource
+{
+public:
+    virtual ~FrameSource();
+
+    virtual bool open() = 0;
+    virtual void release() = 0;
+    virtual bool isOpened() = 0;
+    virtual bool read(cv::Mat &frame) = 0;
+    virtual cv::Size get_size() = 0;
+    virtual double get_fps();
+    virtual std::string get_name() = 0;
+};
+
+/**
+ * @brief The CameraSource class
+ *
+ * Frames from a camera identified by its index
+ */
+class CameraSource : public FrameSource
+{
+public:
+    explicit CameraSource(int camID);
+    ~CameraSource();
+
+    bool open() override;
+    void release() override;
+    bool isOpened() override;
+    bool read(cv::Mat &frame) override;
+    cv::Size get_size() override;
+    double get_fps() override;
+    std::string get_name() override;
+
+private:
+    int camID;
+    cv::VideoCapture capture;
+};
+
+/**
+ * @brief The VideoFileSource class
+ *
+ * Frames from a video file. A background thread decodes a few frames ahead of the reader.
+ */
+class VideoFileSource : public FrameSource
+{
+public:
+    explicit VideoFileSource(const std::string &filename, int decode_ahead=8, bool loop=false);
+    ~VideoFileSource();
+
+    bool open() override;
+    void release() override;
+    bool isOpened() override;
+    bool read(cv::Mat &frame) override;
+    cv::Size get_size() override;
+    double get_fps() override;
+    std::string get_name() override;
+
+private:
+    std::string filename;
+    bool loop;
+    cv::VideoCapture capture;
+    cv::Size size;
+    double fps;
+    FrameRingBuffer decoded;
+    std::thread decoder;
+    std::atomic<bool> decoding, finished;
+
+    void decode();
+};
+
+/**
+ * @brief The ImageSequenceSource class
+ *
+ * Frames from the images of a directory, sorted by filename
+ */
+class ImageSequenceSource : public FrameSource
+{
+public:
+    explicit ImageSequenceSource(const std::string &directory, double fps=0., bool loop=false);
+
+    bool open() override;
+    void release() override;
+    bool isOpened() override;
+    bool read(cv::Mat &frame) override;
+    cv::Size get_size() override;
+    double get_fps() override;
+    std::string get_name() override;
+
+private:
+    std::string directory;
+    std::vector<cv::String> filenames;
+    size_t current;
+    long long delivered;
+    double fps;
+    bool loop, opened;
+    cv::Size size;
+    std::chrono::steady_clock::time_point start;
+};
+
+/**
+ * @brief The SyntheticSource class
+ *
+ * Deterministic generator of frames (moving shapes, noise and text). The content of the frame N
+ * only depends on N and on the seed, so that runs are reproducible.
+ */
+class SyntheticSource : public FrameSource
+{
+public:
+    SyntheticSource(int width=640, int height=480, double fps=30., unsigned int seed=0);
+
+    bool open() override;
+    void release() override;
+    bool isOpened() override;
+    bool read(cv::Mat &frame) override;
+    cv::Size get_size() override;
+    double get_fps() override;
+    std::string get_name() override;
+
+    void render(cv::Mat &frame, long long index);
+
+private:
+    cv::Size size;
+    double fps;
+    unsigned int seed;
+    long long index;
+    bool opened;
+    cv::Mat background, noise;
+    std::chrono::steady_clock::time_point start;
+};
+
+FrameSource* create_frame_source(const std::string &description);
+
+#endif // FRAMESOURCE_H
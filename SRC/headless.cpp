@@ -0,0 +1,469 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *   Batch processing without any window: the frames of a video file, of a directory of images
+ *   (or of any other FrameSource) go through the class MyImage as fast as possible.
+ *   The processing is described on the command line or in a configuration file (see PipelineSpec).
+ *   The results are written to a video file or to a directory of images (by a pool of threads,
+ *   see SnapshotWriter), and the time spent
+ *   in every step is reported at the end.
+ *   A session recorded by the GUI (see SessionRecorder) is replayed with the same parameter changes
+ *   at the same frames, and every processed frame is compared with the one of the GUI.
+ *   No Qt thing here.
+*/
+
+#include "myimage.h"
+#include "framesource.h"
+#include "pipelinespec.h"
+#include "videorecorder.h"
+#include "snapshotwriter.h"
+#include "processingcommands.h"
+#include "sessionlog.h"
+
+#include "opencv2/imgcodecs.hpp"
+#include "opencv2/videoio.hpp"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief The StepTimes struct
+ *
+ * Durations in milliseconds of one step of the processing, one value per frame
+ */
+struct StepTimes {
+    std::string name;
+    std::vector<double> values;
+};
+
+/**
+ * @brief usage
+ * @param program: string the name of the executable
+ *
+ * Print the options of the program
+ */
+static void usage(const char *program) {
+    std::cout << "Usage: " << program << " --input <source> [options]\n\n"
+              << "Options:\n"
+              << "  --input <source>      camera:<id>, video:<file>, images:<dir>, raw:<file>, synthetic[:WxH[@fps[:seed]]]\n"
+              << "                        or simply the path of a video file, of a raw file or of a directory of images\n"
+              << "  --pipeline <stages>   the processing, for instance \"bw,blur:method=2:range=5,motion\"\n"
+              << "  --config <file>       the processing read from a file (one stage per line, # for comments)\n"
+              << "  --session <file>      replay a session recorded by the GUI: its frames (default input) with its\n"
+              << "                        parameter changes, the results are compared with those of the GUI\n"
+              << "                        (exit code 2 if a frame differs)\n"
+              << "  --output <path>       a video file, or an existing directory that receives one image per frame\n"
+              << "  --image-format <f>    format of the images written in the output directory: png (default),\n"
+              << "                        png-fast (low compression), jpg[:quality] or bmp (no compression)\n"
+              << "  --frames <N>          stop after N frames (mandatory for cameras and synthetic sources)\n"
+              << "  --report <file>       write the timing report to this file instead of the standard output\n"
+              << "  --ornaments <dir>     directory of the images put over the faces (default: images)\n"
+              << "  --analysis-width <N>  the detectors (faces, objects, motion, qrcode) work on a copy reduced\n"
+              << "                        to N pixels wide (default: 0, the full resolution)\n"
+#ifdef withobjdetect
+              << "  --cascade <file>      face cascade (default: haarcascade_frontalface_default.xml of OpenCV)\n"
+#ifdef withface
+              << "  --facemark <file>     facemark model (default: lbfmodel.yaml of OpenCV)\n"
+#endif
+#endif
+              << "\nStages:\n" << PipelineSpec::get_help() << std::endl;
+}
+
+/**
+ * @brief is_directory
+ * @param path: string a path on the disk
+ * @return true if path is an existing directory
+ */
+static bool is_directory(const std::string &path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 && (info.st_mode & S_IFDIR);
+}
+
+/**
+ * @brief load_ornaments
+ * @param image: MyImage the object that receives the ornaments
+ * @param directory: string the directory containing the images of the ornaments
+ * @return true if all the ornaments could be loaded
+ *
+ * Same images and same colour conventions as captureVideo::loadOrnaments(), but read from the disk
+ */
+static bool load_ornaments(MyImage &image, const std::string &directory) {
+    const char* names[] = { "glasses.jpg", "mustache.jpg", "mouse-nose.jpg", "cartoon_background.jpg" };
+    std::vector<cv::Mat> Mat2send;
+    for (int i=0; i<4; i++) {
+        cv::Mat ornament = cv::imread(directory + "/" + names[i], cv::IMREAD_COLOR);
+        if (ornament.empty()) {
+            std::cerr << "load_ornaments(): couldn't load " << directory << "/" << names[i] << std::endl;
+            return false;
+        }
+        if (i<3)
+            cv::cvtColor(ornament, ornament, cv::COLOR_BGR2RGB);
+        Mat2send.push_back(ornament);
+    }
+    image.loadOrnaments(Mat2send);
+    return true;
+}
+
+/**
+ * @brief write_statistics
+ * @param out: ostream where the report is written
+ * @param step: StepTimes the durations of one step
+ */
+static void write_statistics(std::ostream &out, StepTimes &step) {
+    if (step.values.empty())
+        return;
+    std::vector<double> sorted = step.values;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0.;
+    for (size_t i=0; i<sorted.size(); i++)
+        sum += sorted[i];
+    size_t p50 = (sorted.size()-1) / 2;
+    size_t p99 = (size_t) ((sorted.size()-1) * 0.99);
+
+    char line[256];
+    snprintf(line, sizeof(line), "%-14s %10.3f %10.3f %10.3f %10.3f %10.3f\n", step.name.c_str(),
+             sum/sorted.size(), sorted[p50], sorted[p99], sorted.back(), sum);
+    out << line;
+}
+
+/**
+ * @brief elapsed_ms
+ * @return the number of milliseconds since start
+ */
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+    std::string input, pipeline, config, session_file, output, report, ornaments = "images";
+    long long max_frames = 0;
+    int analysis_width = 0;
+    std::string image_format = "png";
+#ifdef withobjdetect
+    cv::String file_cascade = OPENCV_HAARCASCADES_DIR"haarcascade_frontalface_default.xml";
+#ifdef withface
+    cv::String file_facemark = OPENCV_FACEMARK_DIR"lbfmodel.yaml";
+#endif
+#endif
+
+    // Read the command line
+    for (int i=1; i<argc; i++) {
+        std::string option = argv[i];
+        if (option == "--help" || option == "-h") {
+            usage(argv[0]);
+            return 0;
+        }
+        if (i+1 >= argc) {
+            std::cerr << "Missing value for the option " << option << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+        if      (option == "--input")     input = value;
+        else if (option == "--pipeline")  pipeline = value;
+        else if (option == "--config")    config = value;
+        else if (option == "--session")   session_file = value;
+        else if (option == "--output")    output = value;
+        else if (option == "--report")    report = value;
+        else if (option == "--ornaments") ornaments = value;
+        else if (option == "--frames")    max_frames = std::atoll(value.c_str());
+        else if (option == "--analysis-width") analysis_width = std::atoi(value.c_str());
+        else if (option == "--image-format")   image_format = value;
+#ifdef withobjdetect
+        else if (option == "--cascade")   file_cascade = value;
+#ifdef withface
+        else if (option == "--facemark")  file_facemark = value;
+#endif
+#endif
+        else {
+            std::cerr << "Unknown option " << option << std::endl;
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // Session of the GUI: the processing is given by its parameter changes
+    SessionLog session;
+    bool replay = !session_file.empty();
+    if (replay) {
+        if (!pipeline.empty() || !config.empty()) {
+            std::cerr << "The option --session cannot be combined with --pipeline or --config" << std::endl;
+            return 1;
+        }
+        if (!session.load(session_file)) {
+            std::cerr << session.get_error() << std::endl;
+            return 1;
+        }
+        if (input.empty())
+            input = "raw:" + session.get_frames_filename();
+        // The raw file does not match the log after a frame the GUI could not record
+        if (session.get_lost_frame() >= 0) {
+            std::cerr << "The frame " << session.get_lost_frame() << " of the session was not recorded, "
+                      << "the replay stops before it" << std::endl;
+            if (session.get_lost_frame() == 0)
+                return 1;
+            if (max_frames <= 0 || max_frames > session.get_lost_frame())
+                max_frames = session.get_lost_frame();
+        }
+    }
+    if (input.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // Description of the processing
+    PipelineSpec spec;
+    bool valid = true;
+    if (!config.empty())
+        valid = spec.load(config);
+    else if (!pipeline.empty())
+        valid = spec.parse(pipeline);
+    if (!valid) {
+        std::cerr << spec.get_error() << std::endl;
+        return 1;
+    }
+
+    MyImage myFrame;
+    // Keep the durations of all the frames for the report (up to 100000 frames)
+    myFrame.get_profiler().set_window(max_frames > 0 && max_frames < 100000 ? (int) max_frames : 100000);
+    if (!replay && !spec.apply(myFrame)) {
+        std::cerr << spec.get_error() << std::endl;
+        return 1;
+    }
+    if (analysis_width < 0) {
+        std::cerr << "Invalid width for --analysis-width: " << analysis_width << std::endl;
+        return 1;
+    }
+    myFrame.set_analysis_width(analysis_width);
+#ifdef withobjdetect
+    if (spec.has_stage("face") || (replay && session.uses_command(CMD_FACE))) {
+        if (!myFrame.set_Face_Cascade_Name(file_cascade)) {
+            std::cerr << "Cannot load the face cascade " << file_cascade << std::endl;
+            return 1;
+        }
+#ifdef withface
+        if (!myFrame.set_Face_Facemark_Name(file_facemark)) {
+            std::cerr << "Cannot load the facemark model " << file_facemark << std::endl;
+            return 1;
+        }
+#endif
+        if (!load_ornaments(myFrame, ornaments))
+            return 1;
+    }
+#endif
+
+    // Open the source of the frames
+    FrameSource *source = create_frame_source(input);
+    if (source == nullptr || !source->open()) {
+        std::cerr << "Cannot open the input " << input << std::endl;
+        delete source;
+        return 1;
+    }
+    cv::Size size = source->get_size();
+    double fps = source->get_fps() > 0. ? source->get_fps() : 20.;
+
+    // Prepare the output
+    bool output_images = !output.empty() && is_directory(output);
+    int format = SnapshotWriter::FORMAT_PNG, quality = 95;
+    if (image_format == "png-fast")
+        format = SnapshotWriter::FORMAT_PNG_FAST;
+    else if (image_format == "bmp")
+        format = SnapshotWriter::FORMAT_BMP;
+    else if (image_format.compare(0, 3, "jpg") == 0) {
+        format = SnapshotWriter::FORMAT_JPEG;
+        if (image_format.size() > 4 && image_format[3] == ':')
+            quality = std::atoi(image_format.c_str() + 4);
+    }
+    else if (image_format != "png") {
+        std::cerr << "Unknown image format " << image_format << std::endl;
+        source->release();
+        delete source;
+        return 1;
+    }
+    std::string extension = SnapshotWriter::get_extension(format);
+    // The images are compressed by all the cores, the processing waits only if 32 images are queued
+    SnapshotWriter snapshots(std::max(1, (int) std::thread::hardware_concurrency()), 32);
+    // The video is encoded by its own thread, no frame is dropped
+    VideoRecorder recorder(8, FrameRingBuffer::BLOCK);
+    if (!output.empty() && !output_images) {
+        if (!recorder.start(output, cv::VideoWriter::fourcc('X','V','I','D'), fps, size)) {
+            std::cerr << "Cannot create the video " << output << std::endl;
+            source->release();
+            delete source;
+            return 1;
+        }
+    }
+
+    std::string description = replay ? "session " + session_file : spec.get_description();
+    std::cerr << "Input:    " << source->get_name() << " (" << size.width << "x" << size.height << ")\n"
+              << "Pipeline: " << description << std::endl;
+
+    // Process the frames
+    StepTimes read_times, process_times, side_times, write_times;
+    read_times.name    = "read";
+    process_times.name = "process";
+    side_times.name    = "side outputs";
+    write_times.name   = "write";
+
+    cv::Mat frame, result;
+    char filename[64];
+    long long count = 0;
+    // Replay of a session: next parameter change, side outputs of the GUI, comparison of the results
+    const std::vector<SessionLog::Entry> &entries = session.get_entries();
+    size_t next_entry = 0;
+    int side_outputs = 0;
+    long long checked = 0, different = 0, first_different = -1;
+    std::chrono::steady_clock::time_point start_all = std::chrono::steady_clock::now();
+    while (max_frames <= 0 || count < max_frames) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (!source->read(frame))
+            break;
+        read_times.values.push_back(elapsed_ms(start));
+
+        // The parameters changed by the GUI before this frame
+        for (; next_entry < entries.size() && entries[next_entry].frame <= count; next_entry++) {
+            if (entries[next_entry].key == CMD_SIDE_OUTPUTS)
+                side_outputs = (int) entries[next_entry].value;
+            else
+                apply_command(myFrame, entries[next_entry].key, entries[next_entry].value);
+        }
+
+        start = std::chrono::steady_clock::now();
+        myFrame.set_image_content(frame);
+        process_times.values.push_back(elapsed_ms(start));
+        // The plan of the toggles only exists once the first frame has compiled it
+        if (count == 0)
+            std::cerr << "Plan:     " << myFrame.get_processing_graph().get_description(MyImage::get_stage_names()) << std::endl;
+
+        // Compared before the side outputs, as in the GUI
+        unsigned long long expected;
+        if (replay && session.get_result(count, expected)) {
+            checked++;
+            if (SessionRecorder::hash(myFrame.get_image_content()) != expected) {
+                if (different++ == 0)
+                    first_different = count;
+            }
+        }
+
+        // The side outputs are computed on the processed image, as in the GUI
+        start = std::chrono::steady_clock::now();
+        std::vector<std::pair<std::string, cv::Mat> > sides;
+        if (replay ? (side_outputs & SIDE_MOTION) != 0 : spec.has_stage("motion"))
+            sides.push_back(std::make_pair(std::string("motion"), myFrame.get_motion_detected()));
+        if (replay ? (side_outputs & SIDE_OBJECTS) != 0 : spec.has_stage("objects"))
+            sides.push_back(std::make_pair(std::string("objects"), myFrame.get_object_detected()));
+        if (replay ? (side_outputs & SIDE_HISTOGRAM) != 0 : spec.has_stage("histogram"))
+            sides.push_back(std::make_pair(std::string("histogram"), myFrame.get_image_histogram()));
+        // Other buffers of the processing graph kept as results
+        const std::vector<std::string> &sinks = myFrame.get_processing_graph().get_sinks();
+        for (size_t i=0; i<sinks.size(); i++)
+            if (sinks[i] != "main")
+                sides.push_back(std::make_pair(sinks[i], myFrame.get_graph_output(sinks[i])));
+        if (!sides.empty())
+            side_times.values.push_back(elapsed_ms(start));
+
+        start = std::chrono::steady_clock::now();
+        result = myFrame.get_image_content();
+        if (result.channels() == 1)
+            cv::cvtColor(result, result, cv::COLOR_GRAY2BGR);
+        if (recorder.isRunning()) {
+            recorder.push(result);
+        }
+        else if (output_images) {
+            snprintf(filename, sizeof(filename), "/frame_%06lld", count);
+            snapshots.save(result, output + filename + extension, format, quality);
+            for (size_t i=0; i<sides.size(); i++) {
+                snprintf(filename, sizeof(filename), "_%06lld", count);
+                snapshots.save(sides[i].second, output + "/" + sides[i].first + filename + extension, format, quality);
+            }
+        }
+        if (!output.empty())
+            write_times.values.push_back(elapsed_ms(start));
+
+        count++;
+    }
+    double total_ms = elapsed_ms(start_all);
+    source->release();
+    delete source;
+    // Waits for the frames still queued for the encoder and for the images still queued for the pool
+    recorder.stop();
+    snapshots.wait();
+    total_ms = elapsed_ms(start_all);
+
+    // Timing report
+    std::ofstream report_file;
+    if (!report.empty()) {
+        report_file.open(report.c_str());
+        if (!report_file)
+            std::cerr << "Cannot create the report " << report << ", using the standard output" << std::endl;
+    }
+    std::ostream &out = report_file.is_open() ? report_file : std::cout;
+    out << "Input:     " << input << " (" << size.width << "x" << size.height << ")\n"
+        << "Pipeline:  " << description << "\n"
+        << "Frames:    " << count << "\n"
+        << "Total:     " << total_ms/1000. << " s\n"
+        << "Frame rate: " << (total_ms > 0. ? count*1000./total_ms : 0.) << " fps\n\n"
+        << "step              mean (ms)   p50 (ms)   p99 (ms)   max (ms) total (ms)\n";
+    write_statistics(out, read_times);
+    write_statistics(out, process_times);
+    write_statistics(out, side_times);
+    write_statistics(out, write_times);
+    if (recorder.get_encoded_frames() > 0) {
+        char line[256];
+        snprintf(line, sizeof(line), "%-14s %10.3f %10s %10s %10.3f   (encoder thread, up to %d frames waiting)\n", "encode",
+                 recorder.get_mean_encode_ms(), "-", "-", recorder.get_max_encode_ms(), recorder.get_max_queue_depth());
+        out << line;
+    }
+    if (snapshots.get_written() + snapshots.get_failed() > 0) {
+        char line[256];
+        snprintf(line, sizeof(line), "%-14s %10.3f %10s %10s %10.3f   (%d threads, %llu images, %llu failed)\n", "image write",
+                 snapshots.get_mean_write_ms(), "-", "-", snapshots.get_max_write_ms(),
+                 std::max(1, (int) std::thread::hardware_concurrency()), snapshots.get_written(), snapshots.get_failed());
+        out << line;
+    }
+
+    // Details of the processing, measured inside MyImage
+    out << "\nstage             mean (ms)   p50 (ms)   p99 (ms)   max (ms)    samples\n";
+    std::vector<StageStatistics> stages = myFrame.get_profiler().get_all_statistics();
+    for (size_t i=0; i<stages.size(); i++) {
+        if (stages[i].samples == 0)
+            continue;
+        char line[256];
+        snprintf(line, sizeof(line), "%-14s %10.3f %10.3f %10.3f %10.3f %10d\n", stages[i].name.c_str(),
+                 stages[i].mean, stages[i].p50, stages[i].p99, stages[i].max, stages[i].samples);
+        out << line;
+    }
+
+    // Should stay constant once the first frames have been processed
+    ScratchPool &scratch = myFrame.get_scratch_pool();
+    out << "\nScratch buffers: " << scratch.get_allocations() << " allocations, "
+        << scratch.get_number_buffers() << " buffers kept (" << scratch.get_memory()/1024 << " KiB)\n";
+
+    // Same images as in the GUI?
+    if (replay) {
+        out << "\nSession: " << checked << " frames compared with the GUI, " << different << " different";
+        if (different > 0)
+            out << " (the first one is the frame " << first_different << ")";
+        out << "\n";
+        if (session.get_lost_frame() >= 0)
+            out << "         the session lost its frame " << session.get_lost_frame() << ", the replay stops before it\n";
+        if (checked < (long long) session.get_number_results())
+            out << "         " << (long long) session.get_number_results() - checked << " frames of the session were not replayed\n";
+        if (different > 0) {
+            std::cerr << "The replay differs from the session from the frame " << first_different << std::endl;
+            return 2;
+        }
+    }
+
+    return count > 0 ? 0 : 1;
+}
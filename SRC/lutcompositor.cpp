@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *  Composition of the point operations of MyImage (inversion, global thresholds, brightness,
+ *  contrast and gamma, global histogram equalization of gray images) into one lookup table.
+ *  A chain of these operations costs a single pass over the image. No Qt thing here.
+*/
+
+#include "lutcompositor.h"
+
+#include "opencv2/imgproc.hpp"
+
+#include <cmath>
+#include <cstring>
+
+/**
+ * @brief LutCompositor::LutCompositor
+ *
+ * Constructor of the class LutCompositor. The table is the identity.
+ */
+LutCompositor::LutCompositor() : table(1, 256, CV_8U),
+                                 valid(false),
+                                 rebuilds(0)
+{
+}
+
+/**
+ * @brief LutCompositor::begin
+ *
+ * Start a new chain of operations. The table of the previous chain is kept as long as the
+ * same operations are added again.
+ */
+void LutCompositor::begin() {
+    this->operations.clear();
+}
+
+/**
+ * @brief LutCompositor::add_inverse
+ *
+ * Same result as cv::bitwise_not
+ */
+void LutCompositor::add_inverse() {
+    Operation op;
+    op.kind = INVERSE;
+    op.a = op.b = op.c = 0.;
+    this->operations.push_back(op);
+}
+
+/**
+ * @brief LutCompositor::add_threshold
+ * @param type: integer cv::THRESH_BINARY, cv::THRESH_BINARY_INV, cv::THRESH_TRUNC, cv::THRESH_TOZERO or cv::THRESH_TOZERO_INV
+ * @param value: integer the threshold, the maximum value is 255
+ *
+ * Same result as cv::threshold on a gray image
+ */
+void LutCompositor::add_threshold(int type, int value) {
+    Operation op;
+    op.kind = THRESHOLD;
+    op.a = type;
+    op.b = value;
+    op.c = 0.;
+    this->operations.push_back(op);
+}
+
+/**
+ * @brief LutCompositor::add_tone
+ * @param brightness: integer added to the values [-255,255]
+ * @param contrast: double the gain around the middle gray 128
+ * @param gamma: double the gamma correction, applied after the contrast and the brightness (>1 brightens the dark tones)
+ */
+void LutCompositor::add_tone(int brightness, double contrast, double gamma) {
+    Operation op;
+    op.kind = TONE;
+    op.a = brightness;
+    op.b = contrast;
+    op.c = gamma;
+    this->operations.push_back(op);
+}
+
+/**
+ * @brief LutCompositor::add_equalization
+ * @param gray: cv::Mat the single channel image at the beginning of the chain
+ *
+ * Same result as cv::equalizeHist on the image obtained by the operations already added.
+ * The histogram of this image is the histogram of gray passed through their table.
+ */
+void LutCompositor::add_equalization(const cv::Mat &gray) {
+    CV_Assert(gray.type() == CV_8UC1);
+    int histSize = 256;
+    float range[] = { 0, 256 };
+    const float* histRange = { range };
+    cv::calcHist(&gray, 1, 0, cv::Mat(), this->histogram, 1, &histSize, &histRange, true, false);
+
+    uchar before[256];
+    compose(this->operations.size(), before);
+    int hist[256] = { 0 };
+    for (int v=0; v<256; v++)
+        hist[before[v]] += cvRound(this->histogram.at<float>(v));
+
+    // Same algorithm as cv::equalizeHist
+    Operation op;
+    op.kind = EQUALIZATION;
+    op.a = op.b = op.c = 0.;
+    int total = (int) gray.total();
+    int first = 0;
+    while (first < 255 && hist[first] == 0)
+        first++;
+    if (hist[first] == total) {
+        std::memset(op.table, first, sizeof(op.table));
+    }
+    else {
+        float scale = 255.f / (total - hist[first]);
+        int sum = 0;
+        for (int v=0; v<=first; v++)
+            op.table[v] = 0;
+        for (int v=first+1; v<256; v++) {
+            sum += hist[v];
+            op.table[v] = cv::saturate_cast<uchar>(sum * scale);
+        }
+    }
+    this->operations.push_back(op);
+}
+
+/**
+ * @brief LutCompositor::get_number_operations
+ * @return the number of operations of the current chain
+ */
+int LutCompositor::get_number_operations() {
+    return (int) this->operations.size();
+}
+
+/**
+ * @brief LutCompositor::apply
+ * @param image: cv::Mat 8 bits image with any number of channels, modified in place
+ */
+void LutCompositor::apply(cv::Mat &image) {
+    if (this->operations.empty())
+        return;
+
+    bool same = this->valid && this->built.size() == this->operations.size();
+    for (size_t i=0; same && i<this->operations.size(); i++)
+        same = same_operation(this->operations[i], this->built[i]);
+    if (!same) {
+        compose(this->operations.size(), this->table.ptr<uchar>());
+        this->built = this->operations;
+        this->valid = true;
+        this->rebuilds++;
+    }
+    cv::LUT(image, this->table, image);
+}
+
+/**
+ * @brief LutCompositor::get_rebuilds
+ * @return the number of times the table has been computed
+ */
+unsigned long long LutCompositor::get_rebuilds() {
+    return this->rebuilds;
+}
+
+/**
+ * @brief LutCompositor::compose
+ * @param count: integer the number of operations of the chain to compose
+ * @param result: table that receives the composition
+ */
+void LutCompositor::compose(size_t count, uchar result[256]) {
+    for (int v=0; v<256; v++)
+        result[v] = (uchar) v;
+
+    for (size_t i=0; i<count; i++) {
+        const Operation &op = this->operations[i];
+        for (int v=0; v<256; v++) {
+            int x = result[v];
+            switch (op.kind) {
+            case INVERSE:
+                x = 255 - x;
+                break;
+            case THRESHOLD: {
+                int value = (int) op.b;
+                switch ((int) op.a) {
+                case cv::THRESH_BINARY:     x = x > value ? 255 : 0;     break;
+                case cv::THRESH_BINARY_INV: x = x > value ? 0 : 255;     break;
+                case cv::THRESH_TRUNC:      x = x > value ? value : x;   break;
+                case cv::THRESH_TOZERO:     x = x > value ? x : 0;       break;
+                case cv::THRESH_TOZERO_INV: x = x > value ? 0 : x;       break;
+                default: break;
+                }
+                x = x < 0 ? 0 : (x > 255 ? 255 : x);
+                break;
+            }
+            case TONE: {
+                double y = op.b * (x - 128.) + 128. + op.a;
+                y = y < 0. ? 0. : (y > 255. ? 255. : y);
+                if (op.c > 0. && op.c != 1.)
+                    y = 255. * std::pow(y / 255., 1. / op.c);
+                x = cv::saturate_cast<uchar>(y);
+                break;
+            }
+            case EQUALIZATION:
+                x = op.table[x];
+                break;
+            default:
+                break;
+            }
+            result[v] = (uchar) x;
+        }
+    }
+}
+
+/**
+ * @brief LutCompositor::same_operation
+ * @return true if the two operations give the same table. Never true for the equalization.
+ */
+bool LutCompositor::same_operation(const Operation &first, const Operation &second) {
+    return first.kind == second.kind && first.kind != EQUALIZATION &&
+           first.a == second.a && first.b == second.b && first.c == second.c;
+}
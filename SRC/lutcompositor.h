@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef LUTCOMPOSITOR_H
+#define LUTCOMPOSITOR_H
+
+#include "opencv2/core.hpp"
+
+#include <vector>
+
+/**
+ * @brief The LutCompositor class
+ *
+ * Folds consecutive point operations (the value of a pixel only depends on its own value)
+ * into one table of 256 entries, applied to every channel in a single pass with cv::LUT.
+ * The table is only rebuilt when the operations or their parameters change, except for the
+ * histogram equalization whose table depends on the content of every frame.
+ */
+class LutCompositor
+{
+public:
+    LutCompositor();
+
+    void begin();
+    void add_inverse();
+    void add_threshold(int type, int value);
+    void add_tone(int brightness, double contrast, double gamma);
+    void add_equalization(const cv::Mat &gray);
+    int get_number_operations();
+    void apply(cv::Mat &image);
+
+    unsigned long long get_rebuilds();
+
+private:
+    enum Kind { INVERSE = 1, THRESHOLD, TONE, EQUALIZATION };
+    struct Operation {
+        int kind;
+        double a, b, c;
+        uchar table[256]; // EQUALIZATION only
+    };
+
+    std::vector<Operation> operations, built;
+    cv::Mat table, histogram;
+    bool valid;
+    unsigned long long rebuilds;
+
+    void compose(size_t count, uchar result[256]);
+    static bool same_operation(const Operation &first, const Operation &second);
+};
+
+#endif // LUTCOMPOSITOR_H
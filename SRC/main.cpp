@@ -63,7 +63,7 @@ The code can also be compiled against five optional libraries:
 - libzbar (enables decryption of barcodes and QR codes)
 - libtesseract (enables text recognition inside images)
 
-If you don't have these libraries, just comment the top lines in the file Video.pro. If you have the objdetect library, a face-detetection cascade from OpenCV is also required. In this program the face-detection cascade file is hard-coded as "opencv-4.3.0/data/haarcascades/haarcascade_frontalface_default.xml" in the file capturevideo.cpp. This path must be adapted according to your installation. The ZBar library must also be compiled in order to be able to decode the barcodes / QR codes. For this library to function, it is not mandatory to compile ZBar with gtk, python or qt4 options enabled (only the headers and the library are required, not the executable).
+If you don't have these libraries, just comment the corresponding lines in the file libraries.pri. If you have the objdetect library, a face-detetection cascade from OpenCV is also required. In this program the face-detection cascade file is hard-coded as "opencv-4.3.0/data/haarcascades/haarcascade_frontalface_default.xml" in the file capturevideo.cpp. This path must be adapted according to your installation. The ZBar library must also be compiled in order to be able to decode the barcodes / QR codes. For this library to function, it is not mandatory to compile ZBar with gtk, python or qt4 options enabled (only the headers and the library are required, not the executable).
 
 You must have Qt5 in order to fully take advantage of multithreading. If you only have Qt4, please download version 1.0 of this program.
 
@@ -74,19 +74,19 @@ Your C++ compiler must accept c++11 directives.
 \subsection subsection_install_mac On a MacOS
 This program has been developed on a old Mac. The graphic card supports only OpenCL 1.0 directives, which is not sufficient for for image stitching. Luckily the CPU managed version 1.2 of OpenCL. To set OpenCL to use the CPU, the environment variable OPENCV_OPENCL_DEVICE=":CPU:0" had to be exported. Moreover if your program complains about not finding OpenCV libraries, don't forget to export the path to the OpenCV libraries in the environment variable DYLD_LIBRARY_PATH.
 
-Edit the file Video.pro and provide the path where your OpenCV, ZBar and Tesseract libraries are installed. To create a Makefile or a XCode project, run the Qt command:
+Edit the file libraries.pri and provide the path where your OpenCV, ZBar and Tesseract libraries are installed. To create a Makefile or a XCode project, run the Qt command:
 
 qmake Video.pro
 
 \subsection subsection_install_linux On Linux
-Not tested. Should be similar to what is done for MacOS. Modify the file Video.pro accordingly to your availabilities and launch
+Not tested. Should be similar to what is done for MacOS. Modify the file libraries.pri accordingly to your availabilities and launch
 
 qmake Video.pro
 
 to generate a Makefile, which is used to compile the project.
 
 \subsection subsection_install_windows On Windows
-Generating a Makefile through qmake has never been so easy. Simply modify the file Video.pro and execute
+Generating a Makefile through qmake has never been so easy. Simply modify the file libraries.pri and execute
 
 qmake.exe Video.pro
 
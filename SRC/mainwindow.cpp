@@ -25,12 +25,12 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent),
                                           currentImage(nullptr)
 {
     // Initialize the OpenCV Qthread
-    this->data_lock = new QMutex();
-    this->worker = new captureVideo(this,this->data_lock);
+    this->worker = new captureVideo(this);
     
     // Links signals from the video capturer to functions that update the display
     connect(worker, &captureVideo::frameCaptured,     this, &MainWindow::updateFrame );
     connect(worker, &captureVideo::changeInfo   ,     this, &MainWindow::updateMainStatusLabel );
+    connect(worker, &captureVideo::profileUpdated,    this, &MainWindow::updateProfile );
     connect(worker, &captureVideo::motionCaptured,    this, &MainWindow::update_motion_window );
     connect(worker, &captureVideo::objectsCaptured,   this, &MainWindow::update_objects_window );
     connect(worker, &captureVideo::histogramCaptured, this, &MainWindow::update_histogram_window );
@@ -50,9 +50,12 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent),
         this->launchCamera(0);
     }
     else if (cameras.size() == 0) {
-        std::cerr << "Error: the number of available cameras is equal to zero"<<std::endl;
-        QMessageBox::critical(this, "Cameras", "Error: the number of available cameras is equal to zero");
-        throw std::runtime_error("Error: the number of available cameras is equal to zero");
+        // No camera: run the processing on synthetic frames, a video file can be opened from the menu File
+        std::cerr << "Warning: the number of available cameras is equal to zero"<<std::endl;
+        QMessageBox::warning(this, "Cameras", "The number of available cameras is equal to zero, synthetic frames are used instead");
+        this->worker->setSource(new SyntheticSource(640, 480, 30.));
+        if (!this->launchSource("Synthetic frames"))
+            throw std::runtime_error("Error: could not generate synthetic frames");
     }
     
     // Setup menubar
@@ -76,6 +79,7 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent),
 #ifdef withtesseract
     this->window_tesseract = new Window_Tesseract(this);
     connect(this->window_tesseract, SIGNAL(Signal_get_new_image(bool)) , this, SLOT(treat_Tesseract_get_new_image(bool)) );
+    connect(this->worker, SIGNAL(textAreasCaptured(bool)), this, SLOT(update_tesseract_window(bool)) );
 #endif 
     
     createActions();
@@ -163,6 +167,13 @@ void MainWindow::createActions() {
     this->actionThreshold->setCheckable(true);
     connect(this->actionThreshold, SIGNAL(triggered(bool)), this->worker, SLOT(toggleThreshold(bool)));
     connect(this->actionThreshold, SIGNAL(triggered(bool)), this,         SLOT(treat_Button_Threshold(bool)));
+
+    // Filters / Brightness and contrast
+    this->actionTone = new QAction(tr("Brightness / Contrast"), this);
+    this->actionTone->setToolTip(tr("Adjust the brightness, the contrast and the gamma of the image"));
+    this->actionTone->setCheckable(true);
+    connect(this->actionTone, SIGNAL(triggered(bool)), this->worker, SLOT(toggleTone(bool)));
+    connect(this->actionTone, SIGNAL(triggered(bool)), this,         SLOT(treat_Button_Tone(bool)));
     
     // Detection / Edge detection
     this->actionEdge = new QAction(tr("&Edge recognition"), this);
@@ -240,21 +251,86 @@ void MainWindow::createActions() {
     connect(this->actionPhoto, SIGNAL(triggered(bool)), this->worker, SLOT(togglePhoto(bool)));
     connect(this->actionPhoto, SIGNAL(triggered(bool)), this,         SLOT(treat_Button_Photo(bool)));
 
+    // Operations / Stage timings
+    this->actionProfiling = new QAction(tr("Stage timings"), this);
+    this->actionProfiling->setToolTip(tr("Show the time spent in every stage of the image processing"));
+    this->actionProfiling->setCheckable(true);
+    connect(this->actionProfiling, SIGNAL(triggered(bool)), this->worker, SLOT(toggleProfiling(bool)));
+    connect(this->actionProfiling, SIGNAL(triggered(bool)), this,         SLOT(treat_Button_Profiling(bool)));
+
+    // Operations / Pipelined processing
+    this->actionPipeline = new QAction(tr("Pipelined processing"), this);
+    this->actionPipeline->setToolTip(tr("Spread the stages of the image processing over several cores"));
+    this->actionPipeline->setCheckable(true);
+    connect(this->actionPipeline, SIGNAL(triggered(bool)), this->worker, SLOT(togglePipeline(bool)));
+
+    // Operations / Frame rate control
+    this->actionPerformance = new QAction(tr("Frame rate control"), this);
+    this->actionPerformance->setToolTip(tr("Hold a target frame rate by lowering the quality of the processing"));
+    this->actionPerformance->setCheckable(true);
+    connect(this->actionPerformance, SIGNAL(triggered(bool)), this->worker, SLOT(toggleGovernor(bool)));
+    connect(this->actionPerformance, SIGNAL(triggered(bool)), this,         SLOT(treat_Button_Performance(bool)));
+
     // File / Record
     this->actionRecord = new QAction(tr("&Record"), this);
     this->actionRecord->setToolTip(tr("Record the video"));
     this->actionRecord->setCheckable(true);
     connect(this->actionRecord, SIGNAL(triggered(bool)), this, SLOT(treat_Button_Record(bool)));
+
+    // File / Record every frame
+    this->actionRecordEveryFrame = new QAction(tr("Record every frame"), this);
+    this->actionRecordEveryFrame->setToolTip(tr("Slow down the processing rather than dropping frames when the encoder of the video falls behind"));
+    this->actionRecordEveryFrame->setCheckable(true);
+    connect(this->actionRecordEveryFrame, SIGNAL(triggered(bool)), this, SLOT(treat_Button_Record_Every_Frame(bool)));
+
+    // File / Record on motion
+    this->actionRecordMotion = new QAction(tr("Record on motion"), this);
+    this->actionRecordMotion->setToolTip(tr("Record one video per event of motion, with the seconds before and after it"));
+    this->actionRecordMotion->setCheckable(true);
+    connect(this->actionRecordMotion, SIGNAL(triggered(bool)), this, SLOT(treat_Button_Record_Motion(bool)));
+
+    // File / Record raw frames
+    this->actionRecordRaw = new QAction(tr("Record raw frames"), this);
+    this->actionRecordRaw->setToolTip(tr("Record the frames of the camera without any processing nor lossy compression, to replay them later"));
+    this->actionRecordRaw->setCheckable(true);
+    connect(this->actionRecordRaw, SIGNAL(triggered(bool)), this, SLOT(treat_Button_Record_Raw(bool)));
+
+    // File / Record a session
+    this->actionRecordSession = new QAction(tr("Record a session"), this);
+    this->actionRecordSession->setToolTip(tr("Record the frames of the camera and every change of the parameters, to replay them in VideoHeadless"));
+    this->actionRecordSession->setCheckable(true);
+    connect(this->actionRecordSession, SIGNAL(triggered(bool)), this, SLOT(treat_Button_Record_Session(bool)));
+
+    // File / Stream
+    this->actionStream = new QAction(tr("Stream"), this);
+    this->actionStream->setToolTip(tr("Send the frames to a GStreamer pipeline (RTP, RTSP, ...) while they are displayed and recorded"));
+    this->actionStream->setCheckable(true);
+    connect(this->actionStream, SIGNAL(triggered(bool)), this, SLOT(treat_Button_Stream(bool)));
     
     // File / Save
     this->actionSaveImage = new QAction(tr("&Save"), this );
-    this->actionSaveImage->setToolTip(tr("Save the current image"));
+    this->actionSaveImage->setToolTip(tr("Save the next processed frame, captured as soon as the action is triggered"));
     connect(this->actionSaveImage, SIGNAL(triggered()), this->worker, SLOT(file_save_image()) );
+
+    // File / Save a burst
+    this->actionSaveBurst = new QAction(tr("Save a burst"), this );
+    this->actionSaveBurst->setToolTip(tr("Save consecutive frames, kept in memory at the full frame rate and written afterwards"));
+    connect(this->actionSaveBurst, SIGNAL(triggered()), this, SLOT(treat_Button_Save_Burst()) );
     
     // File / Change camera
     this->actionChangeCamera = new QAction(tr("Change camera"),this);
     this->actionChangeCamera->setToolTip(tr("Change the camera that is used as an input"));
     connect(this->actionChangeCamera, SIGNAL(triggered()), this, SLOT(showCameraSettings()) );
+    
+    // File / Open a video file
+    this->actionOpenVideoFile = new QAction(tr("Open a video file"),this);
+    this->actionOpenVideoFile->setToolTip(tr("Use the frames of a video file as an input"));
+    connect(this->actionOpenVideoFile, SIGNAL(triggered()), this, SLOT(openVideoFile()) );
+    
+    // File / Open a directory of images
+    this->actionOpenImageDirectory = new QAction(tr("Open a directory of images"),this);
+    this->actionOpenImageDirectory->setToolTip(tr("Use the images of a directory as an input"));
+    connect(this->actionOpenImageDirectory, SIGNAL(triggered()), this, SLOT(openImageDirectory()) );
 }
 
 /**
@@ -264,13 +340,25 @@ void MainWindow::createActions() {
  */
 void MainWindow::createToolBars() {
     this->menu_File->addAction(this->actionSaveImage);
+    this->menu_File->addAction(this->actionSaveBurst);
     this->menu_File->addAction(this->actionRecord);
+    this->menu_File->addAction(this->actionRecordEveryFrame);
+    this->menu_File->addAction(this->actionRecordMotion);
+    this->menu_File->addAction(this->actionRecordRaw);
+    this->menu_File->addAction(this->actionRecordSession);
+    this->menu_File->addAction(this->actionStream);
+    this->menu_File->addMenu(createTapMenu(tr("Record from"), captureVideo::SINK_RECORDER));
+    this->menu_File->addMenu(createTapMenu(tr("Stream from"), captureVideo::SINK_STREAM));
+    this->menu_File->addMenu(createTapMenu(tr("Save from"),   captureVideo::SINK_SNAPSHOTS));
     this->menu_File->addAction(this->actionChangeCamera);
+    this->menu_File->addAction(this->actionOpenVideoFile);
+    this->menu_File->addAction(this->actionOpenImageDirectory);
     
     this->menu_Filters->addAction(this->actionColour_BW);
     this->menu_Filters->addAction(this->actionInverse);
     this->menu_Filters->addAction(this->actionBlur);
     this->menu_Filters->addAction(this->actionThreshold);
+    this->menu_Filters->addAction(this->actionTone);
     
     this->menu_Transformations->addAction(this->actionTransformation);
     this->menu_Transformations->addAction(this->actionHistoEq);
@@ -293,6 +381,52 @@ void MainWindow::createToolBars() {
 #endif
     
     this->menu_Operations->addAction(this->actionPhoto);
+    this->menu_Operations->addAction(this->actionProfiling);
+    this->menu_Operations->addAction(this->actionPipeline);
+    this->menu_Operations->addAction(this->actionPerformance);
+}
+
+/**
+ * @brief MainWindow::createTapMenu
+ * @param title: QString the title of the menu
+ * @param sink: integer captureVideo::TapSink whose frames are chosen in the menu
+ * @return the menu of the tap points: camera input, result of a stage, processed image (by default), side outputs
+ */
+QMenu* MainWindow::createTapMenu(const QString &title, int sink) {
+    QMenu *menu = new QMenu(title, this);
+    QActionGroup *group = new QActionGroup(menu);
+    group->setExclusive(true);
+
+    QList<QVariantList> taps;
+    QStringList names;
+    taps << (QVariantList() << sink << FrameSink::TAP_INPUT << -1);
+    names << tr("Camera input");
+    std::vector<std::string> stages = MyImage::get_stage_names();
+    for (int stage=MyImage::STAGE_FACE; stage<=MyImage::STAGE_QRCODE; stage++) {
+        taps << (QVariantList() << sink << FrameSink::TAP_STAGE << stage);
+        names << tr("After %1").arg(QString::fromStdString(stages[stage]));
+    }
+    taps << (QVariantList() << sink << FrameSink::TAP_OUTPUT << -1);
+    names << tr("Processed image");
+    taps << (QVariantList() << sink << FrameSink::TAP_MOTION << -1);
+    names << tr("Motion detection");
+    taps << (QVariantList() << sink << FrameSink::TAP_OBJECTS << -1);
+    names << tr("Object detection");
+    taps << (QVariantList() << sink << FrameSink::TAP_HISTOGRAM << -1);
+    names << tr("Histogram");
+
+    for (int i=0; i<taps.size(); i++) {
+        QAction *action = menu->addAction(names[i]);
+        action->setCheckable(true);
+        action->setData(taps[i]);
+        action->setChecked(taps[i][1].toInt() == FrameSink::TAP_OUTPUT);
+        group->addAction(action);
+        // Input, stages, processed image and side outputs in separate sections
+        if (i == 0 || i == taps.size()-5 || i == taps.size()-4)
+            menu->addSeparator();
+    }
+    connect(group, SIGNAL(triggered(QAction*)), this, SLOT(treat_Tap_Changed(QAction*)));
+    return menu;
 }
 
 /**
@@ -326,6 +460,9 @@ void MainWindow::createWindows(){
     // Create a new object for motion detection and create adequate connections to functions, depending on the received signals
     this->dialog_motion_detection = new Dialog_Motion_Detection(this);
     connect(this->dialog_motion_detection, SIGNAL(Signal_motion_detection_method_changed(int)), this->worker, SLOT(change_motion_detection_method(int)) );
+    connect(this->dialog_motion_detection, SIGNAL(Signal_motion_record_preroll_changed(int)),      this->worker, SLOT(change_motion_preroll(int)) );
+    connect(this->dialog_motion_detection, SIGNAL(Signal_motion_record_postroll_changed(int)),     this->worker, SLOT(change_motion_postroll(int)) );
+    connect(this->dialog_motion_detection, SIGNAL(Signal_motion_record_threshold_changed(double)), this->worker, SLOT(change_motion_threshold(double)) );
     this->dialog_motion_detection->hide();
     
     // Create a new object for object detections and create adequate connections to functions, depending on the received signals
@@ -369,6 +506,20 @@ void MainWindow::createWindows(){
     connect(this->dialog_photo, SIGNAL(Signal_photo_method_changed(int)),   this->worker, SLOT(change_photo_method(int)) );
     connect(this->dialog_photo, SIGNAL(Signal_photo_sigmaS_changed(int)),   this->worker, SLOT(change_photo_sigmas(int)) );
     connect(this->dialog_photo, SIGNAL(Signal_photo_sigmaR_changed(double)),this->worker, SLOT(change_photo_sigmar(double)) );
+
+    // Create a new object for the brightness/contrast/gamma and create adequate connections to functions
+    this->dialog_tone = new Dialog_Tone(this);
+    connect(this->dialog_tone, SIGNAL(Signal_tone_brightness_changed(int)),  this->worker, SLOT(change_tone_brightness(int)) );
+    connect(this->dialog_tone, SIGNAL(Signal_tone_contrast_changed(double)), this->worker, SLOT(change_tone_contrast(double)) );
+    connect(this->dialog_tone, SIGNAL(Signal_tone_gamma_changed(double)),    this->worker, SLOT(change_tone_gamma(double)) );
+    this->dialog_tone->hide();
+
+    // Create a new object for the control of the frame rate and create adequate connections to functions
+    this->dialog_performance = new Dialog_Performance(this);
+    connect(this->dialog_performance, SIGNAL(Signal_performance_target_fps_changed(int)), this->worker, SLOT(change_target_fps(int)) );
+    connect(this->dialog_performance, SIGNAL(Signal_performance_fps_cap_changed(int)),    this->worker, SLOT(change_fps_cap(int)) );
+    connect(this->dialog_performance, SIGNAL(Signal_performance_analysis_width_changed(int)), this->worker, SLOT(change_analysis_width(int)) );
+    this->dialog_performance->hide();
     this->dialog_motion_detection->hide();
     
 #ifdef withzbar
@@ -415,14 +566,8 @@ void MainWindow::createWindows(){
 void MainWindow::launchCamera(int camID){
     // Initialization of the OpenCV thread
     this->worker->setCamera(camID);
-    this->worker->setThreadStatus(false);
-    int width,height ; // will hold the dimensions of the camera frame
-    if (this->worker->openCamera(width,height)) {
-        stopThread();// stop any running thread
-        this->worker->start(); // Launch the new thread (call to run() in capturevideo)
+    if (this->launchSource(this->dialog_choose_camera->get_info_camera())) {
         this->dialog_choose_camera->hide();// hide the dialog window
-        setWindowTitle(this->dialog_choose_camera->get_info_camera());//change the title of the main window to the camera name
-        this->resize(width+25, height+70); // add some space around the frame
     }
     else {
         std::cerr << "Error: could not open the camera"<<std::endl;
@@ -431,6 +576,61 @@ void MainWindow::launchCamera(int camID){
     }
 }
 
+/**
+ * @brief MainWindow::launchSource
+ * @param title: QString the new title of the main window
+ * @return true if the source of frames set in the OpenCV thread could be opened
+ * 
+ * Open the source of frames of the OpenCV thread and launch it
+ */
+bool MainWindow::launchSource(QString title){
+    this->worker->setThreadStatus(false);
+    int width,height ; // will hold the dimensions of the camera frame
+    if (this->worker->openCamera(width,height)) {
+        stopThread();// stop any running thread
+        this->worker->start(); // Launch the new thread (call to run() in capturevideo)
+        setWindowTitle(title);//change the title of the main window to the camera name
+        this->resize(width+25, height+70); // add some space around the frame
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief MainWindow::openVideoFile
+ * 
+ * Ask for a video file and use its frames as an input of the OpenCV thread
+ */
+void MainWindow::openVideoFile(){
+    QString QfileNameLocal = QFileDialog::getOpenFileName(this, tr("Select a video file"), QString(),
+                                                          tr("Videos (*.avi *.mp4 *.mov *.mkv *.raw)") );
+    if (QfileNameLocal.isEmpty()) // If one clicked the cancel button, the string is empty
+        return;
+    
+    // The raw frames are replayed at the pace of their recording
+    if (QFileInfo(QfileNameLocal).suffix().toLower() == "raw")
+        this->worker->setSource(new RawFileSource(QfileNameLocal.toStdString(), true, true));
+    else
+        this->worker->setSource(new VideoFileSource(QfileNameLocal.toStdString(), 8, true));
+    if (!this->launchSource(QfileNameLocal))
+        QMessageBox::critical(this, "Video file", "Error: could not open the video file");
+}
+
+/**
+ * @brief MainWindow::openImageDirectory
+ * 
+ * Ask for a directory and use its images as an input of the OpenCV thread
+ */
+void MainWindow::openImageDirectory(){
+    QString QdirLocal = QFileDialog::getExistingDirectory(this, tr("Select a directory of images"));
+    if (QdirLocal.isEmpty()) // If one clicked the cancel button, the string is empty
+        return;
+    
+    this->worker->setSource(new ImageSequenceSource(QdirLocal.toStdString(), 10., true));
+    if (!this->launchSource(QdirLocal))
+        QMessageBox::critical(this, "Images", "Error: could not find images in the directory");
+}
+
 /**
  * @brief MainWindow::showCameraSettings
  * 
@@ -561,6 +761,19 @@ void MainWindow::treat_Button_Motion_Detection(bool state) {
     }
 }
 
+/**
+ * @brief MainWindow::treat_Button_Tone
+ * @param state: boolean
+ * 
+ * Called when Brightness / Contrast Button is triggered. Display/hide the corresponding dialog window.
+ */
+void MainWindow::treat_Button_Tone(bool state) {
+    if (state)
+        this->dialog_tone->show();
+    else 
+        this->dialog_tone->hide();
+}
+
 /**
  * @brief MainWindow::treat_Button_Photo
  * @param state: boolean
@@ -574,6 +787,33 @@ void MainWindow::treat_Button_Photo(bool state) {
         this->dialog_photo->hide();
 }
 
+/**
+ * @brief MainWindow::treat_Button_Profiling
+ * @param state: boolean
+ *
+ * Called when Stage timings Button is triggered. Removes the overlay and the message when deactivated.
+ */
+void MainWindow::treat_Button_Profiling(bool state) {
+    if (!state) {
+        this->profile_lines.clear();
+        this->mainStatusBar->clearMessage();
+        repaint();
+    }
+}
+
+/**
+ * @brief MainWindow::treat_Button_Performance
+ * @param state: boolean
+ * 
+ * Called when Frame rate control Button is triggered. Display/hide the corresponding dialog window.
+ */
+void MainWindow::treat_Button_Performance(bool state) {
+    if (state)
+        this->dialog_performance->show();
+    else 
+        this->dialog_performance->hide();
+}
+
 /**
  * @brief MainWindow::treat_Button_Record
  * @param state: boolean
@@ -587,6 +827,89 @@ void MainWindow::treat_Button_Record(bool state) {
         this->actionRecord->setChecked(false) ; 
 }
 
+/**
+ * @brief MainWindow::treat_Button_Record_Every_Frame
+ * @param state: boolean
+ * 
+ * Called when Record every frame Button is triggered. Chooses what happens when the encoder of the
+ * video falls behind: the processing waits for it, or the oldest waiting frames are dropped.
+ */
+void MainWindow::treat_Button_Record_Every_Frame(bool state) {
+    this->worker->change_record_policy(state ? FrameRingBuffer::BLOCK : FrameRingBuffer::DROP_OLDEST);
+}
+
+/**
+ * @brief MainWindow::treat_Button_Record_Motion
+ * @param state: boolean
+ * 
+ * Called when Record on motion Button is triggered. Starts/stops the recording of the events of motion.
+ */
+void MainWindow::treat_Button_Record_Motion(bool state) {
+    if ( ! this->worker->file_save_motion(state) )
+        // clicked on cancel in the directory window
+        this->actionRecordMotion->setChecked(false) ;
+}
+
+/**
+ * @brief MainWindow::treat_Button_Record_Raw
+ * @param state: boolean
+ * 
+ * Called when Record raw frames Button is triggered. Starts/stops the recording of the raw frames.
+ */
+void MainWindow::treat_Button_Record_Raw(bool state) {
+    if ( ! this->worker->file_save_raw(state) )
+        // clicked on cancel in the file window
+        this->actionRecordRaw->setChecked(false) ;
+}
+
+/**
+ * @brief MainWindow::treat_Button_Record_Session
+ * @param state: boolean
+ * 
+ * Called when Record a session Button is triggered. Starts/stops the recording of the frames and of the parameter changes.
+ */
+void MainWindow::treat_Button_Record_Session(bool state) {
+    if ( ! this->worker->file_save_session(state) )
+        // clicked on cancel in the file window
+        this->actionRecordSession->setChecked(false) ;
+}
+
+/**
+ * @brief MainWindow::treat_Button_Stream
+ * @param state: boolean
+ * 
+ * Called when Stream Button is triggered. Starts/stops sending the frames to a GStreamer pipeline.
+ */
+void MainWindow::treat_Button_Stream(bool state) {
+    if ( ! this->worker->file_stream(state) )
+        // clicked on cancel in the pipeline window, or the pipeline could not be opened
+        this->actionStream->setChecked(false) ;
+}
+
+/**
+ * @brief MainWindow::treat_Tap_Changed
+ * @param action: QAction chosen in a menu of createTapMenu(), its data is the sink, the tap point and the stage
+ * 
+ * Moves the recorder, the stream or the snapshots to another tap point of the processing
+ */
+void MainWindow::treat_Tap_Changed(QAction *action) {
+    QVariantList tap = action->data().toList();
+    if (tap.size() == 3)
+        this->worker->setTap(tap[0].toInt(), tap[1].toInt(), tap[2].toInt());
+}
+
+/**
+ * @brief MainWindow::treat_Button_Save_Burst
+ * 
+ * Called when Save a burst Button is triggered. Asks the number of frames, then the worker asks the file name.
+ */
+void MainWindow::treat_Button_Save_Burst() {
+    bool ok = false;
+    int count = QInputDialog::getInt(this, tr("Save a burst"), tr("Number of consecutive frames"), 10, 2, 1000, 1, &ok);
+    if (ok)
+        this->worker->file_save_burst(count);
+}
+
 #ifdef withzbar
 /**
  * @brief MainWindow::treat_Button_QRcode
@@ -626,9 +949,27 @@ void MainWindow::treat_Button_Tesseract(bool checked) {
         this->window_tesseract->hide();
 }
 
+/**
+ * @brief MainWindow::treat_Tesseract_get_new_image
+ * @param detectArea: boolean true to detect the areas of text
+ *
+ * The detection is made by the OpenCV thread, see update_tesseract_window()
+ */
 void MainWindow::treat_Tesseract_get_new_image(bool detectArea){
+    this->worker->requestTextAreas(detectArea);
+}
+
+/**
+ * @brief MainWindow::update_tesseract_window
+ * @param detectArea: boolean true if the areas of text have been detected
+ *
+ * Called by a signal from the OpenCV thread
+ * Sets the content of the tesseract Qt window
+ */
+void MainWindow::update_tesseract_window(bool detectArea){
     std::vector<QRect> areas ;
-    QImage new_image = this->worker->detectTextAreas(areas,detectArea) ;
+    QImage new_image;
+    this->worker->getTextAreas(new_image, areas);
     if (detectArea)
         this->window_tesseract->setAreasText(areas);
     this->window_tesseract->showImage(new_image);
@@ -643,45 +984,46 @@ void MainWindow::treat_Tesseract_get_new_image(bool detectArea){
  * Called by a signal from the OpenCV thread
  * Sets the content of the panorama Qt window
  */
-void MainWindow::update_panorama_window(QImage *image) {
-    this->fourthWindow->set_image_content(*image);
+void MainWindow::update_panorama_window(QImage image) {
+    this->fourthWindow->set_image_content(image);
 }
 #endif
 
 /**
  * @brief MainWindow::update_histogram_window
- * @param image: QImage to display on the Qt window
  * 
  * Called by a signal from the OpenCV thread
  * Sets the content of the histogram Qt window
  */
-void MainWindow::update_histogram_window(QImage *image) {
-    if (this->histogram_window_opened)
-        this->secondWindow->set_image_content(*image);
+void MainWindow::update_histogram_window() {
+    QImage image;
+    // Always fetch the image, otherwise the OpenCV thread stops notifying
+    if (this->worker->getHistogramImage(image) && this->histogram_window_opened)
+        this->secondWindow->set_image_content(image);
 }
 
 /**
  * @brief MainWindow::update_objects_window
- * @param image: QImage to display on the Qt window
  * 
  * Called by a signal from the OpenCV thread
  * Sets the content of the object detection Qt window
  */
-void MainWindow::update_objects_window(QImage *image) {
-    if (this->object_detection_window_opened)
-        this->thirdWindow->set_image_content(*image);
+void MainWindow::update_objects_window() {
+    QImage image;
+    if (this->worker->getObjectsImage(image) && this->object_detection_window_opened)
+        this->thirdWindow->set_image_content(image);
 }
 
 /**
  * @brief MainWindow::update_motion_window
- * @param image: QImage to display on the Qt window
  * 
  * Called by a signal from the OpenCV thread
  * Sets the content of the motion detection Qt window
  */
-void MainWindow::update_motion_window(QImage *image) {
-    if (this->motion_detection_window_opened)
-        this->fifthWindow->set_image_content(*image);
+void MainWindow::update_motion_window() {
+    QImage image;
+    if (this->worker->getMotionImage(image) && this->motion_detection_window_opened)
+        this->fifthWindow->set_image_content(image);
 }
 
 #ifdef withzbar
@@ -738,16 +1080,14 @@ void MainWindow::look_for_qrURL(){
 
 /**
  * @brief MainWindow::updateFrame
- * @param image: QImage to display on the main Qt window
  * 
  * Called by a signal from the OpenCV thread
  * Sets the content of main Qt window
  */
-void MainWindow::updateFrame(QImage *image){
-    data_lock->lock();
-    this->myQimage = *image;
-    data_lock->unlock();
-    repaint();
+void MainWindow::updateFrame(){
+    // Fetch the newest frame, the intermediate ones have been dropped by the OpenCV thread
+    if (this->worker->getFrame(this->myQimage))
+        repaint();
 }
 
 /**
@@ -761,6 +1101,18 @@ void MainWindow::updateMainStatusLabel(QString newstring){
     this->mainStatusLabel->setText(newstring);
 }
 
+/**
+ * @brief MainWindow::updateProfile
+ * @param lines: QStringList the durations of the active stages, one stage per line
+ * @param summary: QString the short version shown in the status bar
+ */
+void MainWindow::updateProfile(QStringList lines, QString summary){
+    if (!this->actionProfiling->isChecked())
+        return;
+    this->profile_lines = lines;
+    this->mainStatusBar->showMessage(summary);
+}
+
 /**
  * @brief MainWindow::paintEvent
  * 
@@ -770,6 +1122,20 @@ void MainWindow::updateMainStatusLabel(QString newstring){
 void MainWindow::paintEvent(QPaintEvent* ) {
     QPixmap piximage = QPixmap::fromImage(this->myQimage);
 
+    // Overlay with the durations of the stages
+    if (!this->profile_lines.isEmpty() && !piximage.isNull()) {
+        QPainter painter(&piximage);
+        painter.setFont(QFont("Courier", 10));
+        int line_height = painter.fontMetrics().height();
+        int width = 0;
+        for (int i=0; i<this->profile_lines.size(); i++)
+            width = qMax(width, painter.fontMetrics().boundingRect(this->profile_lines[i]).width());
+        painter.fillRect(5, 5, width+10, line_height*this->profile_lines.size()+10, QColor(0, 0, 0, 160));
+        painter.setPen(Qt::white);
+        for (int i=0; i<this->profile_lines.size(); i++)
+            painter.drawText(10, 10 + line_height*(i+1) - painter.fontMetrics().descent(), this->profile_lines[i]);
+    }
+
     imageScene->clear();
     imageView->resetMatrix();
     imageScene->addPixmap(piximage);
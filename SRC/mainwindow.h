@@ -10,18 +10,19 @@
 #include <QImage>
 #include <QPainter>
 #include <QAction>
+#include <QActionGroup>
 #ifdef withzbar
 #include <QDesktopServices> // to open URL links from QR codes
 #include <QUrl>             // to open URL links from QR codes
 #endif
 #include <QMessageBox>
+#include <QInputDialog> // Number of frames of a burst
 #include <QCameraInfo> // From Qt5
 #include <QMenuBar>
 #include <QGraphicsScene> // To show the content of the camera in the Qt window
 #include <QGraphicsView>  // To show the content of the camera in the Qt window
 #include <QStatusBar>
 
-#include <QMutex>
 #include <QThread>
 
 #include "dialog_choose_camera.h"
@@ -36,6 +37,8 @@
 #endif
 #include "dialog_motion_detection.h"
 #include "dialog_photo.h"
+#include "dialog_tone.h"
+#include "dialog_performance.h"
 #include "secondarywindow.h"
 #ifdef withtesseract
 #include "window_tesseract.h"
@@ -58,9 +61,9 @@ private:
     // For capture thread
     captureVideo *worker;
 //    QThread thread;
-    QMutex *data_lock;
     
     QImage myQimage;
+    QStringList profile_lines; // Durations of the stages, displayed over the image
     
     QMenu *menu_File , *menu_Filters, *menu_Detection, *menu_Transformations, *menu_Operations;
     
@@ -83,6 +86,8 @@ private:
 #endif
     Dialog_Motion_Detection *dialog_motion_detection;
     Dialog_Photo            *dialog_photo;
+    Dialog_Tone             *dialog_tone;
+    Dialog_Performance      *dialog_performance;
     
     SecondaryWindow *secondWindow;
     SecondaryWindow *thirdWindow;
@@ -123,9 +128,21 @@ private:
 #endif
     QAction *actionMotionDetection;
     QAction *actionPhoto;
+    QAction *actionTone;
     QAction *actionRecord;
+    QAction *actionRecordEveryFrame;
+    QAction *actionRecordMotion;
+    QAction *actionRecordRaw;
+    QAction *actionRecordSession;
+    QAction *actionStream;
     QAction *actionSaveImage;
+    QAction *actionSaveBurst;
     QAction *actionChangeCamera;
+    QAction *actionOpenVideoFile;
+    QAction *actionOpenImageDirectory;
+    QAction *actionProfiling;
+    QAction *actionPipeline;
+    QAction *actionPerformance;
 #ifdef withzbar
     QAction *actionQRcode;
 #endif
@@ -133,13 +150,15 @@ private:
     QAction *action_Tesseract;
 #endif
 
-    void update_histogram_window(QImage *image);
-    void update_objects_window(QImage *image);
-    void update_motion_window(QImage *image);
+    void update_histogram_window();
+    void update_objects_window();
+    void update_motion_window();
     void createActions();
     void createToolBars();
+    QMenu* createTapMenu(const QString &title, int sink);
     void createWindows();
     void stopThread();
+    bool launchSource(QString title);
 #ifdef withzbar
     void look_for_qrURL();
 #endif
@@ -151,8 +170,11 @@ protected:
 private slots:
     void launchCamera(int);
     void showCameraSettings();
-    void updateFrame(QImage *image);
+    void openVideoFile();
+    void openImageDirectory();
+    void updateFrame();
     void updateMainStatusLabel(QString);
+    void updateProfile(QStringList lines, QString summary);
 
     void treat_Button_Blur(bool) ;
     void treat_Button_Edge(bool);
@@ -162,11 +184,21 @@ private slots:
     void treat_Button_Object_Detection(bool);
 #ifdef withstitching
     void treat_Button_Panorama(bool);
-    void update_panorama_window(QImage *image);
+    void update_panorama_window(QImage image);
 #endif
     void treat_Button_Motion_Detection(bool);
     void treat_Button_Photo(bool);
+    void treat_Button_Tone(bool);
     void treat_Button_Record(bool);
+    void treat_Button_Record_Every_Frame(bool);
+    void treat_Button_Record_Motion(bool);
+    void treat_Button_Record_Raw(bool);
+    void treat_Button_Record_Session(bool);
+    void treat_Button_Stream(bool);
+    void treat_Tap_Changed(QAction*);
+    void treat_Button_Save_Burst();
+    void treat_Button_Profiling(bool);
+    void treat_Button_Performance(bool);
 #ifdef withzbar
     void treat_Button_QRcode(bool);
 #endif
@@ -174,6 +206,7 @@ private slots:
 #ifdef withtesseract
     void treat_Button_Tesseract(bool);
     void treat_Tesseract_get_new_image(bool);
+    void update_tesseract_window(bool);
 #endif // endif withtesseract
 };
 
@@ -0,0 +1,398 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *  Recording of the events of motion. The frames are compressed in a memory queue that keeps the
+ *  last seconds (pre-roll). A motion larger than the threshold starts an event: the queued frames
+ *  and the following ones are written by a dedicated thread into a new video file, until the motion
+ *  has stopped for some seconds (post-roll). No Qt thing here.
+*/
+
+#include "motionrecorder.h"
+
+#include "opencv2/imgcodecs.hpp"
+#include "opencv2/imgproc.hpp"
+
+#include <cassert>
+#include <ctime>
+#include <iostream>
+
+/**
+ * @brief MotionRecorder::MotionRecorder
+ *
+ * Constructor of the class MotionRecorder. 5 seconds of pre-roll, 10 seconds of post-roll,
+ * an event starts when 1% of the image moves. The thread is launched by start().
+ */
+MotionRecorder::MotionRecorder() : running(false),
+                                   fps(20.),
+                                   preroll(5.),
+                                   postroll(10.),
+                                   threshold(0.01),
+                                   last_motion(0.),
+                                   quality(85),
+                                   max_memory(256*1024*1024),
+                                   memory(0),
+                                   event(0),
+                                   events(0),
+                                   written(0),
+                                   dropped(0)
+{
+}
+
+/**
+ * @brief MotionRecorder::~MotionRecorder
+ *
+ * Finish the current event and stop the thread before destroying the object
+ */
+MotionRecorder::~MotionRecorder() {
+    stop();
+}
+
+/**
+ * @brief MotionRecorder::start
+ * @param directory: string the directory that receives one video file per event
+ * @param fps: double the frame rate written in the files
+ * @return true if the thread has been launched
+ */
+bool MotionRecorder::start(const std::string &directory, double fps) {
+    stop();
+    if (directory.empty())
+        return false;
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->directory = directory;
+        this->fps       = fps > 0. ? fps : 20.;
+        this->frames.clear();
+        this->memory = 0;
+        this->event  = 0;
+        this->events = 0;
+        this->last_filename.clear();
+    }
+    this->written = 0;
+    this->dropped = 0;
+    this->origin  = std::chrono::steady_clock::now();
+    this->running = true;
+    this->thread = std::thread(&MotionRecorder::run, this);
+    return true;
+}
+
+/**
+ * @brief MotionRecorder::stop
+ *
+ * The frames of the current event are written and its file is closed. The pre-roll is lost.
+ */
+void MotionRecorder::stop() {
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->running = false;
+        this->event   = 0;
+    }
+    if (this->thread.joinable())
+        this->thread.join();
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->frames.clear();
+    this->memory = 0;
+}
+
+/**
+ * @brief MotionRecorder::isRunning
+ * @return true if the frames are watched for motion
+ */
+bool MotionRecorder::isRunning() {
+    return this->running;
+}
+
+/**
+ * @brief MotionRecorder::isRecording
+ * @return true if an event of motion is in progress
+ */
+bool MotionRecorder::isRecording() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->event != 0;
+}
+
+/**
+ * @brief MotionRecorder::push
+ * @param frame: cv::Mat the new frame, compressed into the queue
+ * @param motion_area: double the part of the frame in motion, between 0 and 1 (see MyImage::get_motion_area())
+ * @return true if the frame starts a new event
+ *
+ * Called by the processing thread only
+ */
+bool MotionRecorder::push(const cv::Mat &frame, double motion_area) {
+    if (!this->running || frame.empty())
+        return false;
+    double now = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->origin).count();
+
+    // The compression is done outside of the lock, the writing thread is not held up
+    std::vector<int> params;
+    params.push_back(cv::IMWRITE_JPEG_QUALITY);
+    params.push_back(this->quality);
+    std::vector<uchar> data;
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        data.swap(this->encoded);
+    }
+    if (!cv::imencode(".jpg", frame, data, params))
+        return false;
+
+    std::lock_guard<std::mutex> guard(this->lock);
+    if (!this->running)
+        return false;
+    bool started = false;
+    if (this->event == 0 && motion_area >= this->threshold) {
+        // New event: the pre-roll becomes its beginning
+        this->event = ++this->events;
+        for (size_t i=0; i<this->frames.size(); i++)
+            if (this->frames[i].event == 0)
+                this->frames[i].event = this->event;
+        started = true;
+    }
+    if (this->event != 0) {
+        if (motion_area >= this->threshold)
+            this->last_motion = now;
+        else if (now - this->last_motion > this->postroll)
+            this->event = 0; // End of the event, the frame goes to the next pre-roll
+    }
+
+    this->frames.push_back(EncodedFrame());
+    EncodedFrame &added = this->frames.back();
+    added.data.swap(data);
+    added.time  = now;
+    added.event = this->event;
+    this->memory += added.data.size();
+
+    // Keep only the last seconds that are not part of an event, and stay under the memory limit.
+    // The frames of an event are at the front of the queue until they are written.
+    while (!this->frames.empty() && this->frames.front().event == 0 && now - this->frames.front().time > this->preroll)
+        discard_front();
+    while (this->memory > this->max_memory && this->frames.size() > 1) {
+        if (this->frames.front().event != 0)
+            this->dropped++;
+        discard_front();
+    }
+    return started;
+}
+
+/**
+ * @brief MotionRecorder::set_preroll
+ * @param seconds: double the duration recorded before the motion starts
+ */
+void MotionRecorder::set_preroll(double seconds) {
+    assert(seconds>=0.);
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->preroll = seconds > 0. ? seconds : 0.;
+}
+
+/**
+ * @brief MotionRecorder::get_preroll
+ * @return the duration recorded before the motion starts, in seconds
+ */
+double MotionRecorder::get_preroll() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->preroll;
+}
+
+/**
+ * @brief MotionRecorder::set_postroll
+ * @param seconds: double the duration recorded after the motion has stopped
+ */
+void MotionRecorder::set_postroll(double seconds) {
+    assert(seconds>=0.);
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->postroll = seconds > 0. ? seconds : 0.;
+}
+
+/**
+ * @brief MotionRecorder::get_postroll
+ * @return the duration recorded after the motion has stopped, in seconds
+ */
+double MotionRecorder::get_postroll() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->postroll;
+}
+
+/**
+ * @brief MotionRecorder::set_threshold
+ * @param area: double the part of the image in motion that starts an event, between 0 and 1
+ */
+void MotionRecorder::set_threshold(double area) {
+    assert(area>=0. && area<=1.);
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->threshold = area;
+}
+
+/**
+ * @brief MotionRecorder::get_threshold
+ * @return the part of the image in motion that starts an event
+ */
+double MotionRecorder::get_threshold() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->threshold;
+}
+
+/**
+ * @brief MotionRecorder::set_quality
+ * @param quality: integer the JPEG quality of the frames kept in memory [0,100]
+ */
+void MotionRecorder::set_quality(int quality) {
+    assert(quality>=0 && quality<=100);
+    this->quality = quality;
+}
+
+/**
+ * @brief MotionRecorder::set_max_memory
+ * @param bytes: size_t the maximum size of the compressed frames waiting in memory
+ */
+void MotionRecorder::set_max_memory(size_t bytes) {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->max_memory = bytes;
+}
+
+/**
+ * @brief MotionRecorder::get_events
+ * @return the number of events of motion since start()
+ */
+unsigned long long MotionRecorder::get_events() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->events;
+}
+
+/**
+ * @brief MotionRecorder::get_written_frames
+ * @return the number of frames written in the files since start()
+ */
+unsigned long long MotionRecorder::get_written_frames() {
+    return this->written;
+}
+
+/**
+ * @brief MotionRecorder::get_dropped_frames
+ * @return the number of frames of events lost because the memory limit was reached
+ */
+unsigned long long MotionRecorder::get_dropped_frames() {
+    return this->dropped;
+}
+
+/**
+ * @brief MotionRecorder::get_buffered_frames
+ * @return the number of compressed frames in memory
+ */
+int MotionRecorder::get_buffered_frames() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return (int) this->frames.size();
+}
+
+/**
+ * @brief MotionRecorder::get_memory
+ * @return the size of the compressed frames in memory, in bytes
+ */
+size_t MotionRecorder::get_memory() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->memory;
+}
+
+/**
+ * @brief MotionRecorder::get_last_filename
+ * @return the file of the last event, empty if there was none
+ */
+std::string MotionRecorder::get_last_filename() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->last_filename;
+}
+
+/**
+ * @brief MotionRecorder::discard_front
+ *
+ * Remove the oldest frame of the queue, its buffer is kept for the next compression. Called under the lock.
+ */
+void MotionRecorder::discard_front() {
+    this->memory -= this->frames.front().data.size();
+    if (this->frames.front().data.capacity() > this->encoded.capacity())
+        this->encoded.swap(this->frames.front().data);
+    this->frames.pop_front();
+}
+
+/**
+ * @brief MotionRecorder::create_filename
+ * @param event: integer the number of the event
+ * @return the name of the video file of the event: motion_<date>_<time>_<event>.avi
+ */
+std::string MotionRecorder::create_filename(unsigned long long event) {
+    char stamp[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", std::localtime(&now));
+    return this->directory + "/motion_" + stamp + "_" + std::to_string(event) + ".avi";
+}
+
+/**
+ * @brief MotionRecorder::run
+ *
+ * Loop of the thread: write the frames of the events, one file per event, until stop() is called
+ * and the current event is written
+ */
+void MotionRecorder::run() {
+    cv::VideoWriter writer;
+    cv::Size size;
+    unsigned long long file_event = 0;
+    EncodedFrame current;
+    cv::Mat image, resized;
+
+    while (true) {
+        bool active = this->running;
+        bool available = false, finished = false;
+        double fps = 20.;
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            if (!this->frames.empty() && this->frames.front().event != 0) {
+                current.data.swap(this->frames.front().data);
+                current.event = this->frames.front().event;
+                this->memory -= current.data.size();
+                this->frames.pop_front();
+                available = true;
+                if (current.event != file_event)
+                    this->last_filename = create_filename(current.event);
+            }
+            else {
+                // The frames of an event are contiguous: the event is over when the next frame is not part
+                // of it and the processing thread has closed it
+                finished = file_event != 0 && this->event != file_event;
+            }
+            fps = this->fps;
+        }
+
+        if (available) {
+            image = cv::imdecode(current.data, cv::IMREAD_COLOR);
+            if (image.empty())
+                continue;
+            if (current.event != file_event) {
+                // New event, new file
+                writer.release();
+                file_event = current.event;
+                size = image.size();
+                std::string filename = get_last_filename();
+                if (!writer.open(filename, cv::VideoWriter::fourcc('X','V','I','D'), fps, size, true))
+                    std::cerr << "MotionRecorder::run(): Cannot create the video " << filename << std::endl;
+            }
+            if (writer.isOpened()) {
+                if (image.size() != size) {
+                    cv::resize(image, resized, size);
+                    writer.write(resized);
+                }
+                else {
+                    writer.write(image);
+                }
+                this->written++;
+            }
+            continue;
+        }
+        if (finished) {
+            writer.release();
+            file_event = 0;
+        }
+        if (!active)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    writer.release();
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef MOTIONRECORDER_H
+#define MOTIONRECORDER_H
+
+#include "opencv2/core.hpp"
+#include "opencv2/videoio.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief The MotionRecorder class
+ *
+ * Records only the events of motion, one video file per event. The last seconds of frames are kept
+ * compressed (JPEG) in memory. When the part of the image in motion exceeds a threshold, they are
+ * written with the following frames, until some seconds after the motion has stopped.
+ * The frames are pushed by the processing thread and written by a dedicated thread.
+ */
+class MotionRecorder
+{
+public:
+    MotionRecorder();
+    ~MotionRecorder();
+
+    bool start(const std::string &directory, double fps);
+    void stop();
+    bool isRunning();
+    bool isRecording();
+    bool push(const cv::Mat &frame, double motion_area);
+
+    void set_preroll(double seconds);
+    double get_preroll();
+    void set_postroll(double seconds);
+    double get_postroll();
+    void set_threshold(double area);
+    double get_threshold();
+    void set_quality(int quality);
+    void set_max_memory(size_t bytes);
+
+    unsigned long long get_events();
+    unsigned long long get_written_frames();
+    unsigned long long get_dropped_frames();
+    int get_buffered_frames();
+    size_t get_memory();
+    std::string get_last_filename();
+
+private:
+    struct EncodedFrame {
+        std::vector<uchar> data;    // JPEG
+        double time;                // seconds since start()
+        unsigned long long event;   // 0 as long as the frame only belongs to the pre-roll
+    };
+
+    std::deque<EncodedFrame> frames;
+    std::vector<uchar> encoded;     // buffer of the compression, recycled from the discarded frames
+    std::mutex lock;
+    std::thread thread;
+    std::atomic<bool> running;
+    std::string directory, last_filename;
+    double fps, preroll, postroll, threshold, last_motion;
+    int quality;
+    size_t max_memory, memory;
+    unsigned long long event, events;
+    std::atomic<unsigned long long> written, dropped;
+    std::chrono::steady_clock::time_point origin;
+
+    void run();
+    void discard_front();
+    std::string create_filename(unsigned long long event);
+};
+
+#endif // MOTIONRECORDER_H
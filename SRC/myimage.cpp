@@ -9,12 +9,23 @@
 
 #include "myimage.h"
 
+/**
+ * @brief MyImage::get_stage_names
+ * @return the names of the stages, in the order of the enum MyImage::Stage
+ */
+std::vector<std::string> MyImage::get_stage_names() {
+    const char* names[MyImage::NB_STAGES] = { "face", "bw", "photo", "tone", "inverse", "histeq", "edge", "blur",
+                                              "threshold", "transform", "qrcode",
+                                              "objects", "motion", "histogram", "pipeline" };
+    return std::vector<std::string>(names, names + MyImage::NB_STAGES);
+}
+
 /**
  * @brief MyImage::MyImage
  * 
  * Constructor of the class MyImage. Initialization of all the parameters to default values.
  */
-MyImage::MyImage()
+MyImage::MyImage() : profiler(get_stage_names())
 {
     // Initializations for all the image operations
 #ifdef withobjdetect
@@ -65,11 +76,42 @@ MyImage::MyImage()
     this->motion_detected              = false;
     this->motion_detection_method      = 1;
     this->motion_background_first_time = true;
+    this->motion_area                  = 0.;
+    this->draw_motion_boxes            = true;
     
     this->photoed      = false;
     this->photo_method = 1;
     this->photo_sigmar = 0.15;
     this->photo_sigmas = 50;
+
+    this->toned           = false;
+    this->tone_brightness = 0;
+    this->tone_contrast   = 1.;
+    this->tone_gamma      = 1.;
+
+    this->stage_mask = ~0u; // all the stages
+
+    // Fixed order of the stages, the decoded QR codes are read even if the image is not
+    this->graph.set_side_effect(STAGE_QRCODE, true);
+    this->custom_graph = false;
+    this->plan_valid   = false;
+    this->plan_stages  = 0;
+    this->plan_mask    = 0;
+    this->buffers.resize(1);
+    this->lut_chain   = 0;
+    this->lut_pending = false;
+    this->lut_stage   = STAGE_INVERSE;
+    this->strip_execution = true;
+    this->processing_scale = 1.;
+    this->fast_variants    = false;
+    this->analysis_width   = 0;
+    this->strip_pending   = false;
+    this->strip_stage     = STAGE_BLUR;
+    this->chain_output    = 0;
+    this->tap_stages      = 0;
+    this->tapped_stages   = 0;
+    this->stage_taps.resize(NB_STAGES);
+    this->tap_pool        = nullptr;
 }
 
 /**
@@ -220,6 +262,16 @@ void MyImage::togglePhoto(bool state) {
     this->photoed = state;
 }
 
+/**
+ * @brief MyImage::toggleTone
+ * @param state boolean the new state of the filter
+ * 
+ * Toggles the brightness/contrast/gamma correction
+ */
+void MyImage::toggleTone(bool state) {
+    this->toned = state;
+}
+
 #ifdef withzbar
 /**
  * @brief MyImage::toggleQRcode
@@ -240,17 +292,97 @@ void MyImage::toggleQRcode(bool state){
  * @brief MyImage::set_image_content
  * @param content: Mat received from the camera
  * 
- * Receives a new image from the camera and applies algorithms on it, depending on the activated modules
+ * Receives a new image from the camera and applies algorithms on it, depending on the activated modules.
+ * The stages are executed in the order of the compiled plan (see update_plan()).
  */
 void MyImage::set_image_content(cv::Mat &content) {
+    this->profiler.next_frame();
+    ScopedStageTimer timer_pipeline(this->profiler, STAGE_PIPELINE);
+    // The new frame may be received in the buffer of the previous one
+    this->products.invalidate();
+
     // Save the old image for motion detection
     if (this->motion_detected)
         this->previmage = this->image;
 
-    this->image = content;
+    // Gray stages (black and white, threshold, ...) leave a single channel image, the following
+    // stages work on it as is and it is expanded to 3 channels only when a stage needs colours
+    update_plan();
+    const std::vector<PlanStep> &plan = this->graph.get_plan();
+
+    // Reduced resolution (see set_processing_scale()): the stages work on a smaller copy of the frame
+    cv::Mat frame = content;
+    bool scaled = this->processing_scale < 1. && !plan.empty() && !content.empty();
+    if (scaled) {
+        cv::Size size(std::max(1, (int) std::lround(content.cols*this->processing_scale)),
+                      std::max(1, (int) std::lround(content.rows*this->processing_scale)));
+        frame = this->scratch.acquire(size, content.type());
+        cv::resize(content, frame, size, 0, 0, cv::INTER_AREA);
+    }
+    this->input = frame;
+    this->buffers[0] = frame;
+    this->tapped_stages = 0;
+
+    this->lut_chain = 0;
+    for (size_t i=0; i<plan.size(); i++) {
+        const PlanStep &step = plan[i];
+        // A chain of point operations or of filters goes on as long as the steps work on the same image
+        bool chained = (this->lut_pending || this->strip_pending) && step.input == this->chain_output &&
+                       !step.copy_input;
+        if (!chained) {
+            flush_point_operations();
+            flush_strips();
+            this->image = this->buffers[step.input];
+            if (step.copy_input) {
+                cv::Mat copy = this->scratch.acquire(this->image.size(), this->image.type());
+                this->image.copyTo(copy);
+                this->image = copy;
+            }
+        }
+        if (add_strip_operation(step.stage) || fold_point_operation(step.stage)) {
+            this->chain_output = step.output;
+        }
+        else {
+            flush_point_operations();
+            flush_strips();
+            run_stage(step.stage);
+        }
+        this->buffers[step.output] = this->image;
+        // A tapped stage ends the chain it belongs to: its result must exist on its own
+        if (this->tap_stages & stage_bit(step.stage)) {
+            flush_point_operations();
+            flush_strips();
+            // The only copy of the stage: straight into a buffer of the pool, frozen by the caller
+            if (this->tap_pool != nullptr)
+                this->stage_taps[step.stage] = this->tap_pool->acquire(this->image.size(), this->image.type());
+            this->image.copyTo(this->stage_taps[step.stage]);
+            this->tapped_stages |= stage_bit(step.stage);
+        }
+    }
+    flush_point_operations();
+    flush_strips();
+    this->image = this->buffers[0];
+    
+    // Export a 3 channel image, the side outputs and the GUI work in colours
+    toColour();
+    if (scaled) {
+        // Back to the resolution of the camera, in the buffer of the frame: the buffers of the pool
+        // are never exported
+        cv::resize(this->image, content, content.size(), 0, 0, cv::INTER_LINEAR);
+        this->image = content;
+    }
+    this->image2export = this->image;
+}
 
+/**
+ * @brief MyImage::run_stage
+ * @param stage: integer the stage to apply on this->image
+ */
+void MyImage::run_stage(int stage) {
+    ScopedStageTimer timer(this->profiler, stage);
+    switch (stage) {
 #ifdef withobjdetect
-    if (this->face_recon) {
+    case STAGE_FACE:
         // Look for faces before any operation
         detect_faces() ;
 
@@ -263,39 +395,252 @@ void MyImage::set_image_content(cv::Mat &content) {
                     cv::resize(this->background, this->background, this->image.size(), 0, 0, cv::INTER_CUBIC);
         
         this->background.copyTo(this->image, this->mask);
-    }
+        break;
 #endif
-
-    if (!(this->coloured))
+    case STAGE_BW:
         toBlackandWhite();
-    
-    if (this->photoed)
+        break;
+    case STAGE_PHOTO:
         modulephoto();
-    
-    if (this->inversed)
+        break;
+    case STAGE_TONE:
+        toneImage();
+        break;
+    case STAGE_INVERSE:
         inverseImage();
-
-    if (this->histo_eq)
+        break;
+    case STAGE_HISTO_EQ:
         equalizeHistogram();
-
-    if (this->edge_detect)
+        break;
+    case STAGE_EDGE:
         detectEdges();
-
-    if (this->blurred)
+        break;
+    case STAGE_BLUR:
         smoothImage(this->image, this->blur_range, this->blur_method);
-
-    if (this->thresholded)
+        break;
+    case STAGE_THRESHOLD:
         thresholdImage();
-
-    if (this->transformed)
+        break;
+    case STAGE_TRANSFORM:
         transformImage();
-    
+        break;
 #ifdef withzbar
-    if (this->qrcodeactivated)
+    case STAGE_QRCODE:
         getQRcode();
+        break;
 #endif
-    
-    this->image2export = this->image;
+    default:
+        std::cerr << "MyImage::run_stage(): Stage "<<stage<<" cannot be applied on the image"<<std::endl ;
+        break;
+    }
+    // The stages modify the image in place
+    this->products.invalidate();
+}
+
+/**
+ * @brief MyImage::active_stages
+ * @return the stages of set_image_content() activated by the toggles (bits 1<<Stage)
+ */
+unsigned int MyImage::active_stages() {
+    unsigned int stages = 0;
+#ifdef withobjdetect
+    if (this->face_recon)   stages |= stage_bit(STAGE_FACE);
+#endif
+    if (!(this->coloured))  stages |= stage_bit(STAGE_BW);
+    if (this->photoed)      stages |= stage_bit(STAGE_PHOTO);
+    if (this->toned)        stages |= stage_bit(STAGE_TONE);
+    if (this->inversed)     stages |= stage_bit(STAGE_INVERSE);
+    if (this->histo_eq)     stages |= stage_bit(STAGE_HISTO_EQ);
+    if (this->edge_detect)  stages |= stage_bit(STAGE_EDGE);
+    if (this->blurred)      stages |= stage_bit(STAGE_BLUR);
+    if (this->thresholded)  stages |= stage_bit(STAGE_THRESHOLD);
+    if (this->transformed)  stages |= stage_bit(STAGE_TRANSFORM);
+#ifdef withzbar
+    if (this->qrcodeactivated) stages |= stage_bit(STAGE_QRCODE);
+#endif
+    return stages;
+}
+
+/**
+ * @brief MyImage::update_plan
+ *
+ * Compiles the processing graph again if the configuration has changed since the last frame.
+ * Without a user graph, the graph is the fixed order face -> BW -> photo -> tone -> inverse -> histogram
+ * equalization -> edges -> blur -> threshold -> transformation -> QR codes of the activated stages.
+ */
+void MyImage::update_plan() {
+    unsigned int stages = this->custom_graph ? 0u : active_stages();
+    if (this->plan_valid && stages == this->plan_stages && this->stage_mask == this->plan_mask)
+        return;
+
+    if (!this->custom_graph) {
+        this->graph.clear();
+        for (int stage=STAGE_FACE; stage<=STAGE_QRCODE; stage++)
+            if (stages & stage_bit(stage))
+                this->graph.add_node(stage);
+    }
+    if (!this->graph.compile(this->stage_mask))
+        std::cerr << "MyImage::update_plan(): " << this->graph.get_error() << std::endl;
+    this->buffers.resize(this->graph.get_number_buffers());
+    this->plan_valid  = true;
+    this->plan_stages = stages;
+    this->plan_mask   = this->stage_mask;
+}
+
+/**
+ * @brief MyImage::fold_point_operation
+ * @param stage: integer the stage to apply on this->image
+ * @return true if the stage has been added to the current lookup table instead of being applied
+ *
+ * Point operations: tone, inversion, the global thresholds (methods 1-5) and the global
+ * histogram equalization of a black and white image. The table is applied by flush_point_operations().
+ */
+bool MyImage::fold_point_operation(int stage) {
+    // A pending chain of filters has not produced its image yet
+    int channels = this->strip_pending ? CV_MAT_CN(this->strips.get_output_type()) : this->image.channels();
+    bool point = stage == STAGE_TONE || stage == STAGE_INVERSE ||
+                 (stage == STAGE_THRESHOLD && this->threshold_method >= 1 && this->threshold_method <= 5) ||
+                 (stage == STAGE_HISTO_EQ && this->histo_eq_method == 1 && channels == 1);
+    if (!point)
+        return false;
+
+    if (stage == STAGE_THRESHOLD && this->image.channels() != 1) {
+        // The thresholds work on the gray levels: apply the table so far, then convert
+        flush_point_operations();
+    }
+    // A pending chain is timed by its own flush, not counted again in this stage
+    if (!this->lut_pending)
+        flush_strips();
+    ScopedStageTimer timer(this->profiler, stage);
+    if (!this->lut_pending) {
+        if (this->luts.size() <= this->lut_chain)
+            this->luts.resize(this->lut_chain + 1);
+        this->luts[this->lut_chain].begin();
+        this->lut_pending = true;
+    }
+    LutCompositor &lut = this->luts[this->lut_chain];
+    switch (stage) {
+    case STAGE_TONE:
+        lut.add_tone(this->tone_brightness, this->tone_contrast, this->tone_gamma);
+        break;
+    case STAGE_INVERSE:
+        lut.add_inverse();
+        break;
+    case STAGE_THRESHOLD:
+        if (this->image.channels() != 1) {
+            cv::Mat gray = this->scratch.acquire(this->image.size(), CV_8UC1);
+            cv::cvtColor(this->image,gray,cv::COLOR_BGR2GRAY);
+            this->image = gray;
+        }
+        lut.add_threshold(this->threshold_method - 1, this->threshold_value);
+        break;
+    case STAGE_HISTO_EQ:
+        // this->image is still the input of the chain
+        lut.add_equalization(this->image);
+        break;
+    }
+    this->lut_stage = stage;
+    return true;
+}
+
+/**
+ * @brief MyImage::flush_point_operations
+ *
+ * Applies the lookup table of the pending point operations on this->image, in one pass.
+ * The duration is counted in the last stage of the chain.
+ */
+void MyImage::flush_point_operations() {
+    if (!this->lut_pending)
+        return;
+    ScopedStageTimer timer(this->profiler, this->lut_stage);
+    this->luts[this->lut_chain].apply(this->image);
+    this->products.invalidate();
+    this->buffers[this->chain_output] = this->image;
+    this->lut_pending = false;
+    this->lut_chain++;
+}
+
+/**
+ * @brief MyImage::add_strip_operation
+ * @param stage: integer the stage to apply on this->image
+ * @return true if the stage has been added to the chain of filters executed by bands
+ *
+ * Neighbourhood filters: box and Gaussian blurs, Sobel and Laplacian edges, adaptive thresholds.
+ * The global thresholds (methods 1-5) join a chain already started, otherwise they are folded in
+ * a lookup table. The chain is executed by flush_strips().
+ */
+bool MyImage::add_strip_operation(int stage) {
+    if (!this->strip_execution)
+        return false;
+    bool filter = (stage == STAGE_BLUR && (this->blur_method == 1 ||
+                                           (this->blur_method == 2 && this->blur_range % 2 == 1))) ||
+                  (stage == STAGE_EDGE && (this->edge_method == 1 || this->edge_method == 2)) ||
+                  (stage == STAGE_THRESHOLD && (this->threshold_method == 8 || this->threshold_method == 9) &&
+                   this->threshold_blocksize > 1 && this->threshold_blocksize % 2 == 1) ||
+                  (stage == STAGE_THRESHOLD && this->strip_pending &&
+                   this->threshold_method >= 1 && this->threshold_method <= 5);
+    if (!filter || this->image.depth() != CV_8U)
+        return false;
+
+    // A pending chain is timed by its own flush, not counted again in this stage
+    if (!this->strip_pending)
+        flush_point_operations();
+    ScopedStageTimer timer(this->profiler, stage);
+    if (!this->strip_pending) {
+        this->strips.begin(this->image.type());
+        this->strip_pending = true;
+    }
+    bool colour = CV_MAT_CN(this->strips.get_output_type()) == 3;
+    switch (stage) {
+    case STAGE_BLUR:
+        if (this->blur_method == 1)
+            this->strips.add_box(this->blur_range);
+        else
+            this->strips.add_gaussian(this->blur_range);
+        break;
+    case STAGE_EDGE:
+        // Same operations as detectEdges()
+        if (colour)
+            this->strips.add_gray(cv::COLOR_BGR2GRAY);
+        this->strips.add_gaussian(3);
+        if (this->edge_method == 1)
+            this->strips.add_sobel();
+        else
+            this->strips.add_laplacian();
+        break;
+    case STAGE_THRESHOLD:
+        // Same operations as thresholdImage()
+        if (colour)
+            this->strips.add_gray(cv::COLOR_BGR2GRAY);
+        if (this->threshold_method <= 5)
+            this->strips.add_threshold(this->threshold_method - 1, this->threshold_value);
+        else
+            this->strips.add_adaptive_threshold(this->threshold_method == 8 ? cv::ADAPTIVE_THRESH_MEAN_C :
+                                                                              cv::ADAPTIVE_THRESH_GAUSSIAN_C,
+                                                this->threshold_type == 1 ? cv::THRESH_BINARY : cv::THRESH_BINARY_INV,
+                                                this->threshold_blocksize);
+        break;
+    }
+    this->strip_stage = stage;
+    return true;
+}
+
+/**
+ * @brief MyImage::flush_strips
+ *
+ * Executes the pending chain of filters on this->image, band after band.
+ * The duration is counted in the last stage of the chain.
+ */
+void MyImage::flush_strips() {
+    if (!this->strip_pending)
+        return;
+    ScopedStageTimer timer(this->profiler, this->strip_stage);
+    cv::Mat result = this->scratch.acquire(this->image.size(), this->strips.get_output_type());
+    this->strips.apply(this->image, result);
+    this->image = result;
+    this->products.invalidate();
+    this->buffers[this->chain_output] = this->image;
+    this->strip_pending = false;
 }
 
 /**
@@ -491,6 +836,33 @@ void MyImage::set_photo_sigmar(double value){
     this->photo_sigmar = value;
 }
 
+/**
+ * @brief MyImage::set_tone_brightness
+ * @param value: integer the brightness added to the values [-255,255]
+ */
+void MyImage::set_tone_brightness(int value){
+    assert(value>=-255 && value<=255);
+    this->tone_brightness = value;
+}
+
+/**
+ * @brief MyImage::set_tone_contrast
+ * @param value: double the contrast gain, 1 leaves the image unchanged
+ */
+void MyImage::set_tone_contrast(double value){
+    assert(value>=0.);
+    this->tone_contrast = value;
+}
+
+/**
+ * @brief MyImage::set_tone_gamma
+ * @param value: double the gamma correction, 1 leaves the image unchanged
+ */
+void MyImage::set_tone_gamma(double value){
+    assert(value>0.);
+    this->tone_gamma = value;
+}
+
 /**
  * @brief MyImage::get_image_content
  * @return The cv::Mat containing the processed image
@@ -504,25 +876,25 @@ cv::Mat& MyImage::get_image_content() {
  * @return The cv::Mat containing the histogram of the processed image
  */
 cv::Mat& MyImage::get_image_histogram() {
-    std::vector<cv::Mat> bgr_planes;
-    cv::split( this->image, bgr_planes ); // split the BGR content of the image into different layers
-
+    ScopedStageTimer timer(this->profiler, STAGE_HISTOGRAM);
     int histSize = 256; // max size for the range [0-255]
-    float range[] = { 0, 256 } ;
-    const float* histRange = { range };
-    bool uniform = true; bool accumulate = false;
 
-    cv::Mat b_hist, g_hist, r_hist;
-    // Get the histogram for each of the BGR content
-    cv::calcHist( &bgr_planes[0], 1, 0, cv::Mat(), b_hist, 1, &histSize, &histRange, uniform, accumulate );
-    cv::calcHist( &bgr_planes[1], 1, 0, cv::Mat(), g_hist, 1, &histSize, &histRange, uniform, accumulate );
-    cv::calcHist( &bgr_planes[2], 1, 0, cv::Mat(), r_hist, 1, &histSize, &histRange, uniform, accumulate );
+    // Histogram of each of the BGR channels, shared with the other operators of the frame
+    FrameProducts &products = frame_products();
+    int channels = this->image.channels();
+    cv::Mat b_hist = this->scratch.acquire(cv::Size(1, histSize), CV_32FC1);
+    cv::Mat g_hist = this->scratch.acquire(cv::Size(1, histSize), CV_32FC1);
+    cv::Mat r_hist = this->scratch.acquire(cv::Size(1, histSize), CV_32FC1);
+    products.histogram(0).copyTo(b_hist);
+    products.histogram(std::min(1, channels-1)).copyTo(g_hist);
+    products.histogram(std::min(2, channels-1)).copyTo(r_hist);
 
     // Draw the histograms for B, G and R
     int hist_w = 512; int hist_h = 400;
     int bin_w = cvRound( (double) hist_w/histSize );
 
-    this->histogram = cv::Mat( hist_h, hist_w, CV_8UC3, cv::Scalar( 0,0,0) );
+    this->scratch.prepare(this->histogram, cv::Size(hist_w, hist_h), CV_8UC3);
+    this->histogram.setTo(cv::Scalar( 0,0,0));
 
     cv::normalize(b_hist, b_hist, 0, this->histogram.rows, cv::NORM_MINMAX, -1, cv::Mat() );
     cv::normalize(g_hist, g_hist, 0, this->histogram.rows, cv::NORM_MINMAX, -1, cv::Mat() );
@@ -560,38 +932,52 @@ cv::Mat& MyImage::get_image_panorama() {
  * @return The cv::Mat containing the detected objects (lines, circles, points)
  */
 cv::Mat& MyImage::get_object_detected() {
-    this->objects = cv::Mat::zeros( this->image.size(), CV_8UC3 );
-    cv::Mat objectsBW = cv::Mat::zeros( this->image.size(), CV_8UC1 );
+    ScopedStageTimer timer(this->profiler, STAGE_OBJECTS);
+    // Every method overwrites the whole content of objectsBW and of this->objects
+    this->scratch.prepare(this->objects, this->image.size(), CV_8UC3);
+    cv::Mat objectsBW = this->scratch.acquire(this->image.size(), CV_8UC1);
 
     switch (this->object_detection_method) {
         case 1: { // Hough line transform
-            cv::Canny(this->image, objectsBW, 50, 200, 3);
+            // The votes of a line are proportional to its length: the threshold follows the resolution
+            const cv::Mat &analyzed = analysis_image();
+            cv::Point2d scale = analysis_scale(analyzed);
+            cv::Mat edges = analyzed.size() == objectsBW.size() ? objectsBW
+                                                                : this->scratch.acquire(analyzed.size(), CV_8UC1);
+            cv::Canny(analyzed, edges, 50, 200, 3);
+            if (edges.data != objectsBW.data)
+                cv::resize(edges, objectsBW, objectsBW.size(), 0, 0, cv::INTER_NEAREST);
             cv::cvtColor(objectsBW, this->objects, cv::COLOR_GRAY2BGR);
             std::vector<cv::Vec2f> lines;
-            cv::HoughLines(objectsBW, lines, 1, CV_PI/180, this->hough_line_threshold, 0, 0 );
+            cv::HoughLines(edges, lines, 1, CV_PI/180, std::max(1, cvRound(this->hough_line_threshold/scale.x)), 0, 0 );
             for( size_t i = 0; i < lines.size(); i++ )
             {
                 float rho = lines[i][0], theta = lines[i][1];
-                cv::Point pt1, pt2;
+                cv::Point2f pt1, pt2;
                 double a = cos(theta), b = sin(theta);
                 double x0 = a*rho, y0 = b*rho;
                 pt1.x = cvRound(x0 + 1000*(-b));
                 pt1.y = cvRound(y0 + 1000*(a));
                 pt2.x = cvRound(x0 - 1000*(-b));
                 pt2.y = cvRound(y0 - 1000*(a));
-                cv::line( this->objects, pt1, pt2, cv::Scalar(255,0,0), 3, cv::LINE_AA);
+                cv::line( this->objects, to_full_resolution(pt1, scale), to_full_resolution(pt2, scale),
+                          cv::Scalar(255,0,0), 3, cv::LINE_AA);
             }
             break;
         }
         case 2: { // Hough circle transform
-            cv::cvtColor(this->image, objectsBW, cv::COLOR_RGB2GRAY);
-            cv::cvtColor(objectsBW, this->objects, cv::COLOR_GRAY2BGR);
-            cv::GaussianBlur(objectsBW, objectsBW, cv::Size(9, 9), 2, 2 );
+            const cv::Mat &analyzed = analysis_gray();
+            cv::Point2d scale = analysis_scale(analyzed);
+            cv::cvtColor(frame_products().gray(), this->objects, cv::COLOR_GRAY2BGR);
+            cv::Mat blurred = analyzed.size() == objectsBW.size() ? objectsBW
+                                                                  : this->scratch.acquire(analyzed.size(), CV_8UC1);
+            cv::GaussianBlur(analyzed, blurred, cv::Size(9, 9), 2, 2 );
             std::vector<cv::Vec3f> circles;
-            cv::HoughCircles(objectsBW, circles, cv::HOUGH_GRADIENT, 1, 10, 100, this->hough_line_threshold, 5);
+            cv::HoughCircles(blurred, circles, cv::HOUGH_GRADIENT, 1, 10/scale.x, 100,
+                             std::max(1, cvRound(this->hough_line_threshold/scale.x)), std::max(1, cvRound(5/scale.x)));
             for(size_t i = 0; i < circles.size(); i++) {
-                cv::Point center(cvRound(circles[i][0]), cvRound(circles[i][1]));
-                int radius = cvRound(circles[i][2]);
+                cv::Point center = to_full_resolution(cv::Point2f(circles[i][0], circles[i][1]), scale);
+                int radius = cvRound(circles[i][2]*scale.x);
                 // draw the circle center
                 cv::circle(this->objects, center, 3, cv::Scalar(0, 255, 0), -1);
                 // draw the circle outline
@@ -603,20 +989,22 @@ cv::Mat& MyImage::get_object_detected() {
             int blockSize = 2;
             int apertureSize = 3;
             double k = 0.04;
-            cv::Mat dst = cv::Mat::zeros( this->image.size(), CV_32FC1 );
+            const cv::Mat &analyzed = analysis_gray();
+            cv::Point2d scale = analysis_scale(analyzed);
+            cv::Mat dst = this->scratch.acquire(analyzed.size(), CV_32FC1);
 
-            cv::cvtColor(this->image, objectsBW, cv::COLOR_RGB2GRAY);
-            cv::cvtColor(objectsBW, this->objects, cv::COLOR_GRAY2BGR);
-            cv::cornerHarris( objectsBW, dst, blockSize, apertureSize, k, cv::BORDER_DEFAULT );
+            cv::cvtColor(frame_products().gray(), this->objects, cv::COLOR_GRAY2BGR);
+            cv::cornerHarris( analyzed, dst, blockSize, apertureSize, k, cv::BORDER_DEFAULT );
             cv::normalize( dst, dst, 0, 255, cv::NORM_MINMAX, CV_32FC1, cv::Mat() );
 
             for( int j = 0; j < dst.rows ; j++ )
                 for( int i = 0; i < dst.cols; i++ )
                     if( (int) dst.at<float>(j,i) > this->hough_line_threshold )
-                        cv::circle( this->objects, cv::Point( i, j ), 5,  cv::Scalar(255, 0, 0), 2, 8, 0 );
+                        cv::circle( this->objects, to_full_resolution(cv::Point2f( i, j ), scale), 5,  cv::Scalar(255, 0, 0), 2, 8, 0 );
             break;
         }
         default :
+            this->objects.setTo(cv::Scalar::all(0));
             std::cerr << "MyImage::get_object_detected(): Unknown kind of object detection "<<this->object_detection_method<<std::endl ;
             break;
     }
@@ -628,11 +1016,18 @@ cv::Mat& MyImage::get_object_detected() {
  * @return The cv::Mat containing the detected motion
  */
 cv::Mat& MyImage::get_motion_detected() {
-    this->motion = cv::Mat::zeros( this->image.size(), CV_8UC3 );
+    ScopedStageTimer timer(this->profiler, STAGE_MOTION);
+    this->scratch.prepare(this->motion, this->image.size(), CV_8UC3);
+    this->motion.setTo(cv::Scalar::all(0));
+    this->motion_area = 0.;
+    this->motion_boxes.clear();
 
     switch (this->motion_detection_method) {
         case 1: { // Background extraction
-            cv::Mat Mask;
+            // The background model follows the size of the analyzed image, it restarts when it changes
+            const cv::Mat &analyzed = analysis_image();
+            cv::Point2d scale = analysis_scale(analyzed);
+            cv::Mat Mask = this->scratch.acquire(analyzed.size(), CV_8UC1);
             if (this->motion_background_first_time) {
                 this->motion_background_first_time = false;
                 int history = 50;
@@ -640,21 +1035,26 @@ cv::Mat& MyImage::get_motion_detected() {
                 bool detectShadows = false;
                 this->pMOG2 = cv::createBackgroundSubtractorMOG2(history,threshold,detectShadows);
            }
-            pMOG2->apply(this->image, Mask); // this->motion contains the foreground mask
+            pMOG2->apply(analyzed, Mask); // this->motion contains the foreground mask
             if (Mask.empty()) {
                 return this->motion;
             }
             
             // Remove noise and emphasize the detected motion
             cv::threshold(Mask, Mask, 25, 255, cv::THRESH_BINARY);
-            int noise_size = 3;
-            cv::Mat kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(noise_size, noise_size));
+            const cv::Mat &kernel = this->operators.structuring_element(cv::MORPH_RECT, 3);
             cv::erode(Mask, Mask, kernel);
-            kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(noise_size, noise_size));
             cv::dilate(Mask, Mask, kernel, cv::Point(-1,-1), 3);
             
+            this->motion_area = (double) cv::countNonZero(Mask) / Mask.total();
+
             // Export the detected motion to the cv::Mat motion
-            this->image.copyTo(this->motion, Mask);
+            cv::Mat fullMask = Mask;
+            if (Mask.size() != this->image.size()) {
+                fullMask = this->scratch.acquire(this->image.size(), CV_8UC1);
+                cv::resize(Mask, fullMask, fullMask.size(), 0, 0, cv::INTER_NEAREST);
+            }
+            this->image.copyTo(this->motion, fullMask);
             
             // Find contours 
             std::vector<std::vector<cv::Point> > contours;
@@ -663,9 +1063,13 @@ cv::Mat& MyImage::get_motion_detected() {
             // Create bounding boxes for each contours and plot on main image 
             cv::Scalar color = cv::Scalar(0, 0, 255); // red
             for(size_t i = 0; i < contours.size(); i++) {
-                cv::Rect rect = cv::boundingRect(contours[i]);
-                cv::rectangle(this->image, rect, color, 1);
+                cv::Rect rect = to_full_resolution(cv::boundingRect(contours[i]), scale);
+                this->motion_boxes.push_back(rect);
+                if (this->draw_motion_boxes)
+                    cv::rectangle(this->image, rect, color, 1);
             } 
+            if (this->draw_motion_boxes)
+                this->products.invalidate();
             
             break;
         }
@@ -678,6 +1082,400 @@ cv::Mat& MyImage::get_motion_detected() {
     return this->motion;
 }
 
+/**
+ * @brief MyImage::get_motion_area
+ * @return the part of the image in motion at the last call to get_motion_detected(), between 0 and 1
+ */
+double MyImage::get_motion_area() {
+    return this->motion_area;
+}
+
+/**
+ * @brief MyImage::set_motion_boxes_drawn
+ * @param state: boolean true to draw the boxes of the motion on the processed image (default), false
+ *               to leave it unchanged: the caller draws get_motion_boxes() where it needs them
+ */
+void MyImage::set_motion_boxes_drawn(bool state) {
+    this->draw_motion_boxes = state;
+}
+
+/**
+ * @brief MyImage::get_motion_boxes
+ * @return the boxes around the parts in motion at the last call to get_motion_detected()
+ */
+const std::vector<cv::Rect>& MyImage::get_motion_boxes() {
+    return this->motion_boxes;
+}
+
+/**
+ * @brief MyImage::reset_history
+ *
+ * Forget the previous frames (previous image and background model of the motion detection),
+ * the next frame is processed as if it were the first one
+ */
+void MyImage::reset_history() {
+    this->previmage.release();
+    this->motion_background_first_time = true;
+    this->motion_area = 0.;
+}
+
+/**
+ * @brief MyImage::stage_bit
+ * @param stage: integer a stage of MyImage::Stage
+ * @return the bit of the stage in a stage mask
+ */
+unsigned int MyImage::stage_bit(int stage) {
+    return 1u << stage;
+}
+
+/**
+ * @brief MyImage::set_stage_mask
+ * @param mask: unsigned integer the stages of set_image_content() executed by this instance
+ *
+ * In the pipelined mode, every instance executes a group of consecutive stages
+ */
+void MyImage::set_stage_mask(unsigned int mask) {
+    this->stage_mask = mask;
+}
+
+/**
+ * @brief MyImage::get_stage_mask
+ * @return the stages of set_image_content() executed by this instance
+ */
+unsigned int MyImage::get_stage_mask() {
+    return this->stage_mask;
+}
+
+/**
+ * @brief MyImage::set_stage_taps
+ * @param stages: unsigned integer the stages whose result is kept for get_stage_tap() (bits 1<<Stage)
+ * @param pool: VideoFramePool that gives the buffers of the copies, to be frozen after take_stage_tap(),
+ *              nullptr to allocate them here. Not owned, must outlive the instance or be reset.
+ *
+ * A tapped stage is not merged in a lookup table or a band chain with the following stages
+ */
+void MyImage::set_stage_taps(unsigned int stages, VideoFramePool *pool) {
+    this->tap_stages = stages;
+    this->tap_pool   = pool;
+}
+
+/**
+ * @brief MyImage::get_stage_taps
+ * @return the stages whose result is kept for get_stage_tap()
+ */
+unsigned int MyImage::get_stage_taps() {
+    return this->tap_stages;
+}
+
+/**
+ * @brief MyImage::get_stage_tap
+ * @param stage: integer a stage of set_image_content()
+ * @return a copy of the image right after the stage for the last frame, empty if the stage was not
+ *         tapped or not executed. At the reduced resolution of set_processing_scale().
+ */
+cv::Mat MyImage::get_stage_tap(int stage) {
+    if (stage < 0 || stage >= NB_STAGES || !(this->tapped_stages & stage_bit(stage)))
+        return cv::Mat();
+    return this->stage_taps[stage];
+}
+
+/**
+ * @brief MyImage::take_stage_tap
+ * @param stage: integer a stage of set_image_content()
+ * @return the copy of get_stage_tap(), the instance keeps no reference to it: a buffer of the pool of
+ *         set_stage_taps() can be given to VideoFramePool::freeze() as is
+ */
+cv::Mat MyImage::take_stage_tap(int stage) {
+    cv::Mat tap = get_stage_tap(stage);
+    if (!tap.empty()) {
+        this->stage_taps[stage].release();
+        this->tapped_stages &= ~stage_bit(stage);
+    }
+    return tap;
+}
+
+/**
+ * @brief MyImage::copy_settings
+ * @param other: MyImage whose parameters are copied
+ *
+ * Copy the toggles and the parameters of all the algorithms, not the images, the stage mask nor the
+ * processing scale (the stages of a frame must all work at the same resolution). Called at every
+ * frame by the instances of the pipelined mode to follow the GUI.
+ */
+void MyImage::copy_settings(const MyImage &other) {
+    this->blur_range     = other.blur_range;
+    this->blur_method    = other.blur_method;
+    this->morpho_element = other.morpho_element;
+
+    this->edge_method     = other.edge_method;
+    this->canny_threshold = other.canny_threshold;
+    this->canny_ratio     = other.canny_ratio;
+
+    this->threshold_method    = other.threshold_method;
+    this->threshold_value     = other.threshold_value;
+    this->threshold_blocksize = other.threshold_blocksize;
+    this->threshold_type      = other.threshold_type;
+
+    this->transformation_method = other.transformation_method;
+    this->transf_rotation_value = other.transf_rotation_value;
+
+    this->histo_eq_method  = other.histo_eq_method;
+    this->histo_tiles      = other.histo_tiles;
+    this->histo_clip_limit = other.histo_clip_limit;
+
+    this->object_detection_method = other.object_detection_method;
+    this->hough_line_threshold    = other.hough_line_threshold;
+    this->motion_detection_method = other.motion_detection_method;
+
+    this->photo_method = other.photo_method;
+    this->photo_sigmas = other.photo_sigmas;
+    this->photo_sigmar = other.photo_sigmar;
+
+    this->tone_brightness = other.tone_brightness;
+    this->tone_contrast   = other.tone_contrast;
+    this->tone_gamma      = other.tone_gamma;
+
+    this->strip_execution = other.strip_execution;
+    this->fast_variants   = other.fast_variants;
+    this->analysis_width  = other.analysis_width;
+
+    this->coloured        = other.coloured;
+    this->inversed        = other.inversed;
+    this->blurred         = other.blurred;
+    this->edge_detect     = other.edge_detect;
+    this->face_recon      = other.face_recon;
+    this->thresholded     = other.thresholded;
+    this->transformed     = other.transformed;
+    this->photoed         = other.photoed;
+    this->toned           = other.toned;
+    this->histo_eq        = other.histo_eq;
+    this->object_detected = other.object_detected;
+    this->motion_detected = other.motion_detected;
+#ifdef withzbar
+    this->qrcodeactivated = other.qrcodeactivated;
+#endif
+}
+
+/**
+ * @brief MyImage::copy_resources
+ * @param other: MyImage whose face detector and ornaments are shared
+ *
+ * Called once when an instance of the pipelined mode is created
+ */
+void MyImage::copy_resources(const MyImage &other) {
+    this->ornament_glasses    = other.ornament_glasses;
+    this->ornament_mustache   = other.ornament_mustache;
+    this->ornament_mouse_nose = other.ornament_mouse_nose;
+    this->background          = other.background.clone(); // resized in place by the face detection
+#ifdef withobjdetect
+    this->face_cascade_name = other.face_cascade_name;
+    this->face_cascade      = other.face_cascade;
+#ifdef withface
+    this->mark_detector     = other.mark_detector;
+#endif
+#endif
+}
+
+/**
+ * @brief MyImage::get_profiler
+ * @return The durations of the stages of the image processing
+ */
+StageProfiler& MyImage::get_profiler() {
+    return this->profiler;
+}
+
+/**
+ * @brief MyImage::get_scratch_pool
+ * @return The temporary images of the operators, with the number of allocations
+ */
+ScratchPool& MyImage::get_scratch_pool() {
+    return this->scratch;
+}
+
+/**
+ * @brief MyImage::set_processing_graph
+ * @param new_graph: ProcessingGraph the order of the stages, replaces the fixed order of the toggles
+ * @return true if the graph is valid
+ *
+ * The toggles of the stages of set_image_content() are ignored as long as a graph is set
+ */
+bool MyImage::set_processing_graph(const ProcessingGraph &new_graph) {
+    ProcessingGraph checked = new_graph;
+    checked.set_side_effect(STAGE_QRCODE, true);
+    if (!checked.compile()) {
+        std::cerr << "MyImage::set_processing_graph(): " << checked.get_error() << std::endl;
+        return false;
+    }
+    this->graph = checked;
+    this->custom_graph = true;
+    this->plan_valid   = false;
+    return true;
+}
+
+/**
+ * @brief MyImage::reset_processing_graph
+ *
+ * Back to the fixed order of the stages, activated by the toggles
+ */
+void MyImage::reset_processing_graph() {
+    this->custom_graph = false;
+    this->plan_valid   = false;
+}
+
+/**
+ * @brief MyImage::get_processing_graph
+ * @return the graph of the stages, compiled for the last frame
+ */
+const ProcessingGraph& MyImage::get_processing_graph() {
+    return this->graph;
+}
+
+/**
+ * @brief MyImage::get_graph_output
+ * @param name: string the name of a buffer of the graph (a sink)
+ * @return the content of the buffer for the last frame, empty if the plan does not use it
+ */
+cv::Mat MyImage::get_graph_output(const std::string &name) {
+    int index = this->graph.get_buffer_index(name);
+    if (index < 0 || index >= (int) this->buffers.size())
+        return cv::Mat();
+    return index == 0 ? this->image2export : this->buffers[index];
+}
+
+/**
+ * @brief MyImage::frame_products
+ * @return the products (gray levels, histograms, ...) of the current image, computed on request
+ */
+FrameProducts& MyImage::frame_products() {
+    this->products.set_image(this->image);
+    return this->products;
+}
+
+/**
+ * @brief MyImage::set_strip_execution
+ * @param state: boolean true to execute the chains of blur/edges/threshold by bands (default),
+ *               false to apply the stages one after the other on the whole image
+ */
+void MyImage::set_strip_execution(bool state) {
+    this->strip_execution = state;
+}
+
+/**
+ * @brief MyImage::get_strip_execution
+ * @return true if the chains of blur/edges/threshold are executed by bands
+ */
+bool MyImage::get_strip_execution() {
+    return this->strip_execution;
+}
+
+/**
+ * @brief MyImage::set_processing_scale
+ * @param scale: double the resolution of the processing relative to the frame, in ]0,1]
+ *
+ * Below 1, the stages work on a reduced copy of the frame, which is scaled back to the size of the
+ * frame at the end of set_image_content()
+ */
+void MyImage::set_processing_scale(double scale) {
+    assert(scale>0. && scale<=1.);
+    this->processing_scale = std::max(0.1, std::min(1., scale));
+}
+
+/**
+ * @brief MyImage::get_processing_scale
+ * @return the resolution of the processing relative to the frame
+ */
+double MyImage::get_processing_scale() {
+    return this->processing_scale;
+}
+
+/**
+ * @brief MyImage::set_fast_variants
+ * @param state: boolean true to use the cheaper variants of the expensive operators (denoising with
+ *               smaller windows, filters of the module photo at half resolution)
+ */
+void MyImage::set_fast_variants(bool state) {
+    this->fast_variants = state;
+}
+
+/**
+ * @brief MyImage::get_fast_variants
+ * @return true if the cheaper variants of the expensive operators are used
+ */
+bool MyImage::get_fast_variants() {
+    return this->fast_variants;
+}
+
+/**
+ * @brief MyImage::set_analysis_width
+ * @param width: integer the width of the reduced copy of the image the analyzers work on (faces,
+ *               objects, motion, QR codes, text areas), 0 to analyze the image at full resolution
+ *
+ * The rectangles, circles, lines and masks found on the reduced copy are mapped back to the
+ * resolution of the image before they are drawn
+ */
+void MyImage::set_analysis_width(int width) {
+    assert(width>=0);
+    this->analysis_width = std::max(0, width);
+}
+
+/**
+ * @brief MyImage::get_analysis_width
+ * @return the width of the images analyzed, 0 for the full resolution
+ */
+int MyImage::get_analysis_width() {
+    return this->analysis_width;
+}
+
+/**
+ * @brief MyImage::analysis_image
+ * @return the image the analyzers work on: a reduced copy of this->image, or the image itself
+ */
+const cv::Mat& MyImage::analysis_image() {
+    if (this->analysis_width > 0)
+        return frame_products().proxy(this->analysis_width);
+    return this->image;
+}
+
+/**
+ * @brief MyImage::analysis_gray
+ * @return the gray levels of analysis_image()
+ */
+const cv::Mat& MyImage::analysis_gray() {
+    if (this->analysis_width > 0)
+        return frame_products().proxy_gray(this->analysis_width);
+    return frame_products().gray();
+}
+
+/**
+ * @brief MyImage::analysis_scale
+ * @param analyzed: cv::Mat the image given by analysis_image() or analysis_gray()
+ * @return the factors from the coordinates of analyzed to the coordinates of this->image
+ */
+cv::Point2d MyImage::analysis_scale(const cv::Mat &analyzed) {
+    return cv::Point2d((double) this->image.cols / analyzed.cols, (double) this->image.rows / analyzed.rows);
+}
+
+/**
+ * @brief MyImage::to_full_resolution
+ * @param rect: cv::Rect found on the analyzed image
+ * @param scale: cv::Point2d given by analysis_scale()
+ * @return the rectangle in the coordinates of this->image
+ */
+cv::Rect MyImage::to_full_resolution(const cv::Rect &rect, const cv::Point2d &scale) {
+    return cv::Rect(cvRound(rect.x*scale.x), cvRound(rect.y*scale.y),
+                    cvRound(rect.width*scale.x), cvRound(rect.height*scale.y));
+}
+
+/**
+ * @brief MyImage::to_full_resolution
+ * @param point: cv::Point2f found on the analyzed image
+ * @param scale: cv::Point2d given by analysis_scale()
+ * @return the point in the coordinates of this->image
+ */
+cv::Point MyImage::to_full_resolution(const cv::Point2f &point, const cv::Point2d &scale) {
+    return cv::Point(cvRound(point.x*scale.x), cvRound(point.y*scale.y));
+}
+
 #ifdef withobjdetect
 /**
  * @brief MyImage::set_Face_Cascade_Name
@@ -728,9 +1526,34 @@ bool MyImage::set_background_image(cv::String &filename){
  * Performs the Colour -> Black and White operation
  */
 void MyImage::toBlackandWhite() {
-    // Convert image to black and white with 3 channels
-    cv::cvtColor(this->image,this->image,cv::COLOR_RGB2GRAY);
-    cv::cvtColor(this->image,this->image,cv::COLOR_GRAY2BGR);
+    // Convert image to black and white, kept in a single channel
+    if (this->image.channels() == 1)
+        return;
+    cv::Mat gray = this->scratch.acquire(this->image.size(), CV_8UC1);
+    cv::cvtColor(this->image,gray,cv::COLOR_BGR2GRAY);
+    this->image = gray;
+}
+
+/**
+ * @brief MyImage::toColour
+ *
+ * Expands a black and white image to 3 channels, in the buffer of the input frame when possible
+ */
+void MyImage::toColour() {
+    if (this->image.channels() != 1)
+        return;
+    // The buffer of the input frame must not be the content of any buffer of the graph, the main
+    // one included: it still holds the input until a stage replaces it
+    bool reuse_input = this->input.size() == this->image.size() && this->input.type() == CV_8UC3;
+    for (size_t i=0; i<this->buffers.size() && reuse_input; i++)
+        reuse_input = this->buffers[i].data != this->input.data;
+    cv::Mat colour;
+    if (reuse_input)
+        colour = this->input;
+    else
+        colour = this->scratch.acquire(this->image.size(), CV_8UC3);
+    cv::cvtColor(this->image,colour,cv::COLOR_GRAY2BGR);
+    this->image = colour;
 }
 
 /**
@@ -743,6 +1566,18 @@ void MyImage::inverseImage() {
     cv::bitwise_not(this->image, this->image);
 }
 
+/**
+ * @brief MyImage::toneImage
+ * 
+ * Performs the brightness/contrast/gamma correction with a lookup table
+ */
+void MyImage::toneImage() {
+    // Own table: the caches of the chains of the plan keep their tables and their counters
+    this->tone_lut.begin();
+    this->tone_lut.add_tone(this->tone_brightness, this->tone_contrast, this->tone_gamma);
+    this->tone_lut.apply(this->image);
+}
+
 /**
  * @brief MyImage::smoothImage
  * @param imag: cv::Mat input image to blur
@@ -776,18 +1611,18 @@ void MyImage::smoothImage(cv::Mat &imag, int blur_range, int method) {
         {
             int op = method - 5;
             int shape = morpho_element - 1;
-            cv::morphologyEx(imag, imag, op, getStructuringElement(shape, cv::Size(blur_range,blur_range)) );
+            cv::morphologyEx(imag, imag, op, this->operators.structuring_element(shape, blur_range) );
             break;
         }
         case 12: // cv::MorphTypes MORPH_HITMISS  = 7
         {
-            cv::cvtColor(imag,imag,cv::COLOR_RGB2GRAY); // Image must be in BW
+            if (imag.channels() != 1) { // Image must be in BW
+                cv::Mat gray = this->scratch.acquire(imag.size(), CV_8UC1);
+                cv::cvtColor(imag,gray,cv::COLOR_BGR2GRAY);
+                imag = gray;
+            }
             int op = method - 5;
-            cv::Mat kernel = (cv::Mat_<int>(3, 3) <<
-                0, 1, 0,
-                1, -1, 1,
-                0, 1, 0);
-            cv::morphologyEx(imag, imag, op, kernel );
+            cv::morphologyEx(imag, imag, op, this->operators.hitmiss_kernel() );
             break;
         }
         default :
@@ -804,9 +1639,12 @@ void MyImage::smoothImage(cv::Mat &imag, int blur_range, int method) {
 void MyImage::detectEdges() {
     switch (this->edge_method) {
         case 1: { // Sobel
-            cv::Mat gray,grad,grad_x,abs_grad_x,grad_y,abs_grad_y;
-            smoothImage(this->image, 3, 2); // Gaussian filter
-            cv::cvtColor( this->image, gray, cv::COLOR_BGR2GRAY );
+            cv::Size size = this->image.size();
+            cv::Mat gray       = this->scratch.acquire(size, CV_8UC1), grad       = this->scratch.acquire(size, CV_8UC1);
+            cv::Mat grad_x     = this->scratch.acquire(size, CV_16S),  grad_y     = this->scratch.acquire(size, CV_16S);
+            cv::Mat abs_grad_x = this->scratch.acquire(size, CV_8UC1), abs_grad_y = this->scratch.acquire(size, CV_8UC1);
+            // Gaussian filter of the gray levels, shared with the other operators
+            cv::GaussianBlur( frame_products().gray(), gray, cv::Size(3,3), 0, 0 );
             // Gradient X
             cv::Sobel( gray, grad_x, CV_16S, 1, 0, 3 );
             cv::convertScaleAbs( grad_x, abs_grad_x );
@@ -815,24 +1653,31 @@ void MyImage::detectEdges() {
             cv::convertScaleAbs( grad_y, abs_grad_y );
             // Total Gradient (approximate)
             cv::addWeighted( abs_grad_x, 0.5, abs_grad_y, 0.5, 0, grad );
-            cv::cvtColor(grad,this->image,cv::COLOR_GRAY2BGR);
+            this->image = grad;
             break;
             }
         case 2: { // Laplacian
-            cv::Mat gray,abs_laplacian,laplacian;
-            smoothImage(this->image, 3, 2); // Gaussian filter
-            cv::cvtColor( this->image, gray, cv::COLOR_BGR2GRAY );
+            cv::Mat gray          = this->scratch.acquire(this->image.size(), CV_8UC1);
+            cv::Mat laplacian     = this->scratch.acquire(this->image.size(), CV_16S);
+            cv::Mat abs_laplacian = this->scratch.acquire(this->image.size(), CV_8UC1);
+            // Gaussian filter of the gray levels, shared with the other operators
+            cv::GaussianBlur( frame_products().gray(), gray, cv::Size(3,3), 0, 0 );
             cv::Laplacian( gray, laplacian, CV_16S, 3 );
             cv::convertScaleAbs( laplacian, abs_laplacian );
-            cv::cvtColor(abs_laplacian,this->image,cv::COLOR_GRAY2BGR);
+            this->image = abs_laplacian;
             break;
             }
         case 3: { // Canny edge detector
-            cv::Mat dst,gray,detected_edges;
+            cv::Mat dst            = this->scratch.acquire(this->image.size(), this->image.type());
+            cv::Mat gray           = this->scratch.acquire(this->image.size(), CV_8UC1);
+            cv::Mat detected_edges = this->scratch.acquire(this->image.size(), CV_8UC1);
             smoothImage(this->image, 3, 2); // Gaussian filter
-            cv::cvtColor( this->image, gray, cv::COLOR_BGR2GRAY );
+            if (this->image.channels() == 1)
+                gray = this->image;
+            else
+                cv::cvtColor( this->image, gray, cv::COLOR_BGR2GRAY );
             cv::Canny( gray, detected_edges, this->canny_threshold, this->canny_threshold*this->canny_ratio, 3 );
-            dst = cv::Scalar::all(0);
+            dst.setTo(cv::Scalar::all(0));
             this->image.copyTo(dst,detected_edges);
             dst.copyTo(this->image);
             break;
@@ -856,8 +1701,13 @@ void MyImage::detect_faces() {
     std::vector<cv::Rect> faces;
     std::vector<cv::Point> ROI_Poly;
 
-    // Detect faces
-    face_cascade.detectMultiScale( this->image, faces, 1.1, 2, 0|cv::CASCADE_SCALE_IMAGE, cv::Size(30, 30) );
+    // Detect faces, on the reduced copy if any
+    const cv::Mat &analyzed = analysis_gray();
+    cv::Point2d scale = analysis_scale(analyzed);
+    int min_size = std::max(1, cvRound(30/scale.x));
+    face_cascade.detectMultiScale( analyzed, faces, 1.1, 2, 0|cv::CASCADE_SCALE_IMAGE, cv::Size(min_size, min_size) );
+    for (size_t i = 0; i < faces.size(); i++)
+        faces[i] = to_full_resolution(faces[i], scale);
 
     // Draw ellipses around faces and get regions of interest
     for( size_t i = 0; i < faces.size(); i++ )
@@ -1027,52 +1877,51 @@ void MyImage::draw_mouse_nose(cv::Mat &frame, std::vector<cv::Point2f> &marks) {
  */
 double MyImage::thresholdImage() {
     double value = this->threshold_value;
+    // The thresholds work on the gray levels, the result stays in a single channel
+    FrameProducts &products = frame_products();
+    const cv::Mat &gray = products.gray();
+    cv::Mat result = this->scratch.acquire(this->image.size(), CV_8UC1);
     switch (this->threshold_method) {
     case 1: // cv::ThresholdTypes THRESH_BINARY       = 0
     case 2: // cv::ThresholdTypes THRESH_BINARY_INV   = 1
     case 3: // cv::ThresholdTypes THRESH_TRUNC        = 2
     case 4: // cv::ThresholdTypes THRESH_TOZERO       = 3
     case 5: { // cv::ThresholdTypes THRESH_TOZERO_INV = 4
-        cv::cvtColor(this->image,this->image,cv::COLOR_RGB2GRAY);
         int type = this->threshold_method - 1 ;
-        cv::threshold( this->image, this->image, this->threshold_value, 255, type );
-        cv::cvtColor(this->image,this->image,cv::COLOR_GRAY2BGR);
+        cv::threshold( gray, result, this->threshold_value, 255, type );
         break;
     }
     case 6: { // cv::ThresholdTypes THRESH_OTSU = 8
-        cv::cvtColor(this->image,this->image,cv::COLOR_RGB2GRAY);
-        value = cv::threshold( this->image, this->image, 0, 255, cv::THRESH_BINARY | cv::THRESH_OTSU );
-        cv::cvtColor(this->image,this->image,cv::COLOR_GRAY2BGR);
+        // Threshold computed from the shared histogram of the gray levels
+        value = products.otsu_threshold();
+        cv::threshold( gray, result, value, 255, cv::THRESH_BINARY );
         break;
     }
     case 7: { // cv::ThresholdTypes THRESH_TRIANGLE = 16
-        cv::cvtColor(this->image,this->image,cv::COLOR_RGB2GRAY);
-        value = cv::threshold( this->image, this->image, 0, 255, cv::THRESH_BINARY | cv::THRESH_TRIANGLE  );
-        cv::cvtColor(this->image,this->image,cv::COLOR_GRAY2BGR);
+        value = products.triangle_threshold();
+        cv::threshold( gray, result, value, 255, cv::THRESH_BINARY );
         break;
     }
     case 8: { // adaptive threshold simple mean
-        cv::cvtColor(this->image,this->image,cv::COLOR_RGB2GRAY);
         if (this->threshold_type == 1)
-            cv::adaptiveThreshold( this->image, this->image, 255,cv::ADAPTIVE_THRESH_MEAN_C, cv::THRESH_BINARY ,this->threshold_blocksize, 0. );
+            cv::adaptiveThreshold( gray, result, 255,cv::ADAPTIVE_THRESH_MEAN_C, cv::THRESH_BINARY ,this->threshold_blocksize, 0. );
         else
-            cv::adaptiveThreshold( this->image, this->image, 255,cv::ADAPTIVE_THRESH_MEAN_C, cv::THRESH_BINARY_INV ,this->threshold_blocksize, 0. );
-        cv::cvtColor(this->image,this->image,cv::COLOR_GRAY2BGR);
+            cv::adaptiveThreshold( gray, result, 255,cv::ADAPTIVE_THRESH_MEAN_C, cv::THRESH_BINARY_INV ,this->threshold_blocksize, 0. );
         break;
     }
     case 9: { // adaptive threshold Gaussian
-        cv::cvtColor(this->image,this->image,cv::COLOR_RGB2GRAY);
         if (this->threshold_type == 1)
-            cv::adaptiveThreshold( this->image, this->image, 255,cv::ADAPTIVE_THRESH_GAUSSIAN_C, cv::THRESH_BINARY ,this->threshold_blocksize, 0. );
+            cv::adaptiveThreshold( gray, result, 255,cv::ADAPTIVE_THRESH_GAUSSIAN_C, cv::THRESH_BINARY ,this->threshold_blocksize, 0. );
         else
-            cv::adaptiveThreshold( this->image, this->image, 255,cv::ADAPTIVE_THRESH_GAUSSIAN_C, cv::THRESH_BINARY_INV ,this->threshold_blocksize, 0. );
-        cv::cvtColor(this->image,this->image,cv::COLOR_GRAY2BGR);
+            cv::adaptiveThreshold( gray, result, 255,cv::ADAPTIVE_THRESH_GAUSSIAN_C, cv::THRESH_BINARY_INV ,this->threshold_blocksize, 0. );
         break;
     }
     default:
         std::cerr << "MyImage::thresholdImage(): Unknown kind of threshold "<<this->threshold_method<<std::endl ;
+        gray.copyTo(result);
         break;
     }
+    this->image = result;
     return value;
 }
 
@@ -1088,7 +1937,10 @@ void MyImage::transformImage() {
         int centerY = this->image.cols / 2;
 
         cv::Mat matRotation = cv::getRotationMatrix2D( cv::Point(centerY, centerX), (transf_rotation_value), 1 );
-        cv::warpAffine( this->image, this->image, matRotation, this->image.size() );
+        // warpAffine cannot work in place, it would clone the image
+        cv::Mat rotated = this->scratch.acquire(this->image.size(), this->image.type());
+        cv::warpAffine( this->image, rotated, matRotation, this->image.size() );
+        rotated.copyTo(this->image);
         break;
     }
     default:
@@ -1104,9 +1956,27 @@ void MyImage::transformImage() {
  * Performs the histogram equalization
  */
 void MyImage::equalizeHistogram() {
-    std::vector<cv::Mat> channels;
-    cv::cvtColor(this->image, this->image, cv::COLOR_BGR2YCrCb); //change the color image from BGR to YCrCb format
-    cv::split(this->image,channels); //split the image into channels
+    if (this->image.channels() == 1) {
+        // Black and white: the gray levels are the luminance
+        switch (this->histo_eq_method) {
+            case 1:
+                cv::equalizeHist(this->image, this->image);
+                return;
+            case 2: {
+                this->operators.clahe(this->histo_clip_limit, this->histo_tiles)->apply(this->image,this->image);
+                return;
+            }
+            default:
+                break;
+        }
+    }
+    toColour();
+    cv::Mat ycrcb = this->scratch.acquire(this->image.size(), CV_8UC3);
+    cv::Mat channels[3];
+    for (int i=0; i<3; i++)
+        channels[i] = this->scratch.acquire(this->image.size(), CV_8UC1);
+    cv::cvtColor(this->image, ycrcb, cv::COLOR_BGR2YCrCb); //change the color image from BGR to YCrCb format
+    cv::split(ycrcb,channels); //split the image into channels
 
     switch (this->histo_eq_method) {
         case 1: {
@@ -1114,10 +1984,7 @@ void MyImage::equalizeHistogram() {
             break;
         }
         case 2:{
-            cv::Ptr<cv::CLAHE> clahe = cv::createCLAHE();
-            clahe->setClipLimit(this->histo_clip_limit);
-            clahe->setTilesGridSize(cv::Size(this->histo_tiles,this->histo_tiles));
-            clahe->apply(channels[0],channels[0]);
+            this->operators.clahe(this->histo_clip_limit, this->histo_tiles)->apply(channels[0],channels[0]);
             break;
         }
         default:{
@@ -1125,8 +1992,8 @@ void MyImage::equalizeHistogram() {
             break;
         }
     }
-    cv::merge(channels,this->image); //merge 3 channels including the modified 1st channel into one image
-    cv::cvtColor(this->image, this->image, cv::COLOR_YCrCb2BGR);
+    cv::merge(channels,3,ycrcb); //merge 3 channels including the modified 1st channel into one image
+    cv::cvtColor(ycrcb, this->image, cv::COLOR_YCrCb2BGR);
 }
 
 /**
@@ -1135,15 +2002,31 @@ void MyImage::equalizeHistogram() {
  * Applies operations from the module Photo
  */
 void MyImage::modulephoto(){
+    // All the methods work in colours
+    toColour();
+
+    // Cheaper variant (see set_fast_variants()): the non-photorealistic renderings work at half resolution
+    cv::Mat full;
+    bool reduced = this->fast_variants && this->photo_method >= 3 && this->photo_method <= 6;
+    if (reduced) {
+        full = this->image;
+        cv::Mat half = this->scratch.acquire(cv::Size((full.cols+1)/2, (full.rows+1)/2), full.type());
+        cv::resize(full, half, half.size(), 0, 0, cv::INTER_AREA);
+        this->image = half;
+    }
     switch (this->photo_method){
         case 1:{ // Contrast Preserving Decolorization
-            cv::Mat gray, color_boost;
+            cv::Mat gray        = this->scratch.acquire(this->image.size(), CV_8UC1);
+            cv::Mat color_boost = this->scratch.acquire(this->image.size(), CV_8UC3);
             cv::decolor( this->image, gray, color_boost );
-            this->image = color_boost;
+            color_boost.copyTo(this->image);
             break;
         }
         case 2:{ // Denoising
-            cv::fastNlMeansDenoisingColored(this->image,this->image,3.,3.,7,21);
+            if (this->fast_variants)
+                cv::fastNlMeansDenoisingColored(this->image,this->image,3.,3.,5,11);
+            else
+                cv::fastNlMeansDenoisingColored(this->image,this->image,3.,3.,7,21);
             break;
         }
         case 3:{ // Non-Photorealistic Rendering: edge preserving filter
@@ -1157,7 +2040,7 @@ void MyImage::modulephoto(){
             break;
         }
         case 5:{ // Non-Photorealistic Rendering: pencil sketch
-            cv::Mat img1;
+            cv::Mat img1 = this->scratch.acquire(this->image.size(), CV_8UC1);
             pencilSketch(this->image,img1, this->image, this->photo_sigmas, this->photo_sigmar, 0.03f);
             break;
         }
@@ -1167,9 +2050,7 @@ void MyImage::modulephoto(){
         }
 #ifdef withxphoto
         case 7: { // xphoto white balance
-            cv::Ptr<cv::xphoto::WhiteBalancer> wb = cv::xphoto::createSimpleWB(); // significant modification
-            // Ptr<xphoto::WhiteBalancer> wb = xphoto::createGrayworldWB(); // not wonderful with my camera
-            wb->balanceWhite(this->image, this->image);
+            this->operators.white_balancer()->balanceWhite(this->image, this->image);
             break;
         }
 #endif
@@ -1178,7 +2059,10 @@ void MyImage::modulephoto(){
             break;
         }
     }
-
+    if (reduced) {
+        cv::resize(this->image, full, full.size(), 0, 0, cv::INTER_LINEAR);
+        this->image = full;
+    }
 }
 
 #ifdef withstitching
@@ -1284,23 +2168,23 @@ int MyImage::panorama_get_size(){
  * Performs the detection and decoding of QR codes + barcodes with the help of ZBar
  */
 void MyImage::getQRcode(){
-    // Create zbar scanner
-    zbar::ImageScanner scanner;
-    // Configure scanner
-    scanner.set_config(zbar::ZBAR_NONE, zbar::ZBAR_CFG_ENABLE, 1);
+    // Zbar scanner, created and configured once
+    zbar::ImageScanner &scanner = this->operators.qrcode_scanner();
     
-    // Convert image to grayscale
-    cv::Mat imGray;
-    cv::cvtColor(this->image, imGray,cv::COLOR_BGR2GRAY); 
+    // Gray levels of the image (or of its reduced copy), shared with the other operators
+    cv::Mat imGray = analysis_gray();
+    cv::Point2d scale = analysis_scale(imGray);
     
     // Wrap image data in a zbar image
-    zbar::Image image(this->image.cols, this->image.rows, "Y800", (uchar *)imGray.data, this->image.cols * this->image.rows);
+    zbar::Image image(imGray.cols, imGray.rows, "Y800", (uchar *)imGray.data, imGray.cols * imGray.rows);
     
     // Scan the image for barcodes and QRCodes
     int nscan = scanner.scan(image);
     
     int current_code = 0;
     if (nscan>0) {
+        // The codes are drawn in colours, imGray keeps the gray levels scanned by zbar
+        toColour();
         for(zbar::Image::SymbolIterator symbol = image.symbol_begin(); symbol != image.symbol_end(); ++symbol) {
             // Print type and data
             
@@ -1313,7 +2197,7 @@ void MyImage::getQRcode(){
             // Obtain location
             std::vector <cv::Point> location;
             for(int i = 0; i< symbol->get_location_size(); i++) {
-                location.push_back(cv::Point(symbol->get_location_x(i),symbol->get_location_y(i)));
+                location.push_back(to_full_resolution(cv::Point2f(symbol->get_location_x(i),symbol->get_location_y(i)), scale));
             }
             
             std::vector<cv::Point> hull;
@@ -1393,7 +2277,9 @@ cv::Mat MyImage::textAreasDetect(std::vector<cv::Rect> &areas, bool detectAreas)
     
     if (detectAreas) {
         cv::Mat blob;
-    
+
+        // The network works on 320x320 pixels: blobFromImage reduces the frame itself, a reduced
+        // copy at analysis_width would only add a resampling
         cv::dnn::blobFromImage(frame, blob,
                                1.0, cv::Size(inputWidth, inputHeight),
                                cv::Scalar(123.68, 116.78, 103.94), true, false);
@@ -32,6 +32,15 @@
 #include "opencv2/dnn.hpp"
 #endif
 
+#include "stagetimer.h"
+#include "scratchpool.h"
+#include "processinggraph.h"
+#include "lutcompositor.h"
+#include "stripexecutor.h"
+#include "frameproducts.h"
+#include "operatorcache.h"
+#include "videoframe.h"
+
 #include <iostream>
 
 //using namespace cv;
@@ -39,7 +48,19 @@
 
 class MyImage
 {
+    // The benchmark (benchmark.cpp) calls the private operators directly
+    friend class MyImageBenchmark;
+
 public:
+    // Stages of the image processing measured by the profiler
+    enum Stage {
+        STAGE_FACE = 0, STAGE_BW, STAGE_PHOTO, STAGE_TONE, STAGE_INVERSE, STAGE_HISTO_EQ, STAGE_EDGE,
+        STAGE_BLUR, STAGE_THRESHOLD, STAGE_TRANSFORM, STAGE_QRCODE, // inside set_image_content()
+        STAGE_OBJECTS, STAGE_MOTION, STAGE_HISTOGRAM,           // side outputs
+        STAGE_PIPELINE,                                         // the whole set_image_content()
+        NB_STAGES
+    };
+
     MyImage();
 
     void set_image_content(cv::Mat &content);
@@ -79,6 +100,10 @@ public:
     void set_photo_method(int);
     void set_photo_sigmas(int);
     void set_photo_sigmar(double);
+
+    void set_tone_brightness(int);
+    void set_tone_contrast(double);
+    void set_tone_gamma(double);
     
 #ifdef withstitching
     void panorama_insert_image();
@@ -95,6 +120,10 @@ public:
 #endif
     cv::Mat& get_object_detected();
     cv::Mat& get_motion_detected();
+    double get_motion_area();
+    void set_motion_boxes_drawn(bool state);
+    const std::vector<cv::Rect>& get_motion_boxes();
+    void reset_history();
 
     void toggleBW(bool);
     void toggleInverse(bool);
@@ -115,6 +144,7 @@ public:
 #endif
     void toggleMotionDetection(bool);
     void togglePhoto(bool);
+    void toggleTone(bool);
 #ifdef withzbar
     void toggleQRcode(bool);
     bool getQRcodedata(std::string &, std::string &);
@@ -122,9 +152,44 @@ public:
 #ifdef withtesseract
     cv::Mat textAreasDetect(std::vector<cv::Rect> &areas, bool detectAreas) ;
 #endif
+
+    StageProfiler& get_profiler();
+    ScratchPool& get_scratch_pool();
+
+    // Pipelined mode: several instances share the stages of set_image_content()
+    void set_stage_mask(unsigned int mask);
+    unsigned int get_stage_mask();
+    void copy_settings(const MyImage &other);
+    void copy_resources(const MyImage &other);
+    static unsigned int stage_bit(int stage);
+
+    // Copies of the image after some stages, for the sinks subscribed to them
+    void set_stage_taps(unsigned int stages, VideoFramePool *pool=nullptr);
+    unsigned int get_stage_taps();
+    cv::Mat get_stage_tap(int stage);
+    cv::Mat take_stage_tap(int stage);
+
+    // Order of the stages: by default the fixed order of the toggles, or a user graph
+    bool set_processing_graph(const ProcessingGraph &new_graph);
+    void reset_processing_graph();
+    const ProcessingGraph& get_processing_graph();
+    cv::Mat get_graph_output(const std::string &name);
+    static std::vector<std::string> get_stage_names();
+
+    // Chains of neighbourhood filters (blur, edges, threshold) executed band after band
+    void set_strip_execution(bool);
+    bool get_strip_execution();
+    void set_processing_scale(double);
+    double get_processing_scale();
+    void set_fast_variants(bool);
+    bool get_fast_variants();
+    void set_analysis_width(int);
+    int get_analysis_width();
     
 private:
     cv::Mat image, previmage, image2export , mask , smoothed, histogram, objects, panorama, motion, background ;
+    // Frame received by set_image_content(), its buffer receives the image when it is expanded back to colours
+    cv::Mat input;
     // Mask ornaments to put over face detected
     cv::Mat ornament_glasses, ornament_mustache, ornament_mouse_nose;
     int blur_range,blur_method,morpho_element;
@@ -136,10 +201,14 @@ private:
     int transformation_method,transf_rotation_value;
     int histo_eq_method,histo_tiles,histo_clip_limit;
     int motion_detection_method,photo_method,photo_sigmas;
-    double canny_ratio,photo_sigmar;
+    int tone_brightness;
+    double canny_ratio,photo_sigmar,tone_contrast,tone_gamma;
     bool coloured,inversed,blurred,edge_detect,face_recon,thresholded,object_detected;
-    bool transformed,photoed;
+    bool transformed,photoed,toned;
     bool motion_detected,motion_background_first_time;
+    double motion_area; // part of the image in motion at the last detection [0,1]
+    bool draw_motion_boxes;                 // the boxes of the motion are drawn on the processed image
+    std::vector<cv::Rect> motion_boxes;     // boxes of the last detection, at the full resolution
     bool histo_eq;
 #ifdef withobjdetect
     cv::String face_cascade_name ;
@@ -167,9 +236,70 @@ private:
 
     cv::Ptr<cv::BackgroundSubtractor> pMOG2;
 
+    // Durations of the stages
+    StageProfiler profiler;
+
+    // Temporary images and objects of the operators, kept from one frame to the next
+    ScratchPool scratch;
+    OperatorCache operators;
+
+    // Stages of set_image_content() executed by this instance (bits 1<<Stage)
+    unsigned int stage_mask;
+
+    // Processing graph and its compiled plan, the images of its buffers ("main" first)
+    ProcessingGraph graph;
+    bool custom_graph, plan_valid;
+    unsigned int plan_stages, plan_mask;
+    std::vector<cv::Mat> buffers;
+
+    // Consecutive point operations of the plan, folded into lookup tables (one per chain of the frame)
+    std::vector<LutCompositor> luts;
+    LutCompositor tone_lut;     // table of toneImage() outside the plan, apart from the chains
+    size_t lut_chain;
+    bool lut_pending;
+    int lut_stage;
+
+    // Consecutive neighbourhood filters of the plan, executed by bands (see StripExecutor)
+    StripExecutor strips;
+    bool strip_execution, strip_pending;
+    int strip_stage;
+
+    // Quality of the processing, lowered to hold the frame rate (see QualityGovernor)
+    double processing_scale;
+    bool fast_variants;
+
+    // Width of the reduced copy the analyzers work on (faces, objects, motion, codes), 0 for the full resolution
+    int analysis_width;
+
+    // Buffer that receives the result of the pending chain (lookup table or bands)
+    int chain_output;
+
+    // Stages whose result is copied (see set_stage_taps()), and those copied for the last frame
+    unsigned int tap_stages, tapped_stages;
+    std::vector<cv::Mat> stage_taps;
+    VideoFramePool *tap_pool;       // gives the buffers of the copies, not owned (nullptr: allocated here)
+
+    // Gray levels, histograms, ... of this->image shared by the operators until it is modified
+    FrameProducts products;
+
     // Methods
+    unsigned int active_stages();
+    void update_plan();
+    void run_stage(int stage);
+    bool fold_point_operation(int stage);
+    void flush_point_operations();
+    bool add_strip_operation(int stage);
+    void flush_strips();
+    FrameProducts& frame_products();
+    const cv::Mat& analysis_image();
+    const cv::Mat& analysis_gray();
+    cv::Point2d analysis_scale(const cv::Mat &analyzed);
+    static cv::Rect to_full_resolution(const cv::Rect &rect, const cv::Point2d &scale);
+    static cv::Point to_full_resolution(const cv::Point2f &point, const cv::Point2d &scale);
+    void toColour();
     void toBlackandWhite();
     void inverseImage();
+    void toneImage();
     void smoothImage(cv::Mat &imag, int blur_range, int method);
     void detectEdges();
 #ifdef withobjdetect
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *  Keeps the OpenCV and ZBar objects of the operators of MyImage from one frame to the next instead
+ *  of creating them for every frame. No Qt thing here.
+*/
+
+#include "operatorcache.h"
+
+#include <cassert>
+
+/**
+ * @brief OperatorCache::OperatorCache
+ *
+ * Constructor of the class OperatorCache. The objects are created on their first use.
+ */
+OperatorCache::OperatorCache() : clahe_clip_limit(-1.),
+                                 clahe_tiles(-1),
+                                 creations(0)
+{
+}
+
+/**
+ * @brief OperatorCache::clahe
+ * @param clip_limit: double the contrast limit of CLAHE
+ * @param tiles: integer the number of tiles in each direction
+ * @return the CLAHE operator configured with these parameters
+ */
+cv::Ptr<cv::CLAHE> OperatorCache::clahe(double clip_limit, int tiles) {
+    assert(tiles>0);
+    if (this->clahe_operator.empty()) {
+        this->clahe_operator = cv::createCLAHE();
+        this->creations++;
+    }
+    if (clip_limit != this->clahe_clip_limit) {
+        this->clahe_operator->setClipLimit(clip_limit);
+        this->clahe_clip_limit = clip_limit;
+    }
+    if (tiles != this->clahe_tiles) {
+        this->clahe_operator->setTilesGridSize(cv::Size(tiles, tiles));
+        this->clahe_tiles = tiles;
+    }
+    return this->clahe_operator;
+}
+
+#ifdef withxphoto
+/**
+ * @brief OperatorCache::white_balancer
+ * @return the simple white balance algorithm of xphoto
+ */
+cv::Ptr<cv::xphoto::WhiteBalancer> OperatorCache::white_balancer() {
+    if (this->balancer.empty()) {
+        this->balancer = cv::xphoto::createSimpleWB(); // significant modification
+        // cv::xphoto::createGrayworldWB(); // not wonderful with my camera
+        this->creations++;
+    }
+    return this->balancer;
+}
+#endif
+
+#ifdef withzbar
+/**
+ * @brief OperatorCache::qrcode_scanner
+ * @return the ZBar scanner, all the kinds of symbols enabled
+ */
+zbar::ImageScanner& OperatorCache::qrcode_scanner() {
+    if (!this->scanner) {
+        this->scanner.reset(new zbar::ImageScanner());
+        this->scanner->set_config(zbar::ZBAR_NONE, zbar::ZBAR_CFG_ENABLE, 1);
+        this->creations++;
+    }
+    return *this->scanner;
+}
+#endif
+
+/**
+ * @brief OperatorCache::structuring_element
+ * @param shape: integer the cv::MorphShapes (MORPH_RECT, MORPH_CROSS, MORPH_ELLIPSE)
+ * @param size: integer the width and the height of the element
+ * @return the structuring element, see cv::getStructuringElement
+ */
+const cv::Mat& OperatorCache::structuring_element(int shape, int size) {
+    assert(size>0);
+    for (size_t i=0; i<this->elements.size(); i++)
+        if (this->elements[i].shape == shape && this->elements[i].size == size)
+            return this->elements[i].kernel;
+
+    // A few elements are in use at the same time (blur and motion detection): forget the oldest
+    if (this->elements.size() >= 4)
+        this->elements.erase(this->elements.begin());
+    Element element;
+    element.shape  = shape;
+    element.size   = size;
+    element.kernel = cv::getStructuringElement(shape, cv::Size(size, size));
+    this->elements.push_back(element);
+    this->creations++;
+    return this->elements.back().kernel;
+}
+
+/**
+ * @brief OperatorCache::hitmiss_kernel
+ * @return the 3x3 kernel of the hit-or-miss transform (isolated pixels)
+ */
+const cv::Mat& OperatorCache::hitmiss_kernel() {
+    if (this->hitmiss.empty()) {
+        this->hitmiss = (cv::Mat_<int>(3, 3) <<
+            0, 1, 0,
+            1, -1, 1,
+            0, 1, 0);
+        this->creations++;
+    }
+    return this->hitmiss;
+}
+
+/**
+ * @brief OperatorCache::get_creations
+ * @return the number of objects created since the creation of the cache
+ */
+unsigned long long OperatorCache::get_creations() {
+    return this->creations;
+}
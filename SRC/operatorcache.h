@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef OPERATORCACHE_H
+#define OPERATORCACHE_H
+
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+#ifdef withxphoto
+#include "opencv2/xphoto/white_balance.hpp"
+#endif
+
+#ifdef withzbar
+#include "zbar.h"
+#endif
+
+#include <memory>
+#include <vector>
+
+/**
+ * @brief The OperatorCache class
+ *
+ * The objects used by the operators of MyImage that are expensive to create (CLAHE, white balance,
+ * ZBar scanner, structuring elements). They are created on the first use, reconfigured only when
+ * their parameters change and kept from one frame to the next. Every MyImage has its own cache.
+ */
+class OperatorCache
+{
+public:
+    OperatorCache();
+
+    cv::Ptr<cv::CLAHE> clahe(double clip_limit, int tiles);
+#ifdef withxphoto
+    cv::Ptr<cv::xphoto::WhiteBalancer> white_balancer();
+#endif
+#ifdef withzbar
+    zbar::ImageScanner& qrcode_scanner();
+#endif
+    const cv::Mat& structuring_element(int shape, int size);
+    const cv::Mat& hitmiss_kernel();
+
+    unsigned long long get_creations();
+
+private:
+    struct Element {
+        int shape, size;
+        cv::Mat kernel;
+    };
+
+    cv::Ptr<cv::CLAHE> clahe_operator;
+    double clahe_clip_limit;
+    int clahe_tiles;
+#ifdef withxphoto
+    cv::Ptr<cv::xphoto::WhiteBalancer> balancer;
+#endif
+#ifdef withzbar
+    std::unique_ptr<zbar::ImageScanner> scanner;
+#endif
+    std::vector<Element> elements;
+    cv::Mat hitmiss;
+    unsigned long long creations;
+};
+
+#endif // OPERATORCACHE_H
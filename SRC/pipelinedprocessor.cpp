@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *  Pipelined execution of the stages of MyImage on several cores. Every group of stages has its
+ *  own thread and its own MyImage, which copies the parameters of the master MyImage (the one
+ *  driven by the GUI) before every frame. The frames travel between the groups through
+ *  FrameRingBuffer queues with the BLOCK policy: no frame is lost or reordered inside the pipeline.
+ *  No Qt thing here.
+*/
+
+#include "pipelinedprocessor.h"
+
+#include <algorithm>
+#include <chrono>
+
+/**
+ * @brief PipelinedProcessor::PipelinedProcessor
+ *
+ * Constructor of the class PipelinedProcessor. Nothing runs until start() is called.
+ */
+PipelinedProcessor::PipelinedProcessor() : input(nullptr),
+                                           master(nullptr),
+                                           running(false),
+                                           settings_version(0)
+{
+}
+
+/**
+ * @brief PipelinedProcessor::~PipelinedProcessor
+ */
+PipelinedProcessor::~PipelinedProcessor() {
+    stop();
+}
+
+/**
+ * @brief PipelinedProcessor::start
+ * @param input: FrameRingBuffer the frames to process
+ * @param master: MyImage the instance that runs the last group, read by pop()'s caller
+ * @param masks: vector of unsigned integers the stages of every group (see MyImage::set_stage_mask)
+ * @param queue_size: integer the number of frames between two groups
+ * @return true if the upstream threads have been launched
+ */
+bool PipelinedProcessor::start(FrameRingBuffer *input, MyImage *master, const std::vector<unsigned int> &masks,
+                               int queue_size) {
+    stop();
+    if (input == nullptr || master == nullptr || masks.size() < 2)
+        return false;
+
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->input  = input;
+    this->master = master;
+    for (size_t i=0; i+1<masks.size(); i++) {
+        MyImage *image = new MyImage();
+        image->copy_resources(*master);
+        image->copy_settings(*master);
+        image->set_stage_mask(masks[i]);
+        this->images.push_back(image);
+        this->queues.push_back(new FrameRingBuffer(queue_size, FrameRingBuffer::BLOCK));
+    }
+    this->master->set_stage_mask(masks.back());
+    update_settings(*master);
+
+    this->running = true;
+    for (size_t i=0; i<this->images.size(); i++)
+        this->threads.push_back(std::thread(&PipelinedProcessor::run, this, i));
+    return true;
+}
+
+/**
+ * @brief PipelinedProcessor::stop
+ *
+ * Stop the upstream threads, delete their MyImage and give all the stages back to the master
+ */
+void PipelinedProcessor::stop() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->running = false;
+    for (size_t i=0; i<this->queues.size(); i++)
+        this->queues[i]->close();
+    for (size_t i=0; i<this->threads.size(); i++)
+        this->threads[i].join();
+    for (size_t i=0; i<this->images.size(); i++) {
+        delete this->images[i];
+        delete this->queues[i];
+    }
+    this->threads.clear();
+    this->images.clear();
+    this->queues.clear();
+    if (this->master != nullptr)
+        this->master->set_stage_mask(~0u);
+    this->master = nullptr;
+}
+
+/**
+ * @brief PipelinedProcessor::update_settings
+ * @param source: MyImage whose toggles and parameters are copied
+ *
+ * Called by the thread of the master after it has changed its parameters. The upstream threads
+ * take the new ones before their next frame, all at once.
+ */
+void PipelinedProcessor::update_settings(const MyImage &source) {
+    std::lock_guard<std::mutex> guard(this->settings_lock);
+    this->settings.copy_settings(source);
+    this->settings_version++;
+}
+
+/**
+ * @brief PipelinedProcessor::isRunning
+ * @return true if the frames go through the upstream threads
+ */
+bool PipelinedProcessor::isRunning() {
+    return this->running;
+}
+
+/**
+ * @brief PipelinedProcessor::pop
+ * @param frame: cv::Mat that receives the output of the last upstream group
+ * @param timeout_ms: integer the maximum waiting time
+ * @return true if a frame has been received. It must then be processed by the master.
+ */
+bool PipelinedProcessor::pop(cv::Mat &frame, int timeout_ms) {
+    // The queues must not be deleted by stop() while waiting
+    std::lock_guard<std::mutex> guard(this->lock);
+    if (!this->running || this->queues.empty())
+        return false;
+    return this->queues.back()->pop(frame, timeout_ms);
+}
+
+/**
+ * @brief PipelinedProcessor::get_number_groups
+ * @return the number of groups including the master, 1 if the pipelined mode is off
+ */
+int PipelinedProcessor::get_number_groups() {
+    return this->running ? (int) this->images.size() + 1 : 1;
+}
+
+/**
+ * @brief PipelinedProcessor::balance
+ * @param costs: vector of doubles the duration of every stage of set_image_content(), in the order of MyImage::Stage
+ * @param groups: integer the number of groups
+ * @return the stage mask of every group
+ *
+ * Split the stages into groups of consecutive stages so that the most expensive group is as
+ * cheap as possible: the throughput of the pipeline is the one of its slowest group.
+ * The last group always contains the last stage (QR code), whose result is read from the master.
+ */
+std::vector<unsigned int> PipelinedProcessor::balance(const std::vector<double> &costs, int groups) {
+    int n = (int) costs.size();
+    groups = std::max(1, std::min(groups, n));
+
+    // best[g][j]: minimal cost of the slowest group when the first j stages are split into g groups
+    std::vector<std::vector<double> > best(groups+1, std::vector<double>(n+1, 1e300));
+    std::vector<std::vector<int> > cut(groups+1, std::vector<int>(n+1, 0));
+    std::vector<double> prefix(n+1, 0.);
+    for (int j=0; j<n; j++)
+        prefix[j+1] = prefix[j] + std::max(0., costs[j]);
+    best[0][0] = 0.;
+    for (int g=1; g<=groups; g++)
+        for (int j=g; j<=n; j++)
+            for (int k=g-1; k<j; k++) {
+                double cost = std::max(best[g-1][k], prefix[j] - prefix[k]);
+                if (cost < best[g][j]) {
+                    best[g][j] = cost;
+                    cut[g][j] = k;
+                }
+            }
+
+    std::vector<unsigned int> masks(groups, 0u);
+    int end = n;
+    for (int g=groups; g>=1; g--) {
+        int begin = cut[g][end];
+        for (int stage=begin; stage<end; stage++)
+            masks[g-1] |= MyImage::stage_bit(stage);
+        end = begin;
+    }
+    return masks;
+}
+
+/**
+ * @brief PipelinedProcessor::run
+ * @param group: index of the upstream group executed by this thread
+ */
+void PipelinedProcessor::run(size_t group) {
+    FrameRingBuffer *in  = group == 0 ? this->input : this->queues[group-1];
+    FrameRingBuffer *out = this->queues[group];
+    MyImage *image = this->images[group];
+    cv::Mat frame, result;
+    unsigned long long version = 0;
+
+    while (this->running) {
+        if (!in->pop(frame, 100)) {
+            // Nothing yet, or the grabbing thread has been stopped
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        // Follow the changes made from the GUI, at a frame boundary
+        if (this->settings_version != version) {
+            std::lock_guard<std::mutex> guard(this->settings_lock);
+            version = this->settings_version;
+            image->copy_settings(this->settings);
+        }
+        image->set_image_content(frame);
+        result = image->get_image_content();
+        out->push(result); // waits while the next group is busy
+    }
+}
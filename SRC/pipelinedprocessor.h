@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef PIPELINEDPROCESSOR_H
+#define PIPELINEDPROCESSOR_H
+
+#include "opencv2/core.hpp"
+
+#include "myimage.h"
+#include "framebuffer.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief The PipelinedProcessor class
+ *
+ * Pipelined mode of the image processing: the stages of MyImage::set_image_content() are split
+ * into groups of consecutive stages, every group runs on its own thread with its own instance
+ * of MyImage and the groups are linked by bounded queues. While frame N is processed by the
+ * last group, frame N+1 is processed by the previous one, and so on.
+ * The last group is the master MyImage, run by the caller (it also computes the side outputs),
+ * so that the frames come out in order and the stateful operations see them in order.
+ */
+class PipelinedProcessor
+{
+public:
+    PipelinedProcessor();
+    ~PipelinedProcessor();
+
+    bool start(FrameRingBuffer *input, MyImage *master, const std::vector<unsigned int> &masks, int queue_size=2);
+    void stop();
+    bool isRunning();
+    bool pop(cv::Mat &frame, int timeout_ms=0);
+    void update_settings(const MyImage &source);
+    int get_number_groups();
+
+    static std::vector<unsigned int> balance(const std::vector<double> &costs, int groups);
+
+private:
+    FrameRingBuffer *input;
+    MyImage *master;
+    std::vector<MyImage*> images;           // one per upstream group
+    std::vector<FrameRingBuffer*> queues;   // output of every upstream group
+    std::vector<std::thread> threads;
+    std::atomic<bool> running;
+    std::mutex lock;
+
+    // Parameters followed by the upstream threads, a snapshot of the master taken between two frames
+    MyImage settings;
+    std::mutex settings_lock;
+    std::atomic<unsigned long long> settings_version;
+
+    void run(size_t group);
+};
+
+#endif // PIPELINEDPROCESSOR_H
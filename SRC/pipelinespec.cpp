@@ -0,0 +1,405 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *  Translates a textual description of the image processing (command line or configuration file)
+ *  into calls to the toggles and setters of the class MyImage. No Qt thing here.
+*/
+
+#include "pipelinespec.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+/**
+ * @brief PipelineSpec::PipelineSpec
+ *
+ * Constructor of the class PipelineSpec. The pipeline is empty.
+ */
+PipelineSpec::PipelineSpec()
+{
+}
+
+/**
+ * @brief PipelineSpec::parse
+ * @param description: string the list of stages, separated by ',' or new lines
+ * @return true if the description is valid. The error can be retrieved with get_error() otherwise
+ */
+bool PipelineSpec::parse(const std::string &description) {
+    static const char* known[] = { "face", "bw", "photo", "tone", "inverse", "histeq", "edge", "blur",
+                                   "threshold", "transform", "qrcode", "motion", "objects", "histogram",
+                                   "output" };
+    this->stages.clear();
+    this->error.clear();
+
+    std::string normalized = description;
+    for (size_t i=0; i<normalized.size(); i++)
+        if (normalized[i] == '\n' || normalized[i] == '\r')
+            normalized[i] = ',';
+
+    std::stringstream list(normalized);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        // Remove the comments and the blanks
+        item = item.substr(0, item.find('#'));
+        item.erase(0, item.find_first_not_of(" \t"));
+        item.erase(item.find_last_not_of(" \t") + 1);
+        if (item.empty())
+            continue;
+
+        Stage stage;
+        std::stringstream fields(item);
+        std::string field;
+        std::getline(fields, stage.name, ':');
+        while (std::getline(fields, field, ':')) {
+            size_t equal = field.find('=');
+            if (equal == std::string::npos || equal == 0) {
+                this->error = "Invalid parameter '"+field+"' for the stage '"+stage.name+"', expected key=value";
+                return false;
+            }
+            stage.params[field.substr(0, equal)] = field.substr(equal+1);
+        }
+
+        bool found = false;
+        for (size_t i=0; i<sizeof(known)/sizeof(known[0]); i++)
+            found = found || stage.name == known[i];
+        if (!found) {
+            this->error = "Unknown stage '"+stage.name+"'";
+            return false;
+        }
+        this->stages.push_back(stage);
+    }
+    return true;
+}
+
+/**
+ * @brief PipelineSpec::load
+ * @param filename: string the configuration file, one stage per line
+ * @return true if the file could be read and its content is valid
+ */
+bool PipelineSpec::load(const std::string &filename) {
+    std::ifstream file(filename.c_str());
+    if (!file) {
+        this->error = "Cannot open the configuration file "+filename;
+        return false;
+    }
+    std::stringstream content;
+    content << file.rdbuf();
+    return parse(content.str());
+}
+
+/**
+ * @brief PipelineSpec::apply
+ * @param image: MyImage the object that will process the frames
+ * @return true if all the parameters could be set
+ *
+ * Deactivates all the modules of image, then activates and configures the stages of the pipeline.
+ * The stages of the image are executed in the order of the description (see ProcessingGraph).
+ */
+bool PipelineSpec::apply(MyImage &image) {
+    this->error.clear();
+    if (!check_parameters())
+        return false;
+
+    image.toggleBW(false);
+    image.toggleInverse(false);
+    image.toggleBlur(false);
+    image.toggleThreshold(false);
+    image.toggleTransformation(false);
+    image.toggleEdge(false);
+    image.toggleHistoEq(false);
+    image.togglePhoto(false);
+    image.toggleTone(false);
+    image.toggleObjectDetection(false);
+    image.toggleMotionDetection(false);
+#ifdef withobjdetect
+    image.toggleFace_Recon(false);
+#endif
+#ifdef withzbar
+    image.toggleQRcode(false);
+#endif
+
+    // Stages that work on the image, in the order of MyImage::Stage
+    std::vector<std::string> names = MyImage::get_stage_names();
+    ProcessingGraph graph;
+
+    int ivalue;
+    double dvalue;
+    for (size_t i=0; i<this->stages.size(); i++) {
+        const Stage &stage = this->stages[i];
+        const std::string &name = stage.name;
+
+        for (int index=MyImage::STAGE_FACE; index<=MyImage::STAGE_QRCODE; index++)
+            if (names[index] == name) {
+                std::string input  = get_string(stage, "in", "main");
+                std::string output = get_string(stage, "out", input);
+                graph.add_node(index, input, output);
+            }
+
+        if (name == "bw") {
+            image.toggleBW(true);
+        }
+        else if (name == "inverse") {
+            image.toggleInverse(true);
+        }
+        else if (name == "blur") {
+            image.toggleBlur(true);
+            int method = 0;
+            if (get_int(stage, "method", ivalue, 1, 12))  image.set_blur_method(method = ivalue);
+            if (get_int(stage, "range", ivalue, 1, 255)) {
+                // Gaussian and median blurs only accept odd sizes
+                if ((method == 2 || method == 3) && ivalue % 2 == 0)
+                    this->error = "Invalid value '"+std::to_string(ivalue)+"' for blur:range, expected an odd size for this method";
+                else
+                    image.set_size_blur(ivalue);
+            }
+            if (get_int(stage, "element", ivalue, 1, 3)) image.set_morpho_element(ivalue);
+        }
+        else if (name == "threshold") {
+            image.toggleThreshold(true);
+            if (get_int(stage, "method", ivalue, 1, 9))   image.set_threshold_method(ivalue);
+            if (get_int(stage, "value", ivalue, 0, 255))  image.set_threshold_value(ivalue);
+            if (get_int(stage, "blocksize", ivalue, 3, 255)) {
+                // Adaptive thresholds only accept odd block sizes
+                if (ivalue % 2 == 0)
+                    this->error = "Invalid value '"+std::to_string(ivalue)+"' for threshold:blocksize, expected an odd size";
+                else
+                    image.set_threshold_blocksize(ivalue);
+            }
+            if (get_int(stage, "type", ivalue, 0, 1))     image.set_threshold_type(ivalue);
+        }
+        else if (name == "transform") {
+            image.toggleTransformation(true);
+            if (get_int(stage, "method", ivalue, 1, 1)) image.set_transf_method(ivalue);
+            if (get_int(stage, "angle", ivalue))        image.set_transf_rotation_value(ivalue);
+        }
+        else if (name == "edge") {
+            image.toggleEdge(true);
+            if (get_int(stage, "method", ivalue, 1, 3))       image.set_edge_method(ivalue);
+            if (get_int(stage, "threshold", ivalue, 0, 255))  image.set_canny_threshold(ivalue);
+            if (get_double(stage, "ratio", dvalue, DBL_MIN))  image.set_canny_ratio(dvalue);
+        }
+        else if (name == "histeq") {
+            image.toggleHistoEq(true);
+            if (get_int(stage, "method", ivalue, 1, 2)) image.set_histo_eq_method(ivalue);
+            if (get_int(stage, "tiles", ivalue, 1))     image.set_histo_eq_tiles(ivalue);
+            if (get_int(stage, "clip", ivalue, 1))      image.set_histo_eq_clip_limit(ivalue);
+        }
+        else if (name == "photo") {
+            image.togglePhoto(true);
+            if (get_int(stage, "method", ivalue, 1, 7))       image.set_photo_method(ivalue);
+            if (get_int(stage, "sigmas", ivalue, 0, 200))     image.set_photo_sigmas(ivalue);
+            if (get_double(stage, "sigmar", dvalue, 0., 1.))  image.set_photo_sigmar(dvalue);
+        }
+        else if (name == "tone") {
+            image.toggleTone(true);
+            if (get_int(stage, "brightness", ivalue, -255, 255)) image.set_tone_brightness(ivalue);
+            if (get_double(stage, "contrast", dvalue, 0.))       image.set_tone_contrast(dvalue);
+            if (get_double(stage, "gamma", dvalue, DBL_MIN))     image.set_tone_gamma(dvalue);
+        }
+        else if (name == "motion") {
+            image.toggleMotionDetection(true);
+            if (get_int(stage, "method", ivalue, 1, 1)) image.set_motion_detection_method(ivalue);
+        }
+        else if (name == "objects") {
+            image.toggleObjectDetection(true);
+            if (get_int(stage, "method", ivalue, 1, 3))   image.set_object_detection_method(ivalue);
+            if (get_int(stage, "threshold", ivalue, 0))   image.set_hough_line_threshold(ivalue);
+        }
+        else if (name == "face") {
+#ifdef withobjdetect
+            image.toggleFace_Recon(true);
+#else
+            this->error = "The stage 'face' requires the OpenCV objdetect library";
+            return false;
+#endif
+        }
+        else if (name == "qrcode") {
+#ifdef withzbar
+            image.toggleQRcode(true);
+#else
+            this->error = "The stage 'qrcode' requires the ZBar library";
+            return false;
+#endif
+        }
+        else if (name == "output") {
+            graph.add_sink(get_string(stage, "buffer", "main"));
+        }
+        if (!this->error.empty())
+            return false;
+    }
+
+    if (!graph.compile()) {
+        this->error = graph.get_error();
+        return false;
+    }
+    return image.set_processing_graph(graph);
+}
+
+/**
+ * @brief PipelineSpec::check_parameters
+ * @return false if a stage has a parameter it does not know, the error is set
+ */
+bool PipelineSpec::check_parameters() {
+    // Parameters of every stage, in=/out= are accepted by all the stages that work on the image
+    static const std::map<std::string, std::vector<std::string> > known = {
+        { "face",      { } },
+        { "bw",        { } },
+        { "photo",     { "method", "sigmas", "sigmar" } },
+        { "tone",      { "brightness", "contrast", "gamma" } },
+        { "inverse",   { } },
+        { "histeq",    { "method", "tiles", "clip" } },
+        { "edge",      { "method", "threshold", "ratio" } },
+        { "blur",      { "method", "range", "element" } },
+        { "threshold", { "method", "value", "blocksize", "type" } },
+        { "transform", { "method", "angle" } },
+        { "qrcode",    { } },
+        { "motion",    { "method" } },
+        { "objects",   { "method", "threshold" } },
+        { "histogram", { } },
+        { "output",    { "buffer" } }
+    };
+    std::vector<std::string> names = MyImage::get_stage_names();
+    for (size_t i=0; i<this->stages.size(); i++) {
+        const Stage &stage = this->stages[i];
+        std::map<std::string, std::vector<std::string> >::const_iterator keys = known.find(stage.name);
+        bool image_stage = false;
+        for (int index=MyImage::STAGE_FACE; index<=MyImage::STAGE_QRCODE; index++)
+            image_stage = image_stage || names[index] == stage.name;
+
+        std::map<std::string, std::string>::const_iterator it;
+        for (it = stage.params.begin(); it != stage.params.end(); ++it) {
+            bool found = image_stage && (it->first == "in" || it->first == "out");
+            if (keys != known.end())
+                for (size_t k=0; k<keys->second.size(); k++)
+                    found = found || keys->second[k] == it->first;
+            if (!found) {
+                this->error = "Unknown parameter '"+it->first+"' for the stage '"+stage.name+"'";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief PipelineSpec::has_stage
+ * @param name: string the name of a stage
+ * @return true if the stage is part of the pipeline
+ */
+bool PipelineSpec::has_stage(const std::string &name) {
+    for (size_t i=0; i<this->stages.size(); i++)
+        if (this->stages[i].name == name)
+            return true;
+    return false;
+}
+
+/**
+ * @brief PipelineSpec::get_error
+ * @return the description of the last error
+ */
+std::string PipelineSpec::get_error() {
+    return this->error;
+}
+
+/**
+ * @brief PipelineSpec::get_description
+ * @return the pipeline written on one line, in the same syntax as parse()
+ */
+std::string PipelineSpec::get_description() {
+    std::string description;
+    for (size_t i=0; i<this->stages.size(); i++) {
+        if (i>0)
+            description += ",";
+        description += this->stages[i].name;
+        std::map<std::string, std::string>::const_iterator it;
+        for (it = this->stages[i].params.begin(); it != this->stages[i].params.end(); ++it)
+            description += ":"+it->first+"="+it->second;
+    }
+    return description;
+}
+
+/**
+ * @brief PipelineSpec::get_help
+ * @return the list of the stages and of their parameters
+ */
+std::string PipelineSpec::get_help() {
+    return "  face                                              face detection\n"
+           "  bw                                                black and white\n"
+           "  photo:method=[1-7]:sigmas=[0-200]:sigmar=[0-1]    module photo\n"
+           "  tone:brightness=N:contrast=X:gamma=X              brightness [-255,255], contrast and gamma (1 = unchanged)\n"
+           "  inverse                                           inverse the colours\n"
+           "  histeq:method=[1-2]:tiles=N:clip=N                histogram equalization (global, CLAHE)\n"
+           "  edge:method=[1-3]:threshold=N:ratio=X             edge detection (Sobel, Laplacian, Canny)\n"
+           "  blur:method=[1-12]:range=N:element=[1-3]          blur and morphological filters (odd range for 2-3)\n"
+           "  threshold:method=[1-9]:value=[0-255]:blocksize=N:type=[0-1]  threshold (odd block size)\n"
+           "  transform:method=1:angle=N                        rotation\n"
+           "  qrcode                                            QR codes and barcodes\n"
+           "  motion:method=1                                   motion detection (side output)\n"
+           "  objects:method=[1-3]:threshold=N                  lines, circles, corners (side output)\n"
+           "  histogram                                         histogram of the image (side output)\n"
+           "  output:buffer=NAME                                keep the buffer NAME as a result (side output)\n"
+           "\n"
+           "  The stages are applied in the order of the list and can be repeated. By default they work\n"
+           "  on the displayed image, the buffer 'main'. in=NAME and out=NAME read and write other buffers,\n"
+           "  for instance \"blur:range=9:out=soft,edge:in=soft,output:buffer=soft\" shows the edges of a\n"
+           "  blurred copy next to the original. The stages whose result is never used are skipped.\n";
+}
+
+/**
+ * @brief PipelineSpec::get_string
+ * @return the parameter key of the stage, default_value if it is not given
+ */
+std::string PipelineSpec::get_string(const Stage &stage, const std::string &key, const std::string &default_value) {
+    std::map<std::string, std::string>::const_iterator it = stage.params.find(key);
+    return it == stage.params.end() || it->second.empty() ? default_value : it->second;
+}
+
+/**
+ * @brief PipelineSpec::get_int
+ * @return true if the parameter key is given for the stage and is a valid integer in [minimum, maximum].
+ *         The error is set if it is given but invalid.
+ */
+bool PipelineSpec::get_int(const Stage &stage, const std::string &key, int &value, int minimum, int maximum) {
+    std::map<std::string, std::string>::const_iterator it = stage.params.find(key);
+    if (it == stage.params.end())
+        return false;
+    char *end = nullptr;
+    long converted = std::strtol(it->second.c_str(), &end, 10);
+    if (end == it->second.c_str() || *end != '\0') {
+        this->error = "Invalid integer '"+it->second+"' for "+stage.name+":"+key;
+        return false;
+    }
+    if (converted < minimum || converted > maximum) {
+        this->error = "Invalid value '"+it->second+"' for "+stage.name+":"+key+", expected "+
+                      (maximum == INT_MAX ? "at least "+std::to_string(minimum)
+                                          : "["+std::to_string(minimum)+", "+std::to_string(maximum)+"]");
+        return false;
+    }
+    value = (int) converted;
+    return true;
+}
+
+/**
+ * @brief PipelineSpec::get_double
+ * @return true if the parameter key is given for the stage and is a valid number in [minimum, maximum].
+ *         The error is set if it is given but invalid.
+ */
+bool PipelineSpec::get_double(const Stage &stage, const std::string &key, double &value, double minimum, double maximum) {
+    std::map<std::string, std::string>::const_iterator it = stage.params.find(key);
+    if (it == stage.params.end())
+        return false;
+    char *end = nullptr;
+    double converted = std::strtod(it->second.c_str(), &end);
+    if (end == it->second.c_str() || *end != '\0') {
+        this->error = "Invalid number '"+it->second+"' for "+stage.name+":"+key;
+        return false;
+    }
+    if (!(converted >= minimum && converted <= maximum)) {
+        this->error = "Invalid value '"+it->second+"' for "+stage.name+":"+key+", out of range";
+        return false;
+    }
+    value = converted;
+    return true;
+}
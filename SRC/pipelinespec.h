@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef PIPELINESPEC_H
+#define PIPELINESPEC_H
+
+#include "myimage.h"
+
+#include <cfloat>
+#include <climits>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The PipelineSpec class
+ *
+ * Textual description of the image processing to apply with MyImage, for instance
+ *      bw,blur:method=2:range=5,threshold:method=6,motion
+ * Every stage is a name followed by optional parameters key=value separated by ':'.
+ * Stages are separated by ',' or by new lines in a configuration file ('#' starts a comment).
+ * The stages are applied in the order of the description, through a ProcessingGraph.
+ */
+class PipelineSpec
+{
+public:
+    struct Stage {
+        std::string name;
+        std::map<std::string, std::string> params;
+    };
+
+    PipelineSpec();
+
+    bool parse(const std::string &description);
+    bool load(const std::string &filename);
+    bool apply(MyImage &image);
+    bool has_stage(const std::string &name);
+    std::string get_error();
+    std::string get_description();
+
+    static std::string get_help();
+
+    std::vector<Stage> stages;
+
+private:
+    std::string error;
+
+    std::string get_string(const Stage &stage, const std::string &key, const std::string &default_value);
+    bool check_parameters();
+    bool get_int(const Stage &stage, const std::string &key, int &value,
+                 int minimum=INT_MIN, int maximum=INT_MAX);
+    bool get_double(const Stage &stage, const std::string &key, double &value,
+                    double minimum=-DBL_MAX, double maximum=DBL_MAX);
+};
+
+#endif // PIPELINESPEC_H
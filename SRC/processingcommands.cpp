@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *  The parameter changes of the processing, applied to the class MyImage in the same way by the GUI
+ *  (captureVideo) and by the replay of the sessions (VideoHeadless). No Qt thing here.
+*/
+
+#include "processingcommands.h"
+
+#include <cmath>
+
+// Names of the commands in the sessions, in the order of ProcessingCommand
+static const char* command_names[NB_COMMANDS] = {
+    "bw", "inverse", "blur", "threshold", "edge", "motion", "face", "objects",
+    "qrcode", "transformation", "histo_eq", "panorama", "photo", "tone",
+    "blur_range", "blur_method", "blur_element",
+    "threshold_value", "threshold_method", "threshold_blocksize", "threshold_type",
+    "edge_method", "canny_threshold", "canny_ratio",
+    "motion_method", "objects_method", "hough_threshold",
+    "transf_method", "transf_rotation",
+    "histo_method", "histo_tiles", "histo_clip", "histo_show",
+    "photo_method", "photo_sigmas", "photo_sigmar",
+    "tone_brightness", "tone_contrast", "tone_gamma",
+    "governor", "target_fps", "fps_cap", "analysis_width",
+    "motion_preroll", "motion_postroll", "motion_threshold",
+    "processing_scale", "fast_variants", "side_outputs"
+};
+
+/**
+ * @brief get_command_name
+ * @param key: integer ProcessingCommand
+ * @return the name of the command in the sessions, "unknown" if key is not a command
+ */
+const char* get_command_name(int key) {
+    return key >= 0 && key < NB_COMMANDS ? command_names[key] : "unknown";
+}
+
+/**
+ * @brief find_command
+ * @param name: string the name of a command in a session
+ * @return the ProcessingCommand, -1 if the name is unknown
+ */
+int find_command(const std::string &name) {
+    for (int key=0; key<NB_COMMANDS; key++)
+        if (name == command_names[key])
+            return key;
+    return -1;
+}
+
+/**
+ * @brief apply_command
+ * @param image: MyImage the object that processes the frames
+ * @param key: integer ProcessingCommand
+ * @param value: double the new value. 0 or 1 for the toggles.
+ * @return true if the command concerns MyImage. The other ones (display, governor, recorders...) are
+ *         left to the caller.
+ */
+bool apply_command(MyImage &image, int key, double value) {
+    int ivalue = (int) std::lround(value);
+    bool state = value != 0.;
+    switch (key) {
+    case CMD_BW:             image.toggleBW(state); break;
+    case CMD_INVERSE:        image.toggleInverse(state); break;
+    case CMD_BLUR:           image.toggleBlur(state); break;
+    case CMD_THRESHOLD:      image.toggleThreshold(state); break;
+    case CMD_EDGE:           image.toggleEdge(state); break;
+    case CMD_MOTION:         image.toggleMotionDetection(state); break;
+#ifdef withobjdetect
+    case CMD_FACE:           image.toggleFace_Recon(state); break;
+#endif // endif withobjdetect
+    case CMD_OBJECTS:        image.toggleObjectDetection(state); break;
+#ifdef withzbar
+    case CMD_QRCODE:         image.toggleQRcode(state); break;
+#endif // endif withzbar
+    case CMD_TRANSFORMATION: image.toggleTransformation(state); break;
+    case CMD_HISTO_EQ:       image.toggleHistoEq(state); break;
+#ifdef withstitching
+    case CMD_PANORAMA:       image.togglePanorama(state); break;
+#endif // endif withstitching
+    case CMD_PHOTO:          image.togglePhoto(state); break;
+    case CMD_TONE:           image.toggleTone(state); break;
+
+    case CMD_BLUR_RANGE:          image.set_size_blur(ivalue); break;
+    case CMD_BLUR_METHOD:         image.set_blur_method(ivalue); break;
+    case CMD_BLUR_ELEMENT:        image.set_morpho_element(ivalue); break;
+    case CMD_THRESHOLD_VALUE:     image.set_threshold_value(ivalue); break;
+    case CMD_THRESHOLD_METHOD:    image.set_threshold_method(ivalue); break;
+    case CMD_THRESHOLD_BLOCKSIZE: image.set_threshold_blocksize(ivalue); break;
+    case CMD_THRESHOLD_TYPE:      image.set_threshold_type(ivalue); break;
+    case CMD_EDGE_METHOD:         image.set_edge_method(ivalue); break;
+    case CMD_CANNY_THRESHOLD:     image.set_canny_threshold(ivalue); break;
+    case CMD_CANNY_RATIO:         image.set_canny_ratio(value); break;
+    case CMD_MOTION_METHOD:       image.set_motion_detection_method(ivalue); break;
+    case CMD_OBJECTS_METHOD:      image.set_object_detection_method(ivalue); break;
+    case CMD_HOUGH_THRESHOLD:     image.set_hough_line_threshold(ivalue); break;
+    case CMD_TRANSF_METHOD:       image.set_transf_method(ivalue); break;
+    case CMD_TRANSF_ROTATION:     image.set_transf_rotation_value(ivalue); break;
+    case CMD_HISTO_METHOD:        image.set_histo_eq_method(ivalue); break;
+    case CMD_HISTO_TILES:         image.set_histo_eq_tiles(ivalue); break;
+    case CMD_HISTO_CLIP:          image.set_histo_eq_clip_limit(ivalue); break;
+    case CMD_PHOTO_METHOD:        image.set_photo_method(ivalue); break;
+    case CMD_PHOTO_SIGMAS:        image.set_photo_sigmas(ivalue); break;
+    case CMD_PHOTO_SIGMAR:        image.set_photo_sigmar(value); break;
+    case CMD_TONE_BRIGHTNESS:     image.set_tone_brightness(ivalue); break;
+    case CMD_TONE_CONTRAST:       image.set_tone_contrast(value); break;
+    case CMD_TONE_GAMMA:          image.set_tone_gamma(value); break;
+    case CMD_ANALYSIS_WIDTH:      image.set_analysis_width(ivalue); break;
+    case CMD_PROCESSING_SCALE:    image.set_processing_scale(value); break;
+    case CMD_FAST_VARIANTS:       image.set_fast_variants(state); break;
+    default:
+        return false;
+    }
+    return true;
+}
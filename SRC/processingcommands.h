@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef PROCESSINGCOMMANDS_H
+#define PROCESSINGCOMMANDS_H
+
+#include "myimage.h"
+
+#include <string>
+
+/**
+ * Parameters of the processing changed while the frames are processed. The GUI posts them to
+ * captureVideo (see CommandQueue), the sessions record them with the frames (see SessionRecorder)
+ * and VideoHeadless replays them.
+ */
+enum ProcessingCommand {
+    CMD_BW = 0, CMD_INVERSE, CMD_BLUR, CMD_THRESHOLD, CMD_EDGE, CMD_MOTION, CMD_FACE, CMD_OBJECTS,
+    CMD_QRCODE, CMD_TRANSFORMATION, CMD_HISTO_EQ, CMD_PANORAMA, CMD_PHOTO, CMD_TONE,
+    CMD_BLUR_RANGE, CMD_BLUR_METHOD, CMD_BLUR_ELEMENT,
+    CMD_THRESHOLD_VALUE, CMD_THRESHOLD_METHOD, CMD_THRESHOLD_BLOCKSIZE, CMD_THRESHOLD_TYPE,
+    CMD_EDGE_METHOD, CMD_CANNY_THRESHOLD, CMD_CANNY_RATIO,
+    CMD_MOTION_METHOD, CMD_OBJECTS_METHOD, CMD_HOUGH_THRESHOLD,
+    CMD_TRANSF_METHOD, CMD_TRANSF_ROTATION,
+    CMD_HISTO_METHOD, CMD_HISTO_TILES, CMD_HISTO_CLIP, CMD_HISTO_SHOW,
+    CMD_PHOTO_METHOD, CMD_PHOTO_SIGMAS, CMD_PHOTO_SIGMAR,
+    CMD_TONE_BRIGHTNESS, CMD_TONE_CONTRAST, CMD_TONE_GAMMA,
+    CMD_GOVERNOR, CMD_TARGET_FPS, CMD_FPS_CAP, CMD_ANALYSIS_WIDTH,
+    CMD_MOTION_PREROLL, CMD_MOTION_POSTROLL, CMD_MOTION_THRESHOLD,
+    // Never posted by the GUI: state of captureVideo recorded in the sessions
+    CMD_PROCESSING_SCALE, CMD_FAST_VARIANTS, CMD_SIDE_OUTPUTS,
+    NB_COMMANDS
+};
+
+/**
+ * Side outputs computed after a frame (value of CMD_SIDE_OUTPUTS)
+ */
+enum SideOutput {
+    SIDE_MOTION = 1, SIDE_OBJECTS = 2, SIDE_HISTOGRAM = 4
+};
+
+const char* get_command_name(int key);
+int find_command(const std::string &name);
+bool apply_command(MyImage &image, int key, double value);
+
+#endif // PROCESSINGCOMMANDS_H
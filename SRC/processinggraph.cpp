@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *  Description of the order of the image processing as a graph of stages linked by named
+ *  buffers, and compilation of this graph into the flat plan executed by MyImage.
+ *  The graph is compiled when it changes, not at every frame. No Qt thing here.
+*/
+
+#include "processinggraph.h"
+
+#include <set>
+
+/**
+ * @brief ProcessingGraph::ProcessingGraph
+ *
+ * Constructor of the class ProcessingGraph. The graph is empty: the image is not modified.
+ */
+ProcessingGraph::ProcessingGraph() : side_effects(0)
+{
+    clear();
+}
+
+/**
+ * @brief ProcessingGraph::clear
+ *
+ * Remove all the nodes and the sinks
+ */
+void ProcessingGraph::clear() {
+    this->nodes.clear();
+    this->sinks.clear();
+    this->plan.clear();
+    this->buffers.assign(1, "main");
+    this->error.clear();
+}
+
+/**
+ * @brief ProcessingGraph::add_node
+ * @param stage: integer the stage (see MyImage::Stage)
+ * @param input: string the buffer read by the stage
+ * @param output: string the buffer written by the stage
+ */
+void ProcessingGraph::add_node(int stage, const std::string &input, const std::string &output) {
+    GraphNode node;
+    node.stage  = stage;
+    node.input  = input;
+    node.output = output;
+    this->nodes.push_back(node);
+}
+
+/**
+ * @brief ProcessingGraph::add_sink
+ * @param buffer: string a buffer whose final content is used outside of the processing
+ */
+void ProcessingGraph::add_sink(const std::string &buffer) {
+    for (size_t i=0; i<this->sinks.size(); i++)
+        if (this->sinks[i] == buffer)
+            return;
+    this->sinks.push_back(buffer);
+}
+
+/**
+ * @brief ProcessingGraph::set_side_effect
+ * @param stage: integer the stage (see MyImage::Stage)
+ * @param state: boolean true if the stage has results besides its image (decoded QR codes, ...)
+ */
+void ProcessingGraph::set_side_effect(int stage, bool state) {
+    if (state)
+        this->side_effects |= 1u << stage;
+    else
+        this->side_effects &= ~(1u << stage);
+}
+
+/**
+ * @brief ProcessingGraph::compile
+ * @param stage_mask: unsigned integer the stages that can be executed (see MyImage::set_stage_mask)
+ * @return true if the graph is valid. The error can be retrieved with get_error() otherwise
+ *
+ * Builds the plan: the nodes are kept in their order, without the ones that are masked
+ * and the ones whose output is overwritten or never read before the end.
+ */
+bool ProcessingGraph::compile(unsigned int stage_mask) {
+    this->plan.clear();
+    this->buffers.assign(1, "main");
+    this->error.clear();
+
+    // Every buffer must be written before being read
+    std::vector<GraphNode> active;
+    std::set<std::string> written;
+    written.insert("main");
+    for (size_t i=0; i<this->nodes.size(); i++) {
+        const GraphNode &node = this->nodes[i];
+        if (!(stage_mask & (1u << node.stage)))
+            continue;
+        if (written.count(node.input) == 0) {
+            this->error = "The buffer '"+node.input+"' is read before being written";
+            return false;
+        }
+        written.insert(node.output);
+        active.push_back(node);
+    }
+    for (size_t i=0; i<this->sinks.size(); i++)
+        if (written.count(this->sinks[i]) == 0) {
+            this->error = "The buffer '"+this->sinks[i]+"' is never written";
+            return false;
+        }
+
+    // Walk backwards from the results to find the nodes that matter
+    std::set<std::string> live(this->sinks.begin(), this->sinks.end());
+    live.insert("main");
+    std::vector<bool> keep(active.size(), false);
+    for (size_t i=active.size(); i-- > 0; ) {
+        const GraphNode &node = active[i];
+        if (live.count(node.output) == 0 && !(this->side_effects & (1u << node.stage)))
+            continue;
+        keep[i] = true;
+        live.erase(node.output);
+        live.insert(node.input);
+    }
+
+    // Buffers that are still read after a given step
+    std::vector<std::set<std::string> > read_after(active.size());
+    std::set<std::string> needed(this->sinks.begin(), this->sinks.end());
+    needed.insert("main");
+    for (size_t i=active.size(); i-- > 0; ) {
+        read_after[i] = needed;
+        if (!keep[i])
+            continue;
+        needed.erase(active[i].output);
+        needed.insert(active[i].input);
+    }
+
+    for (size_t i=0; i<active.size(); i++) {
+        if (!keep[i])
+            continue;
+        PlanStep step;
+        step.stage  = active[i].stage;
+        step.input  = get_buffer_index(active[i].input);
+        if (step.input < 0) {
+            step.input = (int) this->buffers.size();
+            this->buffers.push_back(active[i].input);
+        }
+        step.output = get_buffer_index(active[i].output);
+        if (step.output < 0) {
+            step.output = (int) this->buffers.size();
+            this->buffers.push_back(active[i].output);
+        }
+        // The stages work in place: keep the input if another step or a sink reads it
+        step.copy_input = step.input != step.output && read_after[i].count(active[i].input) > 0;
+        this->plan.push_back(step);
+    }
+    return true;
+}
+
+/**
+ * @brief ProcessingGraph::get_nodes
+ * @return the nodes in their order of execution
+ */
+const std::vector<GraphNode>& ProcessingGraph::get_nodes() const {
+    return this->nodes;
+}
+
+/**
+ * @brief ProcessingGraph::get_plan
+ * @return the steps of the last compilation
+ */
+const std::vector<PlanStep>& ProcessingGraph::get_plan() const {
+    return this->plan;
+}
+
+/**
+ * @brief ProcessingGraph::get_sinks
+ * @return the buffers used outside of the processing, besides "main"
+ */
+const std::vector<std::string>& ProcessingGraph::get_sinks() const {
+    return this->sinks;
+}
+
+/**
+ * @brief ProcessingGraph::get_number_buffers
+ * @return the number of buffers used by the plan, "main" included
+ */
+int ProcessingGraph::get_number_buffers() const {
+    return (int) this->buffers.size();
+}
+
+/**
+ * @brief ProcessingGraph::get_buffer_index
+ * @param name: string the name of a buffer
+ * @return the index of the buffer in the plan, -1 if the plan does not use it
+ */
+int ProcessingGraph::get_buffer_index(const std::string &name) const {
+    for (size_t i=0; i<this->buffers.size(); i++)
+        if (this->buffers[i] == name)
+            return (int) i;
+    return -1;
+}
+
+/**
+ * @brief ProcessingGraph::get_description
+ * @param stage_names: vector of strings the names of the stages
+ * @return the plan written on one line, for instance "blur(main>soft) edge(soft>soft)"
+ */
+std::string ProcessingGraph::get_description(const std::vector<std::string> &stage_names) const {
+    std::string description;
+    for (size_t i=0; i<this->plan.size(); i++) {
+        const PlanStep &step = this->plan[i];
+        if (i>0)
+            description += " ";
+        description += step.stage < (int) stage_names.size() ? stage_names[step.stage] : "?";
+        description += "(" + this->buffers[step.input] + (step.copy_input ? ">>" : ">") + this->buffers[step.output] + ")";
+    }
+    return description.empty() ? "(nothing)" : description;
+}
+
+/**
+ * @brief ProcessingGraph::get_error
+ * @return the description of the last error
+ */
+std::string ProcessingGraph::get_error() const {
+    return this->error;
+}
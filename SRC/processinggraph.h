@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef PROCESSINGGRAPH_H
+#define PROCESSINGGRAPH_H
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief The GraphNode struct
+ *
+ * One stage of the image processing (an index of MyImage::Stage) that reads the image
+ * of a named buffer and writes its result to a named buffer
+ */
+struct GraphNode {
+    int stage;
+    std::string input, output;
+};
+
+/**
+ * @brief The PlanStep struct
+ *
+ * One step of a compiled graph, the buffers are given by their index
+ */
+struct PlanStep {
+    int stage;
+    int input, output;
+    bool copy_input;     // the input is needed later: the stage works on a copy of it
+};
+
+/**
+ * @brief The ProcessingGraph class
+ *
+ * Order of the stages of MyImage::set_image_content(). Stages can be repeated, reordered,
+ * and branched by reading and writing other buffers than "main", the image that is displayed.
+ * compile() turns the nodes into a flat list of steps executed at every frame, without the
+ * nodes whose result is never used. The buffers listed as sinks and "main" are the results.
+ * No Qt thing here.
+ */
+class ProcessingGraph
+{
+public:
+    ProcessingGraph();
+
+    void clear();
+    void add_node(int stage, const std::string &input="main", const std::string &output="main");
+    void add_sink(const std::string &buffer);
+    void set_side_effect(int stage, bool state);
+    bool compile(unsigned int stage_mask=~0u);
+
+    const std::vector<GraphNode>& get_nodes() const;
+    const std::vector<PlanStep>& get_plan() const;
+    const std::vector<std::string>& get_sinks() const;
+    int get_number_buffers() const;
+    int get_buffer_index(const std::string &name) const;
+    std::string get_description(const std::vector<std::string> &stage_names) const;
+    std::string get_error() const;
+
+private:
+    std::vector<GraphNode> nodes;
+    std::vector<std::string> sinks;
+    unsigned int side_effects;          // stages kept even if their image is not used (bits 1<<stage)
+    std::vector<std::string> buffers;   // "main" first
+    std::vector<PlanStep> plan;
+    std::string error;
+};
+
+#endif // PROCESSINGGRAPH_H
@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *  Adaptive quality of the image processing: chooses a quality level from the measured processing
+ *  time of the frames so that the target frame rate is held, and limits the frame rate.
+ *  No Qt thing here.
+*/
+
+#include "qualitygovernor.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <sstream>
+
+// From the full quality to the cheapest processing
+const QualityGovernor::Level QualityGovernor::levels[] = {
+    { 1.,   1, false },
+    { 1.,   2, false },
+    { 1.,   2, true  },
+    { 0.75, 3, true  },
+    { 0.5,  4, true  },
+    { 0.25, 8, true  }
+};
+const int QualityGovernor::number_levels = sizeof(QualityGovernor::levels) / sizeof(QualityGovernor::levels[0]);
+
+// Number of frames over the budget before the quality is lowered
+static const int SLOW_FRAMES = 5;
+// Number of frames with headroom before the quality is raised, doubled after every failed attempt
+static const int MIN_RESTORE_DELAY = 30;
+static const int MAX_RESTORE_DELAY = 960;
+
+/**
+ * @brief QualityGovernor::QualityGovernor
+ *
+ * Constructor of the class QualityGovernor. Disabled, target of 25 frames per second and no maximum.
+ */
+QualityGovernor::QualityGovernor() : enabled(false),
+                                     target_fps(25.),
+                                     fps_cap(0.)
+{
+    reset();
+}
+
+/**
+ * @brief QualityGovernor::set_enabled
+ * @param state: boolean true to adapt the quality, false to always process at the full quality
+ */
+void QualityGovernor::set_enabled(bool state) {
+    this->enabled = state;
+    reset();
+}
+
+/**
+ * @brief QualityGovernor::is_enabled
+ * @return true if the quality is adapted to the target frame rate
+ */
+bool QualityGovernor::is_enabled() {
+    return this->enabled;
+}
+
+/**
+ * @brief QualityGovernor::set_target_fps
+ * @param fps: double the frame rate to hold
+ */
+void QualityGovernor::set_target_fps(double fps) {
+    assert(fps>0.);
+    this->target_fps = fps > 0. ? fps : 1.;
+    this->slow_frames = this->fast_frames = 0;
+    this->restore_delay = MIN_RESTORE_DELAY;
+}
+
+/**
+ * @brief QualityGovernor::get_target_fps
+ * @return the frame rate to hold
+ */
+double QualityGovernor::get_target_fps() {
+    return this->target_fps;
+}
+
+/**
+ * @brief QualityGovernor::set_fps_cap
+ * @param fps: double the maximum frame rate, 0 for no maximum
+ */
+void QualityGovernor::set_fps_cap(double fps) {
+    assert(fps>=0.);
+    this->fps_cap = std::max(0., fps);
+}
+
+/**
+ * @brief QualityGovernor::get_fps_cap
+ * @return the maximum frame rate, 0 if there is no maximum
+ */
+double QualityGovernor::get_fps_cap() {
+    return this->fps_cap;
+}
+
+/**
+ * @brief QualityGovernor::update
+ * @param frame_ms: double the processing time of the last frame, in milliseconds
+ * @return true if the quality level has changed
+ *
+ * The quality is lowered when the average processing time stays over the budget of a frame, and
+ * raised when it stays under 60% of the budget. A level that turns out to be too slow right after
+ * it has been restored is tried again later and later, so that the quality does not oscillate. The
+ * delay is back to its minimum once a restored level has held for twice the delay.
+ */
+bool QualityGovernor::update(double frame_ms) {
+    if (!this->enabled)
+        return false;
+
+    this->average_ms = this->average_ms < 0. ? frame_ms : 0.9*this->average_ms + 0.1*frame_ms;
+    this->frames_at_level++;
+    double budget = 1000. / this->target_fps;
+
+    // A restored level that has held for the whole window is stable: the next attempts start over
+    if (this->restored && this->frames_at_level >= 2*this->restore_delay) {
+        this->restore_delay = MIN_RESTORE_DELAY;
+        this->restored = false;
+    }
+
+    if (this->average_ms > 1.05*budget) {
+        this->fast_frames = 0;
+        if (++this->slow_frames >= SLOW_FRAMES && this->level < number_levels-1) {
+            if (this->restored && this->frames_at_level < 2*this->restore_delay)
+                this->restore_delay = std::min(2*this->restore_delay, MAX_RESTORE_DELAY);
+            change_level(this->level + 1);
+            this->restored = false;
+            return true;
+        }
+    }
+    else if (this->average_ms < 0.6*budget) {
+        this->slow_frames = 0;
+        if (++this->fast_frames >= this->restore_delay && this->level > 0) {
+            change_level(this->level - 1);
+            this->restored = true;
+            return true;
+        }
+    }
+    else {
+        this->slow_frames = this->fast_frames = 0;
+    }
+    return false;
+}
+
+/**
+ * @brief QualityGovernor::reset
+ *
+ * Back to the full quality, the measures are forgotten
+ */
+void QualityGovernor::reset() {
+    this->level = 0;
+    this->average_ms = -1.;
+    this->slow_frames = this->fast_frames = 0;
+    this->frames_at_level = 0;
+    this->restore_delay = MIN_RESTORE_DELAY;
+    this->restored = false;
+}
+
+/**
+ * @brief QualityGovernor::get_sleep_ms
+ * @param frame_ms: double the time since the beginning of the last frame, in milliseconds
+ * @return the number of milliseconds to wait before the next frame to respect the maximum frame rate
+ */
+int QualityGovernor::get_sleep_ms(double frame_ms) {
+    if (this->fps_cap <= 0.)
+        return 0;
+    return std::max(0, (int) std::floor(1000./this->fps_cap - frame_ms));
+}
+
+/**
+ * @brief QualityGovernor::get_level
+ * @return the current quality level, 0 is the full quality
+ */
+int QualityGovernor::get_level() {
+    return this->level;
+}
+
+/**
+ * @brief QualityGovernor::get_number_levels
+ * @return the number of quality levels
+ */
+int QualityGovernor::get_number_levels() {
+    return number_levels;
+}
+
+/**
+ * @brief QualityGovernor::get_scale
+ * @return the resolution of the processing, relative to the resolution of the camera
+ */
+double QualityGovernor::get_scale() {
+    return levels[this->level].scale;
+}
+
+/**
+ * @brief QualityGovernor::get_cadence
+ * @return the analyzers run once every get_cadence() frames
+ */
+int QualityGovernor::get_cadence() {
+    return levels[this->level].cadence;
+}
+
+/**
+ * @brief QualityGovernor::get_fast_variants
+ * @return true if the expensive operators must use their cheaper variants
+ */
+bool QualityGovernor::get_fast_variants() {
+    return levels[this->level].fast_variants;
+}
+
+/**
+ * @brief QualityGovernor::get_description
+ * @return the current quality level in words
+ */
+std::string QualityGovernor::get_description() {
+    if (this->level == 0)
+        return "full quality";
+    const Level &current = levels[this->level];
+    std::stringstream description;
+    description << "resolution " << (int) std::lround(current.scale*100.) << "%, analyzers every "
+                << current.cadence << " frames";
+    if (current.fast_variants)
+        description << ", fast variants";
+    return description.str();
+}
+
+/**
+ * @brief QualityGovernor::change_level
+ * @param new_level: integer the new quality level, the average is measured again
+ */
+void QualityGovernor::change_level(int new_level) {
+    this->level = std::max(0, std::min(number_levels-1, new_level));
+    this->average_ms = -1.;
+    this->slow_frames = this->fast_frames = 0;
+    this->frames_at_level = 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef QUALITYGOVERNOR_H
+#define QUALITYGOVERNOR_H
+
+#include <string>
+
+/**
+ * @brief The QualityGovernor class
+ *
+ * Holds a target frame rate by lowering the quality of the processing when the frames take too long,
+ * and raising it again when there is enough headroom. The quality levels go from the full quality to
+ * a processing at a quarter of the resolution, through a lower cadence of the analyzers (motion,
+ * objects, histogram) and cheaper variants of the expensive operators.
+ * Also computes the pause that keeps the frame rate under a maximum.
+ */
+class QualityGovernor
+{
+public:
+    QualityGovernor();
+
+    void set_enabled(bool state);
+    bool is_enabled();
+    void set_target_fps(double fps);
+    double get_target_fps();
+    void set_fps_cap(double fps);
+    double get_fps_cap();
+
+    bool update(double frame_ms);
+    void reset();
+    int get_sleep_ms(double frame_ms);
+
+    int get_level();
+    int get_number_levels();
+    double get_scale();
+    int get_cadence();
+    bool get_fast_variants();
+    std::string get_description();
+
+private:
+    struct Level {
+        double scale;        // resolution of the processing
+        int cadence;         // the analyzers run once every cadence frames
+        bool fast_variants;  // cheaper variants of the expensive operators
+    };
+    static const Level levels[];
+    static const int number_levels;
+
+    bool enabled;
+    double target_fps, fps_cap;
+    double average_ms;                    // moving average of the processing time of a frame
+    int level;
+    int slow_frames, fast_frames;         // consecutive frames over the budget / with headroom
+    int frames_at_level, restore_delay;
+    bool restored;                        // the last change raised the quality
+
+    void change_level(int new_level);
+};
+
+#endif // QUALITYGOVERNOR_H
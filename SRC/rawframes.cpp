@@ -0,0 +1,859 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *  Raw recording of the frames delivered by the camera, for the profiling and the tuning of the
+ *  processing on the exact same input. The file is made of a header and of one record per frame
+ *  (timestamp + pixels, aligned on 64 bytes), optionally compressed with LZ4 (macro withlz4).
+ *  The replay maps the file in memory: no decoding and no copy of the uncompressed frames.
+ *  No Qt thing here.
+*/
+
+#include "rawframes.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <map>
+
+#ifdef withlz4
+#include <lz4.h>
+#endif
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Layout of the raw files
+static const char RAW_MAGIC[8] = { 'V', 'I', 'D', 'E', 'O', 'R', 'A', 'W' };
+static const uint32_t RAW_VERSION = 1;
+static const uint32_t RAW_FLAG_LZ4 = 1;
+static const size_t RAW_ALIGNMENT = 64;
+
+/**
+ * @brief The RawFileHeader struct
+ *
+ * Beginning of a raw file
+ */
+struct RawFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;             // RAW_FLAG_LZ4 if the frames may be compressed
+    int32_t width, height, type;
+    uint32_t frame_bytes;       // size of an uncompressed frame
+    double fps;
+    uint64_t frame_count;       // 0 if the recording has not been stopped properly
+    uint8_t reserved[16];
+};
+
+/**
+ * @brief The RawRecordHeader struct
+ *
+ * Beginning of the record of a frame, followed by its data and padded to RAW_ALIGNMENT bytes
+ */
+struct RawRecordHeader {
+    uint64_t timestamp;         // microseconds since the start of the recording
+    uint32_t stored_bytes;      // size of the data of the frame
+    uint32_t compressed;        // 1 if the data is compressed with LZ4
+    uint8_t reserved[48];
+};
+
+static_assert(sizeof(RawFileHeader) == RAW_ALIGNMENT, "The header of the raw files must keep the frames aligned");
+static_assert(sizeof(RawRecordHeader) == RAW_ALIGNMENT, "The header of the records must keep the frames aligned");
+
+/**
+ * @brief aligned
+ * @return bytes rounded up to a multiple of RAW_ALIGNMENT
+ */
+static size_t aligned(size_t bytes) {
+    return (bytes + RAW_ALIGNMENT - 1) / RAW_ALIGNMENT * RAW_ALIGNMENT;
+}
+
+/**
+ * @brief RawFrameWriter::RawFrameWriter
+ * @param capacity: integer the number of frames that can wait for the writing thread
+ * @param wait: boolean if true, push() waits for a free place in the queue. Otherwise the frame is
+ *              dropped and the producer never waits.
+ *
+ * Constructor of the class RawFrameWriter. The thread is launched by start()
+ */
+RawFrameWriter::RawFrameWriter(int capacity, bool wait) : capacity(capacity > 0 ? capacity : 1),
+                                               wait(wait),
+                                               running(false),
+                                               file(nullptr),
+                                               fps(0.),
+                                               compress(false),
+                                               type(-1),
+                                               written(0),
+                                               dropped(0),
+                                               written_bytes(0),
+                                               raw_bytes(0),
+                                               write_us(0),
+                                               received(0),
+                                               first_dropped(-1)
+{
+}
+
+/**
+ * @brief RawFrameWriter::~RawFrameWriter
+ *
+ * Write the waiting frames and close the file before destroying the object
+ */
+RawFrameWriter::~RawFrameWriter() {
+    stop();
+}
+
+/**
+ * @brief RawFrameWriter::start
+ * @param filename: string the raw file
+ * @param fps: double the nominal frame rate written in the header (the timestamps are exact)
+ * @param compress: boolean if true, the frames are compressed with LZ4 when it is available
+ * @return true if the file could be created and the thread has been launched
+ *
+ * The size and the type of the frames are those of the first frame. The other frames must be the same.
+ */
+bool RawFrameWriter::start(const std::string &filename, double fps, bool compress) {
+    stop();
+    this->file = std::fopen(filename.c_str(), "wb");
+    if (this->file == nullptr)
+        return false;
+
+    this->filename = filename;
+    this->fps      = fps;
+    this->compress = compress && isCompressionAvailable();
+    this->size     = cv::Size();
+    this->type     = -1;
+    this->written       = 0;
+    this->dropped       = 0;
+    this->written_bytes = 0;
+    this->raw_bytes     = 0;
+    this->write_us      = 0;
+    this->received      = 0;
+    this->first_dropped = -1;
+    // Rewritten with the size of the frames once the first one is known
+    if (!write_header(0)) {
+        std::fclose(this->file);
+        this->file = nullptr;
+        return false;
+    }
+    this->origin  = std::chrono::steady_clock::now();
+    this->running = true;
+    this->thread = std::thread(&RawFrameWriter::run, this);
+    return true;
+}
+
+/**
+ * @brief RawFrameWriter::stop
+ *
+ * The frames still in the queue are written, then the number of frames is written in the header
+ */
+void RawFrameWriter::stop() {
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->running = false;
+    }
+    if (this->thread.joinable())
+        this->thread.join();
+    if (this->file != nullptr) {
+        write_header(this->written);
+        std::fclose(this->file);
+        this->file = nullptr;
+    }
+}
+
+/**
+ * @brief RawFrameWriter::isRunning
+ * @return true if the frames are recorded
+ */
+bool RawFrameWriter::isRunning() {
+    return this->running;
+}
+
+/**
+ * @brief RawFrameWriter::push
+ * @param frame: cv::Mat the frame as delivered by the source, copied before the function returns
+ * @return true if the frame has been queued. False if it has been dropped
+ *
+ * Called by one producer only (the grabbing thread). The time of the call is the timestamp of the frame.
+ */
+bool RawFrameWriter::push(const cv::Mat &frame) {
+    if (!this->running || frame.empty())
+        return false;
+    Frame queued;
+    queued.timestamp = (unsigned long long) std::chrono::duration_cast<std::chrono::microseconds>(
+                           std::chrono::steady_clock::now() - this->origin).count();
+    queued.index = this->received++;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            if (!this->running)
+                return false;
+            if ((int) this->queue.size() < this->capacity) {
+                if (!this->spare.empty()) {
+                    queued.image = this->spare.back();
+                    this->spare.pop_back();
+                }
+                break;
+            }
+            if (!this->wait) {
+                // The disk is too slow, better lose a frame than hold up the camera
+                drop(queued.index);
+                return false;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    // The copy is done outside of the lock, the writing thread is not held up
+    frame.copyTo(queued.image);
+
+    std::lock_guard<std::mutex> guard(this->lock);
+    if (!this->running)
+        return false;
+    this->queue.push_back(queued);
+    return true;
+}
+
+/**
+ * @brief RawFrameWriter::isCompressionAvailable
+ * @return true if the program has been built with LZ4 (macro withlz4)
+ */
+bool RawFrameWriter::isCompressionAvailable() {
+#ifdef withlz4
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief RawFrameWriter::get_filename
+ * @return the file of the last recording
+ */
+std::string RawFrameWriter::get_filename() {
+    return this->filename;
+}
+
+/**
+ * @brief RawFrameWriter::get_written_frames
+ * @return the number of frames written since start()
+ */
+unsigned long long RawFrameWriter::get_written_frames() {
+    return this->written;
+}
+
+/**
+ * @brief RawFrameWriter::get_dropped_frames
+ * @return the number of frames lost since start(): full queue, different size or error of the disk
+ */
+unsigned long long RawFrameWriter::get_dropped_frames() {
+    return this->dropped;
+}
+
+/**
+ * @brief RawFrameWriter::get_first_dropped
+ * @return the index (order of push() since start()) of the first frame lost, -1 if none. The frames
+ *         of the file are the frames pushed before it, in the same order.
+ */
+long long RawFrameWriter::get_first_dropped() {
+    return this->first_dropped;
+}
+
+/**
+ * @brief RawFrameWriter::drop
+ * @param index: integer the order of the lost frame
+ */
+void RawFrameWriter::drop(unsigned long long index) {
+    long long none = -1;
+    this->first_dropped.compare_exchange_strong(none, (long long) index);
+    this->dropped++;
+}
+
+/**
+ * @brief RawFrameWriter::get_written_bytes
+ * @return the size of the records written since start()
+ */
+unsigned long long RawFrameWriter::get_written_bytes() {
+    return this->written_bytes;
+}
+
+/**
+ * @brief RawFrameWriter::get_compression_ratio
+ * @return the size of the frames divided by the size of their records, 1 if nothing has been written
+ */
+double RawFrameWriter::get_compression_ratio() {
+    unsigned long long bytes = this->written_bytes;
+    return bytes > 0 ? (double) this->raw_bytes / bytes : 1.;
+}
+
+/**
+ * @brief RawFrameWriter::get_mean_write_ms
+ * @return the mean time spent to compress and write one frame, in milliseconds
+ */
+double RawFrameWriter::get_mean_write_ms() {
+    unsigned long long n = this->written;
+    return n > 0 ? this->write_us / 1000. / n : 0.;
+}
+
+/**
+ * @brief RawFrameWriter::write_header
+ * @param frame_count: integer the number of frames of the file, 0 while recording
+ * @return true if the header could be written. The file is then positioned at its end.
+ */
+bool RawFrameWriter::write_header(unsigned long long frame_count) {
+    RawFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, RAW_MAGIC, sizeof(RAW_MAGIC));
+    header.version     = RAW_VERSION;
+    header.flags       = this->compress ? RAW_FLAG_LZ4 : 0;
+    header.width       = this->size.width;
+    header.height      = this->size.height;
+    header.type        = this->type < 0 ? 0 : this->type;
+    header.frame_bytes = this->type < 0 ? 0 : (uint32_t) (this->size.area() * CV_ELEM_SIZE(this->type));
+    header.fps         = this->fps;
+    header.frame_count = frame_count;
+
+    bool success = std::fseek(this->file, 0, SEEK_SET) == 0 &&
+                   std::fwrite(&header, sizeof(header), 1, this->file) == 1;
+    std::fseek(this->file, 0, SEEK_END);
+    return success;
+}
+
+/**
+ * @brief RawFrameWriter::write_frame
+ * @param frame: Frame the frame and its timestamp
+ * @param compressed: vector of char the buffer of the compression, kept between the frames
+ * @return true if the frame has been written
+ */
+bool RawFrameWriter::write_frame(const Frame &frame, std::vector<char> &compressed) {
+    if (this->type < 0) {
+        // First frame: it gives the size of all the frames
+        this->size = frame.image.size();
+        this->type = frame.image.type();
+        write_header(0);
+    }
+    if (frame.image.size() != this->size || frame.image.type() != this->type) {
+        drop(frame.index);
+        return false;
+    }
+
+    size_t bytes = frame.image.total() * frame.image.elemSize();
+    const char *data = (const char*) frame.image.data;
+    RawRecordHeader record;
+    std::memset(&record, 0, sizeof(record));
+    record.timestamp    = frame.timestamp;
+    record.stored_bytes = (uint32_t) bytes;
+    record.compressed   = 0;
+#ifdef withlz4
+    if (this->compress) {
+        int bound = LZ4_compressBound((int) bytes);
+        compressed.resize(bound);
+        int stored = LZ4_compress_default(data, compressed.data(), (int) bytes, bound);
+        // Incompressible frames (noise) are stored as they are
+        if (stored > 0 && (size_t) stored < bytes) {
+            data = compressed.data();
+            record.stored_bytes = (uint32_t) stored;
+            record.compressed   = 1;
+        }
+    }
+#else
+    (void) compressed;
+#endif
+
+    static const char padding[RAW_ALIGNMENT] = { 0 };
+    size_t padding_bytes = aligned(record.stored_bytes) - record.stored_bytes;
+    bool success = std::fwrite(&record, sizeof(record), 1, this->file) == 1 &&
+                   std::fwrite(data, 1, record.stored_bytes, this->file) == record.stored_bytes &&
+                   std::fwrite(padding, 1, padding_bytes, this->file) == padding_bytes;
+    if (!success) {
+        if (this->dropped == 0)
+            std::cerr << "RawFrameWriter::write_frame(): Cannot write in " << this->filename << std::endl;
+        drop(frame.index);
+        return false;
+    }
+    this->written++;
+    this->written_bytes += sizeof(record) + record.stored_bytes + padding_bytes;
+    this->raw_bytes     += sizeof(record) + bytes;
+    return true;
+}
+
+/**
+ * @brief RawFrameWriter::run
+ *
+ * Loop of the thread: write the queued frames until stop() is called and the queue is empty
+ */
+void RawFrameWriter::run() {
+    Frame frame;
+    std::vector<char> compressed;
+    while (true) {
+        // Read running before looking at the queue, so that the frames pushed before stop() are not lost
+        bool active = this->running;
+        bool available = false;
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            if (!this->queue.empty()) {
+                frame = this->queue.front();
+                this->queue.pop_front();
+                available = true;
+            }
+        }
+        if (!available) {
+            if (!active)
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            continue;
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        write_frame(frame, compressed);
+        this->write_us += (unsigned long long) std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::steady_clock::now() - start).count();
+
+        // The buffer goes back to push()
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->spare.push_back(frame.image);
+        frame.image.release();
+    }
+}
+
+/**
+ * @brief The MappedPages class
+ *
+ * The frames of a private mapping in use. The pages modified in place by the processing are private
+ * copies that the system cannot drop: when the last cv::Mat of a frame is released, its pages are
+ * discarded and show the file again, except the pages shared with a neighbour frame still in use.
+ * Without that, a pass on a long file would keep a copy of every processed frame.
+ */
+class MappedPages
+{
+public:
+    MappedPages() {
+#ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        this->page_size = (uintptr_t) info.dwPageSize;
+#else
+        this->page_size = (uintptr_t) sysconf(_SC_PAGESIZE);
+#endif
+    }
+
+    /**
+     * @brief acquire
+     * @param data: pointer to the pixels of a frame in the mapping
+     * @param bytes: integer the size of the frame
+     */
+    void acquire(uchar *data, size_t bytes) {
+        std::lock_guard<std::mutex> guard(this->lock);
+        Frame &frame = this->frames[data];
+        frame.bytes = bytes;
+        frame.users++;
+    }
+
+    /**
+     * @brief release
+     * @param data: pointer to the pixels of a frame given to acquire()
+     *
+     * Called when a cv::Mat of the frame is released, the pages are discarded with the last one
+     */
+    void release(uchar *data) {
+        std::lock_guard<std::mutex> guard(this->lock);
+        std::map<uchar*, Frame>::iterator it = this->frames.find(data);
+        if (it == this->frames.end() || --it->second.users > 0)
+            return;
+
+        // Only the pages that no other frame in use overlaps
+        uintptr_t begin = (uintptr_t) data / this->page_size * this->page_size;
+        uintptr_t end   = ((uintptr_t) data + it->second.bytes + this->page_size - 1) / this->page_size * this->page_size;
+        if (it != this->frames.begin()) {
+            std::map<uchar*, Frame>::iterator previous = std::prev(it);
+            if ((uintptr_t) previous->first + previous->second.bytes > begin)
+                begin += this->page_size;
+        }
+        std::map<uchar*, Frame>::iterator next = std::next(it);
+        if (next != this->frames.end() && (uintptr_t) next->first < end)
+            end -= this->page_size;
+        this->frames.erase(it);
+        if (end <= begin)
+            return;
+#ifdef _WIN32
+        // A view FILE_MAP_COPY cannot go back to the file, the pages are at least removed from the
+        // working set (VirtualUnlock on pages that are not locked)
+        VirtualUnlock((void*) begin, end - begin);
+#else
+        // MADV_DONTNEED on a private mapping drops the private copies, the file is read again if needed
+        madvise((void*) begin, end - begin, MADV_DONTNEED);
+#endif
+    }
+
+private:
+    struct Frame {
+        size_t bytes = 0;
+        int users = 0;          // cv::Mat wrapping the frame (see wrap_mapped_frame())
+    };
+
+    std::mutex lock;
+    std::map<uchar*, Frame> frames;
+    uintptr_t page_size;
+};
+
+/**
+ * @brief The RawFileSource::Mapping struct
+ *
+ * A raw file mapped in memory. The mapping is private: the frames modified in place by the processing
+ * get their own copy of the pages, discarded when the frame is released (see MappedPages), and the
+ * file is never modified.
+ */
+struct RawFileSource::Mapping {
+    uchar *data;
+    size_t length;
+    MappedPages pages;
+#ifdef _WIN32
+    HANDLE file, handle;
+#else
+    int descriptor;
+#endif
+
+    Mapping() : data(nullptr), length(0),
+#ifdef _WIN32
+                file(INVALID_HANDLE_VALUE), handle(NULL)
+#else
+                descriptor(-1)
+#endif
+    {
+    }
+
+    bool open(const std::string &filename) {
+#ifdef _WIN32
+        this->file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                 FILE_ATTRIBUTE_NORMAL, NULL);
+        LARGE_INTEGER bytes;
+        if (this->file == INVALID_HANDLE_VALUE || !GetFileSizeEx(this->file, &bytes) || bytes.QuadPart == 0)
+            return false;
+        this->length = (size_t) bytes.QuadPart;
+        this->handle = CreateFileMappingA(this->file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+        if (this->handle == NULL)
+            return false;
+        this->data = (uchar*) MapViewOfFile(this->handle, FILE_MAP_COPY, 0, 0, 0);
+        return this->data != nullptr;
+#else
+        this->descriptor = ::open(filename.c_str(), O_RDONLY);
+        struct stat info;
+        if (this->descriptor < 0 || fstat(this->descriptor, &info) != 0 || info.st_size == 0)
+            return false;
+        this->length = (size_t) info.st_size;
+        void *address = mmap(nullptr, this->length, PROT_READ | PROT_WRITE, MAP_PRIVATE, this->descriptor, 0);
+        if (address == MAP_FAILED)
+            return false;
+        this->data = (uchar*) address;
+        madvise(address, this->length, MADV_SEQUENTIAL);
+        return true;
+#endif
+    }
+
+    ~Mapping() {
+#ifdef _WIN32
+        if (this->data != nullptr)
+            UnmapViewOfFile(this->data);
+        if (this->handle != NULL)
+            CloseHandle(this->handle);
+        if (this->file != INVALID_HANDLE_VALUE)
+            CloseHandle(this->file);
+#else
+        if (this->data != nullptr)
+            munmap(this->data, this->length);
+        if (this->descriptor >= 0)
+            ::close(this->descriptor);
+#endif
+    }
+};
+
+/**
+ * @brief The MappingAllocator class
+ *
+ * Lets a cv::Mat reference a frame of a mapped file: the file stays mapped as long as one of its
+ * frames is in use, wherever it went (ring buffers, MyImage, recorders...). The buffers allocated
+ * later for these cv::Mat come from the default allocator.
+ */
+class MappingAllocator : public cv::MatAllocator
+{
+public:
+    // Owner of a frame, kept in cv::UMatData::userdata
+    struct MappedFrame {
+        std::shared_ptr<void> mapping;
+        MappedPages *pages;     // belongs to the mapping
+    };
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override {
+        return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usageFlags);
+    }
+
+    bool allocate(cv::UMatData* data, cv::AccessFlag accessflags, cv::UMatUsageFlags usageFlags) const override {
+        return cv::Mat::getStdAllocator()->allocate(data, accessflags, usageFlags);
+    }
+
+    void deallocate(cv::UMatData* data) const override {
+        if (data == nullptr)
+            return;
+        // Give back the pages modified in place, then release the reference of the frame on its mapping
+        MappedFrame *frame = static_cast<MappedFrame*>(data->userdata);
+        frame->pages->release(data->origdata);
+        delete frame;
+        delete data;
+    }
+
+    /**
+     * @brief get
+     * @return the allocator of the mapped frames, never destroyed so that it outlives all the frames
+     */
+    static MappingAllocator* get() {
+        static MappingAllocator *allocator = new MappingAllocator();
+        return allocator;
+    }
+};
+
+/**
+ * @brief wrap_mapped_frame
+ * @param owner: the mapping that contains the frame
+ * @param pages: MappedPages the frames of the mapping in use
+ * @param data: pointer to the pixels in the mapping
+ * @param size: cv::Size the dimensions of the frame
+ * @param type: integer the OpenCV type of the frame
+ * @return a cv::Mat on the pixels of the mapping, without any copy
+ */
+static cv::Mat wrap_mapped_frame(const std::shared_ptr<void> &owner, MappedPages &pages, uchar *data,
+                                 cv::Size size, int type) {
+    cv::Mat frame(size, type, data);
+    cv::UMatData *u = new cv::UMatData(MappingAllocator::get());
+    u->data = u->origdata = data;
+    u->size     = frame.total() * frame.elemSize();
+    u->refcount = 1; // the reference of frame
+    pages.acquire(data, u->size);
+    MappingAllocator::MappedFrame *owned = new MappingAllocator::MappedFrame;
+    owned->mapping = owner;
+    owned->pages   = &pages;
+    u->userdata = owned;
+    frame.u = u;
+    return frame;
+}
+
+/**
+ * @brief RawFileSource::RawFileSource
+ * @param filename: string the raw file written by RawFrameWriter
+ * @param realtime: boolean if true, the frames are delivered at the pace of their timestamps
+ * @param loop: boolean if true, restart from the beginning at the end of the file
+ */
+RawFileSource::RawFileSource(const std::string &filename, bool realtime, bool loop) : filename(filename),
+                                                                                     realtime(realtime),
+                                                                                     loop(loop),
+                                                                                     compressed(false),
+                                                                                     type(0),
+                                                                                     frame_bytes(0),
+                                                                                     fps(0.),
+                                                                                     current(0),
+                                                                                     first_timed(0)
+{
+}
+
+RawFileSource::~RawFileSource() {
+    release();
+}
+
+/**
+ * @brief RawFileSource::map
+ * @return true if the file could be mapped in memory
+ *
+ * A new mapping is made for every pass on the file: the frames of the previous pass may have been
+ * modified in place, and their mapping lives until they are released
+ */
+bool RawFileSource::map() {
+    std::shared_ptr<Mapping> new_mapping = std::make_shared<Mapping>();
+    if (!new_mapping->open(this->filename))
+        return false;
+    this->mapping = new_mapping;
+    return true;
+}
+
+bool RawFileSource::open() {
+    release();
+    if (!map()) {
+        std::cerr << "RawFileSource::open(): Cannot map the file " << this->filename << std::endl;
+        return false;
+    }
+    RawFileHeader header;
+    if (this->mapping->length >= sizeof(header))
+        std::memcpy(&header, this->mapping->data, sizeof(header));
+    if (this->mapping->length < sizeof(header) || std::memcmp(header.magic, RAW_MAGIC, sizeof(RAW_MAGIC)) != 0 ||
+        header.version != RAW_VERSION || header.width <= 0 || header.height <= 0 ||
+        header.frame_bytes != (uint32_t) (header.width * header.height * CV_ELEM_SIZE(header.type))) {
+        std::cerr << "RawFileSource::open(): " << this->filename << " is not a valid raw file" << std::endl;
+        release();
+        return false;
+    }
+    this->size        = cv::Size(header.width, header.height);
+    this->type        = header.type;
+    this->frame_bytes = header.frame_bytes;
+    this->fps         = header.fps;
+    this->compressed  = false;
+
+    // Index of the records. The file may have been cut (recording not stopped properly): the last
+    // complete record is the end.
+    size_t offset = sizeof(header);
+    RawRecordHeader record;
+    while (offset + sizeof(record) <= this->mapping->length) {
+        std::memcpy(&record, this->mapping->data + offset, sizeof(record));
+        if (offset + sizeof(record) + record.stored_bytes > this->mapping->length ||
+            (!record.compressed && record.stored_bytes != this->frame_bytes))
+            break;
+        this->offsets.push_back(offset);
+        this->timestamps.push_back(record.timestamp);
+        this->compressed = this->compressed || record.compressed;
+        offset += sizeof(record) + aligned(record.stored_bytes);
+    }
+    if (this->offsets.empty()) {
+        std::cerr << "RawFileSource::open(): No frame in " << this->filename << std::endl;
+        release();
+        return false;
+    }
+#ifndef withlz4
+    if (this->compressed) {
+        std::cerr << "RawFileSource::open(): " << this->filename << " is compressed with LZ4, which is not available" << std::endl;
+        release();
+        return false;
+    }
+#endif
+    if (this->fps <= 0. && this->timestamps.size() > 1 && this->timestamps.back() > this->timestamps.front())
+        this->fps = 1e6 * (this->timestamps.size()-1) / (this->timestamps.back() - this->timestamps.front());
+
+    this->current     = 0;
+    this->first_timed = 0;
+    this->start = std::chrono::steady_clock::now();
+    return true;
+}
+
+void RawFileSource::release() {
+    // The frames still in use keep their own reference on the mapping
+    this->mapping.reset();
+    this->offsets.clear();
+    this->timestamps.clear();
+    this->current = 0;
+}
+
+bool RawFileSource::isOpened() {
+    return this->mapping != nullptr;
+}
+
+bool RawFileSource::read(cv::Mat &frame) {
+    if (this->mapping == nullptr)
+        return false;
+    if (this->current >= (long long) this->offsets.size()) {
+        if (!this->loop || !map())
+            return false;
+        this->current     = 0;
+        this->first_timed = 0;
+        this->start = std::chrono::steady_clock::now();
+    }
+
+    // Deliver the frames at the pace of the recording
+    if (this->realtime)
+        std::this_thread::sleep_until(this->start + std::chrono::microseconds(
+                                          (long long) (this->timestamps[this->current] - this->timestamps[this->first_timed])));
+
+    uchar *data = this->mapping->data + this->offsets[this->current];
+    RawRecordHeader record;
+    std::memcpy(&record, data, sizeof(record));
+    data += sizeof(record);
+    this->current++;
+
+    if (!record.compressed) {
+        frame = wrap_mapped_frame(this->mapping, this->mapping->pages, data, this->size, this->type);
+        return true;
+    }
+#ifdef withlz4
+    // Never decompress into the pages of a mapping
+    if (frame.u != nullptr && frame.u->currAllocator == MappingAllocator::get())
+        frame.release();
+    frame.create(this->size, this->type);
+    int decompressed = LZ4_decompress_safe((const char*) data, (char*) frame.data, (int) record.stored_bytes,
+                                           (int) this->frame_bytes);
+    if (decompressed != (int) this->frame_bytes) {
+        std::cerr << "RawFileSource::read(): Corrupted frame " << this->current-1 << " in " << this->filename << std::endl;
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+cv::Size RawFileSource::get_size() {
+    return this->size;
+}
+
+double RawFileSource::get_fps() {
+    return this->fps;
+}
+
+std::string RawFileSource::get_name() {
+    return this->filename;
+}
+
+/**
+ * @brief RawFileSource::seek
+ * @param index: integer the frame delivered by the next read()
+ * @return true if the frame exists
+ */
+bool RawFileSource::seek(long long index) {
+    if (this->mapping == nullptr || index < 0 || index >= (long long) this->offsets.size())
+        return false;
+    // The frames after index may have been delivered and modified already
+    if (!map())
+        return false;
+    this->current     = index;
+    this->first_timed = index;
+    this->start = std::chrono::steady_clock::now();
+    return true;
+}
+
+/**
+ * @brief RawFileSource::get_position
+ * @return the index of the frame delivered by the next read()
+ */
+long long RawFileSource::get_position() {
+    return this->current;
+}
+
+/**
+ * @brief RawFileSource::get_frame_count
+ * @return the number of complete frames in the file
+ */
+long long RawFileSource::get_frame_count() {
+    return (long long) this->offsets.size();
+}
+
+/**
+ * @brief RawFileSource::get_timestamp
+ * @param index: integer the index of a frame
+ * @return the time of the frame since the first one, in seconds
+ */
+double RawFileSource::get_timestamp(long long index) {
+    assert(index>=0 && index<(long long) this->timestamps.size());
+    if (index < 0 || index >= (long long) this->timestamps.size())
+        return 0.;
+    return (this->timestamps[index] - this->timestamps[0]) / 1e6;
+}
+
+/**
+ * @brief RawFileSource::isCompressed
+ * @return true if some frames of the file are compressed with LZ4 (they are then copied when read)
+ */
+bool RawFileSource::isCompressed() {
+    return this->compressed;
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef RAWFRAMES_H
+#define RAWFRAMES_H
+
+#include "opencv2/core.hpp"
+#include "framesource.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief The RawFrameWriter class
+ *
+ * Records the frames exactly as they are delivered, without any lossy compression, in a raw file:
+ * a header, then one record per frame (timestamp + pixels), optionally compressed with LZ4.
+ * The frames are copied by push() and written (and compressed) by a dedicated thread. When the queue
+ * is full, push() drops the frame, or waits for the thread if nothing must be lost (sessions).
+ */
+class RawFrameWriter
+{
+public:
+    explicit RawFrameWriter(int capacity=16, bool wait=false);
+    ~RawFrameWriter();
+
+    bool start(const std::string &filename, double fps, bool compress);
+    void stop();
+    bool isRunning();
+    bool push(const cv::Mat &frame);
+
+    static bool isCompressionAvailable();
+    std::string get_filename();
+    unsigned long long get_written_frames();
+    unsigned long long get_dropped_frames();
+    long long get_first_dropped();
+    unsigned long long get_written_bytes();
+    double get_compression_ratio();
+    double get_mean_write_ms();
+
+private:
+    struct Frame {
+        cv::Mat image;
+        unsigned long long timestamp;   // microseconds since start()
+        unsigned long long index;       // order of the call to push()
+    };
+
+    std::deque<Frame> queue;
+    std::vector<cv::Mat> spare;         // buffers of the written frames, recycled by push()
+    int capacity;
+    bool wait;
+    std::mutex lock;
+    std::thread thread;
+    std::atomic<bool> running;
+    std::string filename;
+    std::FILE *file;
+    double fps;
+    bool compress;
+    cv::Size size;
+    int type;
+    std::chrono::steady_clock::time_point origin;
+    std::atomic<unsigned long long> written, dropped, written_bytes, raw_bytes, write_us;
+    unsigned long long received;        // calls to push(), producer only
+    std::atomic<long long> first_dropped;
+
+    void run();
+    void drop(unsigned long long index);
+    bool write_header(unsigned long long frame_count);
+    bool write_frame(const Frame &frame, std::vector<char> &compressed);
+};
+
+/**
+ * @brief The RawFileSource class
+ *
+ * Frames from a raw file written by RawFrameWriter. The file is mapped in memory: the uncompressed
+ * frames are delivered without any copy, and any frame can be reached directly (seek()).
+ * By default the frames are delivered as fast as they are read, realtime follows their timestamps.
+ */
+class RawFileSource : public FrameSource
+{
+public:
+    explicit RawFileSource(const std::string &filename, bool realtime=false, bool loop=false);
+    ~RawFileSource();
+
+    bool open() override;
+    void release() override;
+    bool isOpened() override;
+    bool read(cv::Mat &frame) override;
+    cv::Size get_size() override;
+    double get_fps() override;
+    std::string get_name() override;
+
+    bool seek(long long index);
+    long long get_position();
+    long long get_frame_count();
+    double get_timestamp(long long index);
+    bool isCompressed();
+
+private:
+    struct Mapping;
+
+    std::string filename;
+    bool realtime, loop, compressed;
+    std::shared_ptr<Mapping> mapping;
+    std::vector<size_t> offsets;                    // position of the record of every frame
+    std::vector<unsigned long long> timestamps;     // microseconds
+    cv::Size size;
+    int type;
+    size_t frame_bytes;
+    double fps;
+    long long current, first_timed;
+    std::chrono::steady_clock::time_point start;
+
+    bool map();
+};
+
+#endif // RAWFRAMES_H
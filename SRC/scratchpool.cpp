@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *  Pool of the temporary images used by the operators of MyImage. The buffers are looked up by
+ *  size and type and reused from one frame to the next, so that the processing of a stream of
+ *  frames of constant size does not allocate any image buffer once the pool is warm.
+ *  The number of allocations is counted to check it. No Qt thing here.
+*/
+
+#include "scratchpool.h"
+
+/**
+ * @brief ScratchPool::ScratchPool
+ * @param max_buffers: integer the maximum number of buffers kept by the pool
+ */
+ScratchPool::ScratchPool(int max_buffers) : max_buffers(max_buffers > 0 ? max_buffers : 1),
+                                            allocations(0)
+{
+}
+
+/**
+ * @brief ScratchPool::acquire
+ * @param size: cv::Size the size of the temporary image
+ * @param type: integer the OpenCV type of the temporary image (CV_8UC1, CV_16S, ...)
+ * @return a cv::Mat of the requested size and type. Its content is undefined.
+ *
+ * The buffer stays in use as long as the returned header, or a copy of it, exists
+ */
+cv::Mat ScratchPool::acquire(cv::Size size, int type) {
+    for (size_t i=0; i<this->buffers.size(); i++) {
+        const cv::Mat &buffer = this->buffers[i];
+        if (buffer.size() == size && buffer.type() == type && is_free(buffer))
+            return buffer;
+    }
+
+    cv::Mat buffer(size, type);
+    this->allocations++;
+    if (this->buffers.size() >= this->max_buffers) {
+        // Forget a free buffer to make room, otherwise the new one is not kept
+        for (size_t i=0; i<this->buffers.size(); i++)
+            if (is_free(this->buffers[i])) {
+                this->buffers.erase(this->buffers.begin() + i);
+                break;
+            }
+    }
+    if (this->buffers.size() < this->max_buffers)
+        this->buffers.push_back(buffer);
+    return buffer;
+}
+
+/**
+ * @brief ScratchPool::prepare
+ * @param buffer: cv::Mat a member image of MyImage that is rewritten at every frame
+ * @param size: cv::Size the size of the image
+ * @param type: integer the OpenCV type of the image
+ *
+ * Keeps the buffer of the image if it has the right size and type and nobody else
+ * holds it (the GUI, the recorder, ...). Otherwise a new buffer is allocated.
+ */
+void ScratchPool::prepare(cv::Mat &buffer, cv::Size size, int type) {
+    if (buffer.u && buffer.u->refcount>1)
+        buffer.release();
+    if (buffer.size() != size || buffer.type() != type) {
+        buffer.create(size, type);
+        this->allocations++;
+    }
+}
+
+/**
+ * @brief ScratchPool::clear
+ *
+ * Give back the memory of all the buffers. The buffers still in use are freed by their last header.
+ */
+void ScratchPool::clear() {
+    this->buffers.clear();
+}
+
+/**
+ * @brief ScratchPool::get_allocations
+ * @return the number of image buffers allocated through the pool since the last reset
+ */
+unsigned long long ScratchPool::get_allocations() {
+    return this->allocations;
+}
+
+/**
+ * @brief ScratchPool::get_number_buffers
+ * @return the number of buffers kept by the pool
+ */
+int ScratchPool::get_number_buffers() {
+    return (int) this->buffers.size();
+}
+
+/**
+ * @brief ScratchPool::get_memory
+ * @return the number of bytes kept by the pool
+ */
+size_t ScratchPool::get_memory() {
+    size_t bytes = 0;
+    for (size_t i=0; i<this->buffers.size(); i++)
+        bytes += this->buffers[i].total() * this->buffers[i].elemSize();
+    return bytes;
+}
+
+/**
+ * @brief ScratchPool::reset_counters
+ */
+void ScratchPool::reset_counters() {
+    this->allocations = 0;
+}
+
+/**
+ * @brief ScratchPool::is_free
+ * @return true if the pool holds the only header of the buffer
+ */
+bool ScratchPool::is_free(const cv::Mat &buffer) {
+    return buffer.u && buffer.u->refcount == 1;
+}
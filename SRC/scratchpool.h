@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef SCRATCHPOOL_H
+#define SCRATCHPOOL_H
+
+#include "opencv2/core.hpp"
+
+#include <vector>
+
+/**
+ * @brief The ScratchPool class
+ *
+ * Keeps the temporary images of the operators of MyImage from one frame to the next.
+ * A buffer is lent by acquire() to a cv::Mat header and is free again as soon as all
+ * the headers that share it are gone, so that the pool only allocates when a new
+ * size or type is requested, or when more buffers are in use at the same time.
+ * Not thread-safe: every MyImage has its own pool.
+ */
+class ScratchPool
+{
+public:
+    explicit ScratchPool(int max_buffers=32);
+
+    cv::Mat acquire(cv::Size size, int type);
+    void prepare(cv::Mat &buffer, cv::Size size, int type);
+    void clear();
+
+    unsigned long long get_allocations();
+    int get_number_buffers();
+    size_t get_memory();
+    void reset_counters();
+
+private:
+    std::vector<cv::Mat> buffers;
+    size_t max_buffers;
+    unsigned long long allocations;
+
+    static bool is_free(const cv::Mat &buffer);
+};
+
+#endif // SCRATCHPOOL_H
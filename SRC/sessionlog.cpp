@@ -0,0 +1,453 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *  Recording of the sessions of the GUI (input frames + parameter changes + hashes of the results)
+ *  and reading of the sessions for their replay in VideoHeadless. The replay gives the same images
+ *  as the GUI bit for bit, and the time spent in every stage on the exact same input.
+ *  No Qt thing here.
+*/
+
+#include "sessionlog.h"
+#include "processingcommands.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+/**
+ * @brief SessionRecorder::SessionRecorder
+ *
+ * Constructor of the class SessionRecorder. The frames of a session are never dropped: the processing
+ * waits for the writing thread if the disk cannot follow.
+ */
+SessionRecorder::SessionRecorder() : requested(false),
+                                     running(false),
+                                     fps(0.),
+                                     requested_fps(0.),
+                                     log(nullptr),
+                                     frames(16, true),
+                                     frame(-1),
+                                     side_outputs(-1),
+                                     commands(0)
+{
+}
+
+/**
+ * @brief SessionRecorder::~SessionRecorder
+ *
+ * Close the files of the current session before destroying the object
+ */
+SessionRecorder::~SessionRecorder() {
+    stop();
+}
+
+/**
+ * @brief SessionRecorder::request
+ * @param filename: string the log of the session. The frames are written next to it, with the extension .raw
+ * @param fps: double the nominal frame rate of the frames
+ *
+ * Called by the GUI. The session begins when the processing thread calls begin() between two frames.
+ */
+void SessionRecorder::request(const std::string &filename, double fps) {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->requested_filename = filename;
+    this->requested_fps      = fps;
+    this->requested          = true;
+}
+
+/**
+ * @brief SessionRecorder::isRequested
+ * @return true if a session waits for begin()
+ */
+bool SessionRecorder::isRequested() {
+    return this->requested;
+}
+
+/**
+ * @brief SessionRecorder::begin
+ * @param state: vector<double> the current value of every ProcessingCommand, NaN if it has never been set
+ * @return true if the files of the requested session could be created. The error is given by get_error() otherwise
+ *
+ * Called by the processing thread between two frames. The current state is written as the changes of the first frame.
+ */
+bool SessionRecorder::begin(const std::vector<double> &state) {
+    std::lock_guard<std::mutex> guard(this->lock);
+    if (!this->requested || this->running)
+        return false;
+    this->requested = false;
+    this->filename  = this->requested_filename;
+    this->fps       = this->requested_fps;
+    this->error.clear();
+
+    size_t dot   = this->filename.find_last_of('.');
+    size_t slash = this->filename.find_last_of("/\\");
+    std::string frames_filename = (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+                                  ? this->filename + ".raw" : this->filename.substr(0, dot) + ".raw";
+    this->log = std::fopen(this->filename.c_str(), "w");
+    if (this->log == nullptr) {
+        this->error = "Cannot create the file "+this->filename;
+        return false;
+    }
+    // Uncompressed: the writing thread keeps up more easily, the processing seldom waits for it
+    if (!this->frames.start(frames_filename, this->fps, false)) {
+        this->error = "Cannot create the file "+frames_filename;
+        std::fclose(this->log);
+        this->log = nullptr;
+        return false;
+    }
+
+    std::fprintf(this->log, "# Session: <frame> <parameter> <value>, the value applies from this frame on\n");
+    std::fprintf(this->log, "frames %s\n", frames_filename.substr(slash == std::string::npos ? 0 : slash+1).c_str());
+    std::fprintf(this->log, "fps %.17g\n", this->fps);
+    for (size_t key=0; key<state.size(); key++)
+        if (!std::isnan(state[key]))
+            std::fprintf(this->log, "0 %s %.17g\n", get_command_name((int) key), state[key]);
+
+    this->frame        = -1;
+    this->side_outputs = -1;
+    this->commands     = 0;
+    this->running      = true;
+    return true;
+}
+
+/**
+ * @brief SessionRecorder::stop
+ *
+ * The frames still waiting are written before the files are closed. A session still requested is cancelled.
+ */
+void SessionRecorder::stop() {
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->requested = false;
+        this->running   = false;
+        if (this->log != nullptr) {
+            std::fclose(this->log);
+            this->log = nullptr;
+        }
+    }
+    this->frames.stop();
+}
+
+/**
+ * @brief SessionRecorder::isRunning
+ * @return true if the frames and the parameter changes are recorded
+ */
+bool SessionRecorder::isRunning() {
+    return this->running;
+}
+
+/**
+ * @brief SessionRecorder::record_frame
+ * @param input: cv::Mat the frame as received by the processing, copied before the function returns
+ * @return false if the session is not running (stop() may have been called meanwhile: get_error() stays
+ *         empty), or if a frame could not be written: the session is then stopped and the reason is
+ *         given by get_error()
+ *
+ * Called by the processing thread before the frame is processed. Waits if the disk cannot follow.
+ * The raw file does not match the log anymore from a lost frame on: the log is closed with a line
+ * "<frame> lost" where the replay stops (see SessionLog::get_lost_frame()).
+ */
+bool SessionRecorder::record_frame(const cv::Mat &input) {
+    if (!this->running)
+        return false;
+    bool queued = this->frames.push(input);
+    std::lock_guard<std::mutex> guard(this->lock);
+    // Stopped by stop() during the push, which then rejected the frame: not a failure of the writing
+    if (!this->running)
+        return false;
+    this->frame++;
+    // The writing thread may lose an older frame (error of the disk, frame of another size)
+    long long lost = this->frames.get_first_dropped();
+    if (queued && lost < 0)
+        return true;
+    if (lost < 0 || lost > this->frame)
+        lost = this->frame;
+
+    this->error = "The frame "+std::to_string(lost)+" could not be written in "+this->frames.get_filename()+
+                  ", the session is stopped";
+    if (this->log != nullptr) {
+        std::fprintf(this->log, "%lld lost\n", lost);
+        std::fclose(this->log);
+        this->log = nullptr;
+    }
+    this->running = false;
+    return false;
+}
+
+/**
+ * @brief SessionRecorder::record_command
+ * @param key: integer ProcessingCommand
+ * @param value: double the new value
+ *
+ * Called by the processing thread when a parameter changes between two frames: it applies from the next frame on
+ */
+void SessionRecorder::record_command(int key, double value) {
+    if (!this->running)
+        return;
+    std::lock_guard<std::mutex> guard(this->lock);
+    if (this->log == nullptr)
+        return;
+    std::fprintf(this->log, "%lld %s %.17g\n", this->frame+1, get_command_name(key), value);
+    this->commands++;
+}
+
+/**
+ * @brief SessionRecorder::record_result
+ * @param hash: integer the hash of the processed frame (see hash())
+ * @param side_outputs: integer the SideOutput computed after the frame
+ *
+ * Called by the processing thread once the last recorded frame has been processed
+ */
+void SessionRecorder::record_result(unsigned long long hash, int side_outputs) {
+    if (!this->running)
+        return;
+    std::lock_guard<std::mutex> guard(this->lock);
+    if (this->log == nullptr || this->frame < 0)
+        return;
+    if (side_outputs != this->side_outputs) {
+        std::fprintf(this->log, "%lld %s %d\n", this->frame, get_command_name(CMD_SIDE_OUTPUTS), side_outputs);
+        this->side_outputs = side_outputs;
+    }
+    std::fprintf(this->log, "%lld result %016llx\n", this->frame, hash);
+}
+
+/**
+ * @brief SessionRecorder::get_filename
+ * @return the log of the last session
+ */
+std::string SessionRecorder::get_filename() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->filename;
+}
+
+/**
+ * @brief SessionRecorder::get_error
+ * @return the reason why begin() failed, or why record_frame() stopped the session
+ */
+std::string SessionRecorder::get_error() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->error;
+}
+
+/**
+ * @brief SessionRecorder::get_frames
+ * @return the number of frames of the last session
+ */
+unsigned long long SessionRecorder::get_frames() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return (unsigned long long) (this->frame + 1);
+}
+
+/**
+ * @brief SessionRecorder::get_commands
+ * @return the number of parameter changes recorded during the last session
+ */
+unsigned long long SessionRecorder::get_commands() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->commands;
+}
+
+/**
+ * @brief SessionRecorder::get_dropped_frames
+ * @return the number of frames that could not be written, 0 unless the disk failed
+ */
+unsigned long long SessionRecorder::get_dropped_frames() {
+    return this->frames.get_dropped_frames();
+}
+
+/**
+ * @brief SessionRecorder::hash
+ * @param image: cv::Mat any image
+ * @return a 64 bits hash of the size, of the type and of the pixels of the image
+ *
+ * Eight bytes at a time: a few milliseconds for a Full HD frame
+ */
+unsigned long long SessionRecorder::hash(const cv::Mat &image) {
+    const uint64_t multiplier = 0x9E3779B97F4A7C15ULL;
+    uint64_t h = 0xCBF29CE484222325ULL ^ ((uint64_t) image.rows << 40) ^ ((uint64_t) image.cols << 16) ^ (uint64_t) image.type();
+    size_t row_bytes = image.cols * image.elemSize();
+    for (int y=0; y<image.rows; y++) {
+        const uchar *row = image.ptr(y);
+        size_t x = 0;
+        for (; x + 8 <= row_bytes; x += 8) {
+            uint64_t word;
+            std::memcpy(&word, row + x, 8);
+            h = (h ^ word) * multiplier;
+            h ^= h >> 29;
+        }
+        for (; x < row_bytes; x++)
+            h = (h ^ row[x]) * multiplier;
+    }
+    return (unsigned long long) h;
+}
+
+/**
+ * @brief SessionLog::SessionLog
+ *
+ * Constructor of the class SessionLog. The session is empty.
+ */
+SessionLog::SessionLog() : fps(0.),
+                           lost_frame(-1)
+{
+}
+
+/**
+ * @brief SessionLog::load
+ * @param filename: string a session written by SessionRecorder
+ * @return true if the file could be read and its content is valid. The error can be retrieved with get_error() otherwise
+ */
+bool SessionLog::load(const std::string &filename) {
+    this->entries.clear();
+    this->results.clear();
+    this->frames_filename.clear();
+    this->error.clear();
+    this->fps = 0.;
+    this->lost_frame = -1;
+
+    std::ifstream file(filename.c_str());
+    if (!file) {
+        this->error = "Cannot read the session "+filename;
+        return false;
+    }
+    std::string line;
+    int number = 0;
+    while (std::getline(file, line)) {
+        number++;
+        line = line.substr(0, line.find('#'));
+        std::stringstream fields(line);
+        std::string first, name, value;
+        if (!(fields >> first))
+            continue;
+        if (first == "frames") {
+            std::getline(fields >> std::ws, this->frames_filename);
+            this->frames_filename.erase(this->frames_filename.find_last_not_of(" \t\r") + 1);
+            continue;
+        }
+        if (first == "fps") {
+            fields >> this->fps;
+            continue;
+        }
+        if (fields >> name && name == "lost" && first.find_first_not_of("0123456789") == std::string::npos) {
+            long long lost = std::atoll(first.c_str());
+            if (this->lost_frame < 0 || lost < this->lost_frame)
+                this->lost_frame = lost;
+            continue;
+        }
+        if (!(fields >> value) || first.find_first_not_of("0123456789") != std::string::npos) {
+            this->error = "Invalid line "+std::to_string(number)+" of the session "+filename;
+            return false;
+        }
+        long long frame = std::atoll(first.c_str());
+        if (name == "result") {
+            this->results[frame] = std::strtoull(value.c_str(), nullptr, 16);
+            continue;
+        }
+        Entry entry;
+        entry.frame = frame;
+        entry.key   = find_command(name);
+        entry.value = std::atof(value.c_str());
+        if (entry.key < 0) {
+            this->error = "Unknown parameter '"+name+"' at the line "+std::to_string(number)+" of the session "+filename;
+            return false;
+        }
+        this->entries.push_back(entry);
+    }
+    if (this->frames_filename.empty()) {
+        this->error = "No file of frames in the session "+filename;
+        return false;
+    }
+    // Relative to the directory of the session
+    size_t slash = filename.find_last_of("/\\");
+    bool absolute = this->frames_filename[0] == '/' || this->frames_filename[0] == '\\' ||
+                    (this->frames_filename.size() > 1 && this->frames_filename[1] == ':');
+    if (!absolute && slash != std::string::npos)
+        this->frames_filename = filename.substr(0, slash+1) + this->frames_filename;
+
+    // The frames of the raw file do not match the log after a lost frame
+    if (this->lost_frame >= 0)
+        this->results.erase(this->results.lower_bound(this->lost_frame), this->results.end());
+
+    // The changes of a frame keep the order in which they were made
+    std::stable_sort(this->entries.begin(), this->entries.end(),
+                     [](const Entry &a, const Entry &b) { return a.frame < b.frame; });
+    return true;
+}
+
+/**
+ * @brief SessionLog::get_error
+ * @return the reason why load() failed
+ */
+std::string SessionLog::get_error() {
+    return this->error;
+}
+
+/**
+ * @brief SessionLog::get_frames_filename
+ * @return the raw file of the input frames (see RawFileSource)
+ */
+std::string SessionLog::get_frames_filename() {
+    return this->frames_filename;
+}
+
+/**
+ * @brief SessionLog::get_lost_frame
+ * @return the first frame that could not be recorded, the replay must stop before it. -1 if none
+ */
+long long SessionLog::get_lost_frame() {
+    return this->lost_frame;
+}
+
+/**
+ * @brief SessionLog::get_fps
+ * @return the nominal frame rate of the session
+ */
+double SessionLog::get_fps() {
+    return this->fps;
+}
+
+/**
+ * @brief SessionLog::get_entries
+ * @return the parameter changes, sorted by frame
+ */
+const std::vector<SessionLog::Entry>& SessionLog::get_entries() {
+    return this->entries;
+}
+
+/**
+ * @brief SessionLog::get_result
+ * @param frame: integer the index of a frame
+ * @param hash: integer receives the hash of the frame processed by the GUI
+ * @return false if the session has no hash for this frame
+ */
+bool SessionLog::get_result(long long frame, unsigned long long &hash) {
+    std::map<long long, unsigned long long>::const_iterator found = this->results.find(frame);
+    if (found == this->results.end())
+        return false;
+    hash = found->second;
+    return true;
+}
+
+/**
+ * @brief SessionLog::get_number_results
+ * @return the number of frames with a hash
+ */
+size_t SessionLog::get_number_results() {
+    return this->results.size();
+}
+
+/**
+ * @brief SessionLog::uses_command
+ * @param key: integer ProcessingCommand
+ * @return true if the parameter is set to a non zero value at some point of the session
+ */
+bool SessionLog::uses_command(int key) {
+    for (size_t i=0; i<this->entries.size(); i++)
+        if (this->entries[i].key == key && this->entries[i].value != 0.)
+            return true;
+    return false;
+}
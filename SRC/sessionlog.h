@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef SESSIONLOG_H
+#define SESSIONLOG_H
+
+#include "opencv2/core.hpp"
+#include "rawframes.h"
+
+#include <atomic>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The SessionRecorder class
+ *
+ * Records a session of the GUI so that VideoHeadless can replay it: the input frames in a raw file
+ * (see RawFrameWriter, no frame is dropped) and, in a text file, every parameter change with the
+ * index of the first frame processed with it, plus a hash of every processed frame.
+ * The recording is requested by the GUI and begins at a frame boundary, in the processing thread.
+ */
+class SessionRecorder
+{
+public:
+    SessionRecorder();
+    ~SessionRecorder();
+
+    void request(const std::string &filename, double fps);
+    bool isRequested();
+    bool begin(const std::vector<double> &state);
+    void stop();
+    bool isRunning();
+
+    bool record_frame(const cv::Mat &input);
+    void record_command(int key, double value);
+    void record_result(unsigned long long hash, int side_outputs);
+
+    std::string get_filename();
+    std::string get_error();
+    unsigned long long get_frames();
+    unsigned long long get_commands();
+    unsigned long long get_dropped_frames();
+
+    static unsigned long long hash(const cv::Mat &image);
+
+private:
+    std::mutex lock;
+    std::atomic<bool> requested, running;
+    std::string filename, requested_filename, error;
+    double fps, requested_fps;
+    std::FILE *log;
+    RawFrameWriter frames;
+    long long frame;                // index of the last recorded frame, -1 before the first one
+    int side_outputs;               // last SideOutput mask written, -1 before the first frame
+    unsigned long long commands;
+};
+
+/**
+ * @brief The SessionLog class
+ *
+ * A session written by SessionRecorder, read back for the replay
+ */
+class SessionLog
+{
+public:
+    struct Entry {
+        long long frame;            // index of the first frame processed with this value
+        int key;                    // ProcessingCommand
+        double value;
+    };
+
+    SessionLog();
+
+    bool load(const std::string &filename);
+    std::string get_error();
+    std::string get_frames_filename();
+    double get_fps();
+    long long get_lost_frame();
+    const std::vector<Entry>& get_entries();
+    bool get_result(long long frame, unsigned long long &hash);
+    size_t get_number_results();
+    bool uses_command(int key);
+
+private:
+    std::string error, frames_filename;
+    double fps;
+    long long lost_frame;           // first frame missing from the raw file, -1 if none
+    std::vector<Entry> entries;
+    std::map<long long, unsigned long long> results;
+};
+
+#endif // SESSIONLOG_H
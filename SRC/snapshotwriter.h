@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef SNAPSHOTWRITER_H
+#define SNAPSHOTWRITER_H
+
+#include "opencv2/core.hpp"
+#include "videoframe.h"
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief The SnapshotWriter class
+ *
+ * Saves images on the disk with a pool of threads, the caller only pays for a copy of the image.
+ * A snapshot or a burst of consecutive frames is captured with capture() and offer(), and kept in
+ * memory until its file name is known (commit()): the frames are shared, not copied (see VideoFrame).
+ * Single images are written with save().
+ */
+class SnapshotWriter
+{
+public:
+    enum Format {
+        FORMAT_PNG = 0,     // lossless
+        FORMAT_PNG_FAST,    // lossless, low compression
+        FORMAT_JPEG,        // lossy, see the quality
+        FORMAT_BMP,         // no compression at all
+        NB_FORMATS
+    };
+
+    explicit SnapshotWriter(int threads=2, int max_pending=16);
+    ~SnapshotWriter();
+
+    void capture(int count);
+    bool isCapturing();
+    void offer(const VideoFrame &frame);
+    void commit(const std::string &filename, int format, int quality=95);
+    void cancel();
+
+    void save(const cv::Mat &image, const std::string &filename, int format, int quality=95);
+    void wait();
+    bool take_report(std::string &report);
+
+    void set_max_memory(size_t bytes);
+    int get_captured_frames();
+    int get_pending();
+    unsigned long long get_written();
+    unsigned long long get_failed();
+    double get_mean_write_ms();
+    double get_max_write_ms();
+
+    static std::string get_extension(int format);
+    static std::vector<int> get_parameters(int format, int quality);
+
+private:
+    struct Job {
+        cv::Mat image;
+        std::string filename;
+        std::vector<int> parameters;
+    };
+
+    // Jobs waiting for a thread of the pool
+    std::deque<Job> jobs;
+    std::vector<std::thread> threads;
+    std::atomic<bool> running;
+    int active, max_pending;
+
+    // Current capture: frames kept in memory until commit()
+    std::atomic<int> remaining;
+    std::vector<cv::Mat> held;
+    size_t held_memory, max_memory;
+    int captured, count;
+    int requested_count;                // count asked to capture(), before the memory limit cuts the burst
+    bool committed, reported;
+    std::string batch_filename;
+    std::vector<int> batch_parameters;
+
+    std::mutex lock;
+    std::atomic<unsigned long long> written, failed, write_us, max_write_us;
+
+    void run();
+    void enqueue(const cv::Mat &image, int index);
+    std::string create_filename(int index);
+};
+
+#endif // SNAPSHOTWRITER_H
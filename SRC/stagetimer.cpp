@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *  Measure the time spent in every stage of the image processing (blur, threshold, ...).
+ *  The last durations are kept in a rolling window per stage and summarized as mean, median,
+ *  99th percentile and maximum. No Qt thing here.
+*/
+
+#include "stagetimer.h"
+
+#include <algorithm>
+#include <cassert>
+
+/**
+ * @brief StageProfiler::StageProfiler
+ * @param names: vector of strings the names of the stages, the index of a stage is its position
+ * @param window: integer the number of durations kept per stage
+ */
+StageProfiler::StageProfiler(const std::vector<std::string> &names, int window) : names(names),
+                                                                                  history(names.size()),
+                                                                                  frame(0)
+{
+    set_window(window);
+}
+
+/**
+ * @brief StageProfiler::next_frame
+ *
+ * Called once per frame, before the first stage, to know which stages are still in use
+ */
+void StageProfiler::next_frame() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->frame++;
+}
+
+/**
+ * @brief StageProfiler::record
+ * @param stage: integer the index of the stage
+ * @param milliseconds: double the duration of the stage for the current frame
+ *
+ * The durations recorded for the same stage during the same frame are added up
+ */
+void StageProfiler::record(int stage, double milliseconds) {
+    assert(stage>=0 && stage<(int)this->history.size());
+    std::lock_guard<std::mutex> guard(this->lock);
+    History &h = this->history[stage];
+    if (h.recorded && h.last_frame == this->frame) {
+        // The stage has already been measured during this frame (repeated stage, folded stages, ...)
+        size_t last = h.next > 0 ? h.next-1 : this->window-1;
+        h.durations[last] += milliseconds;
+        return;
+    }
+    h.durations[h.next] = milliseconds;
+    h.next++;
+    if (h.next == this->window) {
+        h.next = 0;
+        h.full = true;
+    }
+    h.last_frame = this->frame;
+    h.recorded = true;
+}
+
+/**
+ * @brief StageProfiler::reset
+ *
+ * Forget all the recorded durations
+ */
+void StageProfiler::reset() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    for (size_t i=0; i<this->history.size(); i++) {
+        this->history[i].next = 0;
+        this->history[i].full = false;
+        this->history[i].last_frame = 0;
+        this->history[i].recorded = false;
+    }
+    this->frame = 0;
+}
+
+/**
+ * @brief StageProfiler::set_window
+ * @param window: integer the number of durations kept per stage. The recorded durations are lost.
+ */
+void StageProfiler::set_window(int window) {
+    assert(window>0);
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->window = (size_t) (window > 0 ? window : 1);
+        for (size_t i=0; i<this->history.size(); i++)
+            this->history[i].durations.assign(this->window, 0.);
+    }
+    reset();
+}
+
+/**
+ * @brief StageProfiler::get_statistics
+ * @param stage: integer the index of the stage
+ * @return the statistics of the stage over the rolling window
+ */
+StageStatistics StageProfiler::get_statistics(int stage) {
+    assert(stage>=0 && stage<(int)this->history.size());
+    StageStatistics stats;
+    std::vector<double> sorted;
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        const History &h = this->history[stage];
+        size_t count = h.full ? this->window : h.next;
+        sorted.assign(h.durations.begin(), h.durations.begin() + count);
+        stats.active = count > 0 && h.last_frame + 1 >= this->frame;
+    }
+    stats.name    = this->names[stage];
+    stats.samples = (int) sorted.size();
+    stats.mean = stats.p50 = stats.p99 = stats.max = 0.;
+    if (sorted.empty())
+        return stats;
+
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0.;
+    for (size_t i=0; i<sorted.size(); i++)
+        sum += sorted[i];
+    stats.mean = sum / sorted.size();
+    stats.p50  = sorted[(sorted.size()-1) / 2];
+    stats.p99  = sorted[(size_t) ((sorted.size()-1) * 0.99)];
+    stats.max  = sorted.back();
+    return stats;
+}
+
+/**
+ * @brief StageProfiler::get_all_statistics
+ * @return the statistics of all the stages, in the order of their index
+ */
+std::vector<StageStatistics> StageProfiler::get_all_statistics() {
+    std::vector<StageStatistics> all;
+    for (int i=0; i<(int)this->history.size(); i++)
+        all.push_back(get_statistics(i));
+    return all;
+}
+
+/**
+ * @brief StageProfiler::get_number_stages
+ * @return the number of stages that can be measured
+ */
+int StageProfiler::get_number_stages() {
+    return (int) this->names.size();
+}
+
+/**
+ * @brief StageProfiler::get_frame
+ * @return the number of frames since the last reset
+ */
+unsigned long long StageProfiler::get_frame() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    return this->frame;
+}
+
+/**
+ * @brief ScopedStageTimer::ScopedStageTimer
+ * @param profiler: StageProfiler that receives the duration
+ * @param stage: integer the index of the measured stage
+ */
+ScopedStageTimer::ScopedStageTimer(StageProfiler &profiler, int stage) : profiler(profiler),
+                                                                         stage(stage),
+                                                                         start(std::chrono::steady_clock::now())
+{
+}
+
+/**
+ * @brief ScopedStageTimer::~ScopedStageTimer
+ *
+ * Records the time elapsed since the construction
+ */
+ScopedStageTimer::~ScopedStageTimer() {
+    this->profiler.record(this->stage, std::chrono::duration<double, std::milli>(
+                                           std::chrono::steady_clock::now() - this->start).count());
+}
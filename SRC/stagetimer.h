@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef STAGETIMER_H
+#define STAGETIMER_H
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The StageStatistics struct
+ *
+ * Durations in milliseconds of one stage over the last frames
+ */
+struct StageStatistics {
+    std::string name;
+    double mean, p50, p99, max;
+    int samples;         // number of durations in the rolling window
+    bool active;         // the stage has been executed for the current or the previous frame
+};
+
+/**
+ * @brief The StageProfiler class
+ *
+ * Keeps the last durations of every stage of the image processing in a rolling window
+ * and aggregates them on request. Written by the processing thread, read by any thread.
+ */
+class StageProfiler
+{
+public:
+    StageProfiler(const std::vector<std::string> &names, int window=120);
+
+    void next_frame();
+    void record(int stage, double milliseconds);
+    void reset();
+    void set_window(int window);
+
+    StageStatistics get_statistics(int stage);
+    std::vector<StageStatistics> get_all_statistics();
+    int get_number_stages();
+    unsigned long long get_frame();
+
+private:
+    struct History {
+        std::vector<double> durations;
+        size_t next;
+        bool full;
+        unsigned long long last_frame;
+        bool recorded;   // a duration has been recorded for last_frame
+    };
+
+    std::vector<std::string> names;
+    std::vector<History> history;
+    size_t window;
+    unsigned long long frame;
+    std::mutex lock;
+};
+
+/**
+ * @brief The ScopedStageTimer class
+ *
+ * Measures the time between its construction and its destruction, and records it in the profiler
+ */
+class ScopedStageTimer
+{
+public:
+    ScopedStageTimer(StageProfiler &profiler, int stage);
+    ~ScopedStageTimer();
+
+private:
+    StageProfiler &profiler;
+    int stage;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif // STAGETIMER_H
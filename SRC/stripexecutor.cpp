@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *  Cache-blocked execution of the neighbourhood filters of MyImage: a chain of filters is applied
+ *  band after band, every band overlapping its neighbours by the halo of the chain. No Qt thing here.
+*/
+
+#include "stripexecutor.h"
+
+#include <algorithm>
+#include <cassert>
+
+/**
+ * @brief The StripExecutor::BandLoop class
+ *
+ * Body of cv::parallel_for_, processes the bands range.start to range.end-1
+ */
+class StripExecutor::BandLoop : public cv::ParallelLoopBody
+{
+public:
+    BandLoop(StripExecutor &executor, int band_rows, const cv::Mat &src, cv::Mat &dst) :
+        executor(executor), band_rows(band_rows), src(src), dst(dst)
+    {
+    }
+
+    void operator()(const cv::Range &range) const override {
+        for (int i=range.start; i<range.end; i++)
+            this->executor.run_band(i, this->band_rows, this->src, this->dst);
+    }
+
+private:
+    StripExecutor &executor;
+    int band_rows;
+    const cv::Mat &src;
+    cv::Mat &dst;
+};
+
+/**
+ * @brief StripExecutor::StripExecutor
+ * @param cache_size: the number of bytes of the cache that the images of a band should fit in
+ */
+StripExecutor::StripExecutor(size_t cache_size) : type(CV_8UC3),
+                                                  output_type(CV_8UC3),
+                                                  halo(0)
+{
+    set_cache_size(cache_size);
+}
+
+/**
+ * @brief StripExecutor::begin
+ * @param type: integer the OpenCV type of the images the chain will be applied to
+ *
+ * Starts a new chain of filters, empty
+ */
+void StripExecutor::begin(int type) {
+    this->operations.clear();
+    this->type = this->output_type = type;
+    this->halo = 0;
+}
+
+/**
+ * @brief StripExecutor::add_box
+ * @param ksize: integer the size of the box filter (cv::blur)
+ */
+void StripExecutor::add_box(int ksize) {
+    assert(ksize>0);
+    add_operation(BOX, ksize/2, ksize);
+}
+
+/**
+ * @brief StripExecutor::add_gaussian
+ * @param ksize: integer the size of the Gaussian filter, odd
+ */
+void StripExecutor::add_gaussian(int ksize) {
+    assert(ksize>0 && ksize%2==1);
+    add_operation(GAUSSIAN, ksize/2, ksize);
+}
+
+/**
+ * @brief StripExecutor::add_gray
+ * @param code: integer the cv::ColorConversionCodes from colours to gray (cv::COLOR_BGR2GRAY, ...)
+ */
+void StripExecutor::add_gray(int code) {
+    assert(CV_MAT_CN(this->output_type)==3);
+    add_operation(GRAY, 0, code);
+    this->output_type = CV_8UC1;
+}
+
+/**
+ * @brief StripExecutor::add_sobel
+ *
+ * Approximated gradient of a gray image: mean of the absolute values of the 3x3 Sobel derivatives
+ */
+void StripExecutor::add_sobel() {
+    assert(this->output_type==CV_8UC1);
+    add_operation(SOBEL, 1, 0);
+}
+
+/**
+ * @brief StripExecutor::add_laplacian
+ *
+ * Absolute value of the 3x3 Laplacian of a gray image
+ */
+void StripExecutor::add_laplacian() {
+    assert(this->output_type==CV_8UC1);
+    add_operation(LAPLACIAN, 1, 0);
+}
+
+/**
+ * @brief StripExecutor::add_threshold
+ * @param type: integer the cv::ThresholdTypes (THRESH_BINARY, ..., THRESH_TOZERO_INV)
+ * @param value: double the threshold
+ */
+void StripExecutor::add_threshold(int type, double value) {
+    assert(this->output_type==CV_8UC1);
+    add_operation(THRESHOLD, 0, type, 0, 0, value);
+}
+
+/**
+ * @brief StripExecutor::add_adaptive_threshold
+ * @param method: integer the cv::AdaptiveThresholdTypes
+ * @param type: integer THRESH_BINARY or THRESH_BINARY_INV
+ * @param blocksize: integer the size of the neighbourhood, odd
+ */
+void StripExecutor::add_adaptive_threshold(int method, int type, int blocksize) {
+    assert(this->output_type==CV_8UC1);
+    assert(blocksize>1 && blocksize%2==1);
+    add_operation(ADAPTIVE_THRESHOLD, blocksize/2, method, type, blocksize);
+}
+
+/**
+ * @brief StripExecutor::apply
+ * @param src: cv::Mat the input image, of the type given to begin()
+ * @param dst: cv::Mat the result, of type get_output_type(). Must not share its data with src.
+ */
+void StripExecutor::apply(const cv::Mat &src, cv::Mat &dst) {
+    assert(src.type()==this->type);
+    assert(src.data != dst.data || dst.empty());
+    dst.create(src.size(), this->output_type);
+    if (this->operations.empty()) {
+        src.copyTo(dst);
+        return;
+    }
+    int band_rows = get_band_rows(src.size());
+    int count = (src.rows + band_rows - 1) / band_rows;
+    if ((int) this->bands.size() < count)
+        this->bands.resize(count);
+    cv::parallel_for_(cv::Range(0, count), BandLoop(*this, band_rows, src, dst));
+}
+
+/**
+ * @brief StripExecutor::get_number_operations
+ * @return the number of filters of the chain
+ */
+int StripExecutor::get_number_operations() {
+    return (int) this->operations.size();
+}
+
+/**
+ * @brief StripExecutor::get_halo
+ * @return the number of rows added above and below every band
+ */
+int StripExecutor::get_halo() {
+    return this->halo;
+}
+
+/**
+ * @brief StripExecutor::get_output_type
+ * @return the OpenCV type of the result of the chain
+ */
+int StripExecutor::get_output_type() {
+    return this->output_type;
+}
+
+/**
+ * @brief StripExecutor::get_band_rows
+ * @param size: cv::Size the size of the image
+ * @return the number of rows of a band
+ *
+ * A band and its temporary images fit in the cache, but it is at least 8 times higher than the
+ * halo so that less than a quarter of the rows is filtered twice. Small images are shared out
+ * between the threads.
+ */
+int StripExecutor::get_band_rows(const cv::Size &size) {
+    // Two images of the band plus the 16 bits gradients
+    size_t row_bytes = (size_t) size.width * CV_ELEM_SIZE(this->type) * 4;
+    int rows = (int) std::max<size_t>(1, this->cache_size / std::max<size_t>(1, row_bytes));
+    rows = std::max(rows, std::max(8, 8*this->halo));
+
+    int threads = std::max(1, cv::getNumThreads());
+    rows = std::min(rows, std::max((size.height + threads - 1) / threads, 2*this->halo));
+    return std::max(1, std::min(rows, size.height));
+}
+
+/**
+ * @brief StripExecutor::set_cache_size
+ * @param bytes: the number of bytes of the cache that the images of a band should fit in
+ */
+void StripExecutor::set_cache_size(size_t bytes) {
+    assert(bytes>0);
+    this->cache_size = bytes;
+}
+
+/**
+ * @brief StripExecutor::add_operation
+ * @param kind: integer the filter
+ * @param halo: integer the radius of the filter, in rows
+ */
+void StripExecutor::add_operation(int kind, int halo, int a, int b, int c, double value) {
+    Operation operation;
+    operation.kind  = kind;
+    operation.a     = a;
+    operation.b     = b;
+    operation.c     = c;
+    operation.value = value;
+    this->operations.push_back(operation);
+    this->halo += halo;
+}
+
+/**
+ * @brief StripExecutor::run_band
+ * @param index: integer the index of the band
+ * @param band_rows: integer the number of rows of a band
+ * @param src: cv::Mat the input image
+ * @param dst: cv::Mat the result, the rows of the band are written
+ *
+ * The filters are applied on the rows of the band extended by the halo. After every filter the rows
+ * near the ends of the band are wrong (the filter extrapolates the borders), but there are never
+ * more of them than the halo, except at the top and the bottom of the image which are real borders.
+ */
+void StripExecutor::run_band(int index, int band_rows, const cv::Mat &src, cv::Mat &dst) {
+    int first  = index * band_rows;
+    int last   = std::min(src.rows, first + band_rows);
+    int top    = std::max(0, first - this->halo);
+    int bottom = std::min(src.rows, last + this->halo);
+    Band &band = this->bands[index];
+
+    // The first filter reads the input image, the next ones the buffers of the band in turn
+    cv::Mat current = src.rowRange(top, bottom);
+    for (size_t i=0; i<this->operations.size(); i++) {
+        cv::Mat &out = band.buffer[i % 2];
+        run_operation(this->operations[i], current, out, band);
+        current = out;
+    }
+    current.rowRange(first - top, last - top).copyTo(dst.rowRange(first, last));
+}
+
+/**
+ * @brief StripExecutor::run_operation
+ * @param operation: Operation the filter
+ * @param in: cv::Mat the rows to filter
+ * @param out: cv::Mat the filtered rows
+ * @param band: Band the temporary images of the band
+ */
+void StripExecutor::run_operation(const Operation &operation, const cv::Mat &in, cv::Mat &out, Band &band) {
+    switch (operation.kind) {
+    case BOX:
+        cv::blur(in, out, cv::Size(operation.a, operation.a));
+        break;
+    case GAUSSIAN:
+        cv::GaussianBlur(in, out, cv::Size(operation.a, operation.a), 0, 0);
+        break;
+    case GRAY:
+        cv::cvtColor(in, out, operation.a);
+        break;
+    case SOBEL:
+        cv::Sobel(in, band.grad_x, CV_16S, 1, 0, 3);
+        cv::convertScaleAbs(band.grad_x, band.abs_grad_x);
+        cv::Sobel(in, band.grad_y, CV_16S, 0, 1, 3);
+        cv::convertScaleAbs(band.grad_y, band.abs_grad_y);
+        cv::addWeighted(band.abs_grad_x, 0.5, band.abs_grad_y, 0.5, 0, out);
+        break;
+    case LAPLACIAN:
+        cv::Laplacian(in, band.grad_x, CV_16S, 3);
+        cv::convertScaleAbs(band.grad_x, out);
+        break;
+    case THRESHOLD:
+        cv::threshold(in, out, operation.value, 255, operation.a);
+        break;
+    case ADAPTIVE_THRESHOLD:
+        cv::adaptiveThreshold(in, out, 255, operation.a, operation.b, operation.c, 0.);
+        break;
+    }
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef STRIPEXECUTOR_H
+#define STRIPEXECUTOR_H
+
+#include "opencv2/core.hpp"
+#include "opencv2/imgproc.hpp"
+
+#include <vector>
+
+/**
+ * @brief The StripExecutor class
+ *
+ * Runs a chain of neighbourhood filters (blur, Sobel, Laplacian, thresholds) over horizontal bands
+ * of the image instead of filtering the whole image once per stage. A band is small enough to stay
+ * in the cache from the first filter to the last one. Every band is extended by the halo of the
+ * chain (the sum of the radii of the filters) so that its rows are exactly the rows of the
+ * filters applied to the whole image. The bands are processed in parallel.
+ */
+class StripExecutor
+{
+public:
+    StripExecutor(size_t cache_size = 512*1024);
+
+    void begin(int type);
+    void add_box(int ksize);
+    void add_gaussian(int ksize);
+    void add_gray(int code);
+    void add_sobel();
+    void add_laplacian();
+    void add_threshold(int type, double value);
+    void add_adaptive_threshold(int method, int type, int blocksize);
+    void apply(const cv::Mat &src, cv::Mat &dst);
+
+    int get_number_operations();
+    int get_halo();
+    int get_output_type();
+    int get_band_rows(const cv::Size &size);
+    void set_cache_size(size_t bytes);
+
+private:
+    enum Kind { BOX = 1, GAUSSIAN, GRAY, SOBEL, LAPLACIAN, THRESHOLD, ADAPTIVE_THRESHOLD };
+    struct Operation {
+        int kind;
+        int a, b, c;
+        double value;
+    };
+    // Images of one band, kept from one frame to the next
+    struct Band {
+        cv::Mat buffer[2];
+        cv::Mat grad_x, grad_y, abs_grad_x, abs_grad_y;
+    };
+    class BandLoop;
+
+    std::vector<Operation> operations;
+    std::vector<Band> bands;
+    int type, output_type, halo;
+    size_t cache_size;
+
+    void add_operation(int kind, int halo, int a, int b=0, int c=0, double value=0.);
+    void run_band(int index, int band_rows, const cv::Mat &src, cv::Mat &dst);
+    void run_operation(const Operation &operation, const cv::Mat &in, cv::Mat &out, Band &band);
+};
+
+#endif // STRIPEXECUTOR_H
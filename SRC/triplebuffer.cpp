@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *  Triple buffer used to hand over the processed frames from the OpenCV thread to the GUI.
+ *  The OpenCV thread never blocks, the GUI always displays the newest image and the images
+ *  produced faster than the GUI can display them are dropped instead of being queued.
+ *  No Qt thing here.
+*/
+
+#include "triplebuffer.h"
+
+/**
+ * @brief TripleBuffer::TripleBuffer
+ *
+ * Constructor of the class TripleBuffer. The slots are empty until the writer fills them.
+ */
+TripleBuffer::TripleBuffer() : write_index(0),
+                               read_index(1),
+                               ready(2),
+                               notified(false),
+                               published(0),
+                               consumed(0),
+                               dropped(0)
+{
+}
+
+/**
+ * @brief TripleBuffer::get_write_buffer
+ * @return the slot that receives a frame before publish(). Its previous frame is released when it is replaced.
+ */
+VideoFrame& TripleBuffer::get_write_buffer() {
+    return this->buffers[this->write_index];
+}
+
+/**
+ * @brief TripleBuffer::publish
+ * @return true if the reader must be notified. False if a notification is already pending.
+ *
+ * Called by the writer: the write buffer becomes the ready buffer. If the previous ready buffer
+ * has not been read, it is dropped and reused as the next write buffer.
+ */
+bool TripleBuffer::publish() {
+    int previous = this->ready.exchange(this->write_index | FRESH, std::memory_order_acq_rel);
+    this->write_index = previous & INDEX_MASK;
+    this->published++;
+    if (previous & FRESH)
+        this->dropped++;
+    return !this->notified.exchange(true, std::memory_order_acq_rel);
+}
+
+/**
+ * @brief TripleBuffer::acquire
+ * @return true if a new image is available in get_read_buffer()
+ *
+ * Called by the reader: the newest published image becomes the read buffer.
+ * The previous read frame is released by the writer when it reuses the slot.
+ */
+bool TripleBuffer::acquire() {
+    // Clear the notification first, so that an image published from now on triggers a new one
+    this->notified.store(false, std::memory_order_release);
+    if (!(this->ready.load(std::memory_order_acquire) & FRESH))
+        return false;
+    int previous = this->ready.exchange(this->read_index, std::memory_order_acq_rel);
+    this->read_index = previous & INDEX_MASK;
+    this->consumed++;
+    return true;
+}
+
+/**
+ * @brief TripleBuffer::get_read_buffer
+ * @return the frame obtained by the last successful acquire()
+ */
+const VideoFrame& TripleBuffer::get_read_buffer() {
+    return this->buffers[this->read_index];
+}
+
+/**
+ * @brief TripleBuffer::get_published_frames
+ * @return the number of images published by the writer
+ */
+unsigned long long TripleBuffer::get_published_frames() {
+    return this->published;
+}
+
+/**
+ * @brief TripleBuffer::get_consumed_frames
+ * @return the number of images taken by the reader
+ */
+unsigned long long TripleBuffer::get_consumed_frames() {
+    return this->consumed;
+}
+
+/**
+ * @brief TripleBuffer::get_dropped_frames
+ * @return the number of images replaced by a newer one before being read
+ */
+unsigned long long TripleBuffer::get_dropped_frames() {
+    return this->dropped;
+}
+
+/**
+ * @brief TripleBuffer::reset_counters
+ */
+void TripleBuffer::reset_counters() {
+    this->published = 0;
+    this->consumed  = 0;
+    this->dropped   = 0;
+}
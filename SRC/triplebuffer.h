@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include "videoframe.h"
+
+#include <atomic>
+
+/**
+ * @brief The TripleBuffer class
+ *
+ * Latest-frame-wins handoff of frames between one writer and one reader.
+ * The writer puts a frame in the write slot and publishes it as the ready slot, the reader takes the
+ * ready slot as its read slot. The three slots are only exchanged, so that the writer never waits
+ * for the reader and the reader always gets the newest frame. The frames are immutable and shared
+ * (see VideoFrame): the reader may keep its frame as long as it wants, the pixels are never reused
+ * before it releases it. A frame published before the previous one has been read replaces it.
+ */
+class TripleBuffer
+{
+public:
+    TripleBuffer();
+
+    VideoFrame& get_write_buffer();
+    bool publish();
+    bool acquire();
+    const VideoFrame& get_read_buffer();
+
+    unsigned long long get_published_frames();
+    unsigned long long get_consumed_frames();
+    unsigned long long get_dropped_frames();
+    void reset_counters();
+
+private:
+    static const int INDEX_MASK = 3;
+    static const int FRESH      = 4; // the ready buffer has not been read yet
+
+    VideoFrame buffers[3];
+    int write_index;                 // owned by the writer
+    int read_index;                  // owned by the reader
+    std::atomic<int> ready;          // index of the ready buffer + FRESH
+    std::atomic<bool> notified;      // the reader has been told that a new image is ready
+    std::atomic<unsigned long long> published, consumed, dropped;
+};
+
+#endif // TRIPLEBUFFER_H
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *  Immutable and reference-counted frames, shared without any copy by all the consumers of the
+ *  processed images (display, recorders, snapshots). Their buffers are recycled by a pool.
+ *  No Qt thing here.
+*/
+
+#include "videoframe.h"
+
+#include <chrono>
+
+/**
+ * @brief VideoFrame::VideoFrame
+ *
+ * Constructor of the class VideoFrame. The frame is empty, the frames are created by VideoFramePool.
+ */
+VideoFrame::VideoFrame()
+{
+}
+
+/**
+ * @brief VideoFrame::empty
+ * @return true if the frame has no pixels
+ */
+bool VideoFrame::empty() const {
+    return !this->data || this->data->image.empty();
+}
+
+/**
+ * @brief VideoFrame::get_image
+ * @return the pixels of the frame, shared with all the copies of the frame: never write into them
+ */
+const cv::Mat& VideoFrame::get_image() const {
+    static const cv::Mat none;
+    return this->data ? this->data->image : none;
+}
+
+/**
+ * @brief VideoFrame::get_sequence
+ * @return the number of the frame given at its creation
+ */
+unsigned long long VideoFrame::get_sequence() const {
+    return this->data ? this->data->sequence : 0;
+}
+
+/**
+ * @brief VideoFrame::get_timestamp
+ * @return the time of the creation of the frame, in microseconds of std::chrono::steady_clock
+ */
+unsigned long long VideoFrame::get_timestamp() const {
+    return this->data ? this->data->timestamp : 0;
+}
+
+/**
+ * @brief VideoFrame::get_format
+ * @return the OpenCV type of the pixels (CV_8UC3 for BGR, CV_8UC1 for gray)
+ */
+int VideoFrame::get_format() const {
+    return get_image().type();
+}
+
+/**
+ * @brief VideoFrame::get_size
+ * @return the dimensions of the frame
+ */
+cv::Size VideoFrame::get_size() const {
+    return get_image().size();
+}
+
+/**
+ * @brief VideoFrame::get_use_count
+ * @return the number of VideoFrame objects that share this frame
+ */
+long VideoFrame::get_use_count() const {
+    return this->data.use_count();
+}
+
+/**
+ * @brief VideoFramePool::VideoFramePool
+ * @param max_buffers: integer the number of free buffers kept for the next frames
+ *
+ * Constructor of the class VideoFramePool. The buffers are allocated on first use.
+ */
+VideoFramePool::VideoFramePool(int max_buffers) : recycler(new Recycler),
+                                                  allocations(0)
+{
+    this->recycler->max_buffers = max_buffers > 0 ? max_buffers : 0;
+}
+
+/**
+ * @brief VideoFramePool::acquire
+ * @param size: cv::Size the dimensions of the buffer
+ * @param type: integer the OpenCV type of the buffer
+ * @return a buffer that nothing else references, to be filled then given to freeze()
+ */
+cv::Mat VideoFramePool::acquire(cv::Size size, int type) {
+    {
+        std::lock_guard<std::mutex> guard(this->recycler->lock);
+        std::vector<cv::Mat> &buffers = this->recycler->buffers;
+        for (size_t i=0; i<buffers.size(); i++) {
+            if (buffers[i].size() == size && buffers[i].type() == type) {
+                cv::Mat buffer = buffers[i];
+                buffers.erase(buffers.begin() + i);
+                return buffer;
+            }
+        }
+    }
+    this->allocations++;
+    return cv::Mat(size, type);
+}
+
+/**
+ * @brief VideoFramePool::freeze
+ * @param buffer: cv::Mat the pixels of the new frame. The header is released: the frame is the only owner
+ * @param sequence: integer the number of the frame
+ * @return the frame, its buffer comes back to the pool when its last reference is released
+ */
+VideoFrame VideoFramePool::freeze(cv::Mat &buffer, unsigned long long sequence) {
+    VideoFrame::Data *data = new VideoFrame::Data;
+    data->image     = buffer;
+    data->sequence  = sequence;
+    data->timestamp = (unsigned long long) std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::steady_clock::now().time_since_epoch()).count();
+    buffer.release();
+
+    std::shared_ptr<Recycler> recycler = this->recycler;
+    VideoFrame frame;
+    frame.data = std::shared_ptr<const VideoFrame::Data>(data, [recycler](const VideoFrame::Data *released) {
+        // A buffer still shared by a cv::Mat header (kept by a consumer) is not recycled
+        const cv::Mat &image = released->image;
+        if (image.u != nullptr && image.u->refcount == 1) {
+            std::lock_guard<std::mutex> guard(recycler->lock);
+            if (recycler->buffers.size() < recycler->max_buffers)
+                recycler->buffers.push_back(image);
+        }
+        delete released;
+    });
+    return frame;
+}
+
+/**
+ * @brief VideoFramePool::create
+ * @param image: cv::Mat the pixels of the new frame, copied before the function returns
+ * @param sequence: integer the number of the frame
+ * @return the frame, with its own copy of image
+ */
+VideoFrame VideoFramePool::create(const cv::Mat &image, unsigned long long sequence) {
+    if (image.empty())
+        return VideoFrame();
+    cv::Mat buffer = acquire(image.size(), image.type());
+    image.copyTo(buffer);
+    return freeze(buffer, sequence);
+}
+
+/**
+ * @brief VideoFramePool::share
+ * @param image: cv::Mat the pixels of the new frame, referenced and not copied
+ * @param sequence: integer the number of the frame
+ * @return the frame, sharing the buffer of image. The buffer does not come back to a pool.
+ *
+ * For the images whose producer never writes into a buffer that is still referenced elsewhere
+ * (ScratchPool, FrameGrabber, FrameRingBuffer): the frame stays unchanged without any copy.
+ */
+VideoFrame VideoFramePool::share(const cv::Mat &image, unsigned long long sequence) {
+    if (image.empty())
+        return VideoFrame();
+    VideoFrame::Data *data = new VideoFrame::Data;
+    data->image     = image;
+    data->sequence  = sequence;
+    data->timestamp = (unsigned long long) std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::steady_clock::now().time_since_epoch()).count();
+    VideoFrame frame;
+    frame.data = std::shared_ptr<const VideoFrame::Data>(data);
+    return frame;
+}
+
+/**
+ * @brief VideoFramePool::get_allocations
+ * @return the number of buffers allocated since the construction, stays constant once the frames are recycled
+ */
+unsigned long long VideoFramePool::get_allocations() {
+    return this->allocations;
+}
+
+/**
+ * @brief VideoFramePool::get_number_buffers
+ * @return the number of free buffers
+ */
+int VideoFramePool::get_number_buffers() {
+    std::lock_guard<std::mutex> guard(this->recycler->lock);
+    return (int) this->recycler->buffers.size();
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef VIDEOFRAME_H
+#define VIDEOFRAME_H
+
+#include "opencv2/core.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief The VideoFrame class
+ *
+ * A processed frame (pixels + sequence number + timestamp) that never changes once created.
+ * Copying a VideoFrame only copies a reference: the display, the recorders and the snapshots share
+ * the same pixels from any thread, and the pixels live as long as one of them keeps the frame.
+ * The image returned by get_image() must only be read.
+ */
+class VideoFrame
+{
+public:
+    VideoFrame();
+
+    bool empty() const;
+    const cv::Mat& get_image() const;
+    unsigned long long get_sequence() const;
+    unsigned long long get_timestamp() const;
+    int get_format() const;
+    cv::Size get_size() const;
+    long get_use_count() const;
+
+private:
+    friend class VideoFramePool;
+
+    struct Data {
+        cv::Mat image;
+        unsigned long long sequence;
+        unsigned long long timestamp;   // microseconds of std::chrono::steady_clock
+    };
+
+    std::shared_ptr<const Data> data;
+};
+
+/**
+ * @brief The VideoFramePool class
+ *
+ * Creates the VideoFrame objects in recycled buffers: the buffer of a frame comes back to the pool
+ * when the last reference to the frame is released, in any thread. Thread-safe.
+ */
+class VideoFramePool
+{
+public:
+    explicit VideoFramePool(int max_buffers=16);
+
+    cv::Mat acquire(cv::Size size, int type);
+    VideoFrame freeze(cv::Mat &buffer, unsigned long long sequence);
+    VideoFrame create(const cv::Mat &image, unsigned long long sequence);
+    static VideoFrame share(const cv::Mat &image, unsigned long long sequence);
+
+    unsigned long long get_allocations();
+    int get_number_buffers();
+
+private:
+    struct Recycler {
+        std::mutex lock;
+        std::vector<cv::Mat> buffers;   // free buffers, referenced by nothing else
+        size_t max_buffers;
+    };
+
+    std::shared_ptr<Recycler> recycler; // shared with the frames, which may outlive the pool
+    std::atomic<unsigned long long> allocations;
+};
+
+#endif // VIDEOFRAME_H
@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+ *
+ * PURPOSE
+ *  The thread that encodes the recorded video. It is decoupled from the image processing through
+ *  a FrameRingBuffer so that the time spent in the codec is not added to every frame.
+ *  No Qt thing here.
+*/
+
+#include "videorecorder.h"
+
+#include <cassert>
+#include <chrono>
+
+/**
+ * @brief VideoRecorder::VideoRecorder
+ * @param capacity: integer the number of frames that can wait for the encoder
+ * @param policy: integer FrameRingBuffer::DROP_OLDEST to drop frames when the encoder falls behind,
+ *                FrameRingBuffer::BLOCK to make the processing wait for it
+ *
+ * Constructor of the class VideoRecorder. The thread is launched by start()
+ */
+VideoRecorder::VideoRecorder(int capacity, int policy) : queue(capacity, FrameRingBuffer::DROP_OLDEST),
+                                                         running(false),
+                                                         max_depth(0),
+                                                         encoded(0),
+                                                         encode_us(0),
+                                                         max_encode_us(0)
+{
+    set_policy(policy);
+}
+
+/**
+ * @brief VideoRecorder::~VideoRecorder
+ *
+ * Stop the thread and close the file before destroying the object
+ */
+VideoRecorder::~VideoRecorder() {
+    stop();
+}
+
+/**
+ * @brief VideoRecorder::start
+ * @param filename: string the video file, its extension selects the container
+ * @param fourcc: integer the codec (cv::VideoWriter::fourcc)
+ * @param fps: double the frame rate written in the file
+ * @param size: cv::Size the dimensions of the frames
+ * @return true if the file could be created and the thread has been launched
+ */
+bool VideoRecorder::start(const std::string &filename, int fourcc, double fps, cv::Size size) {
+    stop();
+    if (!this->writer.open(filename, fourcc, fps, size, true))
+        return false;
+    launch(filename, size);
+    return true;
+}
+
+/**
+ * @brief VideoRecorder::start_stream
+ * @param pipeline: string a GStreamer pipeline beginning with appsrc, for instance
+ *                  "appsrc ! videoconvert ! x264enc tune=zerolatency ! rtph264pay ! udpsink host=127.0.0.1 port=5000"
+ * @param fps: double the frame rate of the stream
+ * @param size: cv::Size the dimensions of the frames
+ * @return true if OpenCV could open the pipeline (it must be built with GStreamer) and the thread has been launched
+ */
+bool VideoRecorder::start_stream(const std::string &pipeline, double fps, cv::Size size) {
+    stop();
+    if (!this->writer.open(pipeline, cv::CAP_GSTREAMER, 0, fps, size, true))
+        return false;
+    launch(pipeline, size);
+    return true;
+}
+
+/**
+ * @brief VideoRecorder::launch
+ * @param filename: string the destination opened by this->writer
+ * @param size: cv::Size the dimensions of the frames
+ *
+ * Prepare the queue and launch the thread of the encoder
+ */
+void VideoRecorder::launch(const std::string &filename, cv::Size size) {
+    this->filename   = filename;
+    this->frame_size = size;
+    this->queue.allocate(size, CV_8UC3);
+    this->queue.reset_counters();
+    this->queue.reopen();
+    this->max_depth     = 0;
+    this->encoded       = 0;
+    this->encode_us     = 0;
+    this->max_encode_us = 0;
+    this->running = true;
+    this->thread = std::thread(&VideoRecorder::run, this);
+}
+
+/**
+ * @brief VideoRecorder::stop
+ *
+ * The frames still in the queue are encoded, then the file is closed
+ */
+void VideoRecorder::stop() {
+    this->running = false;
+    if (this->thread.joinable())
+        this->thread.join();
+    // Release a producer blocked on a full queue, nobody consumes it anymore
+    this->queue.close();
+    if (this->writer.isOpened())
+        this->writer.release();
+}
+
+/**
+ * @brief VideoRecorder::isRunning
+ * @return true if a video is being recorded
+ */
+bool VideoRecorder::isRunning() {
+    return this->running;
+}
+
+/**
+ * @brief VideoRecorder::push
+ * @param frame: cv::Mat the frame to record (BGR or gray), copied into a buffer of the queue
+ * @return true if the frame has been queued
+ *
+ * Called by the processing thread only. With the policy DROP_OLDEST the oldest waiting frame is
+ * discarded when the queue is full, with BLOCK the call waits for the encoder.
+ */
+bool VideoRecorder::push(const cv::Mat &frame) {
+    if (!this->running || frame.empty())
+        return false;
+
+    // The codec receives colour frames of the size given to start()
+    const cv::Mat *colour = &frame;
+    if (frame.channels() == 1) {
+        cv::cvtColor(frame, this->converted, cv::COLOR_GRAY2BGR);
+        colour = &this->converted;
+    }
+    // The buffer given back by the queue may still be shared by a VideoFrame
+    if (this->staging.u != nullptr && this->staging.u->refcount > 1)
+        this->staging.release();
+    if (colour->size() != this->frame_size)
+        cv::resize(*colour, this->staging, this->frame_size);
+    else
+        colour->copyTo(this->staging);
+
+    bool queued = this->queue.push(this->staging);
+    int depth = this->queue.get_size();
+    if (depth > this->max_depth)
+        this->max_depth = depth;
+    return queued;
+}
+
+/**
+ * @brief VideoRecorder::push
+ * @param frame: VideoFrame the frame to record, shared with the queue if it is a colour frame of the size of the video
+ * @return true if the frame has been queued
+ *
+ * Called by the processing thread only. The encoder only reads the pixels of the frame.
+ */
+bool VideoRecorder::push(const VideoFrame &frame) {
+    const cv::Mat &image = frame.get_image();
+    if (image.channels() != 3 || image.size() != this->frame_size)
+        return push(image);
+    if (!this->running)
+        return false;
+
+    cv::Mat shared = image;
+    bool queued = this->queue.push(shared);
+    int depth = this->queue.get_size();
+    if (depth > this->max_depth)
+        this->max_depth = depth;
+    return queued;
+}
+
+/**
+ * @brief VideoRecorder::set_policy
+ * @param policy: integer FrameRingBuffer::DROP_OLDEST or FrameRingBuffer::BLOCK
+ */
+void VideoRecorder::set_policy(int policy) {
+    assert(policy==FrameRingBuffer::DROP_OLDEST || policy==FrameRingBuffer::BLOCK);
+    this->queue.set_policy(policy == FrameRingBuffer::BLOCK ? FrameRingBuffer::BLOCK : FrameRingBuffer::DROP_OLDEST);
+}
+
+/**
+ * @brief VideoRecorder::get_policy
+ * @return the behaviour when the encoder falls behind
+ */
+int VideoRecorder::get_policy() {
+    return this->queue.get_policy();
+}
+
+/**
+ * @brief VideoRecorder::get_filename
+ * @return the name of the last recorded video
+ */
+std::string VideoRecorder::get_filename() {
+    return this->filename;
+}
+
+/**
+ * @brief VideoRecorder::get_queue_depth
+ * @return the number of frames waiting for the encoder
+ */
+int VideoRecorder::get_queue_depth() {
+    return this->queue.get_size();
+}
+
+/**
+ * @brief VideoRecorder::get_max_queue_depth
+ * @return the largest number of frames that waited for the encoder since start()
+ */
+int VideoRecorder::get_max_queue_depth() {
+    return this->max_depth;
+}
+
+/**
+ * @brief VideoRecorder::get_encoded_frames
+ * @return the number of frames written in the file since start()
+ */
+unsigned long long VideoRecorder::get_encoded_frames() {
+    return this->encoded;
+}
+
+/**
+ * @brief VideoRecorder::get_dropped_frames
+ * @return the number of frames discarded because the encoder fell behind
+ */
+unsigned long long VideoRecorder::get_dropped_frames() {
+    return this->queue.get_dropped_frames();
+}
+
+/**
+ * @brief VideoRecorder::get_mean_encode_ms
+ * @return the mean encoding time of a frame in milliseconds
+ */
+double VideoRecorder::get_mean_encode_ms() {
+    unsigned long long frames = this->encoded;
+    return frames > 0 ? this->encode_us / 1000. / frames : 0.;
+}
+
+/**
+ * @brief VideoRecorder::get_max_encode_ms
+ * @return the longest encoding time of a frame in milliseconds
+ */
+double VideoRecorder::get_max_encode_ms() {
+    return this->max_encode_us / 1000.;
+}
+
+/**
+ * @brief VideoRecorder::run
+ *
+ * Loop of the thread: encode the queued frames until stop() is called and the queue is empty
+ */
+void VideoRecorder::run() {
+    cv::Mat frame;
+    while (true) {
+        // Read running before popping, so that the frames pushed before stop() are not lost
+        bool active = this->running;
+        if (!this->queue.pop(frame, 20)) {
+            if (!active)
+                break;
+            continue;
+        }
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        this->writer.write(frame);
+        unsigned long long us = (unsigned long long) std::chrono::duration_cast<std::chrono::microseconds>(
+                                    std::chrono::steady_clock::now() - start).count();
+        this->encode_us += us;
+        if (us > this->max_encode_us)
+            this->max_encode_us = us;
+        this->encoded++;
+    }
+}
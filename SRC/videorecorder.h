@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2019-2020 Xavier Dechamps
+*/
+
+#ifndef VIDEORECORDER_H
+#define VIDEORECORDER_H
+
+#include "opencv2/core.hpp"
+#include "opencv2/videoio.hpp"
+#include "framebuffer.h"
+#include "videoframe.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+/**
+ * @brief The VideoRecorder class
+ *
+ * Dedicated thread that encodes the recorded frames into a video file, or into a GStreamer pipeline
+ * for a stream. The frames are queued in a bounded FrameRingBuffer by the processing thread (shared
+ * if they are VideoFrame objects of the size of the video, copied otherwise), which never waits for
+ * the encoder unless the policy is FrameRingBuffer::BLOCK.
+ */
+class VideoRecorder
+{
+public:
+    explicit VideoRecorder(int capacity=8, int policy=FrameRingBuffer::DROP_OLDEST);
+    ~VideoRecorder();
+
+    bool start(const std::string &filename, int fourcc, double fps, cv::Size size);
+    bool start_stream(const std::string &pipeline, double fps, cv::Size size);
+    void stop();
+    bool isRunning();
+    bool push(const cv::Mat &frame);
+    bool push(const VideoFrame &frame);
+
+    void set_policy(int policy);
+    int get_policy();
+    std::string get_filename();
+
+    int get_queue_depth();
+    int get_max_queue_depth();
+    unsigned long long get_encoded_frames();
+    unsigned long long get_dropped_frames();
+    double get_mean_encode_ms();
+    double get_max_encode_ms();
+
+private:
+    FrameRingBuffer queue;
+    cv::Mat staging;              // buffer recycled by the ring, filled by push()
+    cv::Mat converted;            // gray frames expanded to 3 channels
+    cv::VideoWriter writer;
+    cv::Size frame_size;
+    std::string filename;
+    std::thread thread;
+    std::atomic<bool> running;
+    std::atomic<int> max_depth;
+    std::atomic<unsigned long long> encoded, encode_us, max_encode_us;
+
+    void launch(const std::string &filename, cv::Size size);
+    void run();
+};
+
+#endif // VIDEORECORDER_H